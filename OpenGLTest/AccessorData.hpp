@@ -0,0 +1,189 @@
+#pragma once
+#include "GLTF.hpp"
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// CPU access to accessor data, independent of OpenGL so runtimes can read animation, skin and morph data directly
+namespace GLTF {
+	/// <summary>
+	/// Loaded bytes of a buffer, indexed the same as GLTFDoc::buffers.
+	/// </summary>
+	struct BufferSpan {
+		unsigned char const* data = nullptr;
+		size_t size = 0;
+
+		BufferSpan() = default;
+
+		BufferSpan(unsigned char const* _data, size_t _size) : data(_data), size(_size) {
+
+		}
+
+		BufferSpan(std::vector<unsigned char> const& bytes) : data(bytes.data()), size(bytes.size()) {
+
+		}
+	};
+
+	inline float Read_Component_Float(unsigned char const* source, integer_type componentType, bool normalized) {
+		switch (componentType) {
+		case Enumerations::ComponentType::Byte: {
+			signed char value = static_cast<signed char>(*source);
+			return normalized ? std::max(float(value) / 127.0f, -1.0f) : float(value);
+		}
+		case Enumerations::ComponentType::Unsigned_Byte:
+			return normalized ? float(*source) / 255.0f : float(*source);
+		case Enumerations::ComponentType::Short: {
+			short value;
+			memcpy(&value, source, sizeof(value));
+			return normalized ? std::max(float(value) / 32767.0f, -1.0f) : float(value);
+		}
+		case Enumerations::ComponentType::Unsigned_Short: {
+			unsigned short value;
+			memcpy(&value, source, sizeof(value));
+			return normalized ? float(value) / 65535.0f : float(value);
+		}
+		case Enumerations::ComponentType::Int: {
+			int value;
+			memcpy(&value, source, sizeof(value));
+			return float(value);
+		}
+		case Enumerations::ComponentType::Unsigned_Int: {
+			unsigned int value;
+			memcpy(&value, source, sizeof(value));
+			return float(value);
+		}
+		case Enumerations::ComponentType::Float: {
+			float value;
+			memcpy(&value, source, sizeof(value));
+			return value;
+		}
+		}
+		return 0.0f;
+	}
+
+	inline unsigned int Read_Component_Unsigned(unsigned char const* source, integer_type componentType, bool) {
+		switch (componentType) {
+		case Enumerations::ComponentType::Byte:
+		case Enumerations::ComponentType::Unsigned_Byte:
+			return *source;
+		case Enumerations::ComponentType::Short:
+		case Enumerations::ComponentType::Unsigned_Short: {
+			unsigned short value;
+			memcpy(&value, source, sizeof(value));
+			return value;
+		}
+		case Enumerations::ComponentType::Int:
+		case Enumerations::ComponentType::Unsigned_Int: {
+			unsigned int value;
+			memcpy(&value, source, sizeof(value));
+			return value;
+		}
+		case Enumerations::ComponentType::Float: {
+			float value;
+			memcpy(&value, source, sizeof(value));
+			return static_cast<unsigned int>(value);
+		}
+		}
+		return 0;
+	}
+
+	/// <summary>
+	/// Reads every component of an accessor into a tightly packed array, sparse values are applied.
+	/// Matrix columns of byte and short accessors are padded to 4 bytes in the buffer, the padding is skipped.
+	/// </summary>
+	/// <returns>count * ComponentCount() values, zero initialized if the accessor has no bufferView</returns>
+	template <class _Ty>
+	inline std::vector<_Ty> Read_Accessor(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, Accessor const& accessor,
+		_Ty(*convert)(unsigned char const*, integer_type, bool)) {
+		unsigned componentCount = accessor.ComponentCount();
+		size_t componentSize = accessor.BytesPerComponent();
+		if (componentCount == 0 || componentSize == 0) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": accessor '" + accessor.name + "' has an invalid type or componentType.");
+		}
+
+		unsigned rows = componentCount;
+		unsigned columns = 1;
+		switch (accessor.type) {
+		case Accessor::Type::Mat2x2:
+			rows = columns = 2;
+			break;
+		case Accessor::Type::Mat3x3:
+			rows = columns = 3;
+			break;
+		case Accessor::Type::Mat4x4:
+			rows = columns = 4;
+			break;
+		default:
+			break;
+		}
+
+		size_t columnStride = rows * componentSize;
+		if (columns > 1) {
+			columnStride = (columnStride + 3) & ~size_t(3);
+		}
+		size_t elementSize = columnStride * columns;
+
+		std::vector<_Ty> result(size_t(accessor.count) * componentCount, _Ty());
+
+		auto readElements = [&](index_type bufferViewIndex, size_t byteOffset, size_t count, auto&& destinationOf) {
+			BufferView const& bufferView = doc.bufferViews.at(bufferViewIndex);
+			BufferSpan const& buffer = buffers.at(bufferView.buffer);
+			size_t stride = bufferView.byteStride > 0 ? size_t(bufferView.byteStride) : elementSize;
+			size_t start = size_t(bufferView.byteOffset) + byteOffset;
+
+			if (size_t(bufferView.byteOffset) + size_t(bufferView.byteLength) > buffer.size ||
+				(count > 0 && byteOffset + stride * (count - 1) + elementSize > size_t(bufferView.byteLength))) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": accessor '" + accessor.name + "' reads outside of its bufferView.");
+			}
+
+			for (size_t element = 0; element < count; ++element) {
+				unsigned char const* source = buffer.data + start + element * stride;
+				_Ty* destination = destinationOf(element);
+				for (unsigned column = 0; column < columns; ++column) {
+					for (unsigned row = 0; row < rows; ++row) {
+						destination[column * rows + row] = convert(source + column * columnStride + row * componentSize, accessor.componentType, accessor.normalized);
+					}
+				}
+			}
+		};
+
+		if (accessor.bufferView != index_type(-1)) {
+			readElements(accessor.bufferView, size_t(accessor.byteOffset), size_t(accessor.count), [&](size_t element) {
+				return result.data() + element * componentCount;
+			});
+		}
+
+		if (accessor.sparse.definedInFile && accessor.sparse.count > 0) {
+			Accessor::Sparse const& sparse = accessor.sparse;
+			Accessor indices;
+			indices.componentType = sparse.indices.componentType;
+			indices.count = sparse.count;
+			indices.type = Accessor::Type::Scalar;
+			indices.bufferView = sparse.indices.bufferView;
+			indices.byteOffset = sparse.indices.byteOffset;
+
+			std::vector<unsigned int> targets = Read_Accessor<unsigned int>(doc, buffers, indices, &Read_Component_Unsigned);
+			for (unsigned int target : targets) {
+				if (target >= size_t(accessor.count)) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": accessor '" + accessor.name + "' sparse index out of range.");
+				}
+			}
+
+			readElements(sparse.values.bufferView, size_t(sparse.values.byteOffset), size_t(sparse.count), [&](size_t element) {
+				return result.data() + size_t(targets[element]) * componentCount;
+			});
+		}
+
+		return result;
+	}
+
+	inline std::vector<float> Read_Accessor_Float(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, index_type accessorIndex) {
+		return Read_Accessor<float>(doc, buffers, doc.accessors.at(accessorIndex), &Read_Component_Float);
+	}
+
+	inline std::vector<unsigned int> Read_Accessor_Unsigned(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, index_type accessorIndex) {
+		return Read_Accessor<unsigned int>(doc, buffers, doc.accessors.at(accessorIndex), &Read_Component_Unsigned);
+	}
+}
@@ -0,0 +1,578 @@
+#pragma once
+#include "AccessorData.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Per component minimum and maximum of accessor data, used to fill in missing Accessor::min/max and to check the declared ones
+namespace GLTF {
+	// Elements reduced by one task, accessors larger than this are split across the pool
+	constexpr size_t RANGE_CHUNK_ELEMENTS = 1 << 16;
+	// Float bounds are rounded when exporters write them to JSON, relative to the magnitude of the value
+	constexpr double RANGE_TOLERANCE = 1e-5;
+
+	enum class RangeStatus {
+		// Accessor has no min/max, or not one value per component
+		Missing,
+		// Declared bounds match the data
+		Exact,
+		// Declared bounds contain the data but are wider than it
+		Conservative,
+		// Data lies outside of the declared bounds
+		Invalid
+	};
+
+	/// <summary>
+	/// Minimum and maximum of each component.
+	/// As with Accessor::min/max these are the stored values, normalized is not applied, see Normalized_Range.
+	/// </summary>
+	struct AccessorRange {
+		std::vector<number_type> minimum;
+		std::vector<number_type> maximum;
+
+		AccessorRange() = default;
+		AccessorRange(AccessorRange const&) = default;
+		AccessorRange(AccessorRange&&) = default;
+
+		AccessorRange& operator=(AccessorRange const&) = default;
+		AccessorRange& operator=(AccessorRange&&) = default;
+
+		bool Empty() const {
+			return minimum.empty();
+		}
+	};
+
+	/// <summary>
+	/// Vector operations for reducing one component type, specialized for the types the instruction set can compare.
+	/// AVX2 selects the 8-wide specializations, see Simd::Has_Avx2.
+	/// </summary>
+	template <class _Ty, bool AVX2>
+	struct RangeLanes {
+		static constexpr bool SIMD = false;
+	};
+
+#if defined(SIMD_AVX2)
+	template <>
+	struct RangeLanes<float, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 8;
+		using vector_type = __m256;
+		static vector_type Splat(float value) { return _mm256_set1_ps(value); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_ps(reinterpret_cast<float const*>(source)); }
+		static void Store(float* destination, vector_type value) { _mm256_storeu_ps(destination, value); }
+		// The loaded value goes first, minps returns the second operand for NaN so NaNs never reach the result
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_ps(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_ps(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<signed char, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 32;
+		using vector_type = __m256i;
+		static vector_type Splat(signed char value) { return _mm256_set1_epi8(value); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source)); }
+		static void Store(signed char* destination, vector_type value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_epi8(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_epi8(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<unsigned char, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 32;
+		using vector_type = __m256i;
+		static vector_type Splat(unsigned char value) { return _mm256_set1_epi8(char(value)); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source)); }
+		static void Store(unsigned char* destination, vector_type value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_epu8(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_epu8(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<short, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 16;
+		using vector_type = __m256i;
+		static vector_type Splat(short value) { return _mm256_set1_epi16(value); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source)); }
+		static void Store(short* destination, vector_type value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_epi16(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_epi16(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<unsigned short, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 16;
+		using vector_type = __m256i;
+		static vector_type Splat(unsigned short value) { return _mm256_set1_epi16(short(value)); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source)); }
+		static void Store(unsigned short* destination, vector_type value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_epu16(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_epu16(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<int, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 8;
+		using vector_type = __m256i;
+		static vector_type Splat(int value) { return _mm256_set1_epi32(value); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source)); }
+		static void Store(int* destination, vector_type value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_epi32(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_epi32(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<unsigned int, true> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 8;
+		using vector_type = __m256i;
+		static vector_type Splat(unsigned int value) { return _mm256_set1_epi32(int(value)); }
+		static vector_type Load(unsigned char const* source) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source)); }
+		static void Store(unsigned int* destination, vector_type value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm256_min_epu32(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm256_max_epu32(value, current); }
+	};
+#endif
+
+#if defined(SIMD_SSE)
+	// Only SSE2 compares are used, signed bytes and 32 bit integers select on a compare and unsigned shorts are biased to signed
+	template <>
+	struct RangeLanes<float, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 4;
+		using vector_type = __m128;
+		static vector_type Splat(float value) { return _mm_set1_ps(value); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_ps(reinterpret_cast<float const*>(source)); }
+		static void Store(float* destination, vector_type value) { _mm_storeu_ps(destination, value); }
+		// The loaded value goes first, minps returns the second operand for NaN so NaNs never reach the result
+		static vector_type Min(vector_type value, vector_type current) { return _mm_min_ps(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm_max_ps(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<signed char, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 16;
+		using vector_type = __m128i;
+		static vector_type Splat(signed char value) { return _mm_set1_epi8(value); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)); }
+		static void Store(signed char* destination, vector_type value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), value); }
+		static vector_type Select(vector_type mask, vector_type a, vector_type b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+		static vector_type Min(vector_type value, vector_type current) { return Select(_mm_cmplt_epi8(value, current), value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return Select(_mm_cmpgt_epi8(value, current), value, current); }
+	};
+
+	template <>
+	struct RangeLanes<unsigned char, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 16;
+		using vector_type = __m128i;
+		static vector_type Splat(unsigned char value) { return _mm_set1_epi8(char(value)); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)); }
+		static void Store(unsigned char* destination, vector_type value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm_min_epu8(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm_max_epu8(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<short, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 8;
+		using vector_type = __m128i;
+		static vector_type Splat(short value) { return _mm_set1_epi16(value); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)); }
+		static void Store(short* destination, vector_type value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm_min_epi16(value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm_max_epi16(value, current); }
+	};
+
+	template <>
+	struct RangeLanes<unsigned short, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 8;
+		using vector_type = __m128i;
+		static vector_type Bias() { return _mm_set1_epi16(short(0x8000)); }
+		static vector_type Splat(unsigned short value) { return _mm_set1_epi16(short(value)); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)); }
+		static void Store(unsigned short* destination, vector_type value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), value); }
+		static vector_type Min(vector_type value, vector_type current) { return _mm_xor_si128(_mm_min_epi16(_mm_xor_si128(value, Bias()), _mm_xor_si128(current, Bias())), Bias()); }
+		static vector_type Max(vector_type value, vector_type current) { return _mm_xor_si128(_mm_max_epi16(_mm_xor_si128(value, Bias()), _mm_xor_si128(current, Bias())), Bias()); }
+	};
+
+	template <>
+	struct RangeLanes<int, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 4;
+		using vector_type = __m128i;
+		static vector_type Splat(int value) { return _mm_set1_epi32(value); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)); }
+		static void Store(int* destination, vector_type value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), value); }
+		static vector_type Select(vector_type mask, vector_type a, vector_type b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+		static vector_type Min(vector_type value, vector_type current) { return Select(_mm_cmplt_epi32(value, current), value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return Select(_mm_cmpgt_epi32(value, current), value, current); }
+	};
+
+	template <>
+	struct RangeLanes<unsigned int, false> {
+		static constexpr bool SIMD = true;
+		static constexpr size_t LANES = 4;
+		using vector_type = __m128i;
+		static vector_type Bias() { return _mm_set1_epi32(int(0x80000000u)); }
+		static vector_type Splat(unsigned int value) { return _mm_set1_epi32(int(value)); }
+		static vector_type Load(unsigned char const* source) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)); }
+		static void Store(unsigned int* destination, vector_type value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), value); }
+		static vector_type Select(vector_type mask, vector_type a, vector_type b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+		static vector_type Min(vector_type value, vector_type current) { return Select(_mm_cmplt_epi32(_mm_xor_si128(value, Bias()), _mm_xor_si128(current, Bias())), value, current); }
+		static vector_type Max(vector_type value, vector_type current) { return Select(_mm_cmpgt_epi32(_mm_xor_si128(value, Bias()), _mm_xor_si128(current, Bias())), value, current); }
+	};
+#endif
+
+	// Range_Elements with the lanes of one instruction set, components without a specialization take the scalar loop
+	template <class _Ty, bool AVX2>
+	inline void Range_Elements_Lanes(unsigned char const* data, size_t count, size_t stride, unsigned componentCount, _Ty* minimum, _Ty* maximum) {
+		std::fill(minimum, minimum + componentCount, std::numeric_limits<_Ty>::max());
+		std::fill(maximum, maximum + componentCount, std::numeric_limits<_Ty>::lowest());
+		size_t elementSize = componentCount * sizeof(_Ty);
+		size_t element = 0;
+
+		if constexpr (RangeLanes<_Ty, AVX2>::SIMD) {
+			using Lanes = RangeLanes<_Ty, AVX2>;
+			using vector_type = typename Lanes::vector_type;
+			constexpr size_t LANES = Lanes::LANES;
+			_Ty lanes[LANES];
+
+			if (stride == elementSize) {
+				// Packed, a block of 'registers' vectors holds whole elements so every lane keeps the same component
+				size_t registers = componentCount / std::gcd(size_t(componentCount), LANES);
+				size_t blockElements = registers * LANES / componentCount;
+				size_t blocks = count / blockElements;
+				if (blocks > 0) {
+					vector_type low[16];
+					vector_type high[16];
+					for (size_t index = 0; index < registers; ++index) {
+						low[index] = Lanes::Splat(std::numeric_limits<_Ty>::max());
+						high[index] = Lanes::Splat(std::numeric_limits<_Ty>::lowest());
+					}
+					unsigned char const* source = data;
+					for (size_t block = 0; block < blocks; ++block) {
+						for (size_t index = 0; index < registers; ++index) {
+							vector_type value = Lanes::Load(source + index * LANES * sizeof(_Ty));
+							low[index] = Lanes::Min(value, low[index]);
+							high[index] = Lanes::Max(value, high[index]);
+						}
+						source += registers * LANES * sizeof(_Ty);
+					}
+					for (size_t index = 0; index < registers; ++index) {
+						Lanes::Store(lanes, low[index]);
+						for (size_t lane = 0; lane < LANES; ++lane) {
+							size_t component = (index * LANES + lane) % componentCount;
+							minimum[component] = std::min(minimum[component], lanes[lane]);
+						}
+						Lanes::Store(lanes, high[index]);
+						for (size_t lane = 0; lane < LANES; ++lane) {
+							size_t component = (index * LANES + lane) % componentCount;
+							maximum[component] = std::max(maximum[component], lanes[lane]);
+						}
+					}
+					element = blocks * blockElements;
+				}
+			}
+			else if (elementSize <= LANES * sizeof(_Ty) && stride + elementSize >= LANES * sizeof(_Ty) && count > 1) {
+				// Interleaved, one vector per element, the lanes past the element read the next one and are dropped.
+				// The last element is left to the scalar loop so the load never passes the end of the data.
+				vector_type low = Lanes::Splat(std::numeric_limits<_Ty>::max());
+				vector_type high = Lanes::Splat(std::numeric_limits<_Ty>::lowest());
+				for (; element + 1 < count; ++element) {
+					vector_type value = Lanes::Load(data + element * stride);
+					low = Lanes::Min(value, low);
+					high = Lanes::Max(value, high);
+				}
+				Lanes::Store(lanes, low);
+				std::copy(lanes, lanes + componentCount, minimum);
+				Lanes::Store(lanes, high);
+				std::copy(lanes, lanes + componentCount, maximum);
+			}
+		}
+
+		for (; element < count; ++element) {
+			unsigned char const* source = data + element * stride;
+			for (unsigned component = 0; component < componentCount; ++component) {
+				_Ty value;
+				memcpy(&value, source + component * sizeof(_Ty), sizeof(value));
+				// Written as compares so float NaNs fail both
+				if (value < minimum[component]) {
+					minimum[component] = value;
+				}
+				if (value > maximum[component]) {
+					maximum[component] = value;
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Minimum and maximum of each component over 'count' elements 'stride' bytes apart, on the calling thread.
+	/// Float NaNs are ignored.
+	/// </summary>
+	/// <param name="minimum">componentCount values, overwritten</param>
+	/// <param name="maximum">componentCount values, overwritten</param>
+	template <class _Ty>
+	inline void Range_Elements(unsigned char const* data, size_t count, size_t stride, unsigned componentCount, _Ty* minimum, _Ty* maximum) {
+		if (Simd::Has_Avx2()) {
+			Range_Elements_Lanes<_Ty, true>(data, count, stride, componentCount, minimum, maximum);
+		}
+		else {
+			Range_Elements_Lanes<_Ty, false>(data, count, stride, componentCount, minimum, maximum);
+		}
+	}
+
+	/// <summary>
+	/// Range_Elements split into chunks of RANGE_CHUNK_ELEMENTS across 'pool', chunks are merged in order.
+	/// </summary>
+	template <class _Ty>
+	inline void Component_Range(unsigned char const* data, size_t count, size_t stride, unsigned componentCount, _Ty* minimum, _Ty* maximum, ThreadPool* pool = nullptr) {
+		size_t chunks = (count + RANGE_CHUNK_ELEMENTS - 1) / RANGE_CHUNK_ELEMENTS;
+		if (pool == nullptr || chunks <= 1) {
+			Range_Elements(data, count, stride, componentCount, minimum, maximum);
+			return;
+		}
+
+		std::vector<_Ty> chunkMinimum(chunks * componentCount);
+		std::vector<_Ty> chunkMaximum(chunks * componentCount);
+		pool->Parallel_For(chunks, 1, [&](size_t begin, size_t end) {
+			for (size_t chunk = begin; chunk < end; ++chunk) {
+				size_t first = chunk * RANGE_CHUNK_ELEMENTS;
+				Range_Elements(data + first * stride, std::min(RANGE_CHUNK_ELEMENTS, count - first), stride, componentCount,
+					chunkMinimum.data() + chunk * componentCount, chunkMaximum.data() + chunk * componentCount);
+			}
+		});
+
+		std::copy(chunkMinimum.begin(), chunkMinimum.begin() + componentCount, minimum);
+		std::copy(chunkMaximum.begin(), chunkMaximum.begin() + componentCount, maximum);
+		for (size_t chunk = 1; chunk < chunks; ++chunk) {
+			for (unsigned component = 0; component < componentCount; ++component) {
+				minimum[component] = std::min(minimum[component], chunkMinimum[chunk * componentCount + component]);
+				maximum[component] = std::max(maximum[component], chunkMaximum[chunk * componentCount + component]);
+			}
+		}
+	}
+
+	template <class _Ty>
+	inline _Ty Read_Component_Raw(unsigned char const* source, integer_type, bool) {
+		_Ty value;
+		memcpy(&value, source, sizeof(value));
+		return value;
+	}
+
+	template <class _Ty>
+	inline AccessorRange Accessor_Range(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, Accessor const& accessor, ThreadPool* pool) {
+		unsigned componentCount = accessor.ComponentCount();
+		size_t count = size_t(accessor.count);
+		std::vector<_Ty> minimum(componentCount);
+		std::vector<_Ty> maximum(componentCount);
+
+		// Byte and short matrices pad their columns to 4 bytes
+		bool padded = false;
+		switch (accessor.type) {
+		case Accessor::Type::Mat2x2:
+			padded = (2 * sizeof(_Ty)) % 4 != 0;
+			break;
+		case Accessor::Type::Mat3x3:
+			padded = (3 * sizeof(_Ty)) % 4 != 0;
+			break;
+		default:
+			break;
+		}
+
+		if (accessor.bufferView != index_type(-1) && !accessor.sparse.definedInFile && !padded) {
+			// Reduced in place in the buffer
+			BufferView const& bufferView = doc.bufferViews.at(accessor.bufferView);
+			BufferSpan const& buffer = buffers.at(bufferView.buffer);
+			size_t elementSize = componentCount * sizeof(_Ty);
+			size_t stride = bufferView.byteStride > 0 ? size_t(bufferView.byteStride) : elementSize;
+			if (size_t(bufferView.byteOffset) + size_t(bufferView.byteLength) > buffer.size ||
+				size_t(accessor.byteOffset) + stride * (count - 1) + elementSize > size_t(bufferView.byteLength)) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": accessor '" + accessor.name + "' reads outside of its bufferView.");
+			}
+			Component_Range(buffer.data + size_t(bufferView.byteOffset) + size_t(accessor.byteOffset), count, stride, componentCount, minimum.data(), maximum.data(), pool);
+		}
+		else {
+			// Sparse, bufferless and padded accessors are unpacked first, the range is of the values after substitution
+			std::vector<_Ty> values = Read_Accessor<_Ty>(doc, buffers, accessor, &Read_Component_Raw<_Ty>);
+			Component_Range(reinterpret_cast<unsigned char const*>(values.data()), count, componentCount * sizeof(_Ty), componentCount, minimum.data(), maximum.data(), pool);
+		}
+
+		AccessorRange range;
+		range.minimum.assign(minimum.begin(), minimum.end());
+		range.maximum.assign(maximum.begin(), maximum.end());
+		return range;
+	}
+
+	/// <summary>
+	/// Minimum and maximum of each component of an accessor, with sparse values applied.
+	/// </summary>
+	/// <returns>Empty for accessors without elements</returns>
+	inline AccessorRange Compute_Accessor_Range(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, Accessor const& accessor, ThreadPool* pool = nullptr) {
+		if (accessor.count <= 0) {
+			return AccessorRange();
+		}
+		if (accessor.ComponentCount() == 0) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": accessor '" + accessor.name + "' has an invalid type.");
+		}
+
+		switch (accessor.componentType) {
+		case Enumerations::ComponentType::Byte:
+			return Accessor_Range<signed char>(doc, buffers, accessor, pool);
+		case Enumerations::ComponentType::Unsigned_Byte:
+			return Accessor_Range<unsigned char>(doc, buffers, accessor, pool);
+		case Enumerations::ComponentType::Short:
+			return Accessor_Range<short>(doc, buffers, accessor, pool);
+		case Enumerations::ComponentType::Unsigned_Short:
+			return Accessor_Range<unsigned short>(doc, buffers, accessor, pool);
+		case Enumerations::ComponentType::Int:
+			return Accessor_Range<int>(doc, buffers, accessor, pool);
+		case Enumerations::ComponentType::Unsigned_Int:
+			return Accessor_Range<unsigned int>(doc, buffers, accessor, pool);
+		case Enumerations::ComponentType::Float:
+			return Accessor_Range<float>(doc, buffers, accessor, pool);
+		}
+		throw std::runtime_error(FILE_FUNCTION_LINE + ": accessor '" + accessor.name + "' has an invalid componentType.");
+	}
+
+	/// <summary>
+	/// Range of the values a normalized accessor decodes to, the same conversion as Read_Component_Float.
+	/// Ranges of accessors that are not normalized are returned unchanged.
+	/// </summary>
+	inline AccessorRange Normalized_Range(Accessor const& accessor, AccessorRange range) {
+		if (!accessor.normalized) {
+			return range;
+		}
+		auto normalize = [&](number_type value) -> number_type {
+			switch (accessor.componentType) {
+			case Enumerations::ComponentType::Byte:
+				return std::max(value / 127.0, -1.0);
+			case Enumerations::ComponentType::Unsigned_Byte:
+				return value / 255.0;
+			case Enumerations::ComponentType::Short:
+				return std::max(value / 32767.0, -1.0);
+			case Enumerations::ComponentType::Unsigned_Short:
+				return value / 65535.0;
+			}
+			return value;
+		};
+		for (number_type& value : range.minimum) {
+			value = normalize(value);
+		}
+		for (number_type& value : range.maximum) {
+			value = normalize(value);
+		}
+		return range;
+	}
+
+	/// <summary>
+	/// Compares the declared min/max of an accessor against the range of its data.
+	/// Integer components must match exactly, float components within RANGE_TOLERANCE.
+	/// </summary>
+	inline RangeStatus Check_Accessor_Range(Accessor const& accessor, AccessorRange const& actual) {
+		unsigned componentCount = accessor.ComponentCount();
+		if (accessor.min.size() != componentCount || accessor.max.size() != componentCount) {
+			return RangeStatus::Missing;
+		}
+		if (actual.Empty()) {
+			return RangeStatus::Exact;
+		}
+
+		bool exact = true;
+		for (unsigned component = 0; component < componentCount; ++component) {
+			double tolerance = 0.0;
+			if (accessor.componentType == Enumerations::ComponentType::Float) {
+				tolerance = RANGE_TOLERANCE * std::max({ 1.0, std::abs(actual.minimum[component]), std::abs(actual.maximum[component]) });
+			}
+			double below = actual.minimum[component] - accessor.min[component];
+			double above = accessor.max[component] - actual.maximum[component];
+			if (below < -tolerance || above < -tolerance) {
+				return RangeStatus::Invalid;
+			}
+			if (below > tolerance || above > tolerance) {
+				exact = false;
+			}
+		}
+		return exact ? RangeStatus::Exact : RangeStatus::Conservative;
+	}
+
+	/// <summary>
+	/// Computes the range of an accessor and replaces its min/max with it unless the declared bounds already match.
+	/// </summary>
+	/// <returns>Status of the bounds as declared in the file</returns>
+	inline RangeStatus Resolve_Accessor_Range(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, Accessor& accessor, ThreadPool* pool = nullptr) {
+		AccessorRange range = Compute_Accessor_Range(doc, buffers, accessor, pool);
+		RangeStatus status = Check_Accessor_Range(accessor, range);
+		if (status != RangeStatus::Exact && !range.Empty()) {
+			accessor.min = std::move(range.minimum);
+			accessor.max = std::move(range.maximum);
+		}
+		return status;
+	}
+
+	/// <summary>
+	/// Resolve_Accessor_Range over the given accessors, accessors are spread across the pool and large ones split further.
+	/// </summary>
+	/// <param name="accessors">Distinct accessor indices, only their buffers need to be in memory</param>
+	/// <returns>Status of each accessor as declared in the file, in the order of 'accessors'</returns>
+	inline std::vector<RangeStatus> Resolve_Accessor_Ranges(GLTFDoc& doc, std::vector<BufferSpan> const& buffers, std::vector<index_type> const& accessors, ThreadPool& pool) {
+		std::vector<RangeStatus> status(accessors.size(), RangeStatus::Missing);
+		pool.Parallel_For(accessors.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				status[index] = Resolve_Accessor_Range(doc, buffers, doc.accessors.at(accessors[index]), &pool);
+			}
+		});
+		return status;
+	}
+
+	/// <summary>
+	/// Resolve_Accessor_Range over every accessor of a document.
+	/// </summary>
+	/// <returns>Status of each accessor as declared in the file</returns>
+	inline std::vector<RangeStatus> Resolve_Accessor_Ranges(GLTFDoc& doc, std::vector<BufferSpan> const& buffers, ThreadPool& pool) {
+		std::vector<index_type> accessors(doc.accessors.size());
+		std::iota(accessors.begin(), accessors.end(), index_type(0));
+		return Resolve_Accessor_Ranges(doc, buffers, accessors, pool);
+	}
+
+	/// <summary>
+	/// Distinct accessors read by the primitives of a mesh: attributes, indices and morph targets.
+	/// </summary>
+	inline std::vector<index_type> Mesh_Accessors(Mesh const& mesh) {
+		std::vector<index_type> accessors;
+		for (Mesh::Primitive const& primitive : mesh.primitives) {
+			for (decltype(primitive.attributes)::const_reference attribute : primitive.attributes) {
+				accessors.emplace_back(attribute.second);
+			}
+			if (primitive.indices != index_type(-1)) {
+				accessors.emplace_back(primitive.indices);
+			}
+			for (decltype(primitive.targets)::const_reference target : primitive.targets) {
+				for (index_type accessor : target.second) {
+					if (accessor != index_type(-1)) {
+						accessors.emplace_back(accessor);
+					}
+				}
+			}
+		}
+		std::sort(accessors.begin(), accessors.end());
+		accessors.erase(std::unique(accessors.begin(), accessors.end()), accessors.end());
+		return accessors;
+	}
+}
@@ -0,0 +1,682 @@
+#pragma once
+#include "Simd.hpp"
+#include "AccessorData.hpp"
+#include "NodeTransforms.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Animation runtime, evaluates glTF animation channels of many instances into NodeTransforms
+namespace Animation {
+	enum class Interpolation : unsigned char {
+		Step,
+		Linear,
+		CubicSpline
+	};
+
+	enum class Path : unsigned char {
+		Translation,
+		Rotation,
+		Scale,
+		Weights
+	};
+
+	inline Interpolation Convert_To_Interpolation(std::string const& value) {
+		if (value == "STEP") {
+			return Interpolation::Step;
+		}
+		else if (value == "CUBICSPLINE") {
+			return Interpolation::CubicSpline;
+		}
+		return Interpolation::Linear;
+	}
+
+	inline Path Convert_To_Path(std::string const& value) {
+		if (value == GLTF::Constants::TRANSLATION) {
+			return Path::Translation;
+		}
+		else if (value == GLTF::Constants::ROTATION) {
+			return Path::Rotation;
+		}
+		else if (value == GLTF::Constants::SCALE) {
+			return Path::Scale;
+		}
+		else if (value == GLTF::Constants::WEIGHTS) {
+			return Path::Weights;
+		}
+		throw std::invalid_argument(FILE_FUNCTION_LINE + ": unknown path '" + value + "'.");
+	}
+
+	// Floats of padding after the last key so kernels can always load 4 floats
+	constexpr static size_t VALUE_PADDING = 4;
+
+	enum class Encoding : unsigned char {
+		// 'values' holds the keys
+		Float,
+		// 'packed' holds 16 bits per component, value = rangeOffset + packed * rangeScale
+		Range16,
+		// 'packed' holds 3 shorts per key, the three smallest components of a unit quaternion
+		SmallestThree48
+	};
+
+	/// <summary>
+	/// Keyframes of a sampler as contiguous floats, or quantized see AnimationCompression.hpp.
+	/// </summary>
+	struct SamplerData {
+		std::vector<float> times;
+		// 'width' floats per key, CUBICSPLINE keys hold in-tangent, value and out-tangent
+		std::vector<float> values;
+		unsigned width = 0;
+		Interpolation interpolation = Interpolation::Linear;
+
+		// Quantized keys, only used by STEP and LINEAR samplers
+		Encoding encoding = Encoding::Float;
+		std::vector<unsigned short> packed;
+		// Per component, padded to a multiple of 4
+		std::vector<float> rangeOffset;
+		std::vector<float> rangeScale;
+
+		SamplerData() = default;
+		SamplerData(SamplerData const&) = default;
+		SamplerData(SamplerData&&) = default;
+
+		SamplerData& operator=(SamplerData const&) = default;
+		SamplerData& operator=(SamplerData&&) = default;
+
+		size_t KeyCount() const {
+			return times.size();
+		}
+
+		float const* Value(size_t key) const {
+			return values.data() + (interpolation == Interpolation::CubicSpline ? key * 3 + 1 : key) * width;
+		}
+
+		float const* InTangent(size_t key) const {
+			return values.data() + (key * 3) * width;
+		}
+
+		float const* OutTangent(size_t key) const {
+			return values.data() + (key * 3 + 2) * width;
+		}
+	};
+
+	// Smallest three components lie in [-1/sqrt(2), 1/sqrt(2)], stored as 15 bit integers
+	constexpr static float SMALLEST_THREE_SCALE = 2.0f / 32767.0f * 0.70710678f;
+	constexpr static float SMALLEST_THREE_OFFSET = -0.70710678f;
+
+	/// <summary>
+	/// Unpacks one quantized key.
+	/// </summary>
+	/// <param name="destination">Room for 'width' rounded up to a multiple of 4 floats</param>
+	inline void Decode_Key(SamplerData const& sampler, size_t key, float* destination) {
+		if (sampler.encoding == Encoding::SmallestThree48) {
+			unsigned short const* source = sampler.packed.data() + key * 3;
+			unsigned largest = ((source[0] >> 15) << 1) | (source[1] >> 15);
+#ifdef SIMD_SSE
+			__m128i bits = _mm_and_si128(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(source)), _mm_set1_epi16(0x7fff));
+			__m128 small = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(bits, _mm_setzero_si128())), _mm_set1_ps(SMALLEST_THREE_SCALE)), _mm_set1_ps(SMALLEST_THREE_OFFSET));
+			// Lane 3 was read from the next key, it is replaced by the reconstructed component
+			__m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			small = _mm_and_ps(small, mask);
+			__m128 squares = _mm_mul_ps(small, small);
+			__m128 sum = _mm_add_ps(squares, _mm_movehl_ps(squares, squares));
+			sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+			__m128 w = _mm_sqrt_ss(_mm_max_ss(_mm_sub_ss(_mm_set_ss(1.0f), sum), _mm_setzero_ps()));
+			__m128 value = _mm_or_ps(small, _mm_andnot_ps(mask, _mm_shuffle_ps(w, w, _MM_SHUFFLE(0, 0, 0, 0))));
+
+			switch (largest) {
+			case 0:
+				value = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 1, 0, 3));
+				break;
+			case 1:
+				value = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 1, 3, 0));
+				break;
+			case 2:
+				value = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 1, 0));
+				break;
+			}
+			_mm_storeu_ps(destination, value);
+#else
+			float a = (source[0] & 0x7fff) * SMALLEST_THREE_SCALE + SMALLEST_THREE_OFFSET;
+			float b = (source[1] & 0x7fff) * SMALLEST_THREE_SCALE + SMALLEST_THREE_OFFSET;
+			float c = (source[2] & 0x7fff) * SMALLEST_THREE_SCALE + SMALLEST_THREE_OFFSET;
+			float w = std::sqrt(std::max(1.0f - a * a - b * b - c * c, 0.0f));
+			for (unsigned component = 0; component < 4; ++component) {
+				if (component == largest) {
+					destination[component] = w;
+				}
+				else {
+					destination[component] = a;
+					a = b;
+					b = c;
+				}
+			}
+#endif
+			return;
+		}
+
+		unsigned short const* source = sampler.packed.data() + key * sampler.width;
+		unsigned component = 0;
+#ifdef SIMD_SSE
+		for (; component < sampler.width; component += 4) {
+			// 'packed' is padded so the last key can be read 4 shorts at a time
+			__m128i bits = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(source + component)), _mm_setzero_si128());
+			__m128 value = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(bits), _mm_loadu_ps(sampler.rangeScale.data() + component)), _mm_loadu_ps(sampler.rangeOffset.data() + component));
+			_mm_storeu_ps(destination + component, value);
+		}
+#else
+		for (; component < sampler.width; ++component) {
+			destination[component] = sampler.rangeOffset[component] + float(source[component]) * sampler.rangeScale[component];
+		}
+#endif
+	}
+
+	struct ChannelData {
+		unsigned sampler;
+		unsigned node;
+		Path path;
+	};
+
+	/// <summary>
+	/// A glTF animation converted for evaluation, shared by every instance playing it.
+	/// </summary>
+	struct Clip {
+		std::string name;
+		std::vector<SamplerData> samplers;
+		std::vector<ChannelData> channels;
+		float duration = 0.0f;
+
+		Clip() = default;
+
+		Clip(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Animation const& animation) : name(animation.name) {
+			for (GLTF::Animation::Sampler const& sampler : animation.samplers) {
+				SamplerData data;
+				data.interpolation = Convert_To_Interpolation(sampler.interpolation);
+				data.times = GLTF::Read_Accessor_Float(doc, buffers, sampler.input);
+				data.values = GLTF::Read_Accessor_Float(doc, buffers, sampler.output);
+
+				size_t valuesPerKey = data.interpolation == Interpolation::CubicSpline ? 3 : 1;
+				if (data.times.empty() || data.values.size() % (data.times.size() * valuesPerKey) != 0) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": animation '" + name + "' sampler output does not match its input.");
+				}
+
+				data.width = static_cast<unsigned>(data.values.size() / (data.times.size() * valuesPerKey));
+				data.values.resize(data.values.size() + VALUE_PADDING, 0.0f);
+				duration = std::max(duration, data.times.back());
+				samplers.emplace_back(std::move(data));
+			}
+
+			for (GLTF::Animation::Channel const& channel : animation.channels) {
+				// Channels without a node are for extensions
+				if (channel.target.node == GLTF::index_type(-1)) {
+					continue;
+				}
+
+				ChannelData data;
+				data.sampler = static_cast<unsigned>(channel.sampler);
+				data.node = static_cast<unsigned>(channel.target.node);
+				data.path = Convert_To_Path(channel.target.path);
+
+				unsigned width = samplers.at(data.sampler).width;
+				if ((data.path == Path::Rotation && width != 4) || ((data.path == Path::Translation || data.path == Path::Scale) && width != 3)) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": animation '" + name + "' channel output has the wrong type for path '" + channel.target.path + "'.");
+				}
+				channels.emplace_back(data);
+			}
+		}
+
+		Clip(Clip const&) = default;
+		Clip(Clip&&) = default;
+
+		Clip& operator=(Clip const&) = default;
+		Clip& operator=(Clip&&) = default;
+
+		size_t MemoryUsage() const {
+			size_t bytes = channels.size() * sizeof(ChannelData);
+			for (SamplerData const& sampler : samplers) {
+				bytes += (sampler.times.size() + sampler.values.size() + sampler.rangeOffset.size() + sampler.rangeScale.size()) * sizeof(float);
+				bytes += sampler.packed.size() * sizeof(unsigned short);
+			}
+			return bytes;
+		}
+	};
+
+	/// <summary>
+	/// One playing clip, writes to the nodes at slot 'nodeBase' onwards.
+	/// </summary>
+	struct Instance {
+		Clip const* clip;
+		size_t nodeBase;
+		// Slot of each document node when the nodes were not added in document order (SceneGraph), replaces nodeBase
+		unsigned const* nodeSlots = nullptr;
+		float time = 0.0f;
+		float speed = 1.0f;
+		bool loop = true;
+		// Last key used by each sampler, keeps searches to a few comparisons during playback
+		std::vector<unsigned> cursors;
+
+		Instance(Clip const& _clip, size_t _nodeBase) : clip(&_clip), nodeBase(_nodeBase), cursors(_clip.samplers.size(), 0) {
+
+		}
+
+		void Advance(float deltaTime) {
+			time += deltaTime * speed;
+			if (loop && clip->duration > 0.0f) {
+				time = std::fmod(time, clip->duration);
+				if (time < 0.0f) {
+					time += clip->duration;
+				}
+			}
+			else {
+				time = std::min(std::max(time, 0.0f), clip->duration);
+			}
+		}
+	};
+
+	/// <summary>
+	/// Finds key k with times[k] <= time < times[k + 1], starting from the cached cursor.
+	/// </summary>
+	/// <param name="count">At least 2</param>
+	/// <returns>True if a binary search was needed</returns>
+	inline bool Find_Key(float const* times, size_t count, float time, unsigned& cursor) {
+		size_t last = count - 2;
+		size_t key = cursor <= last ? cursor : 0;
+
+		if (time >= times[key]) {
+			// Playback moves forward by at most a couple of keys per frame
+			for (size_t step = 0; step < 2 && key < last && time >= times[key + 1]; ++step) {
+				++key;
+			}
+			if (key == last || time < times[key + 1]) {
+				cursor = static_cast<unsigned>(key);
+				return false;
+			}
+		}
+		else if (key == 0 || time < times[1]) {
+			// Before the cursor, looping clips wrap back to the first key
+			cursor = 0;
+			return false;
+		}
+
+		size_t found = static_cast<size_t>(std::upper_bound(times, times + count, time) - times);
+		found = found == 0 ? 0 : found - 1;
+		cursor = static_cast<unsigned>(std::min(found, last));
+		return true;
+	}
+
+	inline void Copy_Values(float const* source, float* destination, unsigned width) {
+		std::copy(source, source + width, destination);
+	}
+
+	/// <summary>
+	/// destination = a + (b - a) * t, sources must be readable up to a multiple of 4 floats.
+	/// </summary>
+	inline void Blend_Linear(float const* a, float const* b, float t, float* destination, unsigned width) {
+		unsigned i = 0;
+#ifdef SIMD_SSE
+		__m128 factor = _mm_set1_ps(t);
+		for (; i + 4 <= width; i += 4) {
+			__m128 va = _mm_loadu_ps(a + i);
+			__m128 vb = _mm_loadu_ps(b + i);
+			_mm_storeu_ps(destination + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), factor)));
+		}
+		if (width - i == 3) {
+			__m128 va = _mm_loadu_ps(a + i);
+			__m128 vb = _mm_loadu_ps(b + i);
+			__m128 result = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), factor));
+			_mm_storel_pi(reinterpret_cast<__m64*>(destination + i), result);
+			_mm_store_ss(destination + i + 2, _mm_movehl_ps(result, result));
+			return;
+		}
+#endif
+		for (; i < width; ++i) {
+			destination[i] = a[i] + (b[i] - a[i]) * t;
+		}
+	}
+
+	/// <summary>
+	/// Hermite spline between two keys, tangents are scaled by the key interval.
+	/// </summary>
+	inline void Blend_Cubic(float const* v0, float const* outTangent0, float const* inTangent1, float const* v1, float t, float interval, float* destination, unsigned width) {
+		float t2 = t * t;
+		float t3 = t2 * t;
+		float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+		float h10 = (t3 - 2.0f * t2 + t) * interval;
+		float h01 = -2.0f * t3 + 3.0f * t2;
+		float h11 = (t3 - t2) * interval;
+
+		unsigned i = 0;
+#ifdef SIMD_SSE
+		__m128 c00 = _mm_set1_ps(h00);
+		__m128 c10 = _mm_set1_ps(h10);
+		__m128 c01 = _mm_set1_ps(h01);
+		__m128 c11 = _mm_set1_ps(h11);
+		for (; i < width; i += 4) {
+			__m128 result = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v0 + i), c00), _mm_mul_ps(_mm_loadu_ps(outTangent0 + i), c10)),
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v1 + i), c01), _mm_mul_ps(_mm_loadu_ps(inTangent1 + i), c11)));
+
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, result);
+			for (unsigned lane = 0; lane < 4 && i + lane < width; ++lane) {
+				destination[i + lane] = lanes[lane];
+			}
+		}
+#else
+		for (; i < width; ++i) {
+			destination[i] = h00 * v0[i] + h10 * outTangent0[i] + h01 * v1[i] + h11 * inTangent1[i];
+		}
+#endif
+	}
+
+	inline void Normalize_Quaternion(float* q) {
+		float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		for (size_t i = 0; i < 4; ++i) {
+			q[i] *= inverse;
+		}
+	}
+
+	// acos for [0, 1], Abramowitz and Stegun 4.4.46, error below 2e-8
+	inline float Acos_Positive(float x) {
+		float p = -0.0012624911f;
+		p = p * x + 0.0066700901f;
+		p = p * x - 0.0170881256f;
+		p = p * x + 0.0308918810f;
+		p = p * x - 0.0501743046f;
+		p = p * x + 0.0889789874f;
+		p = p * x - 0.2145988016f;
+		p = p * x + 1.5707963050f;
+		return std::sqrt(std::max(1.0f - x, 0.0f)) * p;
+	}
+
+	// sin for [0, pi/2], Taylor series up to x^9
+	inline float Sin_Half_Pi(float x) {
+		float x2 = x * x;
+		return x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f + x2 * (1.0f / 362880.0f)))));
+	}
+
+	// Above this cosine slerp is replaced by lerp to avoid dividing by a vanishing sine
+	constexpr static float SLERP_LINEAR_THRESHOLD = 0.9995f;
+
+	/// <summary>
+	/// Shortest path quaternion blend, slerp or normalized lerp.
+	/// </summary>
+	inline void Blend_Rotation(float const* a, float const* b, float t, float* destination, bool normalizedLerp) {
+		float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+		float sign = dot < 0.0f ? -1.0f : 1.0f;
+		dot *= sign;
+
+		float weightA = 1.0f - t;
+		float weightB = t;
+		if (!normalizedLerp && dot < SLERP_LINEAR_THRESHOLD) {
+			float theta = Acos_Positive(dot);
+			float inverseSin = 1.0f / std::sqrt(1.0f - dot * dot);
+			weightA = Sin_Half_Pi((1.0f - t) * theta) * inverseSin;
+			weightB = Sin_Half_Pi(t * theta) * inverseSin;
+		}
+		weightB *= sign;
+
+		for (size_t i = 0; i < 4; ++i) {
+			destination[i] = a[i] * weightA + b[i] * weightB;
+		}
+		Normalize_Quaternion(destination);
+	}
+
+#ifdef SIMD_SSE
+	inline __m128 Acos_Positive(__m128 x) {
+		__m128 p = _mm_set1_ps(-0.0012624911f);
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0066700901f));
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0170881256f));
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0308918810f));
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0501743046f));
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(0.0889789874f));
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.2145988016f));
+		p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(1.5707963050f));
+		return _mm_mul_ps(_mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), x), _mm_setzero_ps())), p);
+	}
+
+	inline __m128 Sin_Half_Pi(__m128 x) {
+		__m128 x2 = _mm_mul_ps(x, x);
+		__m128 p = _mm_set1_ps(1.0f / 362880.0f);
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 5040.0f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f / 120.0f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 6.0f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(p, x);
+	}
+
+	/// <summary>
+	/// Four rotation blends at once, quaternions are transposed so every lane is one blend.
+	/// </summary>
+	inline void Blend_Rotation_4(float const* const a[4], float const* const b[4], float const t[4], float* const destination[4], bool normalizedLerp) {
+		__m128 ax = _mm_loadu_ps(a[0]), ay = _mm_loadu_ps(a[1]), az = _mm_loadu_ps(a[2]), aw = _mm_loadu_ps(a[3]);
+		__m128 bx = _mm_loadu_ps(b[0]), by = _mm_loadu_ps(b[1]), bz = _mm_loadu_ps(b[2]), bw = _mm_loadu_ps(b[3]);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+		__m128 factor = _mm_loadu_ps(t);
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		// Shortest path, the sign of dot is moved onto b's weight
+		__m128 signMask = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+		dot = _mm_xor_ps(dot, signMask);
+
+		__m128 weightA = _mm_sub_ps(_mm_set1_ps(1.0f), factor);
+		__m128 weightB = factor;
+		if (!normalizedLerp) {
+			__m128 theta = Acos_Positive(dot);
+			__m128 inverseSin = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(dot, dot)), _mm_set1_ps(1e-12f))));
+			__m128 slerpA = _mm_mul_ps(Sin_Half_Pi(_mm_mul_ps(weightA, theta)), inverseSin);
+			__m128 slerpB = _mm_mul_ps(Sin_Half_Pi(_mm_mul_ps(factor, theta)), inverseSin);
+
+			__m128 useSlerp = _mm_cmplt_ps(dot, _mm_set1_ps(SLERP_LINEAR_THRESHOLD));
+			weightA = _mm_or_ps(_mm_and_ps(useSlerp, slerpA), _mm_andnot_ps(useSlerp, weightA));
+			weightB = _mm_or_ps(_mm_and_ps(useSlerp, slerpB), _mm_andnot_ps(useSlerp, weightB));
+		}
+		weightB = _mm_xor_ps(weightB, signMask);
+
+		__m128 x = _mm_add_ps(_mm_mul_ps(ax, weightA), _mm_mul_ps(bx, weightB));
+		__m128 y = _mm_add_ps(_mm_mul_ps(ay, weightA), _mm_mul_ps(by, weightB));
+		__m128 z = _mm_add_ps(_mm_mul_ps(az, weightA), _mm_mul_ps(bz, weightB));
+		__m128 w = _mm_add_ps(_mm_mul_ps(aw, weightA), _mm_mul_ps(bw, weightB));
+
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+		__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared));
+		x = _mm_mul_ps(x, inverseLength);
+		y = _mm_mul_ps(y, inverseLength);
+		z = _mm_mul_ps(z, inverseLength);
+		w = _mm_mul_ps(w, inverseLength);
+
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(destination[0], x);
+		_mm_storeu_ps(destination[1], y);
+		_mm_storeu_ps(destination[2], z);
+		_mm_storeu_ps(destination[3], w);
+	}
+#endif
+
+	struct Settings {
+		// Normalized lerp instead of slerp for LINEAR rotations, faster but not constant velocity
+		bool normalizedLerp = false;
+	};
+
+	/// <summary>
+	/// Evaluates instances in batches, rotations of all instances are gathered and blended 4 at a time.
+	/// </summary>
+	class Evaluator {
+	public:
+		struct Statistics {
+			size_t channels = 0;
+			size_t seeks = 0;
+			size_t rotations = 0;
+
+			void Reset() {
+				channels = seeks = rotations = 0;
+			}
+		};
+
+		Settings settings;
+		Statistics statistics;
+
+		Evaluator() = default;
+
+		Evaluator(Settings _settings) : settings(_settings) {
+
+		}
+
+		void Evaluate(std::vector<Instance>& instances, NodeTransforms& transforms) {
+			Evaluate(instances.data(), instances.size(), transforms);
+		}
+
+		/// <summary>
+		/// Samples every channel of 'count' instances at their current time and writes the node TRS and weights.
+		/// Ranges of instances that do not share nodes can be evaluated on separate threads with separate evaluators.
+		/// </summary>
+		void Evaluate(Instance* instances, size_t count, NodeTransforms& transforms) {
+			_rotationJobs.clear();
+
+			for (size_t index = 0; index < count; ++index) {
+				Instance& instance = instances[index];
+				Clip const& clip = *instance.clip;
+
+				for (ChannelData const& channel : clip.channels) {
+					SamplerData const& sampler = clip.samplers[channel.sampler];
+					size_t slot = instance.nodeBase + channel.node;
+					if (instance.nodeSlots) {
+						if (instance.nodeSlots[channel.node] == unsigned(-1)) {
+							continue;
+						}
+						slot = instance.nodeSlots[channel.node];
+					}
+					if (channel.path != Path::Weights) {
+						transforms.Mark_Dirty(slot);
+					}
+					float* destination = Destination(transforms, slot, channel.path);
+					unsigned width = sampler.width;
+					if (channel.path == Path::Weights) {
+						width = std::min(width, transforms.weightCount[slot]);
+					}
+
+					++statistics.channels;
+
+					// Quantized keys are unpacked into scratch space, room for two keys of 4 float groups
+					size_t scratchWidth = (size_t(sampler.width) + 3) & ~size_t(3);
+					if (sampler.encoding != Encoding::Float && _scratch.size() < scratchWidth * 2) {
+						_scratch.resize(scratchWidth * 2);
+					}
+					float* scratch = _scratch.data();
+
+					// Single key or clamped to the first/last key
+					size_t keyCount = sampler.KeyCount();
+					if (keyCount == 1 || instance.time <= sampler.times.front()) {
+						Copy_Values(Key(sampler, 0, scratch), destination, width);
+						instance.cursors[channel.sampler] = 0;
+						continue;
+					}
+					if (instance.time >= sampler.times.back()) {
+						Copy_Values(Key(sampler, keyCount - 1, scratch), destination, width);
+						continue;
+					}
+
+					unsigned& cursor = instance.cursors[channel.sampler];
+					statistics.seeks += Find_Key(sampler.times.data(), keyCount, instance.time, cursor);
+					size_t key = cursor;
+
+					float interval = sampler.times[key + 1] - sampler.times[key];
+					float t = interval > 0.0f ? (instance.time - sampler.times[key]) / interval : 0.0f;
+
+					switch (sampler.interpolation) {
+					case Interpolation::Step:
+						Copy_Values(Key(sampler, key, scratch), destination, width);
+						break;
+					case Interpolation::Linear: {
+						float const* a = Key(sampler, key, scratch);
+						float const* b = Key(sampler, key + 1, scratch + scratchWidth);
+						if (channel.path == Path::Rotation) {
+							RotationJob job;
+							std::copy(a, a + 4, job.a);
+							std::copy(b, b + 4, job.b);
+							job.destination = destination;
+							job.t = t;
+							_rotationJobs.push_back(job);
+						}
+						else {
+							Blend_Linear(a, b, t, destination, width);
+						}
+						break;
+					}
+					case Interpolation::CubicSpline:
+						Blend_Cubic(sampler.Value(key), sampler.OutTangent(key), sampler.InTangent(key + 1), sampler.Value(key + 1), t, interval, destination, width);
+						if (channel.path == Path::Rotation) {
+							Normalize_Quaternion(destination);
+						}
+						break;
+					}
+				}
+			}
+
+			Blend_Rotations();
+		}
+
+	private:
+		// Keys are copied so quantized keys do not need to outlive their scratch space
+		struct RotationJob {
+			float a[4];
+			float b[4];
+			float* destination;
+			float t;
+		};
+
+		std::vector<RotationJob> _rotationJobs;
+		std::vector<float> _scratch;
+
+		static float const* Key(SamplerData const& sampler, size_t key, float* scratch) {
+			if (sampler.encoding == Encoding::Float) {
+				return sampler.Value(key);
+			}
+			Decode_Key(sampler, key, scratch);
+			return scratch;
+		}
+
+		static float* Destination(NodeTransforms& transforms, size_t slot, Path path) {
+			switch (path) {
+			case Path::Translation:
+				return transforms.translation.data() + slot * 3;
+			case Path::Rotation:
+				return transforms.rotation.data() + slot * 4;
+			case Path::Scale:
+				return transforms.scale.data() + slot * 3;
+			default:
+				return transforms.weights.data() + transforms.weightOffset[slot];
+			}
+		}
+
+		void Blend_Rotations() {
+			size_t index = 0;
+			statistics.rotations += _rotationJobs.size();
+#ifdef SIMD_SSE
+			for (; index + 4 <= _rotationJobs.size(); index += 4) {
+				float const* a[4];
+				float const* b[4];
+				float t[4];
+				float* destination[4];
+				for (size_t lane = 0; lane < 4; ++lane) {
+					RotationJob const& job = _rotationJobs[index + lane];
+					a[lane] = job.a;
+					b[lane] = job.b;
+					t[lane] = job.t;
+					destination[lane] = job.destination;
+				}
+				Blend_Rotation_4(a, b, t, destination, settings.normalizedLerp);
+			}
+#endif
+			for (; index < _rotationJobs.size(); ++index) {
+				RotationJob const& job = _rotationJobs[index];
+				Blend_Rotation(job.a, job.b, job.t, job.destination, settings.normalizedLerp);
+			}
+		}
+	};
+}
@@ -0,0 +1,348 @@
+#pragma once
+#include "Animation.hpp"
+
+// Load time reduction of animation data, removes redundant keys, resamples and quantizes samplers of a Clip
+namespace Animation {
+	struct CompressionSettings {
+		// Largest error allowed at a removed key, per component in the units of the channel
+		float translationTolerance = 0.0001f;
+		// Per quaternion component
+		float rotationTolerance = 0.0001f;
+		float scaleTolerance = 0.0001f;
+		float weightTolerance = 0.001f;
+		// Keys per second of a fixed rate resample, 0 keeps the source key times
+		// CUBICSPLINE samplers become LINEAR when resampled
+		float resampleRate = 0.0f;
+		// 16 bits per component relative to the sampler range, 48 bits per rotation key
+		// Off by default, decoding packed keys costs more per evaluation than reading floats
+		bool quantize = false;
+		// Part of each tolerance left for quantization when quantizing, key reduction gets the rest
+		// Samplers whose 16 bit steps are too coarse for their part keep float keys
+		float quantizationShare = 0.5f;
+	};
+
+	struct CompressionStatistics {
+		size_t keysBefore = 0;
+		size_t keysAfter = 0;
+		size_t bytesBefore = 0;
+		size_t bytesAfter = 0;
+		// Samplers packed by Quantize and those left as floats because packing would exceed their tolerance
+		size_t quantizedSamplers = 0;
+		size_t floatSamplers = 0;
+	};
+
+	/// <summary>
+	/// Samples a float sampler at 'time'.
+	/// </summary>
+	/// <param name="destination">Room for 'width' floats</param>
+	inline void Sample(SamplerData const& sampler, bool rotation, float time, float* destination) {
+		size_t keyCount = sampler.KeyCount();
+		if (keyCount == 1 || time <= sampler.times.front()) {
+			Copy_Values(sampler.Value(0), destination, sampler.width);
+			return;
+		}
+		if (time >= sampler.times.back()) {
+			Copy_Values(sampler.Value(keyCount - 1), destination, sampler.width);
+			return;
+		}
+
+		unsigned cursor = 0;
+		Find_Key(sampler.times.data(), keyCount, time, cursor);
+		float interval = sampler.times[cursor + 1] - sampler.times[cursor];
+		float t = interval > 0.0f ? (time - sampler.times[cursor]) / interval : 0.0f;
+
+		switch (sampler.interpolation) {
+		case Interpolation::Step:
+			Copy_Values(sampler.Value(cursor), destination, sampler.width);
+			break;
+		case Interpolation::Linear:
+			if (rotation) {
+				Blend_Rotation(sampler.Value(cursor), sampler.Value(cursor + 1), t, destination, false);
+			}
+			else {
+				Blend_Linear(sampler.Value(cursor), sampler.Value(cursor + 1), t, destination, sampler.width);
+			}
+			break;
+		case Interpolation::CubicSpline:
+			Blend_Cubic(sampler.Value(cursor), sampler.OutTangent(cursor), sampler.InTangent(cursor + 1), sampler.Value(cursor + 1), t, interval, destination, sampler.width);
+			if (rotation) {
+				Normalize_Quaternion(destination);
+			}
+			break;
+		}
+	}
+
+	/// <returns>Largest component difference, q and -q are the same rotation</returns>
+	inline float Key_Error(float const* a, float const* b, unsigned width, bool rotation) {
+		float error = 0.0f;
+		float negatedError = 0.0f;
+		for (unsigned component = 0; component < width; ++component) {
+			error = std::max(error, std::fabs(a[component] - b[component]));
+			negatedError = std::max(negatedError, std::fabs(a[component] + b[component]));
+		}
+		return rotation ? std::min(error, negatedError) : error;
+	}
+
+	/// <summary>
+	/// Replaces the keys with keys at a fixed rate between the first and last key time, STEP samplers are left as they are.
+	/// </summary>
+	inline void Resample(SamplerData& sampler, bool rotation, float rate) {
+		if (rate <= 0.0f || sampler.interpolation == Interpolation::Step || sampler.encoding != Encoding::Float || sampler.KeyCount() < 2) {
+			return;
+		}
+
+		float start = sampler.times.front();
+		float end = sampler.times.back();
+		size_t keyCount = static_cast<size_t>(std::ceil((end - start) * rate)) + 1;
+		keyCount = std::max(keyCount, size_t(2));
+
+		SamplerData resampled;
+		resampled.width = sampler.width;
+		resampled.interpolation = Interpolation::Linear;
+		resampled.times.resize(keyCount);
+		resampled.values.resize(keyCount * sampler.width + VALUE_PADDING, 0.0f);
+		for (size_t key = 0; key < keyCount; ++key) {
+			float time = key + 1 == keyCount ? end : start + (end - start) * float(key) / float(keyCount - 1);
+			resampled.times[key] = time;
+			Sample(sampler, rotation, time, resampled.values.data() + key * sampler.width);
+		}
+
+		sampler = std::move(resampled);
+	}
+
+	/// <summary>
+	/// Removes keys that interpolation between their neighbours reproduces within 'tolerance'.
+	/// CUBICSPLINE samplers are not reduced, resample them first.
+	/// </summary>
+	inline void Reduce_Keys(SamplerData& sampler, bool rotation, float tolerance) {
+		size_t keyCount = sampler.KeyCount();
+		if (sampler.interpolation == Interpolation::CubicSpline || sampler.encoding != Encoding::Float || keyCount < 2) {
+			return;
+		}
+
+		unsigned width = sampler.width;
+		std::vector<size_t> kept(1, 0);
+		std::vector<float> reconstructed(size_t(width) + VALUE_PADDING);
+
+		if (sampler.interpolation == Interpolation::Step) {
+			// A key is only needed when the held value changes
+			for (size_t key = 1; key < keyCount; ++key) {
+				if (Key_Error(sampler.Value(kept.back()), sampler.Value(key), width, rotation) > tolerance) {
+					kept.emplace_back(key);
+				}
+			}
+		}
+		else {
+			// Greedy, extend the segment from the last kept key until a skipped key is out of tolerance
+			size_t anchor = 0;
+			for (size_t next = 2; next < keyCount; ++next) {
+				float const* a = sampler.Value(anchor);
+				float const* b = sampler.Value(next);
+				float interval = sampler.times[next] - sampler.times[anchor];
+
+				for (size_t key = anchor + 1; key < next; ++key) {
+					float t = interval > 0.0f ? (sampler.times[key] - sampler.times[anchor]) / interval : 0.0f;
+					if (rotation) {
+						Blend_Rotation(a, b, t, reconstructed.data(), false);
+					}
+					else {
+						Blend_Linear(a, b, t, reconstructed.data(), width);
+					}
+
+					if (Key_Error(reconstructed.data(), sampler.Value(key), width, rotation) > tolerance) {
+						anchor = next - 1;
+						kept.emplace_back(anchor);
+						break;
+					}
+				}
+			}
+			kept.emplace_back(keyCount - 1);
+
+			// Constant channel
+			if (kept.size() == 2 && Key_Error(sampler.Value(0), sampler.Value(keyCount - 1), width, rotation) <= tolerance) {
+				kept.pop_back();
+			}
+		}
+
+		if (kept.size() == keyCount) {
+			return;
+		}
+
+		std::vector<float> times;
+		std::vector<float> values;
+		times.reserve(kept.size());
+		values.reserve(kept.size() * width + VALUE_PADDING);
+		for (size_t key : kept) {
+			times.emplace_back(sampler.times[key]);
+			values.insert(values.end(), sampler.Value(key), sampler.Value(key) + width);
+		}
+		values.resize(values.size() + VALUE_PADDING, 0.0f);
+
+		sampler.times = std::move(times);
+		sampler.values = std::move(values);
+	}
+
+	/// <summary>
+	/// Packs STEP and LINEAR float keys, rotations as smallest three quaternions, everything else relative to the sampler range.
+	/// Interpolating packed keys is off by at most the largest key error, so a sampler is only packed when every decoded key
+	/// is within 'tolerance' of its float key, otherwise it is left as it was.
+	/// </summary>
+	/// <returns>True when the sampler was packed</returns>
+	inline bool Quantize(SamplerData& sampler, bool rotation, float tolerance) {
+		if (sampler.interpolation == Interpolation::CubicSpline || sampler.encoding != Encoding::Float) {
+			return false;
+		}
+
+		size_t keyCount = sampler.KeyCount();
+		unsigned width = sampler.width;
+		sampler.packed.clear();
+
+		if (rotation && width == 4) {
+			sampler.packed.reserve(keyCount * 3 + 4);
+			for (size_t key = 0; key < keyCount; ++key) {
+				float q[4];
+				Copy_Values(sampler.Value(key), q, 4);
+				Normalize_Quaternion(q);
+
+				unsigned largest = 0;
+				for (unsigned component = 1; component < 4; ++component) {
+					if (std::fabs(q[component]) > std::fabs(q[largest])) {
+						largest = component;
+					}
+				}
+				// q and -q are the same rotation, keep the dropped component positive
+				float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+				unsigned short small[3];
+				unsigned index = 0;
+				for (unsigned component = 0; component < 4; ++component) {
+					if (component != largest) {
+						float value = std::round((q[component] * sign - SMALLEST_THREE_OFFSET) / SMALLEST_THREE_SCALE);
+						small[index++] = static_cast<unsigned short>(std::min(std::max(value, 0.0f), 32767.0f));
+					}
+				}
+				sampler.packed.emplace_back(static_cast<unsigned short>(small[0] | ((largest >> 1) << 15)));
+				sampler.packed.emplace_back(static_cast<unsigned short>(small[1] | ((largest & 1) << 15)));
+				sampler.packed.emplace_back(small[2]);
+			}
+			sampler.encoding = Encoding::SmallestThree48;
+		}
+		else {
+			size_t paddedWidth = (size_t(width) + 3) & ~size_t(3);
+			sampler.rangeOffset.assign(paddedWidth, 0.0f);
+			sampler.rangeScale.assign(paddedWidth, 0.0f);
+			for (unsigned component = 0; component < width; ++component) {
+				float minimum = sampler.Value(0)[component];
+				float maximum = minimum;
+				for (size_t key = 1; key < keyCount; ++key) {
+					minimum = std::min(minimum, sampler.Value(key)[component]);
+					maximum = std::max(maximum, sampler.Value(key)[component]);
+				}
+				sampler.rangeOffset[component] = minimum;
+				sampler.rangeScale[component] = (maximum - minimum) / 65535.0f;
+				// Rounding to the nearest step is off by up to half a step, a large range can not meet a small tolerance
+				if (sampler.rangeScale[component] * 0.5f > tolerance) {
+					sampler.rangeOffset.clear();
+					sampler.rangeScale.clear();
+					return false;
+				}
+			}
+
+			sampler.packed.reserve(keyCount * width + 4);
+			for (size_t key = 0; key < keyCount; ++key) {
+				for (unsigned component = 0; component < width; ++component) {
+					float scale = sampler.rangeScale[component];
+					float value = scale > 0.0f ? std::round((sampler.Value(key)[component] - sampler.rangeOffset[component]) / scale) : 0.0f;
+					sampler.packed.emplace_back(static_cast<unsigned short>(std::min(std::max(value, 0.0f), 65535.0f)));
+				}
+			}
+			sampler.encoding = Encoding::Range16;
+		}
+
+		// Decoding reads 4 shorts at a time
+		sampler.packed.resize(sampler.packed.size() + 4, 0);
+
+		// Smallest three error grows as the dropped component is rebuilt, measure what decoding actually returns
+		std::vector<float> decoded(((size_t(width) + 3) & ~size_t(3)) + VALUE_PADDING);
+		float normalized[4];
+		for (size_t key = 0; key < keyCount; ++key) {
+			Decode_Key(sampler, key, decoded.data());
+			float const* source = sampler.Value(key);
+			if (sampler.encoding == Encoding::SmallestThree48) {
+				Copy_Values(source, normalized, 4);
+				Normalize_Quaternion(normalized);
+				source = normalized;
+			}
+			if (Key_Error(decoded.data(), source, width, rotation) > tolerance) {
+				sampler.packed.clear();
+				sampler.rangeOffset.clear();
+				sampler.rangeScale.clear();
+				sampler.encoding = Encoding::Float;
+				return false;
+			}
+		}
+
+		sampler.values.clear();
+		sampler.values.shrink_to_fit();
+		return true;
+	}
+
+	/// <summary>
+	/// Resamples, reduces and quantizes every sampler of a clip, the tolerance of a sampler is the smallest of the channels using it.
+	/// When quantizing the tolerance is split between key reduction and quantization, so together they stay within it.
+	/// </summary>
+	inline CompressionStatistics Compress(Clip& clip, CompressionSettings const& settings) {
+		CompressionStatistics statistics;
+		statistics.bytesBefore = clip.MemoryUsage();
+
+		for (size_t index = 0; index < clip.samplers.size(); ++index) {
+			SamplerData& sampler = clip.samplers[index];
+			statistics.keysBefore += sampler.KeyCount();
+
+			bool used = false;
+			bool rotation = false;
+			float tolerance = 0.0f;
+			for (ChannelData const& channel : clip.channels) {
+				if (channel.sampler != index) {
+					continue;
+				}
+
+				float channelTolerance = settings.weightTolerance;
+				switch (channel.path) {
+				case Path::Translation:
+					channelTolerance = settings.translationTolerance;
+					break;
+				case Path::Rotation:
+					channelTolerance = settings.rotationTolerance;
+					rotation = true;
+					break;
+				case Path::Scale:
+					channelTolerance = settings.scaleTolerance;
+					break;
+				default:
+					break;
+				}
+				tolerance = used ? std::min(tolerance, channelTolerance) : channelTolerance;
+				used = true;
+			}
+
+			if (used) {
+				Resample(sampler, rotation, settings.resampleRate);
+				float quantizationTolerance = settings.quantize ? tolerance * settings.quantizationShare : 0.0f;
+				Reduce_Keys(sampler, rotation, tolerance - quantizationTolerance);
+				if (settings.quantize) {
+					if (Quantize(sampler, rotation, quantizationTolerance)) {
+						++statistics.quantizedSamplers;
+					}
+					else {
+						++statistics.floatSamplers;
+					}
+				}
+			}
+			statistics.keysAfter += sampler.KeyCount();
+		}
+
+		statistics.bytesAfter = clip.MemoryUsage();
+		return statistics;
+	}
+}
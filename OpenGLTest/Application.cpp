@@ -1,8 +1,13 @@
-#include "Shader.hpp"
+﻿#include "Shader.hpp"
 #include "VertexArray.hpp"
 #include "Graphics.hpp"
 #include "Ply.hpp"
 #include "Texture.hpp"
+#include "RingBuffer.hpp"
+#include "BufferArena.hpp"
+#include "IndirectDraw.hpp"
+#include "GpuCulling.hpp"
+#include "MeshInstanced.hpp"
 
 #include <GLAD\gl.h>
 #include <GLFW\glfw3.h>
@@ -14,6 +19,8 @@
 #include <cstddef>
 
 #include <map>
+#include <memory>
+#include <numeric>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
@@ -159,6 +166,10 @@ struct GLError {
 
 const unsigned int SCREEN_WIDTH = 800;
 const unsigned int SCREEN_HEIGHT = 600;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 10000.0f;
+// Texture memory for the finer levels of streamed images, their small tails are always resident
+const size_t TEXTURE_BUDGET = size_t(256) << 20;
 
 struct Vertex {
 	float x, y, z;
@@ -166,22 +177,144 @@ struct Vertex {
 	float s, t;
 };
 
-struct DrawArraysIndirectCommand {
-	unsigned int  count;
-	unsigned int  instanceCount;
-	unsigned int  first;
-	unsigned int  baseInstance;
+// Interleaved triangles of one glTF primitive, indices are relative to its own vertices
+struct PrimitiveGeometry {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	// Document material, -1 when the primitive has none
+	unsigned int material = unsigned(-1);
+	// From the material's alphaMode
+	RenderQueue::Pass pass = RenderQueue::Pass::Opaque;
 };
 
+// A primitive copied into the mesh arena
+struct ArenaPrimitive {
+	size_t geometry;
+	unsigned int material;
+	RenderQueue::Pass pass;
+};
+
+// Vertices and indices the mesh arena starts with, it doubles when full
+const uint32_t MESH_ARENA_VERTICES = 1 << 20;
+const uint32_t MESH_ARENA_INDICES = 1 << 22;
+
+// std140 layout of the Frame uniform block in vertex.glsl and fragment.glsl
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 cameraPosition;
+	glm::vec4 cameraOrientation;
+	glm::vec4 modelPosition;
+	glm::vec4 modelOrientation;
+	float ratio;
+	float padding[3];
+};
+
+// Bytes of per frame uniforms, storage and instance data
+const GLsizeiptr FRAME_DATA_SIZE = GLsizeiptr(4) << 20;
+
+// Occluders are meshes of at most this many triangles, rasterizing more on the CPU costs more than it hides
+const size_t OCCLUDER_MAX_TRIANGLES = 1024;
+// drawn for instances whose bounds span at least this part of their document's bounds
+const float OCCLUDER_MIN_SCENE_FRACTION = 0.05f;
+// While meshes stream in, changes to the instance list and picking hierarchy are rebuilt at most this often
+const std::chrono::milliseconds STREAM_REBUILD_INTERVAL(250);
+
 void Callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
 	std::cout << "Something Broke" << std::endl;
 }
 
 #include "GLTF.hpp"
 #include "GLToolkit.hpp"
+#include "MeshoptDecoder.hpp"
+#include "AccessorData.hpp"
+#include "AccessorRange.hpp"
+#include "AnimationCompression.hpp"
+#include "Skinning.hpp"
+#include "SceneGraph.hpp"
+#include "SceneInstancing.hpp"
+#include "BVH.hpp"
+#include "Culling.hpp"
+#include "Occlusion.hpp"
+#include "RayCast.hpp"
+#include "Streaming.hpp"
+#include "TextureStreaming.hpp"
+
+// A mesh drawn by a skinned node, deformed on the CPU each frame and written over its vertices in the mesh arena.
+// A mesh drawn by several skinned nodes is deformed once, by the first of them.
+struct SkinnedDraw {
+	GLTF::index_type mesh;
+	GLTF::index_type skin;
+	// Bind pose streams and deformed vertices of each primitive Mesh_Geometry keeps, empty until the mesh is read
+	std::vector<Skinning::SkinnedMesh> primitives;
+	std::vector<std::vector<Vertex>> vertices;
+	std::vector<std::vector<Skinning::SkinnedVertex>> skinned;
+	std::vector<glm::mat4> palette;
+	// World space bounds of the last pose, empty until the first
+	AABB bounds;
+	bool changed = false;
+};
 
 struct GLTFObject {
-	
+	SceneGraph scene;
+	// Slot in scene of each document node, -1 for nodes outside the default scene
+	std::vector<unsigned> nodeSlots;
+	// Object space bounds indexed by document mesh
+	std::vector<AABB> meshBounds;
+	// Indexed by scene slot, the EXT_mesh_gpu_instancing transforms of each node, empty for nodes drawn once
+	std::vector<std::vector<glm::mat4>> slotInstances;
+	// World space bounds of everything drawn, a node with a mesh or one GPU instance of it, with their slots and world matrices, the BVH is built over these
+	std::vector<AABB> instanceBounds;
+	std::vector<unsigned> instanceSlots;
+	std::vector<glm::mat4> instanceWorlds;
+	// Instances grouped by mesh, each primitive of a batch is one instanced draw
+	std::vector<SceneInstancing::Batch> batches;
+	BVH instances;
+	// instanceBounds laid out for the culling kernels
+	Culling::BoundsSoA instanceCullBounds;
+	// Indices into instanceSlots visible this frame
+	std::vector<unsigned> visibleInstances;
+	// Triangles of each instance for picking and the scene slot of each picking instance
+	RayCast::Scene picking;
+	std::vector<unsigned> pickingSlots;
+	// Set while buffers are still being read, meshBounds holds placeholders for meshes that are not ready
+	std::shared_ptr<Streaming::DocumentStream> stream;
+	// Images decode on the thread pool, textures indexed by document image are uploaded as they finish
+	std::shared_ptr<TextureDecode::TextureDecoder> decoder;
+	std::vector<std::shared_ptr<Texture2D>> images;
+	// Small images wait here until decoding drains, then share texture arrays
+	std::vector<std::pair<size_t, TextureDecode::DecodedImage>> atlasImages;
+	std::vector<GLTF::integer_type> imageWraps;
+	std::vector<std::shared_ptr<Texture2DArray>> textureArrays;
+	// Indexed by document image, packed images sample textureArrays instead of images
+	std::vector<TextureAtlas::Placement> imagePlacements;
+	std::vector<TextureAtlas::MaterialTextures> materialTextures;
+	// Indexed by document image, handles of images whose levels stream under TEXTURE_BUDGET, -1 for the rest
+	std::vector<size_t> streamedImages;
+	// Indexed by document mesh, the images its materials sample and uv units per object space unit, 0 until known
+	std::vector<std::vector<GLTF::index_type>> meshImages;
+	std::vector<float> meshUvDensity;
+	// Geometry read while loading waits here until the GL thread copies it into the mesh arena
+	std::vector<std::pair<GLTF::index_type, std::vector<PrimitiveGeometry>>> pendingGeometry;
+	// Indexed by document mesh, arena handles of its triangle primitives
+	std::vector<std::vector<ArenaPrimitive>> meshPrimitives;
+	// Clips are built once the stream has read their keyframes, the playing ones write into scene.transforms
+	std::vector<Animation::Clip> animations;
+	std::vector<Animation::Instance> playing;
+	Animation::Evaluator animator;
+	std::vector<Skinning::SkinData> skins;
+	std::vector<SkinnedDraw> skinnedDraws;
+	// Indexed by scene slot, the skinned draw of skinned nodes, -1 for the rest
+	std::vector<size_t> slotSkinnedDraws;
+	// Indexed by document mesh, the mesh's own triangles when it can occlude, null for the rest and until it is read
+	std::vector<std::shared_ptr<Occlusion::OccluderMesh const>> meshOccluders;
+	// Indices into instanceSlots drawn into the occlusion depth buffer
+	std::vector<unsigned> occluderInstances;
+	// Published meshes patch the instances in place, what needs a rebuild waits for Rebuild_Streamed_Instances.
+	// instancesChanged is set when the instance list itself changes, GPU instances read or a mesh that had no bounds
+	bool rebuildPending = false;
+	bool instancesChanged = false;
+	std::chrono::steady_clock::time_point rebuilt;
 };
 #include <mutex>
 
@@ -234,59 +367,6 @@ void AddAttribute(BufferFormat& format, GLTF::Accessor const* accessor, unsigned
 	}
 }
 
-template <class _Ty>
-void Check_Max_Min_Values(std::vector<unsigned char>& values, GLTF::Accessor const& accessor) {
-	if (values.size() / sizeof(_Ty) != accessor.count) {
-		// Don't check if it is not safe to check
-		return;
-	}
-
-	_Ty* valuePointer = reinterpret_cast<_Ty*>(values.data() + accessor.byteOffset);
-	_Ty* endPointer = reinterpret_cast<_Ty*>(values.data() + values.size());
-	decltype(accessor.ComponentCount()) componentCount(accessor.ComponentCount());
-	
-	//if (accessor.max.size() == componentCount) {
-	//	// Check Max and Min
-	//	if (accessor.min.size() == componentCount) {
-	//		for (size_t initialIdx = 0; initialIdx < accessor.count; ++initialIdx) {
-	//			for (size_t repeater = 0, limit = componentCount; repeater < limit; ++repeater) {
-	//				if (valuePointer[initialIdx + repeater] > accessor.max[repeater]) {
-	//					valuePointer[initialIdx + repeater] = accessor.max[repeater];
-	//				}
-	//				if (valuePointer[initialIdx + repeater] < accessor.min[repeater]) {
-	//					valuePointer[initialIdx + repeater] = accessor.min[repeater];
-	//				}
-	//			}
-	//		}
-	//	}
-	//	// Check only max
-	//	else {
-	//		for (size_t initialIdx = 0; initialIdx < accessor.count; initialIdx += componentCount) {
-	//			for (size_t repeater = 0, limit = componentCount; repeater < limit; ++repeater) {
-	//				if (valuePointer[initialIdx + repeater] > accessor.max[repeater]) {
-	//					valuePointer[initialIdx + repeater] = accessor.max[repeater];
-	//				}
-	//			}
-	//		}
-	//	}
-	//}
-	//else {
-	//	// Check only min
-	//	if (accessor.min.size() == componentCount) {
-	//		for (size_t initialIdx = 0; initialIdx < accessor.count; initialIdx += componentCount) {
-	//			for (size_t repeater = 0, limit = componentCount; repeater < limit; ++repeater) {
-	//				if (valuePointer[initialIdx + repeater] < accessor.min[repeater]) {
-	//					valuePointer[initialIdx + repeater] = accessor.min[repeater];
-	//				}
-	//			}
-	//		}
-	//	}
-	//	else {
-	//		// No check
-	//	}
-	//}
-}
-
 template <class _Ty>
 std::vector<_Ty> Subrange_Vector(std::vector<unsigned char>&& source, size_t offset, size_t distance) {
 	typename std::vector<_Ty>::const_iterator tempIter = source.cbegin() + offset;
@@ -295,6 +375,646 @@ std::vector<_Ty> Subrange_Vector(std::vector<unsigned char>&& source, size_t off
 	return copy;
 }
 
+// Every TRIANGLES primitive of a mesh goes into one picking hierarchy
+void Mesh_Triangles(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& spans, GLTF::Mesh const& mesh, std::vector<float>& meshPositions, std::vector<unsigned>& meshIndices) {
+	for (GLTF::Mesh::Primitive const& primitive : mesh.primitives) {
+		if (primitive.mode != 4 || primitive.attributes.find(GLTF::Constants::ATTRIBUTE_POSITION) == primitive.attributes.cend()) {
+			continue;
+		}
+		std::vector<float> positions;
+		std::vector<unsigned> indices;
+		RayCast::Primitive_Triangles(doc, spans, primitive, positions, indices);
+		unsigned base = unsigned(meshPositions.size() / 3);
+		for (unsigned index : indices) {
+			meshIndices.emplace_back(base + index);
+		}
+		meshPositions.insert(meshPositions.end(), positions.begin(), positions.end());
+	}
+}
+
+// Occluders have to be solid where they are drawn, so meshes with blended or cut out materials, other primitive modes,
+// morph targets or a skin are left out, they can show what is behind them or move away from their bind pose triangles
+bool Can_Occlude(GLTF::GLTFDoc const& doc, GLTF::index_type mesh) {
+	for (GLTF::Mesh::Primitive const& primitive : doc.meshes[mesh].primitives) {
+		if (primitive.mode != 4 || !primitive.targets.empty()) {
+			return false;
+		}
+		if (primitive.material < doc.materials.size() && doc.materials[primitive.material].alphaMode != GLTF::Constants::DEFAULT_ALPHA_MODE) {
+			return false;
+		}
+	}
+	for (GLTF::Node const& node : doc.nodes) {
+		if (node.mesh == mesh && node.skin != GLTF::index_type(-1)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Every TRIANGLES primitive of a mesh as Vertex, attributes the primitive lacks are zero
+std::vector<PrimitiveGeometry> Mesh_Geometry(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& spans, GLTF::Mesh const& mesh) {
+	std::vector<PrimitiveGeometry> geometry;
+	for (GLTF::Mesh::Primitive const& primitive : mesh.primitives) {
+		auto position = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_POSITION);
+		if (primitive.mode != 4 || position == primitive.attributes.cend()) {
+			continue;
+		}
+		std::vector<float> positions = GLTF::Read_Accessor_Float(doc, spans, position->second);
+		std::vector<float> normals;
+		std::vector<float> uvs;
+		auto normal = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_NORMAL);
+		if (normal != primitive.attributes.cend()) {
+			normals = GLTF::Read_Accessor_Float(doc, spans, normal->second);
+		}
+		auto uv = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_TEXCOORD_0);
+		if (uv != primitive.attributes.cend()) {
+			uvs = GLTF::Read_Accessor_Float(doc, spans, uv->second);
+		}
+		PrimitiveGeometry primitiveGeometry;
+		size_t count = positions.size() / 3;
+		primitiveGeometry.vertices.resize(count, Vertex{});
+		for (size_t vertex = 0; vertex < count; ++vertex) {
+			Vertex& target = primitiveGeometry.vertices[vertex];
+			target.x = positions[vertex * 3];
+			target.y = positions[vertex * 3 + 1];
+			target.z = positions[vertex * 3 + 2];
+			if (normals.size() >= (vertex + 1) * 3) {
+				target.nx = normals[vertex * 3];
+				target.ny = normals[vertex * 3 + 1];
+				target.nz = normals[vertex * 3 + 2];
+			}
+			if (uvs.size() >= (vertex + 1) * 2) {
+				target.s = uvs[vertex * 2];
+				target.t = uvs[vertex * 2 + 1];
+			}
+		}
+		if (primitive.indices != GLTF::index_type(-1)) {
+			primitiveGeometry.indices = GLTF::Read_Accessor_Unsigned(doc, spans, primitive.indices);
+		}
+		else {
+			for (unsigned int index = 0; index < unsigned(count); ++index) {
+				primitiveGeometry.indices.emplace_back(index);
+			}
+		}
+		primitiveGeometry.indices.resize(primitiveGeometry.indices.size() / 3 * 3);
+		if (primitive.material < doc.materials.size()) {
+			primitiveGeometry.material = unsigned(primitive.material);
+			std::string const& alphaMode = doc.materials[primitive.material].alphaMode;
+			primitiveGeometry.pass = alphaMode == GLTF::Constants::ALPHA_MODE_BLEND ? RenderQueue::Pass::Transparent : alphaMode == GLTF::Constants::ALPHA_MODE_MASK ? RenderQueue::Pass::Masked : RenderQueue::Pass::Opaque;
+		}
+		geometry.emplace_back(std::move(primitiveGeometry));
+	}
+	return geometry;
+}
+
+// Decodes images, builds their mip chains and block compresses them on the pool, so the GL thread only uploads
+// The result is kept as KTX2 in the temporary directory, later runs only read and upload it
+std::shared_ptr<TextureDecode::TextureDecoder> Image_Decoder(GLTF::GLTFDoc const& doc) {
+	std::vector<Mipmap::MipSettings> settings;
+	std::vector<BlockCompression::CompressSettings> compression;
+	for (GLTF::index_type image = 0; image < doc.images.size(); ++image) {
+		settings.emplace_back(TextureDecode::Image_Mip_Settings(doc, image));
+		compression.emplace_back(TextureDecode::Image_Compression(doc, image));
+	}
+	std::error_code error;
+	std::filesystem::path cache = std::filesystem::temp_directory_path(error);
+	if (!error) {
+		cache = cache / "OpenGLTest" / "Textures";
+	}
+	return std::make_shared<TextureDecode::TextureDecoder>(Default_Thread_Pool(), [settings, compression](size_t key, TextureDecode::DecodedImage& image) {
+		// KTX2 images are stored ready to upload
+		if (!image.compressed.Empty() || !image.mips.empty()) {
+			return;
+		}
+		image.srgb = settings[key].srgb;
+		image.mips = Mipmap::Generate(image.pixels.data(), image.width, image.height, image.channels, settings[key], &Default_Thread_Pool());
+		// Small images stay uncompressed so they can be packed together
+		if (TextureAtlas::Packable(image)) {
+			return;
+		}
+		image.compressed = BlockCompression::Compress_Chain(image.pixels.data(), image.mips, image.width, image.height, image.channels, compression[key], &Default_Thread_Pool());
+		// Only the compressed levels are uploaded
+		image.mips.clear();
+	}, [settings, compression, cache](size_t key, std::vector<unsigned char> const& encoded) {
+		return cache.empty() ? cache : TextureDecode::Cache_Path(cache, encoded, settings[key], compression[key]);
+	});
+}
+
+// Sizes the per image state and records how materials sample the images, for packing them into texture arrays
+void Prepare_Images(GLTFObject& object, GLTF::GLTFDoc const& doc) {
+	object.images.resize(doc.images.size());
+	object.imagePlacements.resize(doc.images.size());
+	for (GLTF::index_type image = 0; image < doc.images.size(); ++image) {
+		object.imageWraps.emplace_back(TextureAtlas::Image_Wrap(doc, image));
+	}
+	object.materialTextures = TextureAtlas::Material_Textures(doc);
+	object.streamedImages.resize(doc.images.size(), size_t(-1));
+	object.meshUvDensity.resize(doc.meshes.size(), 0.0f);
+	for (GLTF::Mesh const& mesh : doc.meshes) {
+		std::vector<GLTF::index_type> images;
+		for (GLTF::Mesh::Primitive const& primitive : mesh.primitives) {
+			if (primitive.material >= object.materialTextures.size()) {
+				continue;
+			}
+			TextureAtlas::MaterialTextures const& material = object.materialTextures[primitive.material];
+			for (TextureAtlas::TextureBinding const* binding : { &material.baseColor, &material.metallicRoughness, &material.normal, &material.occlusion, &material.emissive }) {
+				if (binding->Used() && std::find(images.begin(), images.end(), binding->image) == images.end()) {
+					images.emplace_back(binding->image);
+				}
+			}
+		}
+		object.meshImages.emplace_back(std::move(images));
+	}
+}
+
+// Opens a document without reading its buffers, instances are culled against declared bounds until their mesh arrives
+GLTFObject Stream_GLTF_File(std::filesystem::path const& path) {
+	GLTFObject loaded;
+	loaded.stream = std::make_shared<Streaming::DocumentStream>(path, Default_Thread_Pool());
+	GLTF::GLTFDoc const& doc = loaded.stream->Document();
+	loaded.nodeSlots = loaded.scene.Add_Document(doc);
+	loaded.scene.Update();
+	loaded.meshBounds = loaded.stream->Placeholder_Bounds();
+	loaded.meshPrimitives.resize(doc.meshes.size());
+	loaded.meshOccluders.resize(doc.meshes.size());
+	loaded.slotSkinnedDraws.resize(loaded.scene.Size(), size_t(-1));
+	for (size_t node = 0; node < doc.nodes.size(); ++node) {
+		GLTF::Node const& source = doc.nodes[node];
+		if (source.skin >= doc.skins.size() || source.mesh >= doc.meshes.size() || loaded.nodeSlots[node] == unsigned(-1)) {
+			continue;
+		}
+		std::vector<SkinnedDraw>::const_iterator draw = std::find_if(loaded.skinnedDraws.cbegin(), loaded.skinnedDraws.cend(), [&](SkinnedDraw const& existing) { return existing.mesh == source.mesh; });
+		if (draw == loaded.skinnedDraws.cend()) {
+			loaded.skinnedDraws.push_back({ source.mesh, source.skin });
+			draw = loaded.skinnedDraws.cend() - 1;
+		}
+		loaded.slotSkinnedDraws[loaded.nodeSlots[node]] = size_t(draw - loaded.skinnedDraws.cbegin());
+	}
+	// GPU instances are read with their node's mesh, until then the node stands in for them
+	SceneInstancing::Instance_Bounds(loaded.scene, loaded.slotInstances, loaded.meshBounds, loaded.instanceBounds, loaded.instanceSlots, loaded.instanceWorlds);
+	loaded.instances.Build(loaded.instanceBounds, &Default_Thread_Pool());
+	loaded.instanceCullBounds.Assign(loaded.instanceBounds);
+	loaded.batches = SceneInstancing::Compile(doc, loaded.scene, loaded.nodeSlots, loaded.instanceSlots);
+	loaded.decoder = Image_Decoder(doc);
+	Prepare_Images(loaded, doc);
+	return loaded;
+}
+
+// Packs the held small images into texture arrays and uploads them, images the packer leaves out get their own texture
+void Pack_Atlas_Images(GLTFObject& object) {
+	std::vector<TextureAtlas::ImageInfo> infos;
+	std::vector<TextureDecode::DecodedImage const*> pixels;
+	for (std::pair<size_t, TextureDecode::DecodedImage> const& held : object.atlasImages) {
+		infos.emplace_back(TextureAtlas::Image_Info(held.second, object.imageWraps[held.first]));
+		pixels.emplace_back(&held.second);
+	}
+	TextureAtlas::Plan plan = TextureAtlas::Pack(infos);
+	int firstArray = int(object.textureArrays.size());
+	for (TextureAtlas::Group const& group : plan.groups) {
+		std::shared_ptr<Texture2DArray> array = std::make_shared<Texture2DArray>(group);
+		for (int layer = 0; layer < group.layers; ++layer) {
+			array->Upload(layer, TextureAtlas::Compose_Layer(group, layer, pixels, &Default_Thread_Pool()));
+		}
+		object.textureArrays.emplace_back(std::move(array));
+	}
+	for (size_t index = 0; index < object.atlasImages.size(); ++index) {
+		std::pair<size_t, TextureDecode::DecodedImage> const& held = object.atlasImages[index];
+		TextureAtlas::Placement placement = plan.placements[index];
+		if (placement.Packed()) {
+			placement.group += firstArray;
+		}
+		else {
+			object.images[held.first] = std::make_shared<Texture2D>(held.second, held.second.srgb);
+		}
+		object.imagePlacements[held.first] = placement;
+	}
+	TextureAtlas::Apply_Placements(object.materialTextures, object.imagePlacements);
+	object.atlasImages.clear();
+}
+
+// Uploads the images that finished decoding, the only part of texture loading on the GL thread
+// Large images with every level go to the streamer, which uploads only the levels the view needs
+void Upload_Decoded_Images(GLTFObject& object, TextureStreaming::TextureStreamer& streamer) {
+	if (!object.decoder) {
+		return;
+	}
+	if (object.stream) {
+		for (GLTF::index_type image : object.stream->Take_Ready_Images()) {
+			object.decoder->Enqueue(size_t(image), object.stream->Image_Data(image));
+		}
+	}
+	for (std::pair<size_t, TextureDecode::DecodedImage>& decoded : object.decoder->Take_Finished()) {
+		if (!decoded.second.Valid()) {
+			std::cout << "Image " << decoded.first << " failed to decode: " << decoded.second.error << std::endl;
+			continue;
+		}
+		if (TextureAtlas::Packable(decoded.second)) {
+			object.atlasImages.emplace_back(std::move(decoded));
+		}
+		else if (TextureStreaming::Streamable(decoded.second)) {
+			object.streamedImages[decoded.first] = streamer.Add(std::make_shared<TextureDecode::DecodedImage const>(std::move(decoded.second)));
+		}
+		else if (decoded.second.compressed.Empty()) {
+			object.images[decoded.first] = std::make_shared<Texture2D>(decoded.second, decoded.second.srgb);
+		}
+		else {
+			object.images[decoded.first] = std::make_shared<Texture2D>(decoded.second.compressed, decoded.second.srgb);
+		}
+	}
+	// Streamed documents may pack in several batches, each batch adds its own arrays
+	if (!object.atlasImages.empty() && object.decoder->Pending() == 0) {
+		Pack_Atlas_Images(object);
+	}
+}
+
+// Copies geometry that finished loading into the arena, meshes then draw from the arena's buffers by baseVertex and firstIndex
+void Upload_Mesh_Geometry(GLTFObject& object, BufferArena& arena) {
+	for (std::pair<GLTF::index_type, std::vector<PrimitiveGeometry>> const& pending : object.pendingGeometry) {
+		for (PrimitiveGeometry const& primitive : pending.second) {
+			object.meshPrimitives[pending.first].push_back({ arena.Add(primitive.vertices, primitive.indices), primitive.material, primitive.pass });
+		}
+	}
+	object.pendingGeometry.clear();
+}
+
+// Texture the base color of a material samples, the texture array for packed images, 0 while it is not uploaded
+GLuint Base_Color_Texture(GLTFObject const& object, TextureStreaming::TextureStreamer const& streamer, unsigned int material) {
+	if (material >= object.materialTextures.size() || !object.materialTextures[material].baseColor.Used()) {
+		return 0;
+	}
+	TextureAtlas::TextureBinding const& binding = object.materialTextures[material].baseColor;
+	if (binding.placement.Packed()) {
+		return object.textureArrays[size_t(binding.placement.group)]->Id();
+	}
+	if (object.streamedImages[binding.image] != size_t(-1)) {
+		return streamer.Id(object.streamedImages[binding.image]);
+	}
+	return object.images[binding.image] ? object.images[binding.image]->Id() : 0;
+}
+
+// Layer and uv transform of a material's base color in its texture array, the default BatchLayer when it is not packed
+IndirectDraw::BatchLayer Base_Color_Layer(GLTFObject const& object, unsigned int material) {
+	IndirectDraw::BatchLayer layer;
+	if (material < object.materialTextures.size() && object.materialTextures[material].baseColor.placement.Packed()) {
+		TextureAtlas::Placement const& placement = object.materialTextures[material].baseColor.placement;
+		layer.layer = placement.layer;
+		layer.uvTransform = placement.uvTransform;
+	}
+	return layer;
+}
+
+// Queues every arena primitive of the visible instances with the instance's bounds, grouped by their base color texture so each group binds one texture
+void Queue_Visible_Draws(GLTFObject const& object, BufferArena const& arena, TextureStreaming::TextureStreamer const& streamer, GLuint program, GLuint vertexArray, IndirectDraw::IndirectRenderer& renderer) {
+	for (unsigned visible : object.visibleInstances) {
+		unsigned slot = object.instanceSlots[visible];
+		GLTF::index_type mesh = object.scene.mesh[slot];
+		if (mesh >= object.meshPrimitives.size()) {
+			continue;
+		}
+		for (ArenaPrimitive const& primitive : object.meshPrimitives[mesh]) {
+			IndirectDraw::GroupKey key;
+			key.program = program;
+			key.vertexArray = vertexArray;
+			key.batch = Base_Color_Texture(object, streamer, primitive.material);
+			key.pass = primitive.pass;
+			renderer.Add(key, arena.MeshRange(primitive.geometry), object.instanceWorlds[visible], primitive.material, object.instanceBounds[visible], Base_Color_Layer(object, primitive.material));
+		}
+	}
+}
+
+// Queues one instanced draw per primitive of each batch for its visible instances, in place of a draw per instance when culling on the CPU
+void Queue_Visible_Batches(GLTFObject const& object, BufferArena const& arena, TextureStreaming::TextureStreamer const& streamer, GLuint program, GLuint vertexArray, IndirectDraw::IndirectRenderer& renderer) {
+	std::vector<unsigned char> visible(object.instanceSlots.size(), 0);
+	for (unsigned instance : object.visibleInstances) {
+		visible[instance] = 1;
+	}
+	std::vector<glm::mat4> worlds;
+	for (SceneInstancing::Batch const& batch : object.batches) {
+		if (batch.mesh >= object.meshPrimitives.size() || object.meshPrimitives[batch.mesh].empty()) {
+			continue;
+		}
+		worlds.clear();
+		for (unsigned instance : batch.instances) {
+			if (visible[instance]) {
+				worlds.emplace_back(object.instanceWorlds[instance]);
+			}
+		}
+		for (ArenaPrimitive const& primitive : object.meshPrimitives[batch.mesh]) {
+			IndirectDraw::GroupKey key;
+			key.program = program;
+			key.vertexArray = vertexArray;
+			key.batch = Base_Color_Texture(object, streamer, primitive.material);
+			key.pass = primitive.pass;
+			renderer.Add(key, arena.MeshRange(primitive.geometry), worlds.data(), worlds.size(), primitive.material, Base_Color_Layer(object, primitive.material));
+		}
+	}
+}
+
+// Picks the instances of occluding meshes that are large next to the rest of the document
+void Select_Occluders(GLTFObject& object) {
+	object.occluderInstances.clear();
+	AABB document;
+	for (AABB const& bounds : object.instanceBounds) {
+		document.Grow(bounds);
+	}
+	if (document.Empty()) {
+		return;
+	}
+	float minimumSize = glm::length(document.Extent()) * OCCLUDER_MIN_SCENE_FRACTION;
+	for (size_t instance = 0; instance < object.instanceSlots.size(); ++instance) {
+		GLTF::index_type mesh = object.scene.mesh[object.instanceSlots[instance]];
+		if (mesh < object.meshOccluders.size() && object.meshOccluders[mesh] && glm::length(object.instanceBounds[instance].Extent()) >= minimumSize) {
+			object.occluderInstances.emplace_back(unsigned(instance));
+		}
+	}
+}
+
+// Bind pose streams of a skinned mesh's primitives, in the order Mesh_Geometry keeps them
+// Primitives without joints and weights keep their bind pose
+void Read_Skinned_Primitives(SkinnedDraw& draw, GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& spans, std::vector<PrimitiveGeometry> const& geometry) {
+	size_t kept = 0;
+	for (GLTF::Mesh::Primitive const& primitive : doc.meshes[draw.mesh].primitives) {
+		if (primitive.mode != 4 || primitive.attributes.find(GLTF::Constants::ATTRIBUTE_POSITION) == primitive.attributes.cend()) {
+			continue;
+		}
+		draw.vertices.emplace_back(geometry[kept++].vertices);
+		try {
+			draw.primitives.emplace_back(doc, spans, primitive);
+		}
+		catch (std::exception const& exception) {
+			std::cout << "Mesh " << draw.mesh << " is drawn in its bind pose: " << exception.what() << std::endl;
+			draw.primitives.emplace_back();
+		}
+		draw.skinned.emplace_back(draw.primitives.back().vertexCount);
+	}
+}
+
+// Replaces placeholder bounds with the real ones and adds picking triangles for meshes the stream finished.
+// Instances of the finished meshes keep their places, their boxes are patched and the culling hierarchy refit.
+// Nodes whose GPU instances were just read replace their one stand in instance, they wait for Rebuild_Streamed_Instances.
+void Publish_Streamed_Meshes(GLTFObject& object) {
+	std::vector<GLTF::index_type> ready = object.stream->Take_Ready_Meshes();
+	if (ready.empty()) {
+		return;
+	}
+	GLTF::GLTFDoc const& doc = object.stream->Document();
+	std::vector<GLTF::BufferSpan> spans = object.stream->Spans();
+	std::vector<std::shared_ptr<RayCast::TriangleBVH const>> triangles(doc.meshes.size());
+	size_t invalidRanges = 0;
+	for (GLTF::index_type mesh : ready) {
+		// Bounds below come from the data, not from the min/max in the file
+		std::vector<GLTF::RangeStatus> rangeStatus = object.stream->Resolve_Mesh_Ranges(mesh);
+		invalidRanges += std::count(rangeStatus.begin(), rangeStatus.end(), GLTF::RangeStatus::Invalid);
+		// Meshes without placeholder bounds had no instances
+		object.instancesChanged |= object.meshBounds[mesh].Empty();
+		object.meshBounds[mesh] = GLTF::Mesh_Bounds(doc, spans, doc.meshes[mesh]);
+		object.meshUvDensity[mesh] = TextureResidency::Mesh_Uv_Density(doc, spans, doc.meshes[mesh]);
+		object.pendingGeometry.emplace_back(mesh, Mesh_Geometry(doc, spans, doc.meshes[mesh]));
+		for (SkinnedDraw& draw : object.skinnedDraws) {
+			if (draw.mesh == mesh) {
+				Read_Skinned_Primitives(draw, doc, spans, object.pendingGeometry.back().second);
+			}
+		}
+		std::vector<float> positions;
+		std::vector<unsigned> indices;
+		Mesh_Triangles(doc, spans, doc.meshes[mesh], positions, indices);
+		triangles[mesh] = std::make_shared<RayCast::TriangleBVH const>(positions, indices, &Default_Thread_Pool());
+		if (!indices.empty() && indices.size() / 3 <= OCCLUDER_MAX_TRIANGLES && Can_Occlude(doc, mesh)) {
+			object.meshOccluders[mesh] = std::make_shared<Occlusion::OccluderMesh const>(std::move(positions), std::move(indices));
+		}
+	}
+	if (invalidRanges > 0) {
+		std::cout << invalidRanges << " accessors of streamed meshes had wrong min/max" << std::endl;
+	}
+	SceneInstancing::Read_Scene_Instances(doc, spans, object.nodeSlots, object.slotInstances, ready);
+
+	// Picking instances are added from the scene, the instance list may not have the GPU instances yet
+	for (size_t slot = 0; slot < object.scene.Size(); ++slot) {
+		GLTF::index_type mesh = object.scene.mesh[slot];
+		if (mesh >= triangles.size() || !triangles[mesh]) {
+			continue;
+		}
+		if (slot < object.slotInstances.size() && !object.slotInstances[slot].empty()) {
+			object.instancesChanged = true;
+			for (glm::mat4 const& instance : object.slotInstances[slot]) {
+				object.picking.Add_Instance(triangles[mesh], object.scene.world[slot] * instance);
+				object.pickingSlots.emplace_back(unsigned(slot));
+			}
+		}
+		else {
+			object.picking.Add_Instance(triangles[mesh], object.scene.world[slot]);
+			object.pickingSlots.emplace_back(unsigned(slot));
+		}
+	}
+
+	// Batches group the instances by mesh, so only the instances of the finished meshes are visited
+	std::vector<unsigned char> published(doc.meshes.size(), 0);
+	for (GLTF::index_type mesh : ready) {
+		published[mesh] = 1;
+	}
+	for (unsigned instance : SceneInstancing::Patch_Instance_Bounds(object.batches, published, object.slotInstances, object.meshBounds, object.instanceSlots, object.instanceWorlds, object.instanceBounds)) {
+		object.instanceCullBounds.Set(instance, object.instanceBounds[instance]);
+	}
+	object.instances.Refit(object.instanceBounds.data());
+	object.rebuildPending = true;
+}
+
+// Rebuilds what published meshes changed, at most every STREAM_REBUILD_INTERVAL while the stream reads and once more when it is done.
+// The picking hierarchy gains instances and occluders depend on the bounds, the instance list only changes for instancesChanged.
+void Rebuild_Streamed_Instances(GLTFObject& object) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!object.rebuildPending || (!object.stream->Done() && now - object.rebuilt < STREAM_REBUILD_INTERVAL)) {
+		return;
+	}
+	if (object.instancesChanged) {
+		GLTF::GLTFDoc const& doc = object.stream->Document();
+		SceneInstancing::Instance_Bounds(object.scene, object.slotInstances, object.meshBounds, object.instanceBounds, object.instanceSlots, object.instanceWorlds);
+		object.instances.Build(object.instanceBounds, &Default_Thread_Pool());
+		object.instanceCullBounds.Assign(object.instanceBounds);
+		object.batches = SceneInstancing::Compile(doc, object.scene, object.nodeSlots, object.instanceSlots);
+		object.instancesChanged = false;
+	}
+	object.picking.Build(&Default_Thread_Pool());
+	Select_Occluders(object);
+	object.rebuildPending = false;
+	object.rebuilt = now;
+}
+
+// Builds the clips and skins once the stream has read their accessors, the first clip plays on a loop as in other glTF viewers
+void Load_Streamed_Animations(GLTFObject& object) {
+	if (!object.stream->Take_Ready_Animations()) {
+		return;
+	}
+	GLTF::GLTFDoc const& doc = object.stream->Document();
+	std::vector<GLTF::BufferSpan> spans = object.stream->Spans();
+	try {
+		for (GLTF::Animation const& animation : doc.animations) {
+			object.animations.emplace_back(doc, spans, animation);
+			// Exported clips are baked at a fixed rate, most keys are redundant
+			Animation::Compress(object.animations.back(), Animation::CompressionSettings());
+		}
+		for (GLTF::Skin const& skin : doc.skins) {
+			object.skins.emplace_back(doc, spans, skin);
+		}
+	}
+	catch (std::exception const& exception) {
+		std::cout << "Animations failed to load: " << exception.what() << std::endl;
+		object.animations.clear();
+		object.skins.clear();
+	}
+	if (!object.animations.empty()) {
+		object.playing.emplace_back(object.animations.front(), 0);
+		object.playing.back().nodeSlots = object.nodeSlots.data();
+	}
+}
+
+// Moves the instances and picking instances of every node to its current world matrix, then refits both hierarchies.
+// GPU instances are runs of one slot, a node whose GPU instances were read since the last rebuild still has one stand in.
+void Place_Instances(GLTFObject& object) {
+	auto place = [&](std::vector<unsigned> const& slots, auto&& set) {
+		for (size_t first = 0; first < slots.size();) {
+			unsigned slot = slots[first];
+			size_t count = 1;
+			while (first + count < slots.size() && slots[first + count] == slot) {
+				++count;
+			}
+			bool gpuInstances = slot < object.slotInstances.size() && object.slotInstances[slot].size() == count;
+			for (size_t index = 0; index < count; ++index) {
+				set(first + index, gpuInstances ? object.scene.world[slot] * object.slotInstances[slot][index] : object.scene.world[slot]);
+			}
+			first += count;
+		}
+	};
+	place(object.instanceSlots, [&](size_t instance, glm::mat4 const& world) {
+		unsigned slot = object.instanceSlots[instance];
+		size_t skinned = slot < object.slotSkinnedDraws.size() ? object.slotSkinnedDraws[slot] : size_t(-1);
+		if (skinned != size_t(-1) && !object.skinnedDraws[skinned].bounds.Empty()) {
+			// Skinned vertices are already in world space
+			object.instanceWorlds[instance] = glm::mat4(1.0f);
+			object.instanceBounds[instance] = object.skinnedDraws[skinned].bounds;
+		}
+		else {
+			object.instanceWorlds[instance] = world;
+			object.instanceBounds[instance] = Transform_AABB(object.meshBounds[object.scene.mesh[slot]], world);
+		}
+		object.instanceCullBounds.Set(instance, object.instanceBounds[instance]);
+	});
+	object.instances.Refit(object.instanceBounds.data());
+	place(object.pickingSlots, [&](size_t instance, glm::mat4 const& world) {
+		object.picking.Set_Transform(unsigned(instance), world);
+	});
+	object.picking.Refit();
+}
+
+// Deforms the skinned meshes into world space with their joints' current matrices, see Upload_Skinned_Vertices
+void Skin_Object(GLTFObject& object) {
+	std::vector<Skinning::SkinJob> jobs;
+	for (SkinnedDraw& draw : object.skinnedDraws) {
+		if (draw.primitives.empty() || draw.skin >= object.skins.size()) {
+			continue;
+		}
+		Skinning::SkinData const& skin = object.skins[draw.skin];
+		if (std::any_of(skin.joints.cbegin(), skin.joints.cend(), [&](unsigned joint) { return joint >= object.nodeSlots.size() || object.nodeSlots[joint] == unsigned(-1); })) {
+			continue;
+		}
+		Skinning::Build_Palette(skin, object.scene.world.data(), glm::mat4(1.0f), draw.palette, object.nodeSlots.data());
+		for (size_t primitive = 0; primitive < draw.primitives.size(); ++primitive) {
+			Skinning::SkinnedMesh const& mesh = draw.primitives[primitive];
+			if (mesh.vertexCount > 0 && mesh.maxJoint < draw.palette.size()) {
+				jobs.push_back({ &mesh, Skinning::Method::LinearBlend, draw.palette.data(), nullptr, draw.palette.size(), draw.skinned[primitive].data() });
+			}
+		}
+		draw.changed = true;
+	}
+	if (jobs.empty()) {
+		return;
+	}
+	Skinning::Skin_Meshes(jobs, Default_Thread_Pool());
+
+	for (SkinnedDraw& draw : object.skinnedDraws) {
+		if (!draw.changed) {
+			continue;
+		}
+		draw.bounds = AABB();
+		for (size_t primitive = 0; primitive < draw.primitives.size(); ++primitive) {
+			if (draw.primitives[primitive].vertexCount == 0 || draw.primitives[primitive].maxJoint >= draw.palette.size()) {
+				continue;
+			}
+			for (size_t vertex = 0; vertex < draw.skinned[primitive].size(); ++vertex) {
+				Skinning::SkinnedVertex const& source = draw.skinned[primitive][vertex];
+				Vertex& target = draw.vertices[primitive][vertex];
+				target.x = source.position[0];
+				target.y = source.position[1];
+				target.z = source.position[2];
+				target.nx = source.normal[0];
+				target.ny = source.normal[1];
+				target.nz = source.normal[2];
+				draw.bounds.Grow(glm::vec3(target.x, target.y, target.z));
+			}
+		}
+	}
+}
+
+// Writes the vertices Skin_Object deformed over the skinned meshes' copies in the arena
+void Upload_Skinned_Vertices(GLTFObject& object, BufferArena& arena) {
+	for (SkinnedDraw& draw : object.skinnedDraws) {
+		if (!draw.changed || object.meshPrimitives[draw.mesh].size() != draw.vertices.size()) {
+			continue;
+		}
+		for (size_t primitive = 0; primitive < draw.vertices.size(); ++primitive) {
+			if (draw.primitives[primitive].vertexCount > 0) {
+				arena.Update_Vertices(object.meshPrimitives[draw.mesh][primitive].geometry, draw.vertices[primitive]);
+			}
+		}
+		draw.changed = false;
+	}
+}
+
+// Advances the playing clips and updates the nodes they move, skinned meshes follow their joints and instances their nodes
+void Animate_Object(GLTFObject& object, float deltaTime) {
+	if (object.playing.empty() && object.skinnedDraws.empty()) {
+		return;
+	}
+	for (Animation::Instance& instance : object.playing) {
+		instance.Advance(deltaTime);
+	}
+	if (!object.playing.empty()) {
+		object.animator.Evaluate(object.playing, object.scene.transforms);
+		object.scene.Update(Default_Thread_Pool());
+	}
+	Skin_Object(object);
+	Place_Instances(object);
+}
+
+// Asks the streamer for the levels visible instances need, from their distance and how densely their meshes use texture space
+// With a frustum the instances are tested here, for when visibleInstances holds every instance because drawing is culled on the GPU
+void Request_Streamed_Images(GLTFObject const& object, TextureStreaming::TextureStreamer& streamer, glm::mat4 const& view, glm::mat4 const& projection, Frustum const* frustum = nullptr) {
+	for (unsigned visible : object.visibleInstances) {
+		unsigned slot = object.instanceSlots[visible];
+		GLTF::index_type mesh = object.scene.mesh[slot];
+		if (mesh >= object.meshImages.size() || object.meshImages[mesh].empty() || object.meshUvDensity[mesh] <= 0.0f) {
+			continue;
+		}
+		// The nearest point of the bounds decides, a large instance close by needs its finest levels
+		AABB const& bounds = object.instanceBounds[visible];
+		unsigned planes = FRUSTUM_ALL_PLANES;
+		if (frustum && !frustum->Test(bounds, planes)) {
+			continue;
+		}
+		glm::vec3 center = glm::vec3(view * glm::vec4((bounds.minimum + bounds.maximum) * 0.5f, 1.0f));
+		float radius = glm::length(bounds.maximum - bounds.minimum) * 0.5f;
+		float pixelsPerWorldUnit = TextureResidency::Pixels_Per_World_Unit(projection, float(SCREEN_HEIGHT), -center.z - radius);
+		glm::mat4 const& world = object.instanceWorlds[visible];
+		float scale = std::max(std::max(glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1]))), glm::length(glm::vec3(world[2])));
+		float uvPerWorldUnit = object.meshUvDensity[mesh] / std::max(scale, 1e-6f);
+		for (GLTF::index_type image : object.meshImages[mesh]) {
+			if (object.streamedImages[image] != size_t(-1)) {
+				streamer.Request(object.streamedImages[image], uvPerWorldUnit, pixelsPerWorldUnit);
+			}
+		}
+	}
+}
+
 GLTFObject Load_GLTF_File(std::filesystem::path const& path) {
 	if (std::filesystem::is_directory(path)) {
 		// Error?
@@ -304,6 +1024,7 @@ GLTFObject Load_GLTF_File(std::filesystem::path const& path) {
 			Load_GLTF_File(path);
 		}
 	}
+	GLTFObject loaded;
 	if (path.extension() == ".gltf") {
 		// Load directly;
 		JsonParse::JsonReader file(path);
@@ -313,7 +1034,12 @@ GLTFObject Load_GLTF_File(std::filesystem::path const& path) {
 			std::filesystem::path directoryPath(path.parent_path());
 			if (t.first->type == JsonParse::Type::Object) {
 				std::shared_ptr<JsonParse::JsonObject> object = std::static_pointer_cast<JsonParse::JsonObject>(t.first);
-				GLTF::Validator validate(object);
+				std::map<std::string, void(*)(GLTF::Validator&, GLTF::type_json_object const&)> extensionHandlers = {
+					{ GLTF::Constants::EXT_MESHOPT_COMPRESSION, &GLTF::Validate_Meshopt_Compression },
+					{ GLTF::Constants::KHR_TEXTURE_BASISU, &GLTF::Validate_Texture_Basisu },
+					{ GLTF::Constants::EXT_MESH_GPU_INSTANCING, &GLTF::Validate_Mesh_Gpu_Instancing }
+				};
+				GLTF::Validator validate(object, extensionHandlers);
 				if (validate.errors.empty()) {
 					GLTF::GLTFDoc doc(object);
 
@@ -347,7 +1073,75 @@ GLTFObject Load_GLTF_File(std::filesystem::path const& path) {
 					std::vector<GLBufferView> bufferViews;
 
 					for (GLTF::Buffer const& buffer : doc.buffers) {
-						buffers.emplace_back(GLBuffer(buffer, directoryPath));
+						if (GLTF::MeshoptCompression::Is_Fallback_Buffer(buffer)) {
+							// Only reserves space, filled by decoding the compressed bufferViews
+							buffers.emplace_back(GLBuffer((size_t)buffer.byteLength));
+						}
+						else {
+							buffers.emplace_back(GLBuffer(buffer, directoryPath));
+						}
+					}
+
+					// Decode compressed bufferViews in place before any view reads its data
+					for (GLTF::BufferView const& bufferView : doc.bufferViews) {
+						GLTF::type_json_object extension = GLTF::Get_Extension(bufferView, GLTF::Constants::EXT_MESHOPT_COMPRESSION);
+						if (extension) {
+							GLTF::MeshoptCompression compression(extension);
+							std::vector<unsigned char> const& source = buffers[compression.buffer].bufferData;
+							std::vector<unsigned char>& destination = buffers[bufferView.buffer].bufferData;
+							if (size_t(bufferView.byteOffset + bufferView.byteLength) > destination.size() ||
+								!compression.Decode(source.data(), source.size(), destination.data() + bufferView.byteOffset, size_t(bufferView.byteLength))) {
+								throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to decode " + GLTF::Constants::EXT_MESHOPT_COMPRESSION + " bufferView '" + bufferView.name + "'.");
+							}
+						}
+					}
+
+					// Animation keyframes and skins are read on the CPU
+					{
+						std::vector<GLTF::BufferSpan> spans;
+						for (size_t index = 0; index < doc.buffers.size(); ++index) {
+							spans.emplace_back(buffers[index].bufferData);
+						}
+						// Queued first so decoding overlaps with everything below
+						loaded.decoder = Image_Decoder(doc);
+						for (GLTF::index_type image = 0; image < doc.images.size(); ++image) {
+							loaded.decoder->Enqueue_Image(doc, spans, image, directoryPath);
+						}
+						Prepare_Images(loaded, doc);
+						// Exporters omit or get min/max wrong, bounds below come from the data
+						std::vector<GLTF::RangeStatus> rangeStatus = GLTF::Resolve_Accessor_Ranges(doc, spans, Default_Thread_Pool());
+						size_t missingRanges = std::count(rangeStatus.begin(), rangeStatus.end(), GLTF::RangeStatus::Missing);
+						size_t invalidRanges = std::count(rangeStatus.begin(), rangeStatus.end(), GLTF::RangeStatus::Invalid);
+						if (invalidRanges > 0) {
+							std::cout << path << ": " << invalidRanges << " accessors with wrong min/max, " << missingRanges << " without" << std::endl;
+						}
+						loaded.nodeSlots = loaded.scene.Add_Document(doc);
+						loaded.scene.Update();
+						for (GLTF::index_type mesh = 0; mesh < doc.meshes.size(); ++mesh) {
+							loaded.meshBounds.emplace_back(GLTF::Mesh_Bounds(doc, spans, doc.meshes[mesh]));
+							loaded.meshUvDensity[mesh] = TextureResidency::Mesh_Uv_Density(doc, spans, doc.meshes[mesh]);
+							loaded.pendingGeometry.emplace_back(mesh, Mesh_Geometry(doc, spans, doc.meshes[mesh]));
+						}
+						loaded.meshPrimitives.resize(doc.meshes.size());
+						SceneInstancing::Read_Scene_Instances(doc, spans, loaded.nodeSlots, loaded.slotInstances);
+						SceneInstancing::Instance_Bounds(loaded.scene, loaded.slotInstances, loaded.meshBounds, loaded.instanceBounds, loaded.instanceSlots, loaded.instanceWorlds);
+						loaded.instances.Build(loaded.instanceBounds, &Default_Thread_Pool());
+						loaded.instanceCullBounds.Assign(loaded.instanceBounds);
+						// Nodes sharing a mesh are drawn together, a draw per primitive instead of one per node
+						loaded.batches = SceneInstancing::Compile(doc, loaded.scene, loaded.nodeSlots, loaded.instanceSlots);
+						{
+							std::vector<std::vector<float>> meshPositions(doc.meshes.size());
+							std::vector<std::vector<unsigned>> meshIndices(doc.meshes.size());
+							for (size_t mesh = 0; mesh < doc.meshes.size(); ++mesh) {
+								Mesh_Triangles(doc, spans, doc.meshes[mesh], meshPositions[mesh], meshIndices[mesh]);
+							}
+							std::vector<std::shared_ptr<RayCast::TriangleBVH const>> meshes = RayCast::Build_Meshes(meshPositions, meshIndices, Default_Thread_Pool());
+							for (size_t instance = 0; instance < loaded.instanceSlots.size(); ++instance) {
+								loaded.picking.Add_Instance(meshes[loaded.scene.mesh[loaded.instanceSlots[instance]]], loaded.instanceWorlds[instance]);
+							}
+							loaded.pickingSlots = loaded.instanceSlots;
+							loaded.picking.Build(&Default_Thread_Pool());
+						}
 					}
 
 					for (GLTF::BufferView const& bufferView : doc.bufferViews) {
@@ -452,30 +1246,6 @@ GLTFObject Load_GLTF_File(std::filesystem::path const& path) {
 								}
 								}
 							}
-
-							switch (accessor->componentType) {
-							case GLTF::Enumerations::ComponentType::Byte:
-								Check_Max_Min_Values<char>(bufferData, *accessor);
-								break;
-							case GLTF::Enumerations::ComponentType::Unsigned_Byte:
-								Check_Max_Min_Values<unsigned char>(bufferData, *accessor);
-								break;
-							case GLTF::Enumerations::ComponentType::Short:
-								Check_Max_Min_Values<short>(bufferData, *accessor);
-								break;
-							case GLTF::Enumerations::ComponentType::Unsigned_Short:
-								Check_Max_Min_Values<unsigned short>(bufferData, *accessor);
-								break;
-							case GLTF::Enumerations::ComponentType::Int:
-								Check_Max_Min_Values<int>(bufferData, *accessor);
-								break;
-							case GLTF::Enumerations::ComponentType::Unsigned_Int:
-								Check_Max_Min_Values<unsigned int>(bufferData, *accessor);
-								break;
-							case GLTF::Enumerations::ComponentType::Float:
-								Check_Max_Min_Values<float>(bufferData, *accessor);
-								break;
-							}
 						}
 					}
 
@@ -489,10 +1259,10 @@ GLTFObject Load_GLTF_File(std::filesystem::path const& path) {
 		}
 	}
 
-	return GLTFObject();
+	return loaded;
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
 	/* Initialize the library */
 	if (!glfwInit()) {
 		std::cerr << "GLFW Init Faliled." << std::endl;
@@ -600,6 +1370,40 @@ int main(void) {
 	
 	vertArray.SetIndexBuffer(ibuff);
 
+	// Copies of the ply model at each cube position, drawn with one instanced call from a second binding read once per instance
+	Shader instancedShader("./instanced_vertex.glsl", "./fragment.glsl");
+	std::vector<std::shared_ptr<BufferFormat>> instancedFormats{ format, Mesh::MeshInstanced::Format() };
+	VertexArray instancedArray(instancedFormats);
+	instancedArray.SetBuffer(binding.buffer, 0);
+	instancedArray.SetIndexBuffer(ibuff);
+	Mesh::MeshInstanced plyInstances;
+	plyInstances.Bind(instancedArray, 1);
+
+	// glTF meshes share two buffers and one VAO, each primitive is a range in them
+	BufferArena meshArena(format, MESH_ARENA_VERTICES, MESH_ARENA_INDICES);
+	VertexArray meshVertexArray(format);
+	meshArena.Bind(meshVertexArray, 0);
+	// Arena meshes are drawn with one multi-draw per texture, their transforms are read from a storage block
+	Shader indirectShader("./indirect_vertex.glsl", "./fragment.glsl");
+	IndirectDraw::IndirectRenderer indirectRenderer;
+	// When draw counts can come from a buffer every instance is queued and a compute pass culls them, otherwise they are culled here first
+	std::unique_ptr<GpuCulling::GpuCuller> gpuCuller;
+	if (GpuCulling::Supported()) {
+		gpuCuller = std::make_unique<GpuCulling::GpuCuller>();
+	}
+	// Blended materials draw last, back to front, over the depth the others wrote
+	indirectRenderer.bindPass = [](RenderQueue::Pass pass) {
+		if (pass == RenderQueue::Pass::Transparent) {
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+		}
+		else {
+			glDisable(GL_BLEND);
+			glDepthMask(GL_TRUE);
+		}
+	};
+
 	//GLuint VAO;
 	//GLuint VBO;
 	////GLuint EBO;
@@ -659,7 +1463,7 @@ int main(void) {
 	//Texture2D container("./container.jpg");
 	//Texture2D awesomeFace("./awesomeface.png");
 
-	glTextureStorage2D(texture1, 2, GL_RGB8, width, height);
+	glTextureStorage2D(texture1, Mipmap::Level_Count(width, height), GL_RGB8, width, height);
 	glTextureSubImage2D(texture1, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
 	glGenerateTextureMipmap(texture1);
 
@@ -667,7 +1471,7 @@ int main(void) {
 
 	data = stbi_load("./awesomeface.png", &width, &height, &nrChannels, 0);
 
-	glTextureStorage2D(texture2, 2, GL_RGBA8, width, height);
+	glTextureStorage2D(texture2, Mipmap::Level_Count(width, height), GL_RGBA8, width, height);
 	glTextureSubImage2D(texture2, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
 	glGenerateTextureMipmap(texture2);
 
@@ -675,6 +1479,9 @@ int main(void) {
 
 	myShader.SetInt("texture1", 0);
 	myShader.SetInt("texture2", 1);
+	// Per frame data is written through a persistent mapping and bound by range, not set one uniform at a time
+	RingBuffer frameData(FRAME_DATA_SIZE);
+	FrameUniforms frameUniforms;
 
 	glm::vec3 cubePositions[] = {
 		glm::vec3(0.0f,  0.0f,  0.0f),
@@ -689,8 +1496,28 @@ int main(void) {
 		glm::vec3(-1.3f,  1.0f, -1.5f)
 	};
 	
+	for (glm::vec3 const& cubePosition : cubePositions) {
+		plyInstances.Add({ { 0.0f, 0.0f, 0.0f, 1.0f }, { cubePosition.x, cubePosition.y, cubePosition.z }, .01f });
+	}
+
+	// Each .gltf named on the command line streams in while the loop draws it
+	std::vector<GLTFObject> gltfObjects;
+	for (int argument = 1; argument < argc; ++argument) {
+		try {
+			gltfObjects.emplace_back(Stream_GLTF_File(argv[argument]));
+		}
+		catch (std::exception const& exception) {
+			std::cerr << "Failed to load " << argv[argument] << ": " << exception.what() << std::endl;
+		}
+	}
+	TextureStreaming::TextureStreamer textureStreamer(TEXTURE_BUDGET);
+	Culling::FrustumCuller culler;
+	Occlusion::OcclusionCuller occlusionCuller;
+
 	glfwSwapInterval(0);
 	/* Loop until the user closes the window */
+	bool pickHeld = false;
+	double frameTime = glfwGetTime();
 	while (!glfwWindowShouldClose(window)) {
 		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 		/* Render here */
@@ -698,6 +1525,7 @@ int main(void) {
 		//glClear(GL_COLOR_BUFFER_BIT);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		//glClearNamedFramebufferfv(0, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, );
+		frameData.BeginFrame();
 
 		myShader.Use();
 
@@ -711,16 +1539,93 @@ int main(void) {
 		glm::mat4 view(1.0f);
 		glm::mat4 projection(1.0f);
 		view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
-		projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 10000.f);
+		projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
 
 		glm::vec3 cameraPosition(0.0f, 0.0f, -3.0f);
 		//glm::vec4 v(cameraOrientation.x, cameraOrientation.y, cameraOrientation.z, cameraOrientation.w);
-		myShader.SetVec3("cameraPosition", cameraPosition);
-		myShader.SetVec4("cameraOrientation", cameraOrientation);
+		frameUniforms.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+		frameUniforms.cameraOrientation = glm::vec4(cameraOrientation.x, cameraOrientation.y, cameraOrientation.z, cameraOrientation.w);
+
+		frameUniforms.view = view;
+		frameUniforms.projection = projection;
+
+		double time = glfwGetTime();
+		float deltaTime = float(time - frameTime);
+		frameTime = time;
+		// Streamed documents read what is largest on screen first, decoded images are uploaded as they finish
+		for (GLTFObject& object : gltfObjects) {
+			if (object.stream) {
+				object.stream->Prioritize(Streaming::Mesh_Priorities(object.scene, object.meshBounds, view, projection));
+				object.stream->Pump();
+				Publish_Streamed_Meshes(object);
+				Rebuild_Streamed_Instances(object);
+				Load_Streamed_Animations(object);
+			}
+			Animate_Object(object, deltaTime);
+			Upload_Decoded_Images(object, textureStreamer);
+			Upload_Mesh_Geometry(object, meshArena);
+			Upload_Skinned_Vertices(object, meshArena);
+		}
 
-		myShader.SetMat4("view", view);
-		myShader.SetMat4("projection", projection);
-		myShader.SetFloat("ratio", mixRatio);
+		// Only instances in view are submitted
+		culler.statistics.Reset();
+		Frustum frustum(projection * view);
+		for (GLTFObject& object : gltfObjects) {
+			if (gpuCuller) {
+				object.visibleInstances.resize(object.instanceSlots.size());
+				std::iota(object.visibleInstances.begin(), object.visibleInstances.end(), 0u);
+			}
+			else {
+				culler.Cull(frustum, object.instanceCullBounds, object.visibleInstances, &Default_Thread_Pool());
+			}
+		}
+		// Large simple meshes are drawn into a CPU depth buffer and hide the instances behind them
+		occlusionCuller.statistics.Reset();
+		if (std::any_of(gltfObjects.cbegin(), gltfObjects.cend(), [](GLTFObject const& object) { return !object.occluderInstances.empty(); })) {
+			occlusionCuller.Begin(projection * view);
+			for (GLTFObject const& object : gltfObjects) {
+				for (unsigned instance : object.occluderInstances) {
+					occlusionCuller.Add_Occluder(*object.meshOccluders[object.scene.mesh[object.instanceSlots[instance]]], object.instanceWorlds[instance]);
+				}
+			}
+			occlusionCuller.Render(&Default_Thread_Pool());
+			for (GLTFObject& object : gltfObjects) {
+				occlusionCuller.Cull(object.instanceBounds.data(), object.visibleInstances, &Default_Thread_Pool());
+			}
+		}
+		// Streamed images load the levels this frame needs and give up levels nothing has used for longest
+		for (GLTFObject const& object : gltfObjects) {
+			Request_Streamed_Images(object, textureStreamer, view, projection, gpuCuller ? &frustum : nullptr);
+		}
+		textureStreamer.Update();
+		// Left click picks the nearest instance under the cursor
+		bool pickPressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+		if (pickPressed && !pickHeld) {
+			double cursorX;
+			double cursorY;
+			glfwGetCursorPos(window, &cursorX, &cursorY);
+			glm::vec4 viewport(0.0f, 0.0f, float(SCREEN_WIDTH), float(SCREEN_HEIGHT));
+			glm::vec3 nearPoint = glm::unProject(glm::vec3(float(cursorX), float(SCREEN_HEIGHT - cursorY), 0.0f), view, projection, viewport);
+			glm::vec3 farPoint = glm::unProject(glm::vec3(float(cursorX), float(SCREEN_HEIGHT - cursorY), 1.0f), view, projection, viewport);
+			RayCast::Ray ray;
+			ray.origin = nearPoint;
+			ray.direction = glm::normalize(farPoint - nearPoint);
+			size_t pickedObject = gltfObjects.size();
+			RayCast::SceneHit picked;
+			for (size_t object = 0; object < gltfObjects.size(); ++object) {
+				RayCast::SceneHit hit = gltfObjects[object].picking.Intersect(ray);
+				if (hit.Valid() && hit.hit.distance < ray.maxDistance) {
+					ray.maxDistance = hit.hit.distance;
+					pickedObject = object;
+					picked = hit;
+				}
+			}
+			if (picked.Valid()) {
+				std::cout << "Picked object " << pickedObject << ", node slot " << gltfObjects[pickedObject].pickingSlots[picked.instance] << ", triangle " << picked.hit.triangle << " at " << picked.hit.distance << std::endl;
+			}
+		}
+		pickHeld = pickPressed;
+		frameUniforms.ratio = mixRatio;
 
 		vertArray.Bind();
 		//glBindVertexArray(VAO);
@@ -747,13 +1652,62 @@ int main(void) {
 			modelRotate = glm::normalize(modelRotate);
 			//std::cout << "ModelRotate: x=" << modelRotate.x << ", y=" << modelRotate.y << ", z=" << modelRotate.z << ", w=" << modelRotate.w << std::endl;
 			//myShader.SetMat4("model", model);
-			myShader.SetVec3("modelPosition", modelPosition);
-			myShader.SetVec4("modelOrientation", modelRotate);
+			frameUniforms.modelPosition = glm::vec4(modelPosition, 1.0f);
+			frameUniforms.modelOrientation = modelRotate;
+			frameData.BindUniform(0, frameData.Push(frameUniforms, frameData.UniformAlignment()));
 
 			//glDrawElements(GL_TRIANGLES, vertArray.bufferIndex->subBuffers[0].subBufferSize, GL_UNSIGNED_INT, nullptr);
 			//glDrawArrays(GL_TRIANGLES, 0, 36);
 		//}
+
+		// Every copy turns with the model, only the instances changed here are uploaded
+		for (size_t instance = 0; instance < plyInstances.Size(); ++instance) {
+			Mesh::InstanceData placement;
+			placement.orientation = { modelRotate.x, modelRotate.y, modelRotate.z, modelRotate.w };
+			placement.position = { modelPosition.x + cubePositions[instance].x, modelPosition.y + cubePositions[instance].y, modelPosition.z + cubePositions[instance].z };
+			placement.scale = .01f;
+			plyInstances.Set(instance, placement);
+		}
+		plyInstances.Upload();
+		instancedShader.Use();
+		instancedArray.Bind();
+		plyInstances.Draw(GLsizei(indices[3].size()));
+
+		indirectRenderer.statistics.Reset();
+		indirectRenderer.Clear();
+		indirectRenderer.Set_View(view, NEAR_PLANE, FAR_PLANE);
+		for (GLTFObject const& object : gltfObjects) {
+			if (gpuCuller) {
+				Queue_Visible_Draws(object, meshArena, textureStreamer, indirectShader.programId, meshVertexArray.VertexArrayId(), indirectRenderer);
+			}
+			else {
+				Queue_Visible_Batches(object, meshArena, textureStreamer, indirectShader.programId, meshVertexArray.VertexArrayId(), indirectRenderer);
+			}
+		}
+		// Packed base colors are texture arrays, fragment.glsl samples those from unit 2
+		auto bindBatch = [&](uint32_t batch) {
+			GLint target = GL_TEXTURE_2D;
+			if (batch != 0) {
+				glGetTextureParameteriv(batch, GL_TEXTURE_TARGET, &target);
+			}
+			if (target == GL_TEXTURE_2D_ARRAY) {
+				glBindTextureUnit(2, batch);
+			}
+			else {
+				glBindTextureUnit(0, batch != 0 ? batch : texture1);
+			}
+		};
+		if (gpuCuller) {
+			gpuCuller->statistics.Reset();
+		}
+		if (!(gpuCuller ? gpuCuller->Submit(indirectRenderer, frameData, frustum, bindBatch) : indirectRenderer.Submit(frameData, bindBatch))) {
+			std::cout << "Frame data is too small for " << indirectRenderer.Size() << " draws." << std::endl;
+		}
+		// Depth writes have to be back on for the next frame's clear
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
 		
+		frameData.EndFrame();
 		/* Swap front and back buffers */
 		glfwSwapBuffers(window);
 
@@ -762,7 +1716,7 @@ int main(void) {
 		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
 		std::chrono::steady_clock::duration diff = end - start;
 		std::chrono::steady_clock::duration base = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1));
-		std::string message("LeanOpenGL, FPS:" + std::to_string(base.count() / diff.count()));
+		std::string message("LeanOpenGL, FPS:" + std::to_string(base.count() / diff.count()) + ", Culled:" + std::to_string(culler.statistics.Culled()) + "/" + std::to_string(culler.statistics.tested) + " in " + std::to_string(culler.statistics.milliseconds) + "ms, Occluded:" + std::to_string(occlusionCuller.statistics.occluded) + ", Draws:" + (gpuCuller ? std::to_string(gpuCuller->statistics.candidates) + " culled on the GPU in " + std::to_string(gpuCuller->statistics.groups) : std::to_string(indirectRenderer.statistics.instances) + " instances in " + std::to_string(indirectRenderer.statistics.draws) + " draws, " + std::to_string(indirectRenderer.statistics.groups)) + " multi-draws");
 		glfwSetWindowTitle(window, message.c_str());
 	}
 
@@ -0,0 +1,521 @@
+#pragma once
+#include "Bounds.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// <summary>
+/// Bounding volume hierarchy over boxes, built with binned SAH and refit in place when the boxes move.
+/// Children of a node are stored next to each other, always after their parent, and a leaf references a contiguous range of 'indices'.
+/// </summary>
+class BVH {
+public:
+	struct Node {
+		float minimum[3];
+		// First child when count is 0, otherwise the first entry of indices
+		unsigned leftFirst;
+		float maximum[3];
+		unsigned count;
+
+		bool Leaf() const {
+			return count != 0;
+		}
+
+		AABB Bounds() const {
+			return AABB(glm::vec3(minimum[0], minimum[1], minimum[2]), glm::vec3(maximum[0], maximum[1], maximum[2]));
+		}
+
+		void SetBounds(AABB const& bounds) {
+			for (glm::length_t axis = 0; axis < 3; ++axis) {
+				minimum[axis] = bounds.minimum[axis];
+				maximum[axis] = bounds.maximum[axis];
+			}
+		}
+	};
+	static_assert(sizeof(Node) == 32, "BVH nodes are two per cache line");
+
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float maxDistance = std::numeric_limits<float>::max();
+	};
+
+	struct RayHit {
+		unsigned primitive = unsigned(-1);
+		float distance = std::numeric_limits<float>::max();
+	};
+
+	static constexpr unsigned BIN_COUNT = 16;
+	static constexpr unsigned MAX_LEAF_SIZE = 8;
+	// Cost of visiting a node relative to testing one primitive
+	static constexpr float TRAVERSAL_COST = 1.0f;
+	// Below this many primitives Build does not use the pool
+	static constexpr size_t PARALLEL_MINIMUM = 16384;
+	// Past this depth nodes are split at the median, which bounds the depth and the traversal stacks
+	static constexpr unsigned MEDIAN_DEPTH = 64;
+	static constexpr size_t STACK_SIZE = 128;
+
+	std::vector<Node> nodes;
+	std::vector<unsigned> indices;
+
+private:
+	struct Range {
+		unsigned node;
+		unsigned first;
+		unsigned count;
+		unsigned depth;
+	};
+
+	/// <summary>
+	/// Splits the node over [first, first + count) of indices, or leaves it as a leaf.
+	/// </summary>
+	/// <returns>False when the node became a leaf</returns>
+	bool Split(std::vector<Node>& target, unsigned node, unsigned first, unsigned count, unsigned depth, AABB const* bounds, std::vector<glm::vec3> const& centroids, unsigned& leftCount) {
+		AABB nodeBounds;
+		AABB centroidBounds;
+		for (unsigned index = first; index < first + count; ++index) {
+			nodeBounds.Grow(bounds[indices[index]]);
+			centroidBounds.Grow(centroids[indices[index]]);
+		}
+		target[node].SetBounds(nodeBounds);
+		target[node].leftFirst = first;
+		target[node].count = count;
+
+		if (count <= 1) {
+			return false;
+		}
+		if (depth >= MEDIAN_DEPTH) {
+			return Split_Median(target, node, first, count, centroids, centroidBounds, leftCount);
+		}
+
+		// Best plane over the bins of every axis, costs are relative to the node surface area
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		unsigned bestBin = 0;
+		glm::vec3 extent = centroidBounds.Extent();
+		glm::vec3 scale(0.0f);
+		for (glm::length_t axis = 0; axis < 3; ++axis) {
+			scale[axis] = extent[axis] > 0.0f ? BIN_COUNT / extent[axis] : 0.0f;
+		}
+
+		// All three axes in one pass over the primitives
+		AABB axisBinBounds[3][BIN_COUNT];
+		unsigned axisBinCount[3][BIN_COUNT] = {};
+		for (unsigned index = first; index < first + count; ++index) {
+			unsigned primitive = indices[index];
+			glm::vec3 position = (centroids[primitive] - centroidBounds.minimum) * scale;
+			for (glm::length_t axis = 0; axis < 3; ++axis) {
+				unsigned bin = std::min(BIN_COUNT - 1, unsigned(position[axis]));
+				++axisBinCount[axis][bin];
+				axisBinBounds[axis][bin].Grow(bounds[primitive]);
+			}
+		}
+
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+			AABB const* binBounds = axisBinBounds[axis];
+			unsigned const* binCount = axisBinCount[axis];
+
+			// Sweep from both sides for the area and count left and right of each plane
+			float leftArea[BIN_COUNT - 1];
+			unsigned leftCounts[BIN_COUNT - 1];
+			AABB sweep;
+			unsigned sum = 0;
+			for (unsigned bin = 0; bin < BIN_COUNT - 1; ++bin) {
+				sweep.Grow(binBounds[bin]);
+				sum += binCount[bin];
+				leftArea[bin] = sweep.SurfaceArea();
+				leftCounts[bin] = sum;
+			}
+			sweep = AABB();
+			sum = 0;
+			for (unsigned bin = BIN_COUNT - 1; bin > 0; --bin) {
+				sweep.Grow(binBounds[bin]);
+				sum += binCount[bin];
+				float cost = leftArea[bin - 1] * leftCounts[bin - 1] + sweep.SurfaceArea() * sum;
+				if (leftCounts[bin - 1] > 0 && sum > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		float area = nodeBounds.SurfaceArea();
+		float leafCost = area * count;
+		float splitCost = area * TRAVERSAL_COST + bestCost;
+		unsigned middle;
+		if (bestAxis >= 0 && (splitCost < leafCost || count > MAX_LEAF_SIZE)) {
+			float axisScale = scale[bestAxis];
+			float minimum = centroidBounds.minimum[bestAxis];
+			unsigned* split = std::partition(indices.data() + first, indices.data() + first + count, [&](unsigned primitive) {
+				return std::min(BIN_COUNT - 1, unsigned((centroids[primitive][bestAxis] - minimum) * axisScale)) < bestBin;
+			});
+			middle = unsigned(split - indices.data());
+		}
+		else if (count > MAX_LEAF_SIZE) {
+			// Every centroid in one place, any split is as good as another
+			return Split_Median(target, node, first, count, centroids, centroidBounds, leftCount);
+		}
+		else {
+			return false;
+		}
+
+		leftCount = middle - first;
+		target[node].leftFirst = unsigned(target.size());
+		target[node].count = 0;
+		target.emplace_back();
+		target.emplace_back();
+		return true;
+	}
+
+	bool Split_Median(std::vector<Node>& target, unsigned node, unsigned first, unsigned count, std::vector<glm::vec3> const& centroids, AABB const& centroidBounds, unsigned& leftCount) {
+		if (count <= MAX_LEAF_SIZE) {
+			return false;
+		}
+		glm::vec3 extent = centroidBounds.Extent();
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		leftCount = count / 2;
+		std::nth_element(indices.data() + first, indices.data() + first + leftCount, indices.data() + first + count, [&](unsigned a, unsigned b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+		target[node].leftFirst = unsigned(target.size());
+		target[node].count = 0;
+		target.emplace_back();
+		target.emplace_back();
+		return true;
+	}
+
+	/// <summary>
+	/// Builds the subtree of 'root' into 'target', subtrees of at most 'deferSize' primitives are added to 'deferred' instead.
+	/// </summary>
+	void Build_Subtree(std::vector<Node>& target, Range root, AABB const* bounds, std::vector<glm::vec3> const& centroids, size_t deferSize, std::vector<Range>* deferred) {
+		std::vector<Range> stack(1, root);
+		while (!stack.empty()) {
+			Range range = stack.back();
+			stack.pop_back();
+			if (deferred && range.count <= deferSize) {
+				deferred->emplace_back(range);
+				continue;
+			}
+
+			unsigned leftCount = 0;
+			if (Split(target, range.node, range.first, range.count, range.depth, bounds, centroids, leftCount)) {
+				unsigned left = target[range.node].leftFirst;
+				stack.push_back({ left + 1, range.first + leftCount, range.count - leftCount, range.depth + 1 });
+				stack.push_back({ left, range.first, leftCount, range.depth + 1 });
+			}
+		}
+	}
+
+	static bool Ray_Box(Node const& node, glm::vec3 const& origin, glm::vec3 const& inverseDirection, float maxDistance, float& entry) {
+		float entryDistance = 0.0f;
+		float exitDistance = maxDistance;
+		for (glm::length_t axis = 0; axis < 3; ++axis) {
+			float a = (node.minimum[axis] - origin[axis]) * inverseDirection[axis];
+			float b = (node.maximum[axis] - origin[axis]) * inverseDirection[axis];
+			entryDistance = std::max(entryDistance, std::min(a, b));
+			exitDistance = std::min(exitDistance, std::max(a, b));
+		}
+		entry = entryDistance;
+		return entryDistance <= exitDistance;
+	}
+
+public:
+	BVH() = default;
+	BVH(BVH const&) = default;
+	BVH(BVH&&) = default;
+
+	BVH& operator=(BVH const&) = default;
+	BVH& operator=(BVH&&) = default;
+
+	bool Empty() const {
+		return nodes.empty();
+	}
+
+	/// <summary>
+	/// Builds over 'count' boxes, primitive N is bounds[N].
+	/// With a pool the upper levels are split on the calling thread and the subtrees below them are built in parallel.
+	/// </summary>
+	void Build(AABB const* bounds, size_t count, ThreadPool* pool = nullptr) {
+		nodes.clear();
+		indices.resize(count);
+		if (count == 0) {
+			return;
+		}
+
+		std::vector<glm::vec3> centroids(count);
+		for (size_t primitive = 0; primitive < count; ++primitive) {
+			indices[primitive] = unsigned(primitive);
+			centroids[primitive] = bounds[primitive].Center();
+		}
+
+		nodes.reserve(count * 2);
+		nodes.emplace_back();
+		Range root = { 0, 0, unsigned(count), 0 };
+		if (!pool || pool->ThreadCount() == 0 || count < PARALLEL_MINIMUM) {
+			Build_Subtree(nodes, root, bounds, centroids, 0, nullptr);
+			return;
+		}
+
+		std::vector<Range> deferred;
+		size_t deferSize = std::max(count / ((pool->ThreadCount() + 1) * 4), size_t(MAX_LEAF_SIZE));
+		Build_Subtree(nodes, root, bounds, centroids, deferSize, &deferred);
+
+		// Each subtree is built with its root at 0 of its own array, then moved behind the upper levels
+		std::vector<std::vector<Node>> subtrees(deferred.size());
+		pool->Parallel_For(deferred.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				subtrees[index].emplace_back();
+				Range range = deferred[index];
+				range.node = 0;
+				Build_Subtree(subtrees[index], range, bounds, centroids, 0, nullptr);
+			}
+		});
+
+		for (size_t index = 0; index < deferred.size(); ++index) {
+			std::vector<Node> const& subtree = subtrees[index];
+			// Local node N > 0 becomes node N + offset
+			unsigned offset = unsigned(nodes.size()) - 1;
+			for (size_t local = 0; local < subtree.size(); ++local) {
+				Node node = subtree[local];
+				if (!node.Leaf()) {
+					node.leftFirst += offset;
+				}
+				if (local == 0) {
+					nodes[deferred[index].node] = node;
+				}
+				else {
+					nodes.emplace_back(node);
+				}
+			}
+		}
+	}
+
+	void Build(std::vector<AABB> const& bounds, ThreadPool* pool = nullptr) {
+		Build(bounds.data(), bounds.size(), pool);
+	}
+
+	/// <summary>
+	/// Recomputes node bounds for moved primitives, the tree shape is kept so queries slow down as objects drift apart.
+	/// </summary>
+	void Refit(AABB const* bounds) {
+		for (size_t index = nodes.size(); index-- > 0;) {
+			Node& node = nodes[index];
+			AABB nodeBounds;
+			if (node.Leaf()) {
+				for (unsigned primitive = node.leftFirst; primitive < node.leftFirst + node.count; ++primitive) {
+					nodeBounds.Grow(bounds[indices[primitive]]);
+				}
+			}
+			else {
+				nodeBounds = nodes[node.leftFirst].Bounds();
+				nodeBounds.Grow(nodes[node.leftFirst + 1].Bounds());
+			}
+			node.SetBounds(nodeBounds);
+		}
+	}
+
+	/// <summary>
+	/// Appends primitives whose node boxes are inside or intersect the frustum.
+	/// Leaves fully inside are not tested against the planes, so results are conservative at leaf level.
+	/// </summary>
+	/// <returns>Primitives appended</returns>
+	size_t Query_Frustum(Frustum const& frustum, std::vector<unsigned>& results) const {
+		if (nodes.empty()) {
+			return 0;
+		}
+		size_t start = results.size();
+		std::pair<unsigned, unsigned> stack[STACK_SIZE];
+		size_t top = 0;
+		stack[top++] = { 0, FRUSTUM_ALL_PLANES };
+		while (top > 0) {
+			std::pair<unsigned, unsigned> entry = stack[--top];
+			Node const& node = nodes[entry.first];
+			unsigned mask = entry.second;
+			if (mask && !frustum.Test(node.Bounds(), mask)) {
+				continue;
+			}
+			if (node.Leaf()) {
+				results.insert(results.end(), indices.cbegin() + node.leftFirst, indices.cbegin() + node.leftFirst + node.count);
+			}
+			else {
+				stack[top++] = { node.leftFirst + 1, mask };
+				stack[top++] = { node.leftFirst, mask };
+			}
+		}
+		return results.size() - start;
+	}
+
+	/// <summary>
+	/// Appends primitives whose leaf boxes overlap 'box'.
+	/// </summary>
+	/// <param name="bounds">When given only primitives whose own box overlaps are appended</param>
+	/// <returns>Primitives appended</returns>
+	size_t Query_AABB(AABB const& box, std::vector<unsigned>& results, AABB const* bounds = nullptr) const {
+		if (nodes.empty()) {
+			return 0;
+		}
+		size_t start = results.size();
+		unsigned stack[STACK_SIZE];
+		size_t top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			Node const& node = nodes[stack[--top]];
+			if (!node.Bounds().Overlaps(box)) {
+				continue;
+			}
+			if (node.Leaf()) {
+				for (unsigned index = node.leftFirst; index < node.leftFirst + node.count; ++index) {
+					if (!bounds || bounds[indices[index]].Overlaps(box)) {
+						results.emplace_back(indices[index]);
+					}
+				}
+			}
+			else {
+				stack[top++] = node.leftFirst + 1;
+				stack[top++] = node.leftFirst;
+			}
+		}
+		return results.size() - start;
+	}
+
+	/// <summary>
+	/// Closest hit along a ray, children are visited nearest first so far subtrees are skipped once something is hit.
+	/// </summary>
+	/// <param name="intersect">bool(unsigned primitive, Ray const& ray, float& distance), sets distance and returns true on a hit closer than ray.maxDistance</param>
+	template <class _Fn>
+	RayHit Ray_Cast(Ray ray, _Fn&& intersect) const {
+		RayHit hit;
+		if (nodes.empty()) {
+			return hit;
+		}
+		glm::vec3 inverseDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+		float entry;
+		if (!Ray_Box(nodes[0], ray.origin, inverseDirection, ray.maxDistance, entry)) {
+			return hit;
+		}
+
+		std::pair<unsigned, float> stack[STACK_SIZE];
+		size_t top = 0;
+		stack[top++] = { 0, entry };
+		while (top > 0) {
+			std::pair<unsigned, float> current = stack[--top];
+			if (current.second > ray.maxDistance) {
+				continue;
+			}
+			Node const& node = nodes[current.first];
+			if (node.Leaf()) {
+				for (unsigned index = node.leftFirst; index < node.leftFirst + node.count; ++index) {
+					float distance;
+					if (intersect(indices[index], static_cast<Ray const&>(ray), distance) && distance < ray.maxDistance) {
+						ray.maxDistance = distance;
+						hit.primitive = indices[index];
+						hit.distance = distance;
+					}
+				}
+				continue;
+			}
+
+			float nearEntry;
+			float farEntry;
+			unsigned nearChild = node.leftFirst;
+			unsigned farChild = node.leftFirst + 1;
+			bool nearHit = Ray_Box(nodes[nearChild], ray.origin, inverseDirection, ray.maxDistance, nearEntry);
+			bool farHit = Ray_Box(nodes[farChild], ray.origin, inverseDirection, ray.maxDistance, farEntry);
+			if (nearHit && farHit && farEntry < nearEntry) {
+				std::swap(nearChild, farChild);
+				std::swap(nearEntry, farEntry);
+			}
+			else if (!nearHit) {
+				nearHit = farHit;
+				farHit = false;
+				nearChild = farChild;
+				nearEntry = farEntry;
+			}
+			if (farHit) {
+				stack[top++] = { farChild, farEntry };
+			}
+			if (nearHit) {
+				stack[top++] = { nearChild, nearEntry };
+			}
+		}
+		return hit;
+	}
+
+	/// <summary>
+	/// Closest primitive box hit along a ray, for picking.
+	/// </summary>
+	RayHit Ray_Cast_Bounds(Ray const& ray, AABB const* bounds) const {
+		glm::vec3 inverseDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+		return Ray_Cast(ray, [bounds, &inverseDirection](unsigned primitive, Ray const& current, float& distance) {
+			Node box;
+			box.SetBounds(bounds[primitive]);
+			return Ray_Box(box, current.origin, inverseDirection, current.maxDistance, distance);
+		});
+	}
+
+	/// <summary>
+	/// Runs one frustum query per entry of 'frustums', for shadow cascades and other views culled together.
+	/// </summary>
+	void Query_Frustums(Frustum const* frustums, size_t count, std::vector<std::vector<unsigned>>& results, ThreadPool& pool) const {
+		results.resize(count);
+		pool.Parallel_For(count, 1, [&](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				results[index].clear();
+				Query_Frustum(frustums[index], results[index]);
+			}
+		});
+	}
+
+	void Query_AABBs(AABB const* boxes, size_t count, std::vector<std::vector<unsigned>>& results, ThreadPool& pool, AABB const* bounds = nullptr) const {
+		results.resize(count);
+		pool.Parallel_For(count, 64, [&](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				results[index].clear();
+				Query_AABB(boxes[index], results[index], bounds);
+			}
+		});
+	}
+
+	template <class _Fn>
+	void Ray_Cast_Batch(Ray const* rays, size_t count, RayHit* hits, ThreadPool& pool, _Fn const& intersect) const {
+		pool.Parallel_For(count, 256, [&](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				hits[index] = Ray_Cast(rays[index], intersect);
+			}
+		});
+	}
+
+	void Ray_Cast_Bounds_Batch(Ray const* rays, size_t count, RayHit* hits, ThreadPool& pool, AABB const* bounds) const {
+		pool.Parallel_For(count, 256, [&](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				hits[index] = Ray_Cast_Bounds(rays[index], bounds);
+			}
+		});
+	}
+
+	/// <summary>
+	/// Surface area heuristic cost of the tree relative to its root, lower is better, for comparing builds and watching refits degrade.
+	/// </summary>
+	float Cost() const {
+		if (nodes.empty()) {
+			return 0.0f;
+		}
+		float rootArea = nodes[0].Bounds().SurfaceArea();
+		if (rootArea <= 0.0f) {
+			return 0.0f;
+		}
+		float cost = 0.0f;
+		for (Node const& node : nodes) {
+			float area = node.Bounds().SurfaceArea() / rootArea;
+			cost += node.Leaf() ? area * node.count : area * TRAVERSAL_COST;
+		}
+		return cost;
+	}
+};
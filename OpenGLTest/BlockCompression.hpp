@@ -0,0 +1,854 @@
+#pragma once
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Encoders for the BC block formats, 4x4 pixel blocks in 8 or 16 bytes that the GPU samples without decompressing
+// BC7 is only ever written in mode 6, one subset for colour and alpha, so it trades some quality on blocks with several colours for a simple encoder
+namespace BlockCompression {
+	constexpr int BLOCK_SIZE = 4;
+	constexpr int BLOCK_PIXELS = BLOCK_SIZE * BLOCK_SIZE;
+	// Blocks encoded by one task, block rows are grouped until a task has at least this many
+	constexpr size_t BLOCK_CHUNK = 256;
+	// Iterations of the power method used to find the principal axis of a block
+	constexpr int AXIS_ITERATIONS = 8;
+	// Interpolation weights of BC7 4 bit indices, out of 64
+	constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	// BC7 mode 6: one subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices
+	constexpr int BC7_MODE = 6;
+
+	enum class Format {
+		// RGB in 8 bytes, 1 bit alpha is not used
+		BC1,
+		// BC1 colour with a BC4 alpha block, 16 bytes
+		BC3,
+		// One channel in 8 bytes, occlusion, roughness and other masks
+		BC4,
+		// Two BC4 blocks, normal maps store X and Y and rebuild Z
+		BC5,
+		// RGBA in 16 bytes, best quality for colour
+		BC7
+	};
+
+	enum class Quality {
+		// Endpoints from the bounding box of the block
+		Fast,
+		// Endpoints along the principal axis, refined once
+		Normal,
+		// As Normal with more refinement and every p-bit and BC4 mode tried
+		High
+	};
+
+	struct CompressSettings {
+		Format format = Format::BC7;
+		Quality quality = Quality::Normal;
+		// First source channel read by BC4 and BC5
+		int channel = 0;
+	};
+
+	inline size_t Block_Bytes(Format format) {
+		return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+	}
+
+	inline int Format_Channels(Format format) {
+		switch (format) {
+		case Format::BC4:
+			return 1;
+		case Format::BC5:
+			return 2;
+		default:
+			return 4;
+		}
+	}
+
+	inline size_t Level_Bytes(Format format, int width, int height) {
+		return size_t((width + BLOCK_SIZE - 1) / BLOCK_SIZE) * size_t((height + BLOCK_SIZE - 1) / BLOCK_SIZE) * Block_Bytes(format);
+	}
+
+	/// <summary>
+	/// Every level of an image in one block format, level 0 first.
+	/// </summary>
+	struct CompressedImage {
+		Format format = Format::BC7;
+		int width = 0;
+		int height = 0;
+		std::vector<std::vector<unsigned char>> levels;
+
+		CompressedImage() = default;
+		CompressedImage(CompressedImage const&) = default;
+		CompressedImage(CompressedImage&&) = default;
+
+		CompressedImage& operator=(CompressedImage const&) = default;
+		CompressedImage& operator=(CompressedImage&&) = default;
+
+		bool Empty() const {
+			return levels.empty();
+		}
+	};
+
+	/// <summary>
+	/// 16 pixels laid out by channel so four or eight pixels fill a register.
+	/// </summary>
+	struct Block {
+		alignas(32) float channel[4][BLOCK_PIXELS];
+	};
+
+	/// <summary>
+	/// Palette entries laid out by channel, at most 16 for BC7.
+	/// </summary>
+	struct Palette {
+		float channel[4][16];
+		int entries = 0;
+	};
+
+	/// <summary>
+	/// Reads the 4x4 block at (blockX, blockY), pixels past the edge repeat the last row and column.
+	/// Grey and grey alpha images are expanded to RGBA, 'first' selects the channel stored in channel 0 for BC4 and BC5.
+	/// </summary>
+	inline void Fetch_Block(unsigned char const* pixels, int width, int height, int channels, int blockX, int blockY, Block& block, int first = -1) {
+		for (int y = 0; y < BLOCK_SIZE; ++y) {
+			int row = std::min(blockY * BLOCK_SIZE + y, height - 1);
+			for (int x = 0; x < BLOCK_SIZE; ++x) {
+				int column = std::min(blockX * BLOCK_SIZE + x, width - 1);
+				unsigned char const* pixel = pixels + (size_t(row) * size_t(width) + size_t(column)) * size_t(channels);
+				int index = y * BLOCK_SIZE + x;
+				if (first >= 0) {
+					block.channel[0][index] = pixel[std::min(first, channels - 1)];
+					block.channel[1][index] = pixel[std::min(first + 1, channels - 1)];
+					block.channel[2][index] = 0.0f;
+					block.channel[3][index] = 0.0f;
+				}
+				else if (channels >= 3) {
+					block.channel[0][index] = pixel[0];
+					block.channel[1][index] = pixel[1];
+					block.channel[2][index] = pixel[2];
+					block.channel[3][index] = channels == 4 ? pixel[3] : 255.0f;
+				}
+				else {
+					block.channel[0][index] = pixel[0];
+					block.channel[1][index] = pixel[0];
+					block.channel[2][index] = pixel[0];
+					block.channel[3][index] = channels == 2 ? pixel[1] : 255.0f;
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Nearest palette entry of every pixel over the first 'channels' channels.
+	/// </summary>
+	/// <returns>Sum of squared errors</returns>
+	inline float Select_Indices(Block const& block, int channels, Palette const& palette, unsigned char indices[BLOCK_PIXELS]) {
+		float total = 0.0f;
+		int pixel = 0;
+#if defined(SIMD_AVX2)
+		if (Simd::Has_Avx2()) {
+			for (; pixel < BLOCK_PIXELS; pixel += 8) {
+				__m256 best = _mm256_set1_ps(FLT_MAX);
+				__m256 bestIndex = _mm256_setzero_ps();
+				for (int entry = 0; entry < palette.entries; ++entry) {
+					__m256 error = _mm256_setzero_ps();
+					for (int channel = 0; channel < channels; ++channel) {
+						__m256 difference = _mm256_sub_ps(_mm256_load_ps(block.channel[channel] + pixel), _mm256_set1_ps(palette.channel[channel][entry]));
+						error = _mm256_add_ps(error, _mm256_mul_ps(difference, difference));
+					}
+					__m256 closer = _mm256_cmp_ps(error, best, _CMP_LT_OQ);
+					best = _mm256_blendv_ps(best, error, closer);
+					bestIndex = _mm256_blendv_ps(bestIndex, _mm256_set1_ps(float(entry)), closer);
+				}
+				alignas(32) float errors[8];
+				alignas(32) int chosen[8];
+				_mm256_store_ps(errors, best);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(chosen), _mm256_cvttps_epi32(bestIndex));
+				for (int lane = 0; lane < 8; ++lane) {
+					indices[pixel + lane] = (unsigned char)chosen[lane];
+					total += errors[lane];
+				}
+			}
+		}
+#endif
+#if defined(SIMD_SSE)
+		for (; pixel < BLOCK_PIXELS; pixel += 4) {
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			for (int entry = 0; entry < palette.entries; ++entry) {
+				__m128 error = _mm_setzero_ps();
+				for (int channel = 0; channel < channels; ++channel) {
+					__m128 difference = _mm_sub_ps(_mm_load_ps(block.channel[channel] + pixel), _mm_set1_ps(palette.channel[channel][entry]));
+					error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+				}
+				// SSE2 has no blend, select with masks
+				__m128 closer = _mm_cmplt_ps(error, best);
+				best = _mm_or_ps(_mm_and_ps(closer, error), _mm_andnot_ps(closer, best));
+				bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(float(entry))), _mm_andnot_ps(closer, bestIndex));
+			}
+			alignas(16) float errors[4];
+			alignas(16) int chosen[4];
+			_mm_store_ps(errors, best);
+			_mm_store_si128(reinterpret_cast<__m128i*>(chosen), _mm_cvttps_epi32(bestIndex));
+			for (int lane = 0; lane < 4; ++lane) {
+				indices[pixel + lane] = (unsigned char)chosen[lane];
+				total += errors[lane];
+			}
+		}
+#endif
+		for (; pixel < BLOCK_PIXELS; ++pixel) {
+			float best = FLT_MAX;
+			for (int entry = 0; entry < palette.entries; ++entry) {
+				float error = 0.0f;
+				for (int channel = 0; channel < channels; ++channel) {
+					float difference = block.channel[channel][pixel] - palette.channel[channel][entry];
+					error += difference * difference;
+				}
+				if (error < best) {
+					best = error;
+					indices[pixel] = (unsigned char)entry;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	/// <summary>
+	/// Line through the block that endpoints are placed on, the principal axis or for Fast the bounding box diagonal.
+	/// </summary>
+	inline void Endpoint_Line(Block const& block, int channels, Quality quality, float start[4], float end[4]) {
+		float mean[4] = {};
+		float minimum[4];
+		float maximum[4];
+		for (int channel = 0; channel < channels; ++channel) {
+			minimum[channel] = FLT_MAX;
+			maximum[channel] = -FLT_MAX;
+			for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+				float value = block.channel[channel][pixel];
+				mean[channel] += value;
+				minimum[channel] = std::min(minimum[channel], value);
+				maximum[channel] = std::max(maximum[channel], value);
+			}
+			mean[channel] /= float(BLOCK_PIXELS);
+		}
+		if (quality == Quality::Fast) {
+			// Inset the box, the extremes are rarely worth an endpoint
+			for (int channel = 0; channel < channels; ++channel) {
+				float inset = (maximum[channel] - minimum[channel]) / 16.0f;
+				start[channel] = minimum[channel] + inset;
+				end[channel] = maximum[channel] - inset;
+			}
+			return;
+		}
+
+		float covariance[4][4] = {};
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			for (int row = 0; row < channels; ++row) {
+				for (int column = row; column < channels; ++column) {
+					covariance[row][column] += (block.channel[row][pixel] - mean[row]) * (block.channel[column][pixel] - mean[column]);
+				}
+			}
+		}
+		float axis[4] = {};
+		for (int channel = 0; channel < channels; ++channel) {
+			axis[channel] = maximum[channel] - minimum[channel];
+		}
+		for (int iteration = 0; iteration < AXIS_ITERATIONS; ++iteration) {
+			float next[4] = {};
+			for (int row = 0; row < channels; ++row) {
+				for (int column = 0; column < channels; ++column) {
+					next[row] += (row <= column ? covariance[row][column] : covariance[column][row]) * axis[column];
+				}
+			}
+			float length = 0.0f;
+			for (int channel = 0; channel < channels; ++channel) {
+				length = std::max(length, std::abs(next[channel]));
+			}
+			if (length == 0.0f) {
+				break;
+			}
+			for (int channel = 0; channel < channels; ++channel) {
+				axis[channel] = next[channel] / length;
+			}
+		}
+		float lengthSquared = 0.0f;
+		for (int channel = 0; channel < channels; ++channel) {
+			lengthSquared += axis[channel] * axis[channel];
+		}
+		float low = 0.0f;
+		float high = 0.0f;
+		if (lengthSquared > 0.0f) {
+			low = FLT_MAX;
+			high = -FLT_MAX;
+			for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+				float projection = 0.0f;
+				for (int channel = 0; channel < channels; ++channel) {
+					projection += (block.channel[channel][pixel] - mean[channel]) * axis[channel];
+				}
+				low = std::min(low, projection);
+				high = std::max(high, projection);
+			}
+			low /= lengthSquared;
+			high /= lengthSquared;
+		}
+		for (int channel = 0; channel < channels; ++channel) {
+			start[channel] = std::clamp(mean[channel] + axis[channel] * low, 0.0f, 255.0f);
+			end[channel] = std::clamp(mean[channel] + axis[channel] * high, 0.0f, 255.0f);
+		}
+	}
+
+	/// <summary>
+	/// Endpoints that minimize the squared error for the chosen indices, each index interpolates with 'weights[index]' in [0, 1].
+	/// </summary>
+	/// <returns>False when every pixel uses the same weight and the endpoints cannot be solved for</returns>
+	inline bool Refine_Endpoints(Block const& block, int channels, unsigned char const indices[BLOCK_PIXELS], float const* weights, float start[4], float end[4]) {
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			float b = weights[indices[pixel]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int channel = 0; channel < channels; ++channel) {
+				ax[channel] += a * block.channel[channel][pixel];
+				bx[channel] += b * block.channel[channel][pixel];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f) {
+			return false;
+		}
+		for (int channel = 0; channel < channels; ++channel) {
+			start[channel] = std::clamp((bb * ax[channel] - ab * bx[channel]) / determinant, 0.0f, 255.0f);
+			end[channel] = std::clamp((aa * bx[channel] - ab * ax[channel]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	inline int Refinements(Quality quality) {
+		return quality == Quality::Fast ? 0 : quality == Quality::Normal ? 1 : 3;
+	}
+
+	struct BitWriter {
+		unsigned char* data;
+		int position = 0;
+
+		void Write(uint32_t value, int bits) {
+			for (int bit = 0; bit < bits; ++bit, ++position) {
+				data[position >> 3] |= (unsigned char)(((value >> bit) & 1) << (position & 7));
+			}
+		}
+	};
+
+	struct BitReader {
+		unsigned char const* data;
+		int position = 0;
+
+		uint32_t Read(int bits) {
+			uint32_t value = 0;
+			for (int bit = 0; bit < bits; ++bit, ++position) {
+				value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << bit;
+			}
+			return value;
+		}
+	};
+
+	inline uint16_t Pack_565(float const colour[3]) {
+		int red = std::clamp(int(colour[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+		int green = std::clamp(int(colour[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+		int blue = std::clamp(int(colour[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+		return uint16_t((red << 11) | (green << 5) | blue);
+	}
+
+	inline void Unpack_565(uint16_t packed, int colour[3]) {
+		int red = (packed >> 11) & 31;
+		int green = (packed >> 5) & 63;
+		int blue = packed & 31;
+		colour[0] = (red << 3) | (red >> 2);
+		colour[1] = (green << 2) | (green >> 4);
+		colour[2] = (blue << 3) | (blue >> 2);
+	}
+
+	/// <summary>
+	/// Colours of a BC1 block, four colour mode when colour0 > colour1 and always in BC3.
+	/// </summary>
+	inline void BC1_Palette(uint16_t colour0, uint16_t colour1, bool fourColour, int palette[4][4]) {
+		Unpack_565(colour0, palette[0]);
+		Unpack_565(colour1, palette[1]);
+		for (int channel = 0; channel < 3; ++channel) {
+			int a = palette[0][channel];
+			int b = palette[1][channel];
+			if (fourColour || colour0 > colour1) {
+				palette[2][channel] = (2 * a + b + 1) / 3;
+				palette[3][channel] = (a + 2 * b + 1) / 3;
+			}
+			else {
+				palette[2][channel] = (a + b) / 2;
+				palette[3][channel] = 0;
+			}
+		}
+		for (int entry = 0; entry < 4; ++entry) {
+			palette[entry][3] = entry == 3 && !fourColour && colour0 <= colour1 ? 0 : 255;
+		}
+	}
+
+	/// <summary>
+	/// Encodes the colour of a block in four colour mode, alpha is ignored.
+	/// </summary>
+	inline void Encode_BC1(Block const& block, Quality quality, unsigned char* output) {
+		// Weight of colour1 for each index
+		static constexpr float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float start[4];
+		float end[4];
+		Endpoint_Line(block, 3, quality, start, end);
+
+		uint16_t bestColour0 = 0;
+		uint16_t bestColour1 = 0;
+		unsigned char bestIndices[BLOCK_PIXELS] = {};
+		float bestError = FLT_MAX;
+		for (int attempt = 0; attempt <= Refinements(quality); ++attempt) {
+			uint16_t colour0 = Pack_565(start);
+			uint16_t colour1 = Pack_565(end);
+			// Four colour mode needs colour0 > colour1, swapping the endpoints swaps their weights
+			if (colour0 < colour1) {
+				std::swap(colour0, colour1);
+			}
+			int decoded[4][4];
+			BC1_Palette(colour0, colour1, true, decoded);
+			Palette palette;
+			palette.entries = colour0 == colour1 ? 1 : 4;
+			for (int entry = 0; entry < palette.entries; ++entry) {
+				for (int channel = 0; channel < 3; ++channel) {
+					palette.channel[channel][entry] = float(decoded[entry][channel]);
+				}
+			}
+			unsigned char indices[BLOCK_PIXELS];
+			float error = Select_Indices(block, 3, palette, indices);
+			if (error < bestError) {
+				bestError = error;
+				bestColour0 = colour0;
+				bestColour1 = colour1;
+				std::memcpy(bestIndices, indices, sizeof(indices));
+			}
+			if (palette.entries == 1) {
+				break;
+			}
+			float colourStart[4] = { float(decoded[0][0]), float(decoded[0][1]), float(decoded[0][2]) };
+			float colourEnd[4] = { float(decoded[1][0]), float(decoded[1][1]), float(decoded[1][2]) };
+			if (!Refine_Endpoints(block, 3, indices, WEIGHTS, colourStart, colourEnd)) {
+				break;
+			}
+			std::memcpy(start, colourStart, sizeof(float) * 3);
+			std::memcpy(end, colourEnd, sizeof(float) * 3);
+		}
+
+		uint32_t packedIndices = 0;
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			packedIndices |= uint32_t(bestIndices[pixel]) << (pixel * 2);
+		}
+		output[0] = (unsigned char)(bestColour0 & 0xFF);
+		output[1] = (unsigned char)(bestColour0 >> 8);
+		output[2] = (unsigned char)(bestColour1 & 0xFF);
+		output[3] = (unsigned char)(bestColour1 >> 8);
+		std::memcpy(output + 4, &packedIndices, 4);
+	}
+
+	/// <summary>
+	/// Values of a BC4 block, 8 interpolated values when value0 > value1, otherwise 6 and the extremes 0 and 255.
+	/// </summary>
+	inline void BC4_Palette(int value0, int value1, int palette[8]) {
+		palette[0] = value0;
+		palette[1] = value1;
+		if (value0 > value1) {
+			for (int index = 1; index < 7; ++index) {
+				palette[index + 1] = ((7 - index) * value0 + index * value1 + 3) / 7;
+			}
+		}
+		else {
+			for (int index = 1; index < 5; ++index) {
+				palette[index + 1] = ((5 - index) * value0 + index * value1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	inline float Encode_BC4_Mode(Block const& block, int value0, int value1, unsigned char indices[BLOCK_PIXELS]) {
+		int decoded[8];
+		BC4_Palette(value0, value1, decoded);
+		Palette palette;
+		palette.entries = 8;
+		for (int entry = 0; entry < 8; ++entry) {
+			palette.channel[0][entry] = float(decoded[entry]);
+		}
+		return Select_Indices(block, 1, palette, indices);
+	}
+
+	/// <summary>
+	/// Encodes channel 0 of a block.
+	/// </summary>
+	inline void Encode_BC4(Block const& block, Quality quality, unsigned char* output) {
+		// Weight of value1 for each index in 8 value mode
+		static constexpr float WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+		float minimum = 255.0f;
+		float maximum = 0.0f;
+		// Range without the values 6 value mode stores exactly
+		float innerMinimum = 255.0f;
+		float innerMaximum = 0.0f;
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			float value = block.channel[0][pixel];
+			minimum = std::min(minimum, value);
+			maximum = std::max(maximum, value);
+			if (value > 0.0f && value < 255.0f) {
+				innerMinimum = std::min(innerMinimum, value);
+				innerMaximum = std::max(innerMaximum, value);
+			}
+		}
+
+		int bestValue0 = int(maximum);
+		int bestValue1 = int(minimum);
+		unsigned char bestIndices[BLOCK_PIXELS];
+		float bestError = Encode_BC4_Mode(block, bestValue0, bestValue1, bestIndices);
+		if (bestValue0 > bestValue1) {
+			float start[4] = { maximum };
+			float end[4] = { minimum };
+			unsigned char indices[BLOCK_PIXELS];
+			std::memcpy(indices, bestIndices, sizeof(indices));
+			for (int attempt = 0; attempt < Refinements(quality) && Refine_Endpoints(block, 1, indices, WEIGHTS, start, end); ++attempt) {
+				int value0 = int(start[0] + 0.5f);
+				int value1 = int(end[0] + 0.5f);
+				if (value0 <= value1) {
+					break;
+				}
+				float error = Encode_BC4_Mode(block, value0, value1, indices);
+				if (error < bestError) {
+					bestError = error;
+					bestValue0 = value0;
+					bestValue1 = value1;
+					std::memcpy(bestIndices, indices, sizeof(indices));
+				}
+			}
+		}
+		if (quality == Quality::High && innerMinimum <= innerMaximum && (minimum == 0.0f || maximum == 255.0f)) {
+			unsigned char indices[BLOCK_PIXELS];
+			float error = Encode_BC4_Mode(block, int(innerMinimum), int(innerMaximum), indices);
+			if (error < bestError) {
+				bestError = error;
+				bestValue0 = int(innerMinimum);
+				bestValue1 = int(innerMaximum);
+				std::memcpy(bestIndices, indices, sizeof(indices));
+			}
+		}
+
+		output[0] = (unsigned char)bestValue0;
+		output[1] = (unsigned char)bestValue1;
+		std::memset(output + 2, 0, 6);
+		BitWriter writer{ output + 2 };
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			writer.Write(bestIndices[pixel], 3);
+		}
+	}
+
+	/// <summary>
+	/// 7 bit endpoint and p-bit closest to each channel of 'colour', the p-bit is the low bit of all four channels.
+	/// </summary>
+	/// <returns>Squared error of the quantized endpoint</returns>
+	inline float Quantize_BC7_Endpoint(float const colour[4], int pbit, int quantized[4]) {
+		float error = 0.0f;
+		for (int channel = 0; channel < 4; ++channel) {
+			quantized[channel] = std::clamp(int((colour[channel] - float(pbit)) / 2.0f + 0.5f), 0, 127);
+			float difference = float(quantized[channel] * 2 + pbit) - colour[channel];
+			error += difference * difference;
+		}
+		return error;
+	}
+
+	inline void BC7_Palette(int const endpoint0[4], int pbit0, int const endpoint1[4], int pbit1, Palette& palette) {
+		palette.entries = 16;
+		for (int channel = 0; channel < 4; ++channel) {
+			int a = endpoint0[channel] * 2 + pbit0;
+			int b = endpoint1[channel] * 2 + pbit1;
+			for (int entry = 0; entry < 16; ++entry) {
+				palette.channel[channel][entry] = float(((64 - BC7_WEIGHTS[entry]) * a + BC7_WEIGHTS[entry] * b + 32) >> 6);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Encodes a block with BC7 mode 6, the one subset mode that covers colour and alpha together.
+	/// </summary>
+	inline void Encode_BC7(Block const& block, Quality quality, unsigned char* output) {
+		static float const WEIGHTS[16] = {
+			BC7_WEIGHTS[0] / 64.0f, BC7_WEIGHTS[1] / 64.0f, BC7_WEIGHTS[2] / 64.0f, BC7_WEIGHTS[3] / 64.0f,
+			BC7_WEIGHTS[4] / 64.0f, BC7_WEIGHTS[5] / 64.0f, BC7_WEIGHTS[6] / 64.0f, BC7_WEIGHTS[7] / 64.0f,
+			BC7_WEIGHTS[8] / 64.0f, BC7_WEIGHTS[9] / 64.0f, BC7_WEIGHTS[10] / 64.0f, BC7_WEIGHTS[11] / 64.0f,
+			BC7_WEIGHTS[12] / 64.0f, BC7_WEIGHTS[13] / 64.0f, BC7_WEIGHTS[14] / 64.0f, BC7_WEIGHTS[15] / 64.0f
+		};
+		float start[4];
+		float end[4];
+		Endpoint_Line(block, 4, quality, start, end);
+
+		int bestEndpoints[2][4] = {};
+		int bestPbits[2] = {};
+		unsigned char bestIndices[BLOCK_PIXELS] = {};
+		float bestError = FLT_MAX;
+		for (int attempt = 0; attempt <= Refinements(quality); ++attempt) {
+			unsigned char indices[BLOCK_PIXELS];
+			// High tries every pair of p-bits, otherwise each endpoint takes the p-bit that quantizes it best
+			for (int combination = 0; combination < (quality == Quality::High ? 4 : 1); ++combination) {
+				int endpoints[2][4];
+				int pbits[2];
+				if (quality == Quality::High) {
+					pbits[0] = combination & 1;
+					pbits[1] = combination >> 1;
+					Quantize_BC7_Endpoint(start, pbits[0], endpoints[0]);
+					Quantize_BC7_Endpoint(end, pbits[1], endpoints[1]);
+				}
+				else {
+					int other[4];
+					pbits[0] = Quantize_BC7_Endpoint(start, 0, endpoints[0]) <= Quantize_BC7_Endpoint(start, 1, other) ? 0 : 1;
+					if (pbits[0] == 1) {
+						std::memcpy(endpoints[0], other, sizeof(other));
+					}
+					pbits[1] = Quantize_BC7_Endpoint(end, 0, endpoints[1]) <= Quantize_BC7_Endpoint(end, 1, other) ? 0 : 1;
+					if (pbits[1] == 1) {
+						std::memcpy(endpoints[1], other, sizeof(other));
+					}
+				}
+				Palette palette;
+				BC7_Palette(endpoints[0], pbits[0], endpoints[1], pbits[1], palette);
+				float error = Select_Indices(block, 4, palette, indices);
+				if (error < bestError) {
+					bestError = error;
+					std::memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+					std::memcpy(bestPbits, pbits, sizeof(pbits));
+					std::memcpy(bestIndices, indices, sizeof(indices));
+				}
+			}
+			if (bestError == 0.0f) {
+				break;
+			}
+			std::memcpy(indices, bestIndices, sizeof(indices));
+			if (!Refine_Endpoints(block, 4, indices, WEIGHTS, start, end)) {
+				break;
+			}
+		}
+
+		// The high bit of the first index is implied zero, swap the endpoints when it is set
+		if (bestIndices[0] >= 8) {
+			std::swap(bestEndpoints[0], bestEndpoints[1]);
+			std::swap(bestPbits[0], bestPbits[1]);
+			for (unsigned char& index : bestIndices) {
+				index = (unsigned char)(15 - index);
+			}
+		}
+
+		std::memset(output, 0, 16);
+		BitWriter writer{ output };
+		writer.Write(1u << BC7_MODE, BC7_MODE + 1);
+		for (int channel = 0; channel < 4; ++channel) {
+			writer.Write(uint32_t(bestEndpoints[0][channel]), 7);
+			writer.Write(uint32_t(bestEndpoints[1][channel]), 7);
+		}
+		writer.Write(uint32_t(bestPbits[0]), 1);
+		writer.Write(uint32_t(bestPbits[1]), 1);
+		writer.Write(bestIndices[0], 3);
+		for (int pixel = 1; pixel < BLOCK_PIXELS; ++pixel) {
+			writer.Write(bestIndices[pixel], 4);
+		}
+	}
+
+	inline void Encode_Block(Block& block, CompressSettings const& settings, unsigned char* output) {
+		switch (settings.format) {
+		case Format::BC1:
+			Encode_BC1(block, settings.quality, output);
+			break;
+		case Format::BC3: {
+			Block alpha;
+			std::memcpy(alpha.channel[0], block.channel[3], sizeof(alpha.channel[0]));
+			Encode_BC4(alpha, settings.quality, output);
+			Encode_BC1(block, settings.quality, output + 8);
+			break;
+		}
+		case Format::BC4:
+			Encode_BC4(block, settings.quality, output);
+			break;
+		case Format::BC5: {
+			Encode_BC4(block, settings.quality, output);
+			Block second;
+			std::memcpy(second.channel[0], block.channel[1], sizeof(second.channel[0]));
+			Encode_BC4(second, settings.quality, output + 8);
+			break;
+		}
+		case Format::BC7:
+			Encode_BC7(block, settings.quality, output);
+			break;
+		}
+	}
+
+	/// <summary>
+	/// Encodes an 8 bit image of 1 to 4 channels, block rows are spread across 'pool'.
+	/// Sizes that are not a multiple of 4 repeat their edge pixels into the last blocks.
+	/// </summary>
+	inline std::vector<unsigned char> Compress(unsigned char const* pixels, int width, int height, int channels, CompressSettings const& settings, ThreadPool* pool = nullptr) {
+		if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": cannot compress a " + std::to_string(width) + 'x' + std::to_string(height) + " image with " + std::to_string(channels) + " channels.");
+		}
+		int blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		int blocksHigh = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		size_t blockBytes = Block_Bytes(settings.format);
+		std::vector<unsigned char> output(Level_Bytes(settings.format, width, height));
+		int first = settings.format == Format::BC4 || settings.format == Format::BC5 ? settings.channel : -1;
+		auto encodeRows = [&](size_t begin, size_t end) {
+			Block block;
+			for (size_t blockY = begin; blockY < end; ++blockY) {
+				for (int blockX = 0; blockX < blocksWide; ++blockX) {
+					Fetch_Block(pixels, width, height, channels, blockX, int(blockY), block, first);
+					Encode_Block(block, settings, output.data() + (blockY * size_t(blocksWide) + size_t(blockX)) * blockBytes);
+				}
+			}
+		};
+		if (pool == nullptr) {
+			encodeRows(0, size_t(blocksHigh));
+		}
+		else {
+			pool->Parallel_For(size_t(blocksHigh), std::max(BLOCK_CHUNK / size_t(blocksWide), size_t(1)), encodeRows);
+		}
+		return output;
+	}
+
+	/// <summary>
+	/// Encodes a top level and the mip levels below it, such as TextureDecode::DecodedImage::pixels and mips.
+	/// </summary>
+	inline CompressedImage Compress_Chain(unsigned char const* pixels, std::vector<std::vector<unsigned char>> const& mips, int width, int height, int channels, CompressSettings const& settings, ThreadPool* pool = nullptr) {
+		CompressedImage image;
+		image.format = settings.format;
+		image.width = width;
+		image.height = height;
+		image.levels.emplace_back(Compress(pixels, width, height, channels, settings, pool));
+		for (size_t level = 0; level < mips.size(); ++level) {
+			int levelWidth = std::max(width >> (level + 1), 1);
+			int levelHeight = std::max(height >> (level + 1), 1);
+			image.levels.emplace_back(Compress(mips[level].data(), levelWidth, levelHeight, channels, settings, pool));
+		}
+		return image;
+	}
+
+	inline void Decode_BC4(unsigned char const* block, unsigned char* output, int stride) {
+		int palette[8];
+		BC4_Palette(block[0], block[1], palette);
+		BitReader reader{ block + 2 };
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			output[pixel * stride] = (unsigned char)palette[reader.Read(3)];
+		}
+	}
+
+	inline void Decode_BC1(unsigned char const* block, unsigned char* output, bool fourColour) {
+		uint16_t colour0 = uint16_t(block[0] | (block[1] << 8));
+		uint16_t colour1 = uint16_t(block[2] | (block[3] << 8));
+		int palette[4][4];
+		BC1_Palette(colour0, colour1, fourColour, palette);
+		uint32_t indices;
+		std::memcpy(&indices, block + 4, 4);
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			int const* colour = palette[(indices >> (pixel * 2)) & 3];
+			for (int channel = 0; channel < 4; ++channel) {
+				output[pixel * 4 + channel] = (unsigned char)colour[channel];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Decodes BC7 mode 6 blocks, the only mode Encode_BC7 writes.
+	/// </summary>
+	inline void Decode_BC7(unsigned char const* block, unsigned char* output) {
+		BitReader reader{ block };
+		if (reader.Read(BC7_MODE + 1) != (1u << BC7_MODE)) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": only BC7 mode 6 blocks can be decoded.");
+		}
+		int endpoints[2][4];
+		for (int channel = 0; channel < 4; ++channel) {
+			endpoints[0][channel] = int(reader.Read(7));
+			endpoints[1][channel] = int(reader.Read(7));
+		}
+		int pbit0 = int(reader.Read(1));
+		int pbit1 = int(reader.Read(1));
+		Palette palette;
+		BC7_Palette(endpoints[0], pbit0, endpoints[1], pbit1, palette);
+		for (int pixel = 0; pixel < BLOCK_PIXELS; ++pixel) {
+			uint32_t index = reader.Read(pixel == 0 ? 3 : 4);
+			for (int channel = 0; channel < 4; ++channel) {
+				output[pixel * 4 + channel] = (unsigned char)palette.channel[channel][index];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Decodes one level to Format_Channels(format) 8 bit channels, for checking quality on the CPU.
+	/// </summary>
+	inline std::vector<unsigned char> Decompress(unsigned char const* data, int width, int height, Format format) {
+		int channels = Format_Channels(format);
+		int blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		int blocksHigh = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		size_t blockBytes = Block_Bytes(format);
+		std::vector<unsigned char> pixels(size_t(width) * size_t(height) * size_t(channels));
+		unsigned char decoded[BLOCK_PIXELS * 4];
+		for (int blockY = 0; blockY < blocksHigh; ++blockY) {
+			for (int blockX = 0; blockX < blocksWide; ++blockX) {
+				unsigned char const* block = data + (size_t(blockY) * size_t(blocksWide) + size_t(blockX)) * blockBytes;
+				switch (format) {
+				case Format::BC1:
+					Decode_BC1(block, decoded, false);
+					break;
+				case Format::BC3:
+					Decode_BC1(block + 8, decoded, true);
+					Decode_BC4(block, decoded + 3, 4);
+					break;
+				case Format::BC4:
+					Decode_BC4(block, decoded, 1);
+					break;
+				case Format::BC5:
+					Decode_BC4(block, decoded, 2);
+					Decode_BC4(block + 8, decoded + 1, 2);
+					break;
+				case Format::BC7:
+					Decode_BC7(block, decoded);
+					break;
+				}
+				for (int y = 0; y < BLOCK_SIZE && blockY * BLOCK_SIZE + y < height; ++y) {
+					for (int x = 0; x < BLOCK_SIZE && blockX * BLOCK_SIZE + x < width; ++x) {
+						size_t pixel = size_t(blockY * BLOCK_SIZE + y) * size_t(width) + size_t(blockX * BLOCK_SIZE + x);
+						std::memcpy(pixels.data() + pixel * size_t(channels), decoded + (y * BLOCK_SIZE + x) * channels, size_t(channels));
+					}
+				}
+			}
+		}
+		return pixels;
+	}
+
+	/// <summary>
+	/// Peak signal to noise ratio in dB between two images with the same layout, infinite when they are equal.
+	/// </summary>
+	inline double Psnr(unsigned char const* a, unsigned char const* b, size_t count) {
+		double squared = 0.0;
+		for (size_t index = 0; index < count; ++index) {
+			double difference = double(a[index]) - double(b[index]);
+			squared += difference * difference;
+		}
+		if (squared == 0.0) {
+			return std::numeric_limits<double>::infinity();
+		}
+		return 10.0 * std::log10(255.0 * 255.0 * double(count) / squared);
+	}
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include "AccessorData.hpp"
+#include "AccessorRange.hpp"
+#include "SceneGraph.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// <summary>
+/// Axis aligned box, default constructed boxes are empty and grow to fit what is added.
+/// </summary>
+struct AABB {
+	glm::vec3 minimum = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 maximum = glm::vec3(-std::numeric_limits<float>::max());
+
+	AABB() = default;
+	AABB(glm::vec3 const& _minimum, glm::vec3 const& _maximum) : minimum(_minimum), maximum(_maximum) {
+
+	}
+
+	AABB(AABB const&) = default;
+	AABB(AABB&&) = default;
+
+	AABB& operator=(AABB const&) = default;
+	AABB& operator=(AABB&&) = default;
+
+	bool Empty() const {
+		return minimum.x > maximum.x || minimum.y > maximum.y || minimum.z > maximum.z;
+	}
+
+	// Per component, glm::min/max on vectors go through a function pointer that is not always inlined
+	void Grow(glm::vec3 const& point) {
+		for (glm::length_t axis = 0; axis < 3; ++axis) {
+			minimum[axis] = std::min(minimum[axis], point[axis]);
+			maximum[axis] = std::max(maximum[axis], point[axis]);
+		}
+	}
+
+	void Grow(AABB const& box) {
+		for (glm::length_t axis = 0; axis < 3; ++axis) {
+			minimum[axis] = std::min(minimum[axis], box.minimum[axis]);
+			maximum[axis] = std::max(maximum[axis], box.maximum[axis]);
+		}
+	}
+
+	glm::vec3 Center() const {
+		return (minimum + maximum) * 0.5f;
+	}
+
+	glm::vec3 Extent() const {
+		return maximum - minimum;
+	}
+
+	float SurfaceArea() const {
+		if (Empty()) {
+			return 0.0f;
+		}
+		glm::vec3 extent = Extent();
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	bool Overlaps(AABB const& box) const {
+		return minimum.x <= box.maximum.x && maximum.x >= box.minimum.x &&
+			minimum.y <= box.maximum.y && maximum.y >= box.minimum.y &&
+			minimum.z <= box.maximum.z && maximum.z >= box.minimum.z;
+	}
+};
+
+/// <summary>
+/// Planes of a view volume, pointing inwards and normalized so plane distances are in world units.
+/// </summary>
+struct Frustum {
+	enum Plane : unsigned {
+		Left,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		PlaneCount
+	};
+
+	// xyz normal, w distance, a point p is inside a plane when dot(xyz, p) + w >= 0
+	glm::vec4 planes[PlaneCount];
+
+	Frustum() = default;
+
+	/// <param name="viewProjection">projection * view, OpenGL clip space with z in [-w, w]</param>
+	Frustum(glm::mat4 const& viewProjection) {
+		glm::vec4 row[4];
+		for (glm::length_t index = 0; index < 4; ++index) {
+			row[index] = glm::vec4(viewProjection[0][index], viewProjection[1][index], viewProjection[2][index], viewProjection[3][index]);
+		}
+		planes[Left] = row[3] + row[0];
+		planes[Right] = row[3] - row[0];
+		planes[Bottom] = row[3] + row[1];
+		planes[Top] = row[3] - row[1];
+		planes[Near] = row[3] + row[2];
+		planes[Far] = row[3] - row[2];
+		for (glm::vec4& plane : planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+	}
+
+	Frustum(Frustum const&) = default;
+	Frustum& operator=(Frustum const&) = default;
+
+	/// <summary>
+	/// Tests a box against the planes set in 'mask', planes the box is completely inside of are removed from 'mask'.
+	/// </summary>
+	/// <returns>False when the box is outside</returns>
+	bool Test(AABB const& box, unsigned& mask) const {
+		for (unsigned plane = 0; plane < PlaneCount; ++plane) {
+			if (!(mask & (1u << plane))) {
+				continue;
+			}
+			glm::vec3 normal(planes[plane]);
+			// Corner furthest along the normal, and the one furthest against it
+			glm::vec3 positive(normal.x >= 0.0f ? box.maximum.x : box.minimum.x, normal.y >= 0.0f ? box.maximum.y : box.minimum.y, normal.z >= 0.0f ? box.maximum.z : box.minimum.z);
+			glm::vec3 negative(normal.x >= 0.0f ? box.minimum.x : box.maximum.x, normal.y >= 0.0f ? box.minimum.y : box.maximum.y, normal.z >= 0.0f ? box.minimum.z : box.maximum.z);
+			if (glm::dot(normal, positive) + planes[plane].w < 0.0f) {
+				return false;
+			}
+			if (glm::dot(normal, negative) + planes[plane].w >= 0.0f) {
+				mask &= ~(1u << plane);
+			}
+		}
+		return true;
+	}
+};
+
+constexpr unsigned FRUSTUM_ALL_PLANES = (1u << Frustum::PlaneCount) - 1;
+
+/// <summary>
+/// Bounds of a box after a transform, exact for the transformed corners (Arvo).
+/// </summary>
+inline AABB Transform_AABB(AABB const& box, glm::mat4 const& matrix) {
+	if (box.Empty()) {
+		return box;
+	}
+	glm::vec3 minimum(matrix[3]);
+	glm::vec3 maximum(matrix[3]);
+	for (glm::length_t column = 0; column < 3; ++column) {
+		glm::vec3 axis(matrix[column]);
+		glm::vec3 a = axis * box.minimum[column];
+		glm::vec3 b = axis * box.maximum[column];
+		minimum += glm::min(a, b);
+		maximum += glm::max(a, b);
+	}
+	return AABB(minimum, maximum);
+}
+
+namespace GLTF {
+	/// <summary>
+	/// Bounds of a VEC3 accessor in decoded values, from its min and max when present, otherwise from the data.
+	/// Run Resolve_Accessor_Ranges first to not trust min and max from the file.
+	/// </summary>
+	inline AABB Accessor_Bounds(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, index_type accessorIndex, ThreadPool* pool = nullptr) {
+		Accessor const& accessor = doc.accessors.at(accessorIndex);
+		AccessorRange range;
+		if (accessor.min.size() == 3 && accessor.max.size() == 3) {
+			range.minimum = accessor.min;
+			range.maximum = accessor.max;
+		}
+		else {
+			range = Compute_Accessor_Range(doc, buffers, accessor, pool);
+		}
+		range = Normalized_Range(accessor, std::move(range));
+
+		AABB bounds;
+		if (range.minimum.size() == 3 && range.maximum.size() == 3) {
+			bounds.minimum = glm::vec3(float(range.minimum[0]), float(range.minimum[1]), float(range.minimum[2]));
+			bounds.maximum = glm::vec3(float(range.maximum[0]), float(range.maximum[1]), float(range.maximum[2]));
+		}
+		return bounds;
+	}
+
+	/// <summary>
+	/// Object space bounds of every primitive of a mesh.
+	/// Morph targets widen the box by their largest displacements so any weight in [0, 1] stays inside.
+	/// </summary>
+	inline AABB Mesh_Bounds(GLTFDoc const& doc, std::vector<BufferSpan> const& buffers, Mesh const& mesh) {
+		AABB bounds;
+		for (Mesh::Primitive const& primitive : mesh.primitives) {
+			auto position = primitive.attributes.find(Constants::ATTRIBUTE_POSITION);
+			if (position == primitive.attributes.cend()) {
+				continue;
+			}
+			AABB primitiveBounds = Accessor_Bounds(doc, buffers, position->second);
+
+			auto targets = primitive.targets.find(Constants::ATTRIBUTE_POSITION);
+			if (targets != primitive.targets.cend() && !primitiveBounds.Empty()) {
+				glm::vec3 grow(0.0f);
+				glm::vec3 shrink(0.0f);
+				for (index_type target : targets->second) {
+					if (target == index_type(-1)) {
+						continue;
+					}
+					AABB delta = Accessor_Bounds(doc, buffers, target);
+					if (!delta.Empty()) {
+						grow += glm::max(delta.maximum, glm::vec3(0.0f));
+						shrink += glm::min(delta.minimum, glm::vec3(0.0f));
+					}
+				}
+				primitiveBounds.maximum += grow;
+				primitiveBounds.minimum += shrink;
+			}
+			bounds.Grow(primitiveBounds);
+		}
+		return bounds;
+	}
+}
+
+/// <summary>
+/// World space bounds of every scene node with a mesh.
+/// </summary>
+/// <param name="meshBounds">Object space bounds indexed by document mesh</param>
+/// <param name="slots">Scene slot of each box</param>
+inline void Scene_Instance_Bounds(SceneGraph const& scene, std::vector<AABB> const& meshBounds, std::vector<AABB>& bounds, std::vector<unsigned>& slots) {
+	bounds.clear();
+	slots.clear();
+	for (size_t slot = 0; slot < scene.Size(); ++slot) {
+		GLTF::index_type mesh = scene.mesh[slot];
+		if (mesh == GLTF::index_type(-1) || mesh >= meshBounds.size() || meshBounds[mesh].Empty()) {
+			continue;
+		}
+		bounds.emplace_back(Transform_AABB(meshBounds[mesh], scene.world[slot]));
+		slots.emplace_back(unsigned(slot));
+	}
+}
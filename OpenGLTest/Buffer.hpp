@@ -11,7 +11,14 @@ struct VertexArray;
 /// </summary>
 struct MutableBufferT {};
 
-GLuint Create_Single_Buffer() {
+/// <summary>
+/// Pass to buffers to create immutable storage that stays mapped for writing, see glMapNamedBufferRange
+/// </summary>
+struct PersistentBufferT {};
+
+constexpr GLbitfield PERSISTENT_BUFFER_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+inline GLuint Create_Single_Buffer() {
 	GLuint _bufferId;
 	glCreateBuffers(1, &_bufferId);
 	return _bufferId;
@@ -31,6 +38,10 @@ public:
 		glNamedBufferData(_bufferId, bufferSize, 0, GL_STATIC_DRAW);
 	}
 
+	Buffer(GLsizeiptr bufferSize, PersistentBufferT) : _bufferId(Create_Single_Buffer()), _bufferSize(bufferSize), _isResizable(false) {
+		glNamedBufferStorage(_bufferId, bufferSize, 0, PERSISTENT_BUFFER_FLAGS);
+	}
+
 	Buffer(GLsizeiptr bufferSize, void* data) : _bufferId(Create_Single_Buffer()), _bufferSize(bufferSize), _isResizable(false) {
 		glNamedBufferStorage(_bufferId, bufferSize, data, GL_DYNAMIC_STORAGE_BIT);
 	}
@@ -54,25 +65,52 @@ public:
 	bool IsResizable() {
 		return _isResizable;
 	}
-	
-	virtual bool SwapBufferData(void* data, GLsizeiptr dataSize, GLintptr offset = 0) {
-		if (!_isResizable && (dataSize + offset) > _bufferSize) {
+
+	/// <summary>
+	/// Grows a resizable buffer to at least size bytes, the contents are kept and the buffer id does not change.
+	/// </summary>
+	/// <returns>False for buffers that cannot grow</returns>
+	bool Reserve(GLsizeiptr size) {
+		if (size <= _bufferSize) {
+			return true;
+		}
+		if (!_isResizable) {
 			return false;
 		}
+		GLuint kept = Create_Single_Buffer();
+		glNamedBufferData(kept, _bufferSize, 0, GL_STREAM_COPY);
+		glCopyNamedBufferSubData(_bufferId, kept, 0, 0, _bufferSize);
+		glNamedBufferData(_bufferId, size, 0, GL_STATIC_DRAW);
+		glCopyNamedBufferSubData(kept, _bufferId, 0, 0, _bufferSize);
+		glDeleteBuffers(1, &kept);
+		_bufferSize = size;
+		return true;
+	}
+	
+	/// <summary>
+	/// Writes data at offset. Resizable buffers grow to fit and keep the contents before offset, other buffers refuse data that does not fit.
+	/// </summary>
+	virtual bool SwapBufferData(void const* data, GLsizeiptr dataSize, GLintptr offset = 0) {
+		if ((dataSize + offset) > _bufferSize) {
+			if (!_isResizable) {
+				return false;
+			}
+			if (offset == 0) {
+				// Nothing is kept, new storage is filled in one call
+				glNamedBufferData(_bufferId, dataSize, data, GL_STATIC_DRAW);
+				_bufferSize = dataSize;
+				return true;
+			}
+			Reserve(dataSize + offset);
+		}
 
-		glNamedBufferSubData(_bufferId, offset, _bufferSize, 0);
 		glNamedBufferSubData(_bufferId, offset, dataSize, data);
 		return true;
 	}
 
 	template <class _Ty>
-	bool SwapBufferData(std::vector<_Ty> data, GLintptr offset = 0) {
-		if (!_isResizable && (data.size() * sizeof(_Ty) + offset) > _bufferSize) {
-			return false;
-		}
-
-		glNamedBufferSubData(_bufferId, offset, _bufferSize, 0);
-		glNamedBufferSubData(_bufferId, offset, data.size() * sizeof(_Ty), data.data());
+	bool SwapBufferData(std::vector<_Ty> const& data, GLintptr offset = 0) {
+		return SwapBufferData(static_cast<void const*>(data.data()), GLsizeiptr(data.size() * sizeof(_Ty)), offset);
 	}
 	
 	friend struct VertexArray;
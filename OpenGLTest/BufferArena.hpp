@@ -0,0 +1,220 @@
+#pragma once
+#include "Buffer.hpp"
+#include "BufferFormat.hpp"
+#include "BufferIndex.hpp"
+#include "BufferVertex.hpp"
+#include "OffsetAllocator.hpp"
+#include "VertexArray.hpp"
+#include <GLAD\gl.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+/// <summary>
+/// Many meshes of one vertex format packed into one vertex buffer and one index buffer.
+/// Vertices are allocated in whole strides and indices stay relative to their mesh, so a mesh is drawn with
+/// baseVertex and firstIndex from one VAO binding, which is what multi-draw needs.
+/// Both buffers grow when full without changing their ids, so VAOs bound to them stay valid.
+/// </summary>
+class BufferArena {
+public:
+	/// <summary>
+	/// Where a mesh is in the arena, the arguments of glDrawElementsBaseVertex and the indirect commands built from it.
+	/// </summary>
+	struct Range {
+		GLint baseVertex = 0;
+		GLuint firstIndex = 0;
+		GLsizei indexCount = 0;
+		GLuint vertexCount = 0;
+	};
+
+private:
+	struct Mesh {
+		// Allocations, they are at least one unit even for empty meshes
+		uint32_t vertices;
+		uint32_t indices;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		bool live;
+	};
+
+	std::shared_ptr<BufferFormat> _format;
+	std::shared_ptr<BufferVertex> _vertexBuffer;
+	std::shared_ptr<BufferIndex> _indexBuffer;
+	OffsetAllocator _vertices;
+	OffsetAllocator _indices;
+	std::vector<Mesh> _meshes;
+	std::vector<size_t> _unusedMeshes;
+
+	/// <summary>
+	/// Allocates count units, doubling the buffer and the allocator until they fit.
+	/// </summary>
+	static uint32_t Allocate(OffsetAllocator& allocator, Buffer& buffer, GLsizeiptr unitBytes, uint32_t count) {
+		uint32_t allocation = allocator.Allocate(count);
+		while (allocation == OffsetAllocator::NO_SPACE) {
+			uint32_t capacity = std::max(allocator.Capacity() * 2, allocator.Capacity() + count);
+			buffer.Reserve(GLsizeiptr(capacity) * unitBytes);
+			allocator.Grow(capacity);
+			allocation = allocator.Allocate(count);
+		}
+		return allocation;
+	}
+
+	/// <summary>
+	/// Packs a buffer to match its allocator. Moved ranges may overlap where they came from and GL does not allow
+	/// overlapping copies within one buffer, so they are gathered in a scratch buffer and copied back in one go.
+	/// </summary>
+	static void Compact(OffsetAllocator& allocator, Buffer& buffer, GLsizeiptr unitBytes) {
+		std::vector<OffsetAllocator::Move> moves = allocator.Defragment();
+		if (moves.empty()) {
+			return;
+		}
+		// Every allocation after the first moved one moves too, so the moves cover one contiguous range
+		GLintptr start = GLintptr(moves.front().to) * unitBytes;
+		GLintptr end = GLintptr(moves.back().to + moves.back().size) * unitBytes;
+		GLuint scratch = Create_Single_Buffer();
+		glNamedBufferStorage(scratch, end - start, 0, 0);
+		for (OffsetAllocator::Move const& move : moves) {
+			glCopyNamedBufferSubData(buffer.BufferId(), scratch, GLintptr(move.from) * unitBytes, GLintptr(move.to) * unitBytes - start, GLsizeiptr(move.size) * unitBytes);
+		}
+		glCopyNamedBufferSubData(scratch, buffer.BufferId(), 0, start, end - start);
+		glDeleteBuffers(1, &scratch);
+	}
+
+	Mesh const& Get(size_t mesh) const {
+		if (mesh >= _meshes.size() || !_meshes[mesh].live) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": " + std::to_string(mesh) + " is not a mesh in the arena.");
+		}
+		return _meshes[mesh];
+	}
+
+public:
+	/// <param name="vertexCapacity">Vertices before the vertex buffer first grows</param>
+	/// <param name="indexCapacity">Indices before the index buffer first grows</param>
+	BufferArena(std::shared_ptr<BufferFormat> format, uint32_t vertexCapacity, uint32_t indexCapacity) : _format(format),
+		_vertexBuffer(std::make_shared<BufferVertex>(GLsizeiptr(vertexCapacity) * format->Stride(), format, MutableBufferT())),
+		_indexBuffer(std::make_shared<BufferIndex>(GLsizeiptr(indexCapacity) * GLsizeiptr(sizeof(unsigned int)), MutableBufferT())),
+		_vertices(vertexCapacity), _indices(indexCapacity) {
+
+	}
+
+	BufferArena(BufferArena const&) = delete;
+	BufferArena& operator=(BufferArena const&) = delete;
+
+	/// <summary>
+	/// Copies a mesh into the arena.
+	/// </summary>
+	/// <param name="vertices">One element per vertex, laid out as the arena's format</param>
+	/// <param name="indices">Relative to the mesh's own vertices</param>
+	/// <returns>Handle for Range and Remove</returns>
+	template <class _Ty>
+	size_t Add(std::vector<_Ty> const& vertices, std::vector<unsigned int> const& indices) {
+		if (sizeof(_Ty) != _format->Stride()) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": vertex size " + std::to_string(sizeof(_Ty)) + " does not match the arena stride " + std::to_string(_format->Stride()) + ".");
+		}
+		Mesh mesh;
+		mesh.vertices = Allocate(_vertices, *_vertexBuffer, _format->Stride(), uint32_t(vertices.size()));
+		mesh.indices = Allocate(_indices, *_indexBuffer, sizeof(unsigned int), uint32_t(indices.size()));
+		mesh.vertexCount = uint32_t(vertices.size());
+		mesh.indexCount = uint32_t(indices.size());
+		mesh.live = true;
+		glNamedBufferSubData(_vertexBuffer->BufferId(), GLintptr(_vertices.Offset(mesh.vertices)) * _format->Stride(), GLsizeiptr(sizeof(_Ty) * vertices.size()), vertices.data());
+		glNamedBufferSubData(_indexBuffer->BufferId(), GLintptr(_indices.Offset(mesh.indices)) * GLintptr(sizeof(unsigned int)), GLsizeiptr(sizeof(unsigned int) * indices.size()), indices.data());
+
+		size_t handle;
+		if (!_unusedMeshes.empty()) {
+			handle = _unusedMeshes.back();
+			_unusedMeshes.pop_back();
+			_meshes[handle] = mesh;
+		}
+		else {
+			handle = _meshes.size();
+			_meshes.emplace_back(mesh);
+		}
+		return handle;
+	}
+
+	/// <summary>
+	/// Overwrites the vertices of a mesh in place, for meshes deformed on the CPU.
+	/// </summary>
+	/// <param name="vertices">As many as the mesh was added with</param>
+	template <class _Ty>
+	void Update_Vertices(size_t mesh, std::vector<_Ty> const& vertices) {
+		Mesh const& found = Get(mesh);
+		if (sizeof(_Ty) != _format->Stride() || vertices.size() != found.vertexCount) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": " + std::to_string(vertices.size()) + " vertices of size " + std::to_string(sizeof(_Ty)) + " do not match mesh " + std::to_string(mesh) + ".");
+		}
+		glNamedBufferSubData(_vertexBuffer->BufferId(), GLintptr(_vertices.Offset(found.vertices)) * _format->Stride(), GLsizeiptr(sizeof(_Ty) * vertices.size()), vertices.data());
+	}
+
+	/// <summary>
+	/// Frees a mesh's ranges, they merge with free neighbours and are reused by later meshes.
+	/// </summary>
+	void Remove(size_t mesh) {
+		Mesh const& removed = Get(mesh);
+		_vertices.Free(removed.vertices);
+		_indices.Free(removed.indices);
+		_meshes[mesh].live = false;
+		_unusedMeshes.emplace_back(mesh);
+	}
+
+	/// <summary>
+	/// Current place of a mesh, it changes after Defragment.
+	/// </summary>
+	Range MeshRange(size_t mesh) const {
+		Mesh const& found = Get(mesh);
+		Range range;
+		range.baseVertex = GLint(_vertices.Offset(found.vertices));
+		range.vertexCount = found.vertexCount;
+		range.firstIndex = _indices.Offset(found.indices);
+		range.indexCount = GLsizei(found.indexCount);
+		return range;
+	}
+
+	/// <summary>
+	/// Moves every mesh to the front of the buffers with copies on the GPU, leaving all free space in one range at the end.
+	/// </summary>
+	void Defragment() {
+		Compact(_vertices, *_vertexBuffer, _format->Stride());
+		Compact(_indices, *_indexBuffer, sizeof(unsigned int));
+	}
+
+	/// <summary>
+	/// Points a VAO binding and its element buffer at the arena, one bind serves every mesh.
+	/// </summary>
+	bool Bind(VertexArray& vertexArray, GLuint binding) const {
+		return vertexArray.SetBuffer(_vertexBuffer, binding) && vertexArray.SetIndexBuffer(_indexBuffer);
+	}
+
+	/// <summary>
+	/// Draws one mesh as triangles, the arena's VAO must be bound.
+	/// </summary>
+	void Draw(size_t mesh) const {
+		Range range = MeshRange(mesh);
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, reinterpret_cast<void const*>(GLintptr(range.firstIndex) * GLintptr(sizeof(unsigned int))), range.baseVertex);
+	}
+
+	std::shared_ptr<BufferFormat> const& Format() const {
+		return _format;
+	}
+
+	std::shared_ptr<BufferVertex> const& VertexBuffer() const {
+		return _vertexBuffer;
+	}
+
+	std::shared_ptr<BufferIndex> const& IndexBuffer() const {
+		return _indexBuffer;
+	}
+
+	OffsetAllocator const& VertexAllocator() const {
+		return _vertices;
+	}
+
+	OffsetAllocator const& IndexAllocator() const {
+		return _indices;
+	}
+};
@@ -32,6 +32,13 @@ public:
 		subBuffers.emplace_back(indexes, 0);
 	}
 
+	/// <summary>
+	/// Uninitialised storage of bufferSize bytes without sub buffers.
+	/// </summary>
+	BufferIndex(GLsizeiptr bufferSize, MutableBufferT makeMutable) : subBuffers(), Buffer(bufferSize, makeMutable) {
+
+	}
+
 	BufferIndex(std::vector<std::vector<unsigned int>> const& indexes) : subBuffers(), Buffer(CalculateBufferSize(indexes)) {
 		for (size_t idx = 0; idx < subBuffers.size(); ++idx) {
 			glNamedBufferSubData(_bufferId, subBuffers[idx].bufferOffset, subBuffers[idx].subBufferSize, indexes[idx].data());
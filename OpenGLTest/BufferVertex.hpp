@@ -20,6 +20,13 @@ public:
 
 	}
 
+	/// <summary>
+	/// Uninitialised storage of bufferSize bytes, filled later with SwapBufferData or glNamedBufferSubData.
+	/// </summary>
+	BufferVertex(GLsizeiptr bufferSize, std::shared_ptr<BufferFormat> format, MutableBufferT, unsigned int divisor = 0) : bufferFormat(format), _divisor(divisor), Buffer(bufferSize, MutableBufferT()) {
+
+	}
+
 	virtual ~BufferVertex() {
 	
 	}
@@ -30,7 +37,7 @@ public:
 
 	template <class _Ty>
 	bool SwapBufferData(std::vector<_Ty> const& vector) {
-		return this->SwapBufferData(sizeof(_Ty) * vector.size(), vector.data());
+		return Buffer::SwapBufferData(vector);
 	}
 
 	bool operator==(const BufferVertex& other) const {
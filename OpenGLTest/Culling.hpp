@@ -0,0 +1,290 @@
+#pragma once
+#include "Simd.hpp"
+#include "Bounds.hpp"
+#include "BVH.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// Visibility tests of many objects per frame against a view frustum
+namespace Culling {
+	// Objects per SIMD block, the SoA arrays are padded to a multiple of this
+	constexpr size_t BLOCK_SIZE = 8;
+	// Objects per task when culling with a pool
+	constexpr size_t PARALLEL_GRAIN = 16384;
+
+	/// <summary>
+	/// Bounds of the objects as structure of arrays, each object is a box (center, extent) grown by a radius.
+	/// Boxes have radius 0 and spheres have extent 0.
+	/// </summary>
+	struct BoundsSoA {
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+		std::vector<float> radius;
+		size_t count = 0;
+
+		BoundsSoA() = default;
+		BoundsSoA(BoundsSoA const&) = default;
+		BoundsSoA(BoundsSoA&&) = default;
+
+		BoundsSoA& operator=(BoundsSoA const&) = default;
+		BoundsSoA& operator=(BoundsSoA&&) = default;
+
+		size_t Size() const {
+			return count;
+		}
+
+		void Clear() {
+			Resize(0);
+		}
+
+		void Resize(size_t size) {
+			count = size;
+			size_t padded = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+			for (std::vector<float>* stream : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius }) {
+				stream->resize(padded, 0.0f);
+			}
+		}
+
+		void Set(size_t index, AABB const& box) {
+			glm::vec3 center = box.Center();
+			glm::vec3 extent = box.Extent() * 0.5f;
+			centerX[index] = center.x;
+			centerY[index] = center.y;
+			centerZ[index] = center.z;
+			extentX[index] = extent.x;
+			extentY[index] = extent.y;
+			extentZ[index] = extent.z;
+			radius[index] = 0.0f;
+		}
+
+		void Set_Sphere(size_t index, glm::vec3 const& center, float sphereRadius) {
+			centerX[index] = center.x;
+			centerY[index] = center.y;
+			centerZ[index] = center.z;
+			extentX[index] = 0.0f;
+			extentY[index] = 0.0f;
+			extentZ[index] = 0.0f;
+			radius[index] = sphereRadius;
+		}
+
+		void Assign(AABB const* boxes, size_t size) {
+			Resize(size);
+			for (size_t index = 0; index < size; ++index) {
+				Set(index, boxes[index]);
+			}
+		}
+
+		void Assign(std::vector<AABB> const& boxes) {
+			Assign(boxes.data(), boxes.size());
+		}
+	};
+
+	struct Statistics {
+		size_t tested = 0;
+		size_t visible = 0;
+		double milliseconds = 0.0;
+
+		size_t Culled() const {
+			return tested - visible;
+		}
+
+		void Reset() {
+			tested = 0;
+			visible = 0;
+			milliseconds = 0.0;
+		}
+	};
+
+	/// <summary>
+	/// Plane constants broadcast once per cull, absolute normals give the projected box extent.
+	/// </summary>
+	struct FrustumPlanes {
+		float normalX[Frustum::PlaneCount];
+		float normalY[Frustum::PlaneCount];
+		float normalZ[Frustum::PlaneCount];
+		float distance[Frustum::PlaneCount];
+		float absoluteX[Frustum::PlaneCount];
+		float absoluteY[Frustum::PlaneCount];
+		float absoluteZ[Frustum::PlaneCount];
+
+		FrustumPlanes(Frustum const& frustum) {
+			for (unsigned plane = 0; plane < Frustum::PlaneCount; ++plane) {
+				normalX[plane] = frustum.planes[plane].x;
+				normalY[plane] = frustum.planes[plane].y;
+				normalZ[plane] = frustum.planes[plane].z;
+				distance[plane] = frustum.planes[plane].w;
+				absoluteX[plane] = std::fabs(normalX[plane]);
+				absoluteY[plane] = std::fabs(normalY[plane]);
+				absoluteZ[plane] = std::fabs(normalZ[plane]);
+			}
+		}
+	};
+
+	inline bool Test_One(FrustumPlanes const& planes, BoundsSoA const& bounds, size_t index) {
+		for (unsigned plane = 0; plane < Frustum::PlaneCount; ++plane) {
+			float distance = bounds.centerX[index] * planes.normalX[plane] + bounds.centerY[index] * planes.normalY[plane] + bounds.centerZ[index] * planes.normalZ[plane] + planes.distance[plane];
+			distance += bounds.radius[index] + bounds.extentX[index] * planes.absoluteX[plane] + bounds.extentY[index] * planes.absoluteY[plane] + bounds.extentZ[index] * planes.absoluteZ[plane];
+			if (distance < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// <returns>Bit N set when object N of the block is not outside any plane</returns>
+	inline unsigned Test_Block(FrustumPlanes const& planes, BoundsSoA const& bounds, size_t first) {
+#if defined(SIMD_AVX2)
+		if (Simd::Has_Avx2()) {
+			__m256 centerX = _mm256_loadu_ps(bounds.centerX.data() + first);
+			__m256 centerY = _mm256_loadu_ps(bounds.centerY.data() + first);
+			__m256 centerZ = _mm256_loadu_ps(bounds.centerZ.data() + first);
+			__m256 extentX = _mm256_loadu_ps(bounds.extentX.data() + first);
+			__m256 extentY = _mm256_loadu_ps(bounds.extentY.data() + first);
+			__m256 extentZ = _mm256_loadu_ps(bounds.extentZ.data() + first);
+			__m256 radius = _mm256_loadu_ps(bounds.radius.data() + first);
+			__m256 outside = _mm256_setzero_ps();
+			for (unsigned plane = 0; plane < Frustum::PlaneCount; ++plane) {
+				// Signed distance of the center plus the box and sphere reach towards the plane, negative means outside
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(planes.normalX[plane])), _mm256_set1_ps(planes.distance[plane]));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(centerY, _mm256_set1_ps(planes.normalY[plane])));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(centerZ, _mm256_set1_ps(planes.normalZ[plane])));
+				distance = _mm256_add_ps(distance, radius);
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(extentX, _mm256_set1_ps(planes.absoluteX[plane])));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(extentY, _mm256_set1_ps(planes.absoluteY[plane])));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(extentZ, _mm256_set1_ps(planes.absoluteZ[plane])));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+			return ~unsigned(_mm256_movemask_ps(outside)) & 0xFFu;
+		}
+#endif
+#if defined(SIMD_SSE)
+		unsigned mask = 0;
+		for (size_t half = 0; half < BLOCK_SIZE; half += 4) {
+			__m128 centerX = _mm_loadu_ps(bounds.centerX.data() + first + half);
+			__m128 centerY = _mm_loadu_ps(bounds.centerY.data() + first + half);
+			__m128 centerZ = _mm_loadu_ps(bounds.centerZ.data() + first + half);
+			__m128 extentX = _mm_loadu_ps(bounds.extentX.data() + first + half);
+			__m128 extentY = _mm_loadu_ps(bounds.extentY.data() + first + half);
+			__m128 extentZ = _mm_loadu_ps(bounds.extentZ.data() + first + half);
+			__m128 radius = _mm_loadu_ps(bounds.radius.data() + first + half);
+			__m128 outside = _mm_setzero_ps();
+			for (unsigned plane = 0; plane < Frustum::PlaneCount; ++plane) {
+				__m128 distance = _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(planes.normalX[plane])), _mm_set1_ps(planes.distance[plane]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(centerY, _mm_set1_ps(planes.normalY[plane])));
+				distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, _mm_set1_ps(planes.normalZ[plane])));
+				distance = _mm_add_ps(distance, radius);
+				distance = _mm_add_ps(distance, _mm_mul_ps(extentX, _mm_set1_ps(planes.absoluteX[plane])));
+				distance = _mm_add_ps(distance, _mm_mul_ps(extentY, _mm_set1_ps(planes.absoluteY[plane])));
+				distance = _mm_add_ps(distance, _mm_mul_ps(extentZ, _mm_set1_ps(planes.absoluteZ[plane])));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+			}
+			mask |= (~unsigned(_mm_movemask_ps(outside)) & 0xFu) << half;
+		}
+		return mask;
+#else
+		unsigned mask = 0;
+		for (size_t lane = 0; lane < BLOCK_SIZE; ++lane) {
+			mask |= unsigned(Test_One(planes, bounds, first + lane)) << lane;
+		}
+		return mask;
+#endif
+	}
+
+	/// <summary>
+	/// Appends the visible objects of [begin, end), begin is a multiple of BLOCK_SIZE.
+	/// </summary>
+	/// <param name="destination">Room for end - begin indices</param>
+	/// <returns>Indices written</returns>
+	inline size_t Cull_Range(FrustumPlanes const& planes, BoundsSoA const& bounds, size_t begin, size_t end, unsigned* destination) {
+		size_t written = 0;
+		for (size_t first = begin; first < end; first += BLOCK_SIZE) {
+			unsigned mask = Test_Block(planes, bounds, first);
+			if (end - first < BLOCK_SIZE) {
+				mask &= (1u << (end - first)) - 1;
+			}
+			// Branch free compaction, every lane is written and only visible lanes advance
+			for (unsigned lane = 0; lane < BLOCK_SIZE && first + lane < end; ++lane) {
+				destination[written] = unsigned(first + lane);
+				written += (mask >> lane) & 1;
+			}
+		}
+		return written;
+	}
+
+	/// <summary>
+	/// Frustum culling of a BoundsSoA into a compact list of visible indices, in index order.
+	/// </summary>
+	class FrustumCuller {
+		std::vector<size_t> _chunkCounts;
+
+	public:
+		Statistics statistics;
+
+		/// <param name="pool">Splits large sets over the workers, null culls on the calling thread</param>
+		void Cull(Frustum const& frustum, BoundsSoA const& bounds, std::vector<unsigned>& visible, ThreadPool* pool = nullptr) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			FrustumPlanes planes(frustum);
+			size_t count = bounds.Size();
+			visible.resize(count);
+
+			size_t written = 0;
+			if (!pool || pool->ThreadCount() == 0 || count <= PARALLEL_GRAIN) {
+				written = Cull_Range(planes, bounds, 0, count, visible.data());
+			}
+			else {
+				// Each chunk compacts into its own part of the output, then the parts are moved together
+				size_t chunks = (count + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN;
+				_chunkCounts.assign(chunks, 0);
+				pool->Parallel_For(chunks, 1, [&](size_t begin, size_t end) {
+					for (size_t chunk = begin; chunk < end; ++chunk) {
+						size_t first = chunk * PARALLEL_GRAIN;
+						_chunkCounts[chunk] = Cull_Range(planes, bounds, first, std::min(count, first + PARALLEL_GRAIN), visible.data() + first);
+					}
+				});
+				for (size_t chunk = 0; chunk < chunks; ++chunk) {
+					unsigned* source = visible.data() + chunk * PARALLEL_GRAIN;
+					std::copy(source, source + _chunkCounts[chunk], visible.data() + written);
+					written += _chunkCounts[chunk];
+				}
+			}
+			visible.resize(written);
+
+			statistics.tested += count;
+			statistics.visible += written;
+			statistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		/// <summary>
+		/// Culls through a BVH built over the same objects, whole subtrees outside the frustum are skipped
+		/// and the objects of the leaves reached are tested individually. Visible indices are in traversal order.
+		/// </summary>
+		void Cull(Frustum const& frustum, BoundsSoA const& bounds, BVH const& bvh, std::vector<unsigned>& visible) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			visible.clear();
+			bvh.Query_Frustum(frustum, visible);
+			size_t candidates = visible.size();
+
+			// Candidates are scattered, test them one at a time in place
+			FrustumPlanes planes(frustum);
+			size_t written = 0;
+			for (size_t candidate = 0; candidate < candidates; ++candidate) {
+				unsigned index = visible[candidate];
+				visible[written] = index;
+				written += Test_One(planes, bounds, index);
+			}
+			visible.resize(written);
+
+			statistics.tested += bounds.Size();
+			statistics.visible += written;
+			statistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	};
+}
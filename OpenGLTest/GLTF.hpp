@@ -194,10 +194,13 @@ namespace GLTF {
 		const static std::string MIME_TYPE = "mimeType";
 		const static std::string MIME_IMAGE_JPEG = "image/jpeg";
 		const static std::string MIME_IMAGE_PNG = "image/png";
+		const static std::string MIME_IMAGE_KTX2 = "image/ktx2";
 
 		// Material
 		const static std::string ALPHA_MODE = "alphaMode";
 		const static std::string DEFAULT_ALPHA_MODE = "OPAQUE";
+		const static std::string ALPHA_MODE_MASK = "MASK";
+		const static std::string ALPHA_MODE_BLEND = "BLEND";
 		const static std::string ALPHA_CUTOFF = "alphaCutoff";
 		const static std::string PBR_METALLIC_ROUGHNESS = "pbrMetallicRoughness";
 		const static std::string BASE_COLOR_FACTOR = "baseColorFactor";
@@ -265,6 +268,35 @@ namespace GLTF {
 		const static std::string TEXTURES = "textures";
 		const static std::string EXTENSIONS_USED = "extensionsUsed";
 		const static std::string EXTENSIONS_REQUIRED = "extensionsRequired";
+
+		// EXT_meshopt_compression
+		const static std::string EXT_MESHOPT_COMPRESSION = "EXT_meshopt_compression";
+		const static std::string FALLBACK = "fallback";
+		const static std::string FILTER = "filter";
+		const static std::string MESHOPT_MODE_ATTRIBUTES = "ATTRIBUTES";
+		const static std::string MESHOPT_MODE_TRIANGLES = "TRIANGLES";
+		const static std::string MESHOPT_MODE_INDICES = "INDICES";
+		const static std::string MESHOPT_FILTER_NONE = "NONE";
+		const static std::string MESHOPT_FILTER_OCTAHEDRAL = "OCTAHEDRAL";
+		const static std::string MESHOPT_FILTER_QUATERNION = "QUATERNION";
+		const static std::string MESHOPT_FILTER_EXPONENTIAL = "EXPONENTIAL";
+
+		// KHR_texture_basisu
+		const static std::string KHR_TEXTURE_BASISU = "KHR_texture_basisu";
+
+		// EXT_mesh_gpu_instancing
+		const static std::string EXT_MESH_GPU_INSTANCING = "EXT_mesh_gpu_instancing";
+		const static std::string INSTANCE_TRANSLATION = "TRANSLATION";
+		const static std::string INSTANCE_ROTATION = "ROTATION";
+		const static std::string INSTANCE_SCALE = "SCALE";
+
+		// Primitive attribute semantics
+		const static std::string ATTRIBUTE_POSITION = "POSITION";
+		const static std::string ATTRIBUTE_NORMAL = "NORMAL";
+		const static std::string ATTRIBUTE_TANGENT = "TANGENT";
+		const static std::string ATTRIBUTE_TEXCOORD_0 = "TEXCOORD_0";
+		const static std::string ATTRIBUTE_JOINTS_0 = "JOINTS_0";
+		const static std::string ATTRIBUTE_WEIGHTS_0 = "WEIGHTS_0";
 	}
 
 	inline std::string JsonParse_Type_To_String(JsonParse::Type const type) {
@@ -724,6 +756,17 @@ namespace GLTF {
 		void Extensions(type_json_object const& extensions) {
 			for (std::pair<std::string, type_json_element> const& extension : extensions->attributes) {
 				this->extensionsInFile.insert(extension.first);
+
+				decltype(extensionHandlers)::const_iterator handler = extensionHandlers.find(extension.first);
+				if (handler != extensionHandlers.cend() && handler->second) {
+					ManageBreadCrumb crumbs(*this, extension.first);
+					if (extension.second->type == JsonParse::Type::Object) {
+						handler->second(*this, std::static_pointer_cast<JsonParse::JsonObject>(extension.second));
+					}
+					else {
+						errors.push_back(GLTFError(extensions, extension.second, ErrorTypeMismatch(FILE_FUNCTION_LINE, JsonParse::Type::Object, extension.second->type)));
+					}
+				}
 			}
 		}
 
@@ -868,7 +911,7 @@ namespace GLTF {
 			Integer(FILE_FUNCTION_LINE, accessor, Constants::BYTE_OFFSET, &Validator::GreaterEqualZero, false);
 			Integer(FILE_FUNCTION_LINE, accessor, Constants::COMPONENT_TYPE, &Validator::AccessorComponentType, true);
 			Boolean(FILE_FUNCTION_LINE, accessor, Constants::NORMALIZED);
-			Integer(FILE_FUNCTION_LINE, accessor, Constants::COUNT, &Validator::GreaterEqualOne, true);
+			Integer(FILE_FUNCTION_LINE, accessor, Constants::COUNT, &Validator::AccessorCount, true);
 			String(FILE_FUNCTION_LINE, accessor, Constants::TYPE, &Validator::AccessorType, true);
 			// Max and Min are handled in AccessorType
 			Object(FILE_FUNCTION_LINE, accessor, Constants::SPARSE, &Validator::Sparse);
@@ -1011,7 +1054,9 @@ namespace GLTF {
 		}
 
 		void ImageMimeType(CALLBACK_STRING_ARGS(image)) {
-			if (element->value != Constants::MIME_IMAGE_JPEG && element->value != Constants::MIME_IMAGE_PNG) {
+			// KTX2 images are only referenced through KHR_texture_basisu
+			bool ktx2 = element->value == Constants::MIME_IMAGE_KTX2 && extensionHandlers.find(Constants::KHR_TEXTURE_BASISU) != extensionHandlers.cend();
+			if (element->value != Constants::MIME_IMAGE_JPEG && element->value != Constants::MIME_IMAGE_PNG && !ktx2) {
 				errors.push_back(GLTFError(image, element, ErrorMessageValue(messagePreamble, element) + " must be '" + Constants::MIME_IMAGE_JPEG + "' or '" + Constants::MIME_IMAGE_PNG + "'."));
 			}
 		}
@@ -1382,7 +1427,7 @@ namespace GLTF {
 			arraySizes[Constants::IMAGES] = ArraySize(rootObject, Constants::IMAGES);
 			arraySizes[Constants::MATERIALS] = ArraySize(rootObject, Constants::MATERIALS);
 			arraySizes[Constants::MESHES] = ArraySize(rootObject, Constants::MESHES);
-			arraySizes[Constants::NODE] = ArraySize(rootObject, Constants::NODE);
+			arraySizes[Constants::NODES] = ArraySize(rootObject, Constants::NODES);
 			arraySizes[Constants::SAMPLERS] = ArraySize(rootObject, Constants::SAMPLERS);
 			arraySizes[Constants::SCENES] = ArraySize(rootObject, Constants::SCENES);
 			arraySizes[Constants::SKINS] = ArraySize(rootObject, Constants::SKINS);
@@ -1399,7 +1444,7 @@ namespace GLTF {
 			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::IMAGES, &Validator::Image);
 			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::MATERIALS, &Validator::Material);
 			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::MESHES, &Validator::Mesh);
-			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::NODE, &Validator::Node);
+			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::NODES, &Validator::Node);
 			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::SAMPLERS, &Validator::Sampler);
 			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::SCENES, &Validator::Scene);
 			ArrayOfObjects(FILE_FUNCTION_LINE, rootObject, Constants::SKINS, &Validator::Skin);
@@ -1465,7 +1510,7 @@ namespace GLTF {
 	/// <param name="defaultValue">Default value if the find/convert fails</param>
 	/// <returns>Value of the element on success, or default value if the element is missing or of incorrect type</returns>
 	template <>
-	typename JsonParse::JsonNumber::value_type Get_Optional_Value<JsonParse::JsonNumber>(type_json_object const& object, std::string const& elementName, JsonParse::JsonNumber::value_type defaultValue) {
+	inline typename JsonParse::JsonNumber::value_type Get_Optional_Value<JsonParse::JsonNumber>(type_json_object const& object, std::string const& elementName, JsonParse::JsonNumber::value_type defaultValue) {
 		type_json_element foundElement = object->Find(elementName);
 		if (foundElement) {
 			if (foundElement->type == JsonParse::Type::Number) {
@@ -1625,7 +1670,7 @@ namespace GLTF {
 	}
 
 	template <>
-	void Parse_Array_Dynamic<number_type, JsonParse::JsonNumber>(std::vector<number_type>& destination, type_json_object const& object, std::string const& elementName, bool required) {
+	inline void Parse_Array_Dynamic<number_type, JsonParse::JsonNumber>(std::vector<number_type>& destination, type_json_object const& object, std::string const& elementName, bool required) {
 		type_json_element foundElement = object->Find(elementName);
 		if (foundElement && foundElement->type == JsonParse::Type::Array) {
 			type_json_array container = std::static_pointer_cast<JsonParse::JsonArray>(foundElement);
@@ -1655,7 +1700,7 @@ namespace GLTF {
 		}
 	}
 
-	void Parse_Array(std::string&& messagePreamble, number_type* destination, size_t count, type_json_object const& object, std::string const& elementName, bool required = false) {
+	inline void Parse_Array(std::string&& messagePreamble, number_type* destination, size_t count, type_json_object const& object, std::string const& elementName, bool required = false) {
 		type_json_element foundElement = object->Find(elementName);
 		if (foundElement && foundElement->type == JsonParse::Type::Array) {
 			type_json_array jArray = std::static_pointer_cast<JsonParse::JsonArray>(foundElement);
@@ -1679,7 +1724,7 @@ namespace GLTF {
 					return;
 				}
 			}
-			memcpy_s(destination, count, hold.data(), count);
+			memcpy_s(destination, count * sizeof(number_type), hold.data(), count * sizeof(number_type));
 		}
 		else {
 			if (required) {
@@ -1731,6 +1776,17 @@ namespace GLTF {
 		GLTFRootProperty& operator=(GLTFRootProperty&&) = default;
 	};
 
+	/// <summary>
+	/// Finds an extension object on a property.
+	/// </summary>
+	/// <returns>nullptr if the property does not use the extension</returns>
+	inline type_json_object Get_Extension(GLTFProperty const& property, std::string const& extensionName) {
+		if (!property.extensions) {
+			return nullptr;
+		}
+		return Get_Optional_Element<JsonParse::JsonObject>(property.extensions, extensionName);
+	}
+
 	struct TextureInfo : public GLTFProperty {
 		index_type index = -1;
 		index_type texCoord = 0;
@@ -2283,6 +2339,7 @@ namespace GLTF {
 			index_type material;
 			unsigned short mode = 4;
 
+			// Accessor of each morph target by attribute, -1 where a target does not morph the attribute
 			std::unordered_map<std::string, std::vector<index_type>> targets;
 
 			Primitive(type_json_object const& sourceObject) : GLTFProperty(sourceObject),
@@ -2291,7 +2348,7 @@ namespace GLTF {
 				mode(static_cast<decltype(mode)>(Get_Optional_Value<JsonParse::JsonInteger>(sourceObject, Constants::MODE, 4))) {
 
 				type_json_object attributesObject = Get_Required_Element<JsonParse::JsonObject>(FILE_FUNCTION_LINE, sourceObject, Constants::ATTRIBUTES);
-				for (JsonParse::JsonObject::pair_type const& attribute : sourceObject->attributes) {
+				for (JsonParse::JsonObject::pair_type const& attribute : attributesObject->attributes) {
 					if (attribute.second->type != JsonParse::Type::Integer) {
 						throw GltfTypeMismatch(sourceObject, FILE_FUNCTION_LINE + ": object \"attributes\" attribute \"" + attribute.first + "\" value is not an integer.");
 					}
@@ -2314,10 +2371,16 @@ namespace GLTF {
 								throw GltfTypeMismatch(target, FILE_FUNCTION_LINE + ": element \"targets\" at index: " + std::to_string(idx) + " attribute: \"" + attribute.first + "\" is not an integer.");
 							}
 							else {
-								targets[attribute.first].emplace_back(static_cast<size_t>(std::static_pointer_cast<JsonParse::JsonInteger>(attribute.second)->value));
+								// Targets without this attribute before idx are marked -1 so list positions stay target indices
+								std::vector<index_type>& list = targets[attribute.first];
+								list.resize(idx, index_type(-1));
+								list.emplace_back(static_cast<size_t>(std::static_pointer_cast<JsonParse::JsonInteger>(attribute.second)->value));
 							}
 						}
 					}
+					for (decltype(targets)::reference target : targets) {
+						target.second.resize(_targets->values.size(), index_type(-1));
+					}
 
 					if (targets.size() > attributes.size()) {
 						// Exception
@@ -2483,6 +2546,17 @@ namespace GLTF {
 		Texture& operator=(Texture&&) = default;
 	};
 
+	/// <summary>
+	/// Image a texture samples, the KTX2 image of KHR_texture_basisu when the texture has one.
+	/// </summary>
+	inline index_type Texture_Source(Texture const& texture) {
+		type_json_object basisu = Get_Extension(texture, Constants::KHR_TEXTURE_BASISU);
+		if (basisu) {
+			return Get_Optional_Value<JsonParse::JsonInteger>(basisu, Constants::SOURCE, texture.source);
+		}
+		return texture.source;
+	}
+
 	struct GLTFDoc : public GLTFProperty {
 		std::vector<std::string> extensionsUsed;
 		std::vector<std::string> extensionsRequired;
@@ -1,6 +1,8 @@
 #pragma once
 #include "Object.hpp"
 #include "GLTF.hpp"
+#include "DataStream.hpp"
+#include "TextureDecode.hpp"
 #include <GLAD/gl.h>
 #include <algorithm>
 #include <string>
@@ -231,90 +233,6 @@ struct GLCamera : public Object {
 	}
 };
 
-/// <summary>
-/// Utility class for decoding a base64 data-stream as well as parsing the mimeType
-/// </summary>
-struct DataStreamBase64 {
-	std::string mimeType;
-	std::vector<unsigned char> binaryData;
-
-	static std::vector<unsigned char> Base64_Decode(std::string const& source) {
-		static const unsigned char INDEX_ARRAY[256] = {
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  62, 63, 62, 62, 63,
-			52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 0,  0,  0,  0,  0,  0,
-			0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14,
-			15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 0,  0,  0,  0,  63,
-			0,  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-			41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-			0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
-		};
-		if (source.size() == 0) {
-			return std::vector<unsigned char>();
-		}
-		if (source.size() % 4 != 0) {
-			throw std::runtime_error(std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__) + ": Base64 Stream length must be a multiple of four.");
-		}
-
-		const unsigned short paddingCount = (source[source.size() - 1] == '=') + (source[source.size() - 2] == '=');
-		// Index of the last value which does not contain padding
-		const size_t FINALUNPADDED = source.size() - (4 * size_t(paddingCount != 0));
-		std::vector<unsigned char> result((source.size() / 4 * 3) - paddingCount, unsigned char());
-
-		size_t idxResult = 0;
-		int number = 0;
-		unsigned char const* sourcePointer = (unsigned char const*)source.data();
-		unsigned char* resultPointer = result.data();
-		for (size_t idxSource = 0; idxSource != FINALUNPADDED; idxSource += 4, idxResult += 3) {
-			number = INDEX_ARRAY[sourcePointer[idxSource]];
-			number <<= 6;
-			number |= INDEX_ARRAY[sourcePointer[idxSource + 1]];
-			number <<= 6;
-			number |= INDEX_ARRAY[sourcePointer[idxSource + 2]];
-			number <<= 6;
-			number |= INDEX_ARRAY[sourcePointer[idxSource + 3]];
-			//number = (int)(INDEX_ARRAY[sourcePointer[idxSource]]) << 18
-			//	| (int)(INDEX_ARRAY[sourcePointer[idxSource + 1]]) << 12
-			//	| (int)(INDEX_ARRAY[sourcePointer[idxSource + 2]]) << 6
-			//	| (int)(INDEX_ARRAY[sourcePointer[idxSource + 3]]);
-
-			resultPointer[idxResult] = (unsigned char)((number >> 16) | 0xFF);
-			resultPointer[idxResult + 1] = (unsigned char)((number >> 8) | 0xFF);
-			resultPointer[idxResult + 2] = (unsigned char)(number | 0xFF);
-		}
-
-		switch (paddingCount) {
-		case 2:
-			number = (int)(INDEX_ARRAY[sourcePointer[FINALUNPADDED]]) << 18 | (int)(INDEX_ARRAY[sourcePointer[FINALUNPADDED + 1]]) << 12;
-			resultPointer[idxResult] = static_cast<char>(number >> 16);
-			break;
-		case 1:
-			number = INDEX_ARRAY[sourcePointer[FINALUNPADDED]] << 18 | INDEX_ARRAY[sourcePointer[FINALUNPADDED + 1]] << 12 | INDEX_ARRAY[sourcePointer[FINALUNPADDED + 2]] << 6;
-			resultPointer[idxResult] = static_cast<char>(number >> 16);
-			resultPointer[idxResult + 1] = static_cast<char>(number >> 8);
-			break;
-		case 0:
-			break;
-		};
-
-		return result;
-	}
-
-	// dataStream should be a std::vector<unsigned char>, input to this constructor is GLTF::Buffer::uri which is a string
-	DataStreamBase64(std::string const& dataStream) : 
-		mimeType(dataStream.substr(dataStream.find(GLTF::Constants::STREAM_DATA) + GLTF::Constants::STREAM_DATA.length(), dataStream.find(GLTF::Constants::STREAM_SEPERATOR))), 
-		binaryData(Base64_Decode(dataStream.substr(dataStream.find(GLTF::Constants::STREAM_SEPERATOR) + GLTF::Constants::STREAM_SEPERATOR.length()))) {
-	}
-};
-
 /// <summary>
 /// Loads data from a GLTF::Buffer object
 /// </summary>
@@ -448,68 +366,55 @@ public:
 	friend class GLTexture;
 };
  
+/// <summary>
+/// Pixels of a GLTF::Image in 8 bits per channel, see TextureDecode::TextureDecoder to decode many images in parallel.
+/// </summary>
 class GLImage {
-	static GLImage errorImage;
-	void* data;
-
-	int width, height, channels;
+	TextureDecode::DecodedImage _image;
 public:
-	GLImage() : data(nullptr), width(-1), height(-1), channels(-1) {
+	GLImage() = default;
+
+	GLImage(TextureDecode::DecodedImage&& image) : _image(std::move(image)) {
 
 	}
 
-	GLImage(GLTF::Image const& image) : data(nullptr), width(-1), height(-1), channels(-1) {
-		if (!image.uri.empty()) {
-			if (image.uri.find(GLTF::Constants::STREAM_DATA) == 0) {
-				DataStreamBase64 base64(image.uri);
+	/// <summary>
+	/// Decodes on the calling thread.
+	/// </summary>
+	/// <param name="directory">Directory of the document, relative uris are resolved against it</param>
+	GLImage(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::index_type image, std::filesystem::path const& directory) :
+		_image(TextureDecode::Decode_Image(TextureDecode::Image_Bytes(doc, buffers, image, directory))) {
 
-				if (image.mimeType == GLTF::Constants::MIME_IMAGE_PNG) {
+	}
 
-				}
-				else if (image.mimeType == GLTF::Constants::MIME_IMAGE_JPEG) {
-					stbi_loadf_from_memory(base64.binaryData.data(), (int)base64.binaryData.size(), &width, &height, &channels, 0);
-				}
-				
-			}
-			else {
-				if (image.mimeType.empty()) {
-					// Exception, no mimeType needed for load from buffer
-				}
-				if (image.bufferView != -1) {
-					// Load from buffer
-				}
+	GLImage(GLImage const&) = default;
+	GLImage(GLImage&&) = default;
 
-			}
-			// Try to load
-			std::filesystem::path filePath(image.uri);
+	GLImage& operator=(GLImage const&) = default;
+	GLImage& operator=(GLImage&&) = default;
 
-		}
+	bool Valid() const {
+		return _image.Valid();
 	}
 
-	GLImage(GLTF::Image&& image) : data(nullptr), width(-1), height(-1), channels(-1) {
-		if (!image.uri.empty()) {
-			if (image.uri.find(GLTF::Constants::STREAM_DATA) == 0) {
-				DataStreamBase64 base64(image.uri);
+	int Width() const {
+		return _image.width;
+	}
 
-				if (image.mimeType == GLTF::Constants::MIME_IMAGE_PNG) {
+	int Height() const {
+		return _image.height;
+	}
 
-				}
-				else if (image.mimeType == GLTF::Constants::MIME_IMAGE_JPEG) {
-					stbi_loadf_from_memory(base64.binaryData.data(), (int)base64.binaryData.size(), &width, &height, &channels, 0);
-				}
-			}
-			// Try to load
-			std::filesystem::path filePath;
-		}
-		else {
-			if (image.bufferView != -1) {
+	int Channels() const {
+		return _image.channels;
+	}
 
-			}
-		}
+	std::vector<unsigned char> const& Pixels() const {
+		return _image.pixels;
 	}
 
-	~GLImage() {
-		delete data;
+	TextureDecode::DecodedImage const& Decoded() const {
+		return _image;
 	}
 };
 
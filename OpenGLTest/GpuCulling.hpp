@@ -0,0 +1,202 @@
+#pragma once
+#include "Bounds.hpp"
+#include "Buffer.hpp"
+#include "IndirectDraw.hpp"
+#include "RingBuffer.hpp"
+#include "Shader.hpp"
+#include <GLAD\gl.h>
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Frustum culling of the queued indirect draws in a compute shader, the visible draws are drawn with their count read from a buffer
+namespace GpuCulling {
+	// Matches local_size_x of cull_compute.glsl
+	constexpr GLuint WORKGROUP_SIZE = 64;
+	// Draws the output buffers start with, they double when a frame needs more
+	constexpr size_t INITIAL_CAPACITY = 4096;
+
+	// Storage bindings of cull_compute.glsl
+	constexpr GLuint CANDIDATE_BINDING = 0;
+	constexpr GLuint CANDIDATE_DATA_BINDING = 1;
+	constexpr GLuint BOUNDS_BINDING = 2;
+	constexpr GLuint COMMAND_BINDING = 3;
+	constexpr GLuint DRAW_BINDING = 4;
+	constexpr GLuint COUNT_BINDING = 5;
+
+	// std430 element of the bounds the compute shader tests, a box (center, extent) grown by a radius as in Culling::BoundsSoA
+	struct CullBounds {
+		glm::vec3 center;
+		float radius;
+		glm::vec3 extent;
+		// Group of the draw and the first slot of the group in the output, where its visible draws are packed
+		uint32_t group;
+		uint32_t first;
+		// Non zero when the group must keep its order, the draw stays in its own slot and is emptied when culled
+		uint32_t ordered;
+		uint32_t padding[2];
+	};
+
+	/// <summary>
+	/// True when draw counts can come from a buffer, core in 4.6 and ARB_indirect_parameters before it.
+	/// </summary>
+	inline bool Supported() {
+		return GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_indirect_parameters;
+	}
+
+	struct Statistics {
+		size_t candidates = 0;
+		size_t groups = 0;
+		double milliseconds = 0.0;
+
+		void Reset() {
+			candidates = 0;
+			groups = 0;
+			milliseconds = 0.0;
+		}
+	};
+
+	/// <summary>
+	/// Culls the draws of an IndirectRenderer on the GPU. Every candidate is uploaded with its bounds, a compute pass appends the
+	/// visible ones to their group's part of the output with an atomic counter, and each group is drawn with
+	/// glMultiDrawElementsIndirectCount so the CPU never learns what was visible. Check Supported before creating one.
+	/// Groups and passes keep the renderer's order. Draws inside an opaque group are appended in whatever order the threads run,
+	/// transparent groups keep their back to front order with culled draws left in place with no instances.
+	/// </summary>
+	class GpuCuller {
+		ComputeShader _shader;
+		GLint _planesLocation;
+		GLint _countLocation;
+		// Written by the compute pass, only the GPU reads them
+		Buffer _commands;
+		Buffer _draws;
+		Buffer _counts;
+		std::vector<CullBounds> _bounds;
+		std::vector<GLuint> _initialCounts;
+		PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC _multiDrawCount;
+
+		static void Reserve(Buffer& buffer, size_t bytes) {
+			GLsizeiptr size = std::max<GLsizeiptr>(buffer.Size(), 1);
+			while (size < GLsizeiptr(bytes)) {
+				size *= 2;
+			}
+			buffer.Reserve(size);
+		}
+
+	public:
+		Statistics statistics;
+
+		GpuCuller(const char* computePath = "./cull_compute.glsl") : _shader(computePath),
+			_planesLocation(glGetUniformLocation(_shader.programId, "planes")), _countLocation(glGetUniformLocation(_shader.programId, "candidateCount")),
+			_commands(GLsizeiptr(INITIAL_CAPACITY * sizeof(IndirectDraw::DrawElementsIndirectCommand)), MutableBufferT()),
+			_draws(GLsizeiptr(INITIAL_CAPACITY * sizeof(IndirectDraw::DrawData)), MutableBufferT()),
+			_counts(GLsizeiptr(INITIAL_CAPACITY * sizeof(GLuint)), MutableBufferT()),
+			_multiDrawCount(GLAD_GL_VERSION_4_6 ? glMultiDrawElementsIndirectCount : glMultiDrawElementsIndirectCountARB) {
+
+		}
+
+		GpuCuller(GpuCuller const&) = delete;
+		GpuCuller& operator=(GpuCuller const&) = delete;
+
+		/// <summary>
+		/// Sorts the renderer's draws, culls them against the frustum and draws the visible ones. Every draw needs bounds.
+		/// The Frame uniforms must already be bound.
+		/// </summary>
+		/// <param name="bindBatch">Called when the batch changes, after the group's program and vertex array are bound</param>
+		/// <returns>False when the candidates do not fit in the ring's current region, nothing is drawn then</returns>
+		bool Submit(IndirectDraw::IndirectRenderer& renderer, RingBuffer& frameData, Frustum const& frustum, std::function<void(uint32_t batch)> const& bindBatch) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (renderer.Size() == 0) {
+				return true;
+			}
+			renderer.Sort();
+			std::vector<AABB> const& boxes = renderer.Sorted_Bounds();
+			std::vector<IndirectDraw::Group> const& groups = renderer.Groups();
+			if (boxes.size() != renderer.Size()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": draws were queued without bounds.");
+			}
+			if (renderer.Sorted_Data().size() != boxes.size()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": instanced draws can not be culled, queue each instance with its bounds.");
+			}
+
+			_bounds.resize(boxes.size());
+			_initialCounts.resize(groups.size());
+			for (size_t group = 0; group < groups.size(); ++group) {
+				// Blending needs the sorted order, an atomic append would shuffle the group
+				bool ordered = RenderQueue::Depth_Leads(groups[group].key.pass);
+				_initialCounts[group] = ordered ? GLuint(groups[group].count) : 0;
+				for (size_t index = groups[group].first; index < groups[group].first + groups[group].count; ++index) {
+					CullBounds& bounds = _bounds[index];
+					bounds.center = boxes[index].Center();
+					bounds.radius = 0.0f;
+					bounds.extent = boxes[index].Extent() * 0.5f;
+					bounds.group = uint32_t(group);
+					bounds.first = uint32_t(groups[group].first);
+					bounds.ordered = ordered ? 1 : 0;
+					bounds.padding[0] = bounds.padding[1] = 0;
+				}
+			}
+			RingBuffer::Allocation candidates = frameData.Push(renderer.Sorted_Commands(), frameData.StorageAlignment());
+			RingBuffer::Allocation candidateData = frameData.Push(renderer.Sorted_Data(), frameData.StorageAlignment());
+			RingBuffer::Allocation bounds = frameData.Push(_bounds, frameData.StorageAlignment());
+			if (!candidates.Valid() || !candidateData.Valid() || !bounds.Valid()) {
+				return false;
+			}
+			Reserve(_commands, boxes.size() * sizeof(IndirectDraw::DrawElementsIndirectCommand));
+			Reserve(_draws, boxes.size() * sizeof(IndirectDraw::DrawData));
+			Reserve(_counts, groups.size() * sizeof(GLuint));
+			glNamedBufferSubData(_counts.BufferId(), 0, GLsizeiptr(_initialCounts.size() * sizeof(GLuint)), _initialCounts.data());
+
+			frameData.BindStorage(CANDIDATE_BINDING, candidates);
+			frameData.BindStorage(CANDIDATE_DATA_BINDING, candidateData);
+			frameData.BindStorage(BOUNDS_BINDING, bounds);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, _commands.BufferId());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BINDING, _draws.BufferId());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, _counts.BufferId());
+			glProgramUniform4fv(_shader.programId, _planesLocation, Frustum::PlaneCount, &frustum.planes[0][0]);
+			glProgramUniform1ui(_shader.programId, _countLocation, GLuint(boxes.size()));
+			_shader.Dispatch(GLuint((boxes.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE));
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndirectDraw::DRAW_DATA_BINDING, _draws.BufferId());
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands.BufferId());
+			glBindBuffer(GL_PARAMETER_BUFFER, _counts.BufferId());
+			size_t groupIndex = 0;
+			renderer.Bind_Groups(bindBatch, [&](IndirectDraw::Group const& group) {
+				_multiDrawCount(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void const*>(GLintptr(group.first * sizeof(IndirectDraw::DrawElementsIndirectCommand))), GLintptr(groupIndex * sizeof(GLuint)), GLsizei(group.count), 0);
+				++groupIndex;
+			});
+			glBindBuffer(GL_PARAMETER_BUFFER, 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			statistics.candidates += boxes.size();
+			statistics.groups += groups.size();
+			statistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return true;
+		}
+
+		/// <summary>
+		/// Visible draws of each group of the last Submit, every draw for transparent groups. Waits for the GPU so it is for tests and debugging only.
+		/// </summary>
+		std::vector<GLuint> Read_Counts(size_t groups) {
+			std::vector<GLuint> counts(groups);
+			glGetNamedBufferSubData(_counts.BufferId(), 0, GLsizeiptr(groups * sizeof(GLuint)), counts.data());
+			return counts;
+		}
+
+		/// <summary>
+		/// Commands written by the last Submit, group by group as in the renderer's Groups. Waits for the GPU.
+		/// </summary>
+		std::vector<IndirectDraw::DrawElementsIndirectCommand> Read_Commands(size_t draws) {
+			std::vector<IndirectDraw::DrawElementsIndirectCommand> commands(draws);
+			glGetNamedBufferSubData(_commands.BufferId(), 0, GLsizeiptr(draws * sizeof(IndirectDraw::DrawElementsIndirectCommand)), commands.data());
+			return commands;
+		}
+	};
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "Object.hpp"
 #include "VertexArray.hpp"
+#include "MeshInstanced.hpp"
+#include "RenderQueue.hpp"
 #include <glm\glm.hpp>
 #include <vector>
 #include <map>
@@ -57,8 +59,22 @@ namespace Mesh {
 
 	struct Program : Object {
 		// Add mutex and locks for thread-safety
-		using instance_container = std::map<std::shared_ptr<Mesh>, std::vector<std::shared_ptr<EntityInstance>>>;
-		instance_container meshInstances;
+		// Instances queued this frame, the packets of queue index into it
+		std::vector<std::shared_ptr<EntityInstance>> instances;
+		RenderQueue::RenderQueue queue;
+
+		void Clear() {
+			instances.clear();
+			queue.Clear();
+		}
+
+		/// <summary>
+		/// Queues an instance for this frame, fields.program is this program's slot in the caller's table.
+		/// </summary>
+		void Queue(std::shared_ptr<EntityInstance> instance, RenderQueue::Fields const& fields) {
+			queue.Push(fields, uint32_t(instances.size()));
+			instances.emplace_back(std::move(instance));
+		}
 	};
 
 	// Mesh factory stores the information about the mesh
@@ -72,10 +88,6 @@ namespace Mesh {
 		}
 	};
 
-	struct MeshInstanced {
-
-	};
-
 	// Multiple meshes are composed in a single VBO
 	struct MeshComposite {
 
@@ -0,0 +1,347 @@
+#pragma once
+#include "Bounds.hpp"
+#include "BufferArena.hpp"
+#include "RenderQueue.hpp"
+#include "RingBuffer.hpp"
+#include <GLAD\gl.h>
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Draws of arena meshes gathered each frame and submitted with one glMultiDrawElementsIndirect per state group
+namespace IndirectDraw {
+	// Shader storage binding of the DrawData array, see indirect_vertex.glsl
+	constexpr GLuint DRAW_DATA_BINDING = 0;
+
+	// Layout glMultiDrawElementsIndirect reads
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// std430 element of the per draw storage block, the vertex shader reads draws[gl_BaseInstance + gl_InstanceID]
+	struct DrawData {
+		glm::mat4 world;
+		uint32_t material;
+		// Layer of the batch texture array the draw samples, -1 when the batch is a 2D texture
+		int32_t layer;
+		uint32_t padding[2];
+		// Texture coordinates are sampled at uv * uvTransform.xy + uvTransform.zw
+		glm::vec4 uvTransform;
+	};
+
+	/// <summary>
+	/// Where in its batch a draw samples, for batches that are texture arrays of images packed by TextureAtlas.
+	/// </summary>
+	struct BatchLayer {
+		int32_t layer = -1;
+		glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	};
+
+	/// <summary>
+	/// State that must change between multi-draws. Batch is what the caller binds for a material batch, a texture or texture array for example.
+	/// </summary>
+	struct GroupKey {
+		GLuint program = 0;
+		GLuint vertexArray = 0;
+		uint32_t batch = 0;
+		// Passes are drawn in RenderQueue::Pass order, transparent draws back to front
+		RenderQueue::Pass pass = RenderQueue::Pass::Opaque;
+
+		bool operator==(GroupKey const& other) const {
+			return program == other.program && vertexArray == other.vertexArray && batch == other.batch && pass == other.pass;
+		}
+	};
+
+	// Draws sharing a GroupKey, first indexes the sorted draws
+	struct Group {
+		GroupKey key;
+		size_t first;
+		size_t count;
+	};
+
+	struct Statistics {
+		size_t draws = 0;
+		size_t instances = 0;
+		size_t groups = 0;
+		double milliseconds = 0.0;
+
+		void Reset() {
+			draws = 0;
+			instances = 0;
+			groups = 0;
+			milliseconds = 0.0;
+		}
+	};
+
+	/// <summary>
+	/// Collects the frame's visible draws, then sorts them by RenderQueue key and writes the commands and draw data into the frame's RingBuffer.
+	/// baseInstance of each command is the index of its first DrawData, so draws stay addressable across groups without gl_DrawID.
+	/// An instanced draw has one DrawData per instance, consecutive from there.
+	/// </summary>
+	class IndirectRenderer {
+		struct Draw {
+			GroupKey key;
+			DrawElementsIndirectCommand command;
+			// Index in _data of the first instance
+			uint32_t data;
+			// View space distance of the nearest instance, or of the bounds' center
+			float distance;
+		};
+
+		std::vector<Draw> _draws;
+		std::vector<DrawData> _data;
+		std::vector<AABB> _bounds;
+		glm::mat4 _view = glm::mat4(1.0f);
+		float _nearPlane = 0.0f;
+		float _farPlane = 0.0f;
+		// GL names of the frame's draws, sorted and unique, a name's index is its field in the sort key
+		std::vector<GLuint> _programs;
+		std::vector<GLuint> _vertexArrays;
+		std::vector<uint32_t> _batches;
+		// Draws in key order, packet index is the index in _draws
+		std::vector<RenderQueue::Packet> _order;
+		std::vector<RenderQueue::Packet> _orderScratch;
+		// Filled by Sort, commands have baseInstance set to the index of their first sorted DrawData
+		std::vector<DrawElementsIndirectCommand> _sortedCommands;
+		std::vector<DrawData> _sortedData;
+		std::vector<AABB> _sortedBounds;
+		std::vector<Group> _groups;
+
+		template <class _Ty>
+		static void Sort_Names(std::vector<_Ty>& names) {
+			std::sort(names.begin(), names.end());
+			names.erase(std::unique(names.begin(), names.end()), names.end());
+		}
+
+		template <class _Ty>
+		static uint32_t Name_Index(std::vector<_Ty> const& names, _Ty name) {
+			return uint32_t(std::lower_bound(names.begin(), names.end(), name) - names.begin());
+		}
+
+		float Distance(glm::vec3 const& position) const {
+			return -(_view * glm::vec4(position, 1.0f)).z;
+		}
+
+	public:
+		Statistics statistics;
+		// Called before the first group of each pass when set, for the blend and depth write state the pass needs
+		std::function<void(RenderQueue::Pass pass)> bindPass;
+
+		IndirectRenderer() = default;
+		IndirectRenderer(IndirectRenderer const&) = delete;
+		IndirectRenderer& operator=(IndirectRenderer const&) = delete;
+
+		/// <summary>
+		/// Drops the previous frame's draws, call before Add.
+		/// </summary>
+		void Clear() {
+			_draws.clear();
+			_data.clear();
+			_bounds.clear();
+		}
+
+		/// <summary>
+		/// Camera the draws are ordered by, opaque draws front to back within their group and transparent ones back to front.
+		/// Until it is set every draw has the same depth and draws keep the order they were added in.
+		/// </summary>
+		void Set_View(glm::mat4 const& view, float nearPlane, float farPlane) {
+			_view = view;
+			_nearPlane = nearPlane;
+			_farPlane = farPlane;
+		}
+
+		/// <summary>
+		/// Queues one mesh of an arena, the arena must be bound to key.vertexArray.
+		/// </summary>
+		void Add(GroupKey const& key, BufferArena::Range const& range, glm::mat4 const& world, uint32_t material, BatchLayer const& layer = BatchLayer()) {
+			Add(key, range, &world, 1, material, layer);
+		}
+
+		/// <summary>
+		/// Queues one instanced draw of a mesh, an instance for each world matrix. Nothing is queued for no instances.
+		/// </summary>
+		void Add(GroupKey const& key, BufferArena::Range const& range, glm::mat4 const* worlds, size_t instances, uint32_t material, BatchLayer const& layer = BatchLayer()) {
+			if (instances == 0) {
+				return;
+			}
+			Draw draw;
+			draw.key = key;
+			draw.command.count = GLuint(range.indexCount);
+			draw.command.instanceCount = GLuint(instances);
+			draw.command.firstIndex = range.firstIndex;
+			draw.command.baseVertex = range.baseVertex;
+			draw.command.baseInstance = 0;
+			draw.data = uint32_t(_data.size());
+			draw.distance = Distance(glm::vec3(worlds[0][3]));
+			for (size_t instance = 1; instance < instances; ++instance) {
+				draw.distance = std::min(draw.distance, Distance(glm::vec3(worlds[instance][3])));
+			}
+			_draws.emplace_back(draw);
+			DrawData data;
+			data.material = material;
+			data.layer = layer.layer;
+			data.padding[0] = data.padding[1] = 0;
+			data.uvTransform = layer.uvTransform;
+			for (size_t instance = 0; instance < instances; ++instance) {
+				data.world = worlds[instance];
+				_data.emplace_back(data);
+			}
+		}
+
+		/// <summary>
+		/// Queues a draw with its world space bounds, for culling on the GPU. Every draw of a frame needs bounds or none does.
+		/// Culled draws are single instances, the culler packs the visible ones itself.
+		/// </summary>
+		void Add(GroupKey const& key, BufferArena::Range const& range, glm::mat4 const& world, uint32_t material, AABB const& bounds, BatchLayer const& layer = BatchLayer()) {
+			Add(key, range, world, material, layer);
+			_draws.back().distance = Distance(bounds.Center());
+			_bounds.emplace_back(bounds);
+		}
+
+		/// <summary>
+		/// Orders the queued draws into the sorted arrays and Groups, they stay valid until the next Sort.
+		/// Keys are RenderQueue keys: the pass, then the program, vertex array and batch as their index among the frame's
+		/// names so GL names of any size fit, and the quantized depth. Groups are runs of draws with the same GroupKey.
+		/// </summary>
+		void Sort() {
+			if (!_bounds.empty() && _bounds.size() != _draws.size()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": " + std::to_string(_bounds.size()) + " of " + std::to_string(_draws.size()) + " draws have bounds.");
+			}
+			_programs.clear();
+			_vertexArrays.clear();
+			_batches.clear();
+			// Draws are mostly added in runs of the same state, repeats of the previous name are left out before sorting
+			for (Draw const& draw : _draws) {
+				if (_programs.empty() || _programs.back() != draw.key.program) {
+					_programs.push_back(draw.key.program);
+				}
+				if (_vertexArrays.empty() || _vertexArrays.back() != draw.key.vertexArray) {
+					_vertexArrays.push_back(draw.key.vertexArray);
+				}
+				if (_batches.empty() || _batches.back() != draw.key.batch) {
+					_batches.push_back(draw.key.batch);
+				}
+			}
+			Sort_Names(_programs);
+			Sort_Names(_vertexArrays);
+			Sort_Names(_batches);
+			_order.resize(_draws.size());
+			for (uint32_t index = 0; index < uint32_t(_order.size()); ++index) {
+				Draw const& draw = _draws[index];
+				RenderQueue::Fields fields;
+				fields.pass = draw.key.pass;
+				fields.program = Name_Index(_programs, draw.key.program);
+				fields.format = Name_Index(_vertexArrays, draw.key.vertexArray);
+				fields.material = Name_Index(_batches, draw.key.batch);
+				fields.depth = _farPlane > _nearPlane ? RenderQueue::Quantize_Depth(draw.distance, _nearPlane, _farPlane) : 0;
+				_order[index] = { RenderQueue::Make_Key(fields), index, 0 };
+			}
+			// Radix sort is stable so draws of the same key keep the order they were added in
+			RenderQueue::Radix_Sort(_order, _orderScratch);
+
+			_sortedCommands.resize(_order.size());
+			_sortedData.clear();
+			_sortedData.reserve(_data.size());
+			_sortedBounds.resize(_bounds.empty() ? 0 : _order.size());
+			_groups.clear();
+			for (size_t index = 0; index < _order.size(); ++index) {
+				Draw const& draw = _draws[_order[index].index];
+				_sortedCommands[index] = draw.command;
+				_sortedCommands[index].baseInstance = GLuint(_sortedData.size());
+				_sortedData.insert(_sortedData.end(), _data.begin() + draw.data, _data.begin() + draw.data + draw.command.instanceCount);
+				if (!_bounds.empty()) {
+					_sortedBounds[index] = _bounds[_order[index].index];
+				}
+				if (_groups.empty() || !(_groups.back().key == draw.key)) {
+					_groups.push_back({ draw.key, index, 0 });
+				}
+				++_groups.back().count;
+			}
+		}
+
+		/// <summary>
+		/// Binds the state of each group in turn, only what differs from the previous group, and calls draw for it.
+		/// </summary>
+		/// <param name="bindBatch">Called when the batch changes, after the group's program and vertex array are bound</param>
+		void Bind_Groups(std::function<void(uint32_t batch)> const& bindBatch, std::function<void(Group const& group)> const& draw) const {
+			for (size_t group = 0; group < _groups.size(); ++group) {
+				GroupKey const& key = _groups[group].key;
+				GroupKey const* bound = group > 0 ? &_groups[group - 1].key : nullptr;
+				if (bindPass && (!bound || key.pass != bound->pass)) {
+					bindPass(key.pass);
+				}
+				if (!bound || key.program != bound->program) {
+					glUseProgram(key.program);
+				}
+				if (!bound || key.vertexArray != bound->vertexArray) {
+					glBindVertexArray(key.vertexArray);
+				}
+				if (!bound || key.batch != bound->batch) {
+					bindBatch(key.batch);
+				}
+				draw(_groups[group]);
+			}
+		}
+
+		/// <summary>
+		/// Sorts the queued draws and issues one multi-draw per group, the Frame uniforms must already be bound.
+		/// </summary>
+		/// <param name="bindBatch">Called when the batch changes, after the group's program and vertex array are bound</param>
+		/// <returns>False when the draws do not fit in the ring's current region, nothing is drawn then</returns>
+		bool Submit(RingBuffer& frameData, std::function<void(uint32_t batch)> const& bindBatch) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (_draws.empty()) {
+				return true;
+			}
+			Sort();
+			RingBuffer::Allocation commands = frameData.Push(_sortedCommands, 16);
+			RingBuffer::Allocation data = frameData.Push(_sortedData, frameData.StorageAlignment());
+			if (!commands.Valid() || !data.Valid()) {
+				return false;
+			}
+
+			frameData.BindStorage(DRAW_DATA_BINDING, data);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, frameData.BufferId());
+			Bind_Groups(bindBatch, [&](Group const& group) {
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void const*>(commands.offset + GLintptr(group.first * sizeof(DrawElementsIndirectCommand))), GLsizei(group.count), 0);
+			});
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			statistics.groups += _groups.size();
+			statistics.draws += _sortedCommands.size();
+			statistics.instances += _sortedData.size();
+			statistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return true;
+		}
+
+		size_t Size() const {
+			return _draws.size();
+		}
+
+		std::vector<DrawElementsIndirectCommand> const& Sorted_Commands() const {
+			return _sortedCommands;
+		}
+
+		std::vector<DrawData> const& Sorted_Data() const {
+			return _sortedData;
+		}
+
+		std::vector<AABB> const& Sorted_Bounds() const {
+			return _sortedBounds;
+		}
+
+		std::vector<Group> const& Groups() const {
+			return _groups;
+		}
+	};
+}
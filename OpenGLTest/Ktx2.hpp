@@ -0,0 +1,724 @@
+#pragma once
+#include "GLTF.hpp"
+#include "BlockCompression.hpp"
+#include "MappedFile.hpp"
+#include "Mipmap.hpp"
+#include <stb_image.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// KTX 2.0 texture containers, every level is stored ready to upload so loading is reading and uploading
+namespace Ktx2 {
+	constexpr unsigned char IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	// Identifier, header and index up to the level index
+	constexpr size_t HEADER_BYTES = 80;
+	constexpr size_t LEVEL_INDEX_BYTES = 24;
+	constexpr char WRITER_KEY[] = "KTXwriter";
+	constexpr char WRITER[] = "OpenGLTest";
+	constexpr char ORIENTATION_KEY[] = "KTXorientation";
+	// Rows are stored top to bottom, as decoded images are
+	constexpr char ORIENTATION[] = "rd";
+	// Window searched for repeated bytes by the zlib supercompressor
+	constexpr size_t DEFLATE_WINDOW = 1 << 15;
+	// Earlier positions with the same hash tried per match
+	constexpr int DEFLATE_CHAIN = 32;
+
+	// The VkFormat values of the formats this renderer can upload
+	enum class VkFormat : uint32_t {
+		Undefined = 0,
+		R8_Unorm = 9,
+		R8G8_Unorm = 16,
+		R8G8B8A8_Unorm = 37,
+		R8G8B8A8_Srgb = 43,
+		BC1_RGB_Unorm = 131,
+		BC1_RGB_Srgb = 132,
+		BC3_Unorm = 137,
+		BC3_Srgb = 138,
+		BC4_Unorm = 139,
+		BC5_Unorm = 141,
+		BC7_Unorm = 145,
+		BC7_Srgb = 146
+	};
+
+	enum class Supercompression : uint32_t {
+		None = 0,
+		// Basis Universal, needs a transcoder
+		BasisLZ = 1,
+		Zstandard = 2,
+		Zlib = 3
+	};
+
+	inline bool Is_Srgb(VkFormat format) {
+		return format == VkFormat::R8G8B8A8_Srgb || format == VkFormat::BC1_RGB_Srgb || format == VkFormat::BC3_Srgb || format == VkFormat::BC7_Srgb;
+	}
+
+	/// <returns>False for uncompressed formats</returns>
+	inline bool Block_Format(VkFormat format, BlockCompression::Format& block) {
+		switch (format) {
+		case VkFormat::BC1_RGB_Unorm:
+		case VkFormat::BC1_RGB_Srgb:
+			block = BlockCompression::Format::BC1;
+			return true;
+		case VkFormat::BC3_Unorm:
+		case VkFormat::BC3_Srgb:
+			block = BlockCompression::Format::BC3;
+			return true;
+		case VkFormat::BC4_Unorm:
+			block = BlockCompression::Format::BC4;
+			return true;
+		case VkFormat::BC5_Unorm:
+			block = BlockCompression::Format::BC5;
+			return true;
+		case VkFormat::BC7_Unorm:
+		case VkFormat::BC7_Srgb:
+			block = BlockCompression::Format::BC7;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/// <summary>
+	/// Channels of an uncompressed format, 0 for block formats and formats that are not supported.
+	/// </summary>
+	inline int Raw_Channels(VkFormat format) {
+		switch (format) {
+		case VkFormat::R8_Unorm:
+			return 1;
+		case VkFormat::R8G8_Unorm:
+			return 2;
+		case VkFormat::R8G8B8A8_Unorm:
+		case VkFormat::R8G8B8A8_Srgb:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	inline VkFormat Block_Vk_Format(BlockCompression::Format format, bool srgb) {
+		switch (format) {
+		case BlockCompression::Format::BC1:
+			return srgb ? VkFormat::BC1_RGB_Srgb : VkFormat::BC1_RGB_Unorm;
+		case BlockCompression::Format::BC3:
+			return srgb ? VkFormat::BC3_Srgb : VkFormat::BC3_Unorm;
+		case BlockCompression::Format::BC4:
+			return VkFormat::BC4_Unorm;
+		case BlockCompression::Format::BC5:
+			return VkFormat::BC5_Unorm;
+		case BlockCompression::Format::BC7:
+			return srgb ? VkFormat::BC7_Srgb : VkFormat::BC7_Unorm;
+		}
+		return VkFormat::Undefined;
+	}
+
+	/// <summary>
+	/// One and two channel images have no sRGB format that OpenGL can upload, they are stored as UNORM.
+	/// </summary>
+	inline VkFormat Raw_Vk_Format(int channels, bool srgb) {
+		switch (channels) {
+		case 1:
+			return VkFormat::R8_Unorm;
+		case 2:
+			return VkFormat::R8G8_Unorm;
+		case 4:
+			return srgb ? VkFormat::R8G8B8A8_Srgb : VkFormat::R8G8B8A8_Unorm;
+		default:
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": no KTX2 format for " + std::to_string(channels) + " channels.");
+		}
+	}
+
+	/// <summary>
+	/// Bytes of a block, or of a pixel for uncompressed formats.
+	/// </summary>
+	inline size_t Texel_Block_Bytes(VkFormat format) {
+		BlockCompression::Format block;
+		return Block_Format(format, block) ? BlockCompression::Block_Bytes(block) : size_t(Raw_Channels(format));
+	}
+
+	inline size_t Level_Bytes(VkFormat format, int width, int height) {
+		BlockCompression::Format block;
+		if (Block_Format(format, block)) {
+			return BlockCompression::Level_Bytes(block, width, height);
+		}
+		return size_t(width) * size_t(height) * size_t(Raw_Channels(format));
+	}
+
+	/// <summary>
+	/// A texture with every level ready to upload, level 0 first.
+	/// </summary>
+	struct Image {
+		VkFormat format = VkFormat::Undefined;
+		int width = 0;
+		int height = 0;
+		std::vector<std::vector<unsigned char>> levels;
+
+		Image() = default;
+		Image(Image const&) = default;
+		Image(Image&&) = default;
+
+		Image& operator=(Image const&) = default;
+		Image& operator=(Image&&) = default;
+	};
+
+	inline void Put_16(std::vector<unsigned char>& output, uint32_t value) {
+		output.push_back((unsigned char)(value & 0xFF));
+		output.push_back((unsigned char)((value >> 8) & 0xFF));
+	}
+
+	inline void Put_32(std::vector<unsigned char>& output, uint32_t value) {
+		Put_16(output, value & 0xFFFF);
+		Put_16(output, value >> 16);
+	}
+
+	inline void Put_64(std::vector<unsigned char>& output, uint64_t value) {
+		Put_32(output, uint32_t(value & 0xFFFFFFFF));
+		Put_32(output, uint32_t(value >> 32));
+	}
+
+	inline void Set_32(std::vector<unsigned char>& output, size_t offset, uint32_t value) {
+		for (int byte = 0; byte < 4; ++byte) {
+			output[offset + byte] = (unsigned char)((value >> (byte * 8)) & 0xFF);
+		}
+	}
+
+	inline void Set_64(std::vector<unsigned char>& output, size_t offset, uint64_t value) {
+		Set_32(output, offset, uint32_t(value & 0xFFFFFFFF));
+		Set_32(output, offset + 4, uint32_t(value >> 32));
+	}
+
+	inline uint32_t Get_32(unsigned char const* data) {
+		return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+	}
+
+	inline uint64_t Get_64(unsigned char const* data) {
+		return uint64_t(Get_32(data)) | uint64_t(Get_32(data + 4)) << 32;
+	}
+
+	inline void Pad(std::vector<unsigned char>& output, size_t alignment) {
+		while (output.size() % alignment != 0) {
+			output.push_back(0);
+		}
+	}
+
+	/// <summary>
+	/// Basic data format descriptor block for a format, the DFD every KTX2 file carries.
+	/// Supercompressed files leave bytesPlane0 unsized as the spec requires.
+	/// </summary>
+	inline std::vector<unsigned char> Data_Format_Descriptor(VkFormat format, bool supercompressed) {
+		// Khronos data format model, channel ids and qualifiers
+		constexpr unsigned char MODEL_RGBSDA = 1;
+		constexpr unsigned char MODEL_BC1A = 128;
+		constexpr unsigned char MODEL_BC3 = 130;
+		constexpr unsigned char MODEL_BC4 = 131;
+		constexpr unsigned char MODEL_BC5 = 132;
+		constexpr unsigned char MODEL_BC7 = 134;
+		constexpr unsigned char PRIMARIES_BT709 = 1;
+		constexpr unsigned char TRANSFER_LINEAR = 1;
+		constexpr unsigned char TRANSFER_SRGB = 2;
+		constexpr unsigned char CHANNEL_ALPHA = 15;
+		constexpr unsigned char QUALIFIER_LINEAR = 0x10;
+
+		struct Sample {
+			uint32_t bitOffset;
+			uint32_t bitLength;
+			unsigned char channel;
+			uint32_t upper;
+		};
+		std::vector<Sample> samples;
+		unsigned char model = MODEL_RGBSDA;
+		unsigned char blockDimension = 0;
+		bool srgb = Is_Srgb(format);
+		BlockCompression::Format block;
+		if (Block_Format(format, block)) {
+			blockDimension = BlockCompression::BLOCK_SIZE - 1;
+			switch (block) {
+			case BlockCompression::Format::BC1:
+				model = MODEL_BC1A;
+				samples = { { 0, 64, 0, 0xFFFFFFFF } };
+				break;
+			case BlockCompression::Format::BC3:
+				model = MODEL_BC3;
+				samples = { { 0, 64, CHANNEL_ALPHA, 0xFFFFFFFF }, { 64, 64, 0, 0xFFFFFFFF } };
+				break;
+			case BlockCompression::Format::BC4:
+				model = MODEL_BC4;
+				samples = { { 0, 64, 0, 0xFFFFFFFF } };
+				break;
+			case BlockCompression::Format::BC5:
+				model = MODEL_BC5;
+				samples = { { 0, 64, 0, 0xFFFFFFFF }, { 64, 64, 1, 0xFFFFFFFF } };
+				break;
+			case BlockCompression::Format::BC7:
+				model = MODEL_BC7;
+				samples = { { 0, 128, 0, 0xFFFFFFFF } };
+				break;
+			}
+		}
+		else {
+			int channels = Raw_Channels(format);
+			for (int channel = 0; channel < channels; ++channel) {
+				samples.push_back({ uint32_t(channel * 8), 8, (unsigned char)(channel == 3 ? CHANNEL_ALPHA : channel), 255 });
+			}
+		}
+
+		std::vector<unsigned char> descriptor;
+		uint32_t blockSize = 24 + 16 * uint32_t(samples.size());
+		Put_32(descriptor, 4 + blockSize);
+		// Khronos vendor id and basic descriptor type
+		Put_32(descriptor, 0);
+		Put_16(descriptor, 2);
+		Put_16(descriptor, blockSize);
+		descriptor.push_back(model);
+		descriptor.push_back(PRIMARIES_BT709);
+		descriptor.push_back(srgb ? TRANSFER_SRGB : TRANSFER_LINEAR);
+		// Alpha is straight
+		descriptor.push_back(0);
+		for (int dimension = 0; dimension < 4; ++dimension) {
+			descriptor.push_back(dimension < 2 ? blockDimension : 0);
+		}
+		for (int plane = 0; plane < 8; ++plane) {
+			descriptor.push_back(plane == 0 && !supercompressed ? (unsigned char)Texel_Block_Bytes(format) : 0);
+		}
+		for (Sample const& sample : samples) {
+			unsigned char channelType = sample.channel;
+			// Alpha is never sRGB encoded
+			if (srgb && sample.channel == CHANNEL_ALPHA) {
+				channelType |= QUALIFIER_LINEAR;
+			}
+			Put_16(descriptor, sample.bitOffset);
+			descriptor.push_back((unsigned char)(sample.bitLength - 1));
+			descriptor.push_back(channelType);
+			Put_32(descriptor, 0);
+			Put_32(descriptor, 0);
+			Put_32(descriptor, sample.upper);
+		}
+		return descriptor;
+	}
+
+	inline uint32_t Adler_32(unsigned char const* data, size_t size) {
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (size > 0) {
+			// Largest run before b can overflow
+			size_t run = std::min(size, size_t(5552));
+			for (size_t index = 0; index < run; ++index) {
+				a += data[index];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += run;
+			size -= run;
+		}
+		return (b << 16) | a;
+	}
+
+	/// <summary>
+	/// zlib stream of one deflate block with the fixed Huffman codes and hash chain matching, enough to shrink the runs in block compressed data.
+	/// Falls back to stored blocks when that would be larger.
+	/// </summary>
+	inline std::vector<unsigned char> Zlib_Compress(unsigned char const* data, size_t size) {
+		static constexpr int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		constexpr int MINIMUM_MATCH = 3;
+		constexpr int MAXIMUM_MATCH = 258;
+		constexpr size_t HASH_SIZE = 1 << 15;
+
+		std::vector<unsigned char> output = { 0x78, 0x01 };
+		uint32_t bitBuffer = 0;
+		int bitCount = 0;
+		auto bits = [&](uint32_t value, int count) {
+			bitBuffer |= value << bitCount;
+			bitCount += count;
+			while (bitCount >= 8) {
+				output.push_back((unsigned char)(bitBuffer & 0xFF));
+				bitBuffer >>= 8;
+				bitCount -= 8;
+			}
+		};
+		// Huffman codes are sent most significant bit first
+		auto code = [&](uint32_t value, int length) {
+			uint32_t reversed = 0;
+			for (int bit = 0; bit < length; ++bit) {
+				reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+			}
+			bits(reversed, length);
+		};
+		auto literal = [&](int symbol) {
+			if (symbol < 144) {
+				code(0x30 + symbol, 8);
+			}
+			else if (symbol < 256) {
+				code(0x190 + symbol - 144, 9);
+			}
+			else if (symbol < 280) {
+				code(symbol - 256, 7);
+			}
+			else {
+				code(0xC0 + symbol - 280, 8);
+			}
+		};
+		auto hash = [&](size_t position) {
+			return ((uint32_t(data[position]) << 10) ^ (uint32_t(data[position + 1]) << 5) ^ data[position + 2]) & (HASH_SIZE - 1);
+		};
+
+		// Final block with fixed codes
+		bits(1, 1);
+		bits(1, 2);
+		std::vector<int64_t> head(HASH_SIZE, -1);
+		std::vector<int64_t> previous(DEFLATE_WINDOW, -1);
+		auto insert = [&](size_t position) {
+			if (position + MINIMUM_MATCH <= size) {
+				uint32_t key = hash(position);
+				previous[position % DEFLATE_WINDOW] = head[key];
+				head[key] = int64_t(position);
+			}
+		};
+		size_t position = 0;
+		while (position < size) {
+			int bestLength = 0;
+			size_t bestDistance = 0;
+			if (position + MINIMUM_MATCH <= size) {
+				int limit = int(std::min(size - position, size_t(MAXIMUM_MATCH)));
+				int64_t candidate = head[hash(position)];
+				for (int chain = 0; chain < DEFLATE_CHAIN && candidate >= 0 && position - size_t(candidate) <= DEFLATE_WINDOW; ++chain) {
+					int length = 0;
+					while (length < limit && data[size_t(candidate) + length] == data[position + length]) {
+						++length;
+					}
+					if (length > bestLength) {
+						bestLength = length;
+						bestDistance = position - size_t(candidate);
+						if (length == limit) {
+							break;
+						}
+					}
+					candidate = previous[size_t(candidate) % DEFLATE_WINDOW];
+				}
+			}
+			if (bestLength >= MINIMUM_MATCH) {
+				int lengthCode = 28;
+				while (LENGTH_BASE[lengthCode] > bestLength) {
+					--lengthCode;
+				}
+				literal(257 + lengthCode);
+				bits(uint32_t(bestLength - LENGTH_BASE[lengthCode]), LENGTH_EXTRA[lengthCode]);
+				int distanceCode = 29;
+				while (DISTANCE_BASE[distanceCode] > int(bestDistance)) {
+					--distanceCode;
+				}
+				code(uint32_t(distanceCode), 5);
+				bits(uint32_t(bestDistance) - uint32_t(DISTANCE_BASE[distanceCode]), DISTANCE_EXTRA[distanceCode]);
+				for (int index = 0; index < bestLength; ++index) {
+					insert(position + index);
+				}
+				position += size_t(bestLength);
+			}
+			else {
+				literal(data[position]);
+				insert(position);
+				++position;
+			}
+		}
+		literal(256);
+		if (bitCount > 0) {
+			output.push_back((unsigned char)(bitBuffer & 0xFF));
+		}
+		// Data that does not repeat grows under the fixed codes, stored blocks only add their 5 byte headers
+		constexpr size_t STORED_BLOCK = 65535;
+		size_t storedSize = 2 + size + 5 * std::max((size + STORED_BLOCK - 1) / STORED_BLOCK, size_t(1));
+		if (output.size() > storedSize) {
+			output.resize(2);
+			size_t offset = 0;
+			do {
+				size_t length = std::min(size - offset, STORED_BLOCK);
+				output.push_back(offset + length == size ? 1 : 0);
+				Put_16(output, uint32_t(length));
+				Put_16(output, uint32_t(~length & 0xFFFF));
+				output.insert(output.end(), data + offset, data + offset + length);
+				offset += length;
+			} while (offset < size);
+		}
+		uint32_t checksum = Adler_32(data, size);
+		for (int byte = 3; byte >= 0; --byte) {
+			output.push_back((unsigned char)((checksum >> (byte * 8)) & 0xFF));
+		}
+		return output;
+	}
+
+	inline std::vector<unsigned char> Zlib_Decompress(unsigned char const* data, size_t size, size_t decompressedSize) {
+		std::vector<unsigned char> output(decompressedSize);
+		int written = stbi_zlib_decode_buffer(reinterpret_cast<char*>(output.data()), int(output.size()), reinterpret_cast<char const*>(data), int(size));
+		if (written < 0 || size_t(written) != decompressedSize) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": zlib level data is corrupt or the wrong size.");
+		}
+		return output;
+	}
+
+	inline void Put_Key_Value(std::vector<unsigned char>& output, char const* key, char const* value) {
+		size_t keyLength = std::strlen(key) + 1;
+		size_t valueLength = std::strlen(value) + 1;
+		Put_32(output, uint32_t(keyLength + valueLength));
+		output.insert(output.end(), key, key + keyLength);
+		output.insert(output.end(), value, value + valueLength);
+		Pad(output, 4);
+	}
+
+	/// <summary>
+	/// Serializes an image as a KTX2 file, levels are stored smallest first as the spec requires.
+	/// </summary>
+	/// <param name="scheme">None or Zlib, zlib trades load time for size</param>
+	inline std::vector<unsigned char> Serialize(Image const& image, Supercompression scheme = Supercompression::None) {
+		if (scheme != Supercompression::None && scheme != Supercompression::Zlib) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": only zlib supercompression can be written.");
+		}
+		if (image.levels.empty() || image.width <= 0 || image.height <= 0) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": image has no levels.");
+		}
+		for (size_t level = 0; level < image.levels.size(); ++level) {
+			if (image.levels[level].size() != Level_Bytes(image.format, Mipmap::Level_Size(image.width, int(level)), Mipmap::Level_Size(image.height, int(level)))) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": level " + std::to_string(level) + " is the wrong size for its format.");
+			}
+		}
+		bool supercompressed = scheme != Supercompression::None;
+
+		std::vector<unsigned char> output(IDENTIFIER, IDENTIFIER + sizeof(IDENTIFIER));
+		Put_32(output, uint32_t(image.format));
+		// typeSize, 1 for block and 8 bit formats
+		Put_32(output, 1);
+		Put_32(output, uint32_t(image.width));
+		Put_32(output, uint32_t(image.height));
+		// pixelDepth, layerCount, faceCount
+		Put_32(output, 0);
+		Put_32(output, 0);
+		Put_32(output, 1);
+		Put_32(output, uint32_t(image.levels.size()));
+		Put_32(output, uint32_t(scheme));
+		size_t indexOffset = output.size();
+		output.resize(HEADER_BYTES + LEVEL_INDEX_BYTES * image.levels.size(), 0);
+
+		std::vector<unsigned char> descriptor = Data_Format_Descriptor(image.format, supercompressed);
+		size_t descriptorOffset = output.size();
+		output.insert(output.end(), descriptor.begin(), descriptor.end());
+
+		size_t keyValueOffset = output.size();
+		Put_Key_Value(output, ORIENTATION_KEY, ORIENTATION);
+		Put_Key_Value(output, WRITER_KEY, WRITER);
+		size_t keyValueLength = output.size() - keyValueOffset;
+
+		Set_32(output, indexOffset, uint32_t(descriptorOffset));
+		Set_32(output, indexOffset + 4, uint32_t(descriptor.size()));
+		Set_32(output, indexOffset + 8, uint32_t(keyValueOffset));
+		Set_32(output, indexOffset + 12, uint32_t(keyValueLength));
+		// No supercompression global data
+		Set_64(output, indexOffset + 16, 0);
+		Set_64(output, indexOffset + 24, 0);
+
+		// Uncompressed levels start on a multiple of the block size and of 4
+		size_t alignment = supercompressed ? 1 : std::max(Texel_Block_Bytes(image.format), size_t(4));
+		if (alignment % 4 != 0) {
+			alignment *= 4;
+		}
+		for (size_t level = image.levels.size(); level-- > 0;) {
+			std::vector<unsigned char> const& source = image.levels[level];
+			std::vector<unsigned char> packed = supercompressed ? Zlib_Compress(source.data(), source.size()) : std::vector<unsigned char>();
+			std::vector<unsigned char> const& stored = supercompressed ? packed : source;
+			Pad(output, alignment);
+			size_t entry = HEADER_BYTES + LEVEL_INDEX_BYTES * level;
+			Set_64(output, entry, output.size());
+			Set_64(output, entry + 8, stored.size());
+			Set_64(output, entry + 16, source.size());
+			output.insert(output.end(), stored.begin(), stored.end());
+		}
+		return output;
+	}
+
+	inline void Write_File(std::filesystem::path const& path, Image const& image, Supercompression scheme = Supercompression::None) {
+		std::vector<unsigned char> data = Serialize(image, scheme);
+		std::ofstream file(path, std::ofstream::binary | std::ofstream::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to open file '" + path.string() + "' for writing.");
+		}
+		file.write(reinterpret_cast<char const*>(data.data()), std::streamsize(data.size()));
+		if (!file) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to write file '" + path.string() + "'.");
+		}
+	}
+
+	inline bool Is_Ktx2(unsigned char const* data, size_t size) {
+		return size >= sizeof(IDENTIFIER) && std::memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) == 0;
+	}
+
+	/// <summary>
+	/// A parsed KTX2 file, mapped from disk or held in memory. Levels that are not supercompressed are read in place.
+	/// Only 2D textures in the formats of VkFormat with no or zlib supercompression are accepted.
+	/// </summary>
+	class File {
+		struct Level {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		std::shared_ptr<MappedFile> _mapped;
+		std::vector<unsigned char> _owned;
+		unsigned char const* _data = nullptr;
+		size_t _size = 0;
+		VkFormat _format = VkFormat::Undefined;
+		Supercompression _scheme = Supercompression::None;
+		int _width = 0;
+		int _height = 0;
+		bool _generateMipmaps = false;
+		std::vector<Level> _levels;
+
+		void Parse() {
+			if (!Is_Ktx2(_data, _size) || _size < HEADER_BYTES) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": not a KTX2 file.");
+			}
+			unsigned char const* header = _data + sizeof(IDENTIFIER);
+			_format = VkFormat(Get_32(header));
+			_width = int(Get_32(header + 8));
+			_height = int(Get_32(header + 12));
+			uint32_t depth = Get_32(header + 16);
+			uint32_t layers = Get_32(header + 20);
+			uint32_t faces = Get_32(header + 24);
+			// Zero asks the loader to generate mipmaps, the one level is still stored
+			_generateMipmaps = Get_32(header + 28) == 0;
+			uint32_t levelCount = std::max(Get_32(header + 28), 1u);
+			_scheme = Supercompression(Get_32(header + 32));
+
+			BlockCompression::Format block;
+			if (_format == VkFormat::Undefined) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": Basis Universal textures need transcoding, which is not supported.");
+			}
+			if (!Block_Format(_format, block) && Raw_Channels(_format) == 0) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": VkFormat " + std::to_string(uint32_t(_format)) + " is not supported.");
+			}
+			if (_scheme != Supercompression::None && _scheme != Supercompression::Zlib) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": supercompression scheme " + std::to_string(uint32_t(_scheme)) + " is not supported.");
+			}
+			if (_width <= 0 || _height <= 0 || depth > 1 || layers > 1 || faces != 1) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": only 2D textures without layers or faces are supported.");
+			}
+			// Level sizes shift the dimensions by the level, past the 1x1 level the shift would be out of range
+			if (levelCount > uint32_t(Mipmap::Level_Count(_width, _height))) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": " + std::to_string(levelCount) + " levels is more than a " + std::to_string(_width) + "x" + std::to_string(_height) + " texture has.");
+			}
+			if (HEADER_BYTES + LEVEL_INDEX_BYTES * size_t(levelCount) > _size) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": level index is outside of the file.");
+			}
+			for (uint32_t level = 0; level < levelCount; ++level) {
+				unsigned char const* entry = _data + HEADER_BYTES + LEVEL_INDEX_BYTES * level;
+				Level parsed = { Get_64(entry), Get_64(entry + 8), Get_64(entry + 16) };
+				size_t expected = Level_Bytes(_format, Mipmap::Level_Size(_width, int(level)), Mipmap::Level_Size(_height, int(level)));
+				if (parsed.byteOffset > _size || parsed.byteLength > _size - parsed.byteOffset || parsed.uncompressedByteLength != expected ||
+					(_scheme == Supercompression::None && parsed.byteLength != expected)) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": level " + std::to_string(level) + " is outside of the file or the wrong size.");
+				}
+				_levels.push_back(parsed);
+			}
+		}
+
+	public:
+		/// <summary>
+		/// Maps the file, levels are only read from disk when they are used.
+		/// </summary>
+		File(std::filesystem::path const& path) : _mapped(std::make_shared<MappedFile>(path)) {
+			_data = _mapped->Data();
+			_size = _mapped->Size();
+			Parse();
+		}
+
+		File(std::vector<unsigned char> data) : _owned(std::move(data)) {
+			_data = _owned.data();
+			_size = _owned.size();
+			Parse();
+		}
+
+		File(File const&) = delete;
+		File& operator=(File const&) = delete;
+
+		VkFormat Format() const {
+			return _format;
+		}
+
+		Supercompression Scheme() const {
+			return _scheme;
+		}
+
+		int Width() const {
+			return _width;
+		}
+
+		int Height() const {
+			return _height;
+		}
+
+		int Level_Count() const {
+			return int(_levels.size());
+		}
+
+		/// <summary>
+		/// Only level 0 is stored and the loader is asked to build the rest.
+		/// </summary>
+		bool Generate_Mipmaps() const {
+			return _generateMipmaps;
+		}
+
+		/// <summary>
+		/// Stored bytes of a level, in place in the mapping. Only upload ready when Scheme is None.
+		/// </summary>
+		std::pair<unsigned char const*, size_t> Level_View(int level) const {
+			Level const& entry = _levels.at(size_t(level));
+			return { _data + entry.byteOffset, size_t(entry.byteLength) };
+		}
+
+		/// <summary>
+		/// Upload ready bytes of a level, supercompressed levels are inflated.
+		/// </summary>
+		std::vector<unsigned char> Level_Data(int level) const {
+			std::pair<unsigned char const*, size_t> view = Level_View(level);
+			if (_scheme == Supercompression::Zlib) {
+				return Zlib_Decompress(view.first, view.second, size_t(_levels[size_t(level)].uncompressedByteLength));
+			}
+			return std::vector<unsigned char>(view.first, view.first + view.second);
+		}
+
+		Image To_Image() const {
+			Image image;
+			image.format = _format;
+			image.width = _width;
+			image.height = _height;
+			for (int level = 0; level < Level_Count(); ++level) {
+				image.levels.emplace_back(Level_Data(level));
+			}
+			return image;
+		}
+	};
+}
+
+namespace GLTF {
+	/// <summary>
+	/// Validator handler for KHR_texture_basisu, the KTX2 source of a texture.
+	/// KTX2 images in the formats of Ktx2::VkFormat load directly, Basis Universal payloads are reported when they are read.
+	/// </summary>
+	inline void Validate_Texture_Basisu(Validator& validator, type_json_object const& extension) {
+		if (std::find(validator.nameBreadCrumbs.cbegin(), validator.nameBreadCrumbs.cend(), Constants::TEXTURES) == validator.nameBreadCrumbs.cend()) {
+			validator.errors.push_back(Validator::GLTFError(extension, extension, validator.ErrorMessageStart(FILE_FUNCTION_LINE) + " " + Constants::KHR_TEXTURE_BASISU + " is only valid on textures."));
+			return;
+		}
+		validator.Index(FILE_FUNCTION_LINE, extension, Constants::SOURCE, Constants::IMAGES, true);
+	}
+}
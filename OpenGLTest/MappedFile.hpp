@@ -0,0 +1,110 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <stdexcept>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+/// <summary>
+/// Read only view of a whole file, pages are read by the OS as they are touched instead of copied up front.
+/// </summary>
+class MappedFile {
+	unsigned char const* _data = nullptr;
+	size_t _size = 0;
+#if defined(_WIN32)
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = nullptr;
+#else
+	int _file = -1;
+#endif
+
+	void Close() {
+#if defined(_WIN32)
+		if (_data) {
+			UnmapViewOfFile(_data);
+		}
+		if (_mapping) {
+			CloseHandle(_mapping);
+		}
+		if (_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(_file);
+		}
+		_file = INVALID_HANDLE_VALUE;
+		_mapping = nullptr;
+#else
+		if (_data) {
+			munmap(const_cast<unsigned char*>(_data), _size);
+		}
+		if (_file >= 0) {
+			close(_file);
+		}
+		_file = -1;
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+
+public:
+	MappedFile(std::filesystem::path const& path) {
+#if defined(_WIN32)
+		_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size)) {
+			Close();
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to open file '" + path.string() + "'.");
+		}
+		_size = size_t(size.QuadPart);
+		if (_size > 0) {
+			_mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			_data = _mapping ? static_cast<unsigned char const*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+			if (!_data) {
+				Close();
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to map file '" + path.string() + "'.");
+			}
+		}
+#else
+		_file = open(path.c_str(), O_RDONLY);
+		struct stat status;
+		if (_file < 0 || fstat(_file, &status) != 0) {
+			Close();
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to open file '" + path.string() + "'.");
+		}
+		_size = size_t(status.st_size);
+		if (_size > 0) {
+			void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+			if (mapped == MAP_FAILED) {
+				_size = 0;
+				Close();
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to map file '" + path.string() + "'.");
+			}
+			_data = static_cast<unsigned char const*>(mapped);
+		}
+#endif
+	}
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	~MappedFile() {
+		Close();
+	}
+
+	unsigned char const* Data() const {
+		return _data;
+	}
+
+	size_t Size() const {
+		return _size;
+	}
+};
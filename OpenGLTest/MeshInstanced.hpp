@@ -0,0 +1,172 @@
+#pragma once
+#include "BufferArena.hpp"
+#include "BufferFormat.hpp"
+#include "BufferVertex.hpp"
+#include "Graphics.hpp"
+#include "VertexArray.hpp"
+#include <GLAD\gl.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+namespace Mesh {
+	/// <summary>
+	/// Placement of one copy of an instanced mesh, read once per instance by instanced_vertex.glsl.
+	/// The vertex is scaled, rotated by the quaternion and then moved, as vertex.glsl does with QuaternionRotate.
+	/// </summary>
+	struct InstanceData {
+		Quaternion orientation;
+		Vector3 position;
+		float scale;
+
+		static void Describe(BufferFormat& format) {
+			Quaternion::Describe(format);
+			Vector3::Describe(format);
+			format.AddFloat(1);
+		}
+	};
+
+	/// <summary>
+	/// Per instance attributes of a mesh drawn many times with one instanced draw. The instances are kept on the CPU,
+	/// changes mark a dirty range and Upload writes that range in one call, so many edits in a frame cost one upload.
+	/// The buffer is bound with divisor 1 to a binding of a VAO created with the mesh format followed by Format().
+	/// </summary>
+	class MeshInstanced {
+		std::shared_ptr<BufferVertex> _buffer;
+		std::vector<InstanceData> _instances;
+		// Instances changed since the last Upload
+		size_t _dirtyBegin = 0;
+		size_t _dirtyEnd = 0;
+
+		void Mark(size_t index) {
+			if (_dirtyBegin == _dirtyEnd) {
+				_dirtyBegin = index;
+				_dirtyEnd = index + 1;
+			}
+			else {
+				_dirtyBegin = std::min(_dirtyBegin, index);
+				_dirtyEnd = std::max(_dirtyEnd, index + 1);
+			}
+		}
+
+	public:
+		/// <param name="capacity">Instances before the buffer first grows</param>
+		MeshInstanced(size_t capacity = 64) : _buffer(std::make_shared<BufferVertex>(GLsizeiptr(std::max<size_t>(capacity, 1) * sizeof(InstanceData)), Format(), MutableBufferT(), 1)) {
+
+		}
+
+		MeshInstanced(MeshInstanced const&) = delete;
+		MeshInstanced& operator=(MeshInstanced const&) = delete;
+
+		/// <summary>
+		/// Layout of InstanceData, one format is shared by every instanced mesh so VAOs can swap their buffers.
+		/// </summary>
+		static std::shared_ptr<BufferFormat> const& Format() {
+			static std::shared_ptr<BufferFormat> format = [] {
+				std::shared_ptr<BufferFormat> described = std::make_shared<BufferFormat>(alignof(InstanceData));
+				InstanceData::Describe(*described);
+				return described;
+			}();
+			return format;
+		}
+
+		/// <returns>Index of the new instance</returns>
+		size_t Add(InstanceData const& instance) {
+			_instances.emplace_back(instance);
+			Mark(_instances.size() - 1);
+			return _instances.size() - 1;
+		}
+
+		void Set(size_t index, InstanceData const& instance) {
+			_instances.at(index) = instance;
+			Mark(index);
+		}
+
+		/// <summary>
+		/// Removes an instance by moving the last one into its place.
+		/// </summary>
+		/// <returns>Former index of the instance now at index, the removed index when it was last</returns>
+		size_t Remove(size_t index) {
+			if (index >= _instances.size()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": " + std::to_string(index) + " is not an instance.");
+			}
+			size_t last = _instances.size() - 1;
+			if (index != last) {
+				_instances[index] = _instances[last];
+				Mark(index);
+			}
+			_instances.pop_back();
+			if (_dirtyEnd > _instances.size()) {
+				_dirtyEnd = std::max(_dirtyBegin, _instances.size());
+			}
+			return last;
+		}
+
+		void Clear() {
+			_instances.clear();
+			_dirtyBegin = _dirtyEnd = 0;
+		}
+
+		InstanceData const& Get(size_t index) const {
+			return _instances.at(index);
+		}
+
+		size_t Size() const {
+			return _instances.size();
+		}
+
+		/// <summary>
+		/// Writes the instances changed since the last call, growing the buffer when they no longer fit.
+		/// </summary>
+		void Upload() {
+			GLsizeiptr needed = GLsizeiptr(_instances.size() * sizeof(InstanceData));
+			if (needed > _buffer->Size()) {
+				GLsizeiptr size = std::max<GLsizeiptr>(_buffer->Size(), GLsizeiptr(sizeof(InstanceData)));
+				while (size < needed) {
+					size *= 2;
+				}
+				_buffer->Reserve(size);
+			}
+			if (_dirtyBegin < _dirtyEnd) {
+				glNamedBufferSubData(_buffer->BufferId(), GLintptr(_dirtyBegin * sizeof(InstanceData)), GLsizeiptr((_dirtyEnd - _dirtyBegin) * sizeof(InstanceData)), _instances.data() + _dirtyBegin);
+			}
+			_dirtyBegin = _dirtyEnd = 0;
+		}
+
+		/// <summary>
+		/// Points a VAO binding at the instance buffer, the binding must have been made from Format().
+		/// </summary>
+		bool Bind(VertexArray& vertexArray, GLuint binding) const {
+			return vertexArray.SetBuffer(_buffer, binding);
+		}
+
+		/// <summary>
+		/// Draws count instances from first with one call, the VAO holding the mesh and Bind's binding must be bound.
+		/// Instance attributes are read from first on through baseInstance.
+		/// </summary>
+		void Draw(GLsizei indexCount, GLuint firstIndex = 0, GLint baseVertex = 0, GLuint first = 0, GLsizei count = -1) const {
+			if (count < 0) {
+				count = GLsizei(_instances.size()) - GLsizei(first);
+			}
+			if (count <= 0 || indexCount <= 0) {
+				return;
+			}
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, reinterpret_cast<void const*>(GLintptr(firstIndex) * GLintptr(sizeof(unsigned int))), count, baseVertex, first);
+		}
+
+		/// <summary>
+		/// Draws every instance of an arena mesh, the arena and the instance buffer must share the bound VAO.
+		/// </summary>
+		void Draw(BufferArena::Range const& mesh) const {
+			Draw(mesh.indexCount, mesh.firstIndex, mesh.baseVertex);
+		}
+
+		std::shared_ptr<BufferVertex> const& InstanceBuffer() const {
+			return _buffer;
+		}
+	};
+}
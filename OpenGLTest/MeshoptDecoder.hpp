@@ -0,0 +1,1004 @@
+#pragma once
+#include "Simd.hpp"
+#include "GLTF.hpp"
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Decoder for the EXT_meshopt_compression glTF extension
+// Bitstream versions: attributes 0, triangles 1, indices 1
+namespace Meshopt {
+	enum class Mode : unsigned char {
+		Attributes,
+		Triangles,
+		Indices
+	};
+
+	enum class Filter : unsigned char {
+		None,
+		Octahedral,
+		Quaternion,
+		Exponential
+	};
+
+	namespace Constants {
+		constexpr static unsigned char VERTEX_HEADER = 0xa0;
+		constexpr static unsigned char INDEX_HEADER = 0xe0;
+		constexpr static unsigned char SEQUENCE_HEADER = 0xd0;
+
+		constexpr static size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+		constexpr static size_t VERTEX_BLOCK_MAX_SIZE = 256;
+		constexpr static size_t BYTE_GROUP_SIZE = 16;
+		// Largest encoded byte group, 8 bytes of 4-bit selectors + 16 escaped bytes
+		constexpr static size_t BYTE_GROUP_DECODE_LIMIT = 24;
+		constexpr static size_t TAIL_MAX_SIZE = 32;
+		// Triangle codec stores its codeaux table in the last 16 bytes of the stream, it doubles as read padding
+		constexpr static size_t INDEX_TAIL_SIZE = 16;
+		constexpr static size_t SEQUENCE_TAIL_SIZE = 4;
+
+		// Vertex fifo indices at or above this value encode 'last-1', 'last+1' and 'free index'
+		constexpr static int EDGE_FIFO_CACHE_LIMIT = 13;
+	}
+
+	/// <summary>
+	/// Number of vertices encoded in a single block, each block is a multiple of BYTE_GROUP_SIZE.
+	/// </summary>
+	inline size_t Vertex_Block_Size(size_t vertexSize) {
+		size_t result = Constants::VERTEX_BLOCK_SIZE_BYTES / vertexSize;
+		result &= ~(Constants::BYTE_GROUP_SIZE - 1);
+		return result < Constants::VERTEX_BLOCK_MAX_SIZE ? result : Constants::VERTEX_BLOCK_MAX_SIZE;
+	}
+
+	inline unsigned char Unzigzag_8(unsigned char value) {
+		return static_cast<unsigned char>(-(value & 1) ^ (value >> 1));
+	}
+
+	inline unsigned int Decode_VByte(unsigned char const*& data) {
+		unsigned char lead = *data++;
+		// Fast path: single byte
+		if (lead < 128) {
+			return lead;
+		}
+
+		// Slow path: up to 4 more bytes
+		unsigned int result = lead & 127;
+		unsigned int shift = 7;
+		for (int i = 0; i < 4; ++i) {
+			unsigned char group = *data++;
+			result |= unsigned(group & 127) << shift;
+			shift += 7;
+
+			if (group < 128) {
+				break;
+			}
+		}
+
+		return result;
+	}
+
+	inline unsigned int Decode_Index(unsigned char const*& data, unsigned int last) {
+		unsigned int value = Decode_VByte(data);
+		unsigned int delta = (value >> 1) ^ -int(value & 1);
+		return last + delta;
+	}
+
+	inline void Write_Index(void* destination, size_t offset, size_t indexSize, unsigned int value) {
+		if (indexSize == 2) {
+			static_cast<unsigned short*>(destination)[offset] = static_cast<unsigned short>(value);
+		}
+		else {
+			static_cast<unsigned int*>(destination)[offset] = value;
+		}
+	}
+
+	inline void Write_Triangle(void* destination, size_t offset, size_t indexSize, unsigned int a, unsigned int b, unsigned int c) {
+		Write_Index(destination, offset + 0, indexSize, a);
+		Write_Index(destination, offset + 1, indexSize, b);
+		Write_Index(destination, offset + 2, indexSize, c);
+	}
+
+	template <int _Bits>
+	inline unsigned char const* Decode_Bytes_Group_Packed(unsigned char const* data, unsigned char* buffer) {
+		constexpr unsigned char sentinel = (1 << _Bits) - 1;
+		constexpr size_t perByte = 8 / _Bits;
+		// Escaped values are stored after the selectors in order of appearance
+		unsigned char const* escape = data + Constants::BYTE_GROUP_SIZE / perByte;
+
+		for (size_t i = 0; i < Constants::BYTE_GROUP_SIZE; i += perByte) {
+			unsigned char byte = *data++;
+			for (size_t k = 0; k < perByte; ++k) {
+				unsigned char encoded = (byte >> (8 - _Bits)) & sentinel;
+				byte = static_cast<unsigned char>(byte << _Bits);
+				buffer[i + k] = encoded == sentinel ? *escape : encoded;
+				escape += encoded == sentinel;
+			}
+		}
+
+		return escape;
+	}
+
+#ifdef SIMD_SSE
+	struct DecodeTables {
+		// Byte shuffle for each 8-bit escape mask, 0x80 zeroes lanes that are not escaped
+		alignas(16) unsigned char shuffle[256][8];
+		unsigned char count[256];
+		// Escaped groups need _mm_shuffle_epi8, without SSSE3 they are decoded a byte at a time
+		bool ssse3;
+
+		DecodeTables() : ssse3(Simd::Has_Ssse3()) {
+			for (int mask = 0; mask < 256; ++mask) {
+				unsigned char escaped = 0;
+				for (int i = 0; i < 8; ++i) {
+					int bit = (mask >> i) & 1;
+					shuffle[mask][i] = bit ? escaped : 0x80;
+					escaped += static_cast<unsigned char>(bit);
+				}
+				count[mask] = escaped;
+			}
+		}
+	};
+
+	inline DecodeTables const& Decode_Tables() {
+		static const DecodeTables tables;
+		return tables;
+	}
+
+	inline __m128i Decode_Shuffle_Mask(DecodeTables const& tables, unsigned char mask0, unsigned char mask1) {
+		__m128i shuffle0 = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(tables.shuffle[mask0]));
+		__m128i shuffle1 = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(tables.shuffle[mask1]));
+		// Upper half reads escaped bytes after the ones consumed by the lower half
+		shuffle1 = _mm_add_epi8(shuffle1, _mm_set1_epi8(static_cast<char>(tables.count[mask0])));
+		return _mm_unpacklo_epi64(shuffle0, shuffle1);
+	}
+
+	template <int _Bits>
+	inline unsigned char const* Decode_Bytes_Group_Escaped(DecodeTables const& tables, unsigned char const* data, unsigned char* buffer, __m128i selectors) {
+		constexpr size_t selectorBytes = Constants::BYTE_GROUP_SIZE * _Bits / 8;
+		__m128i rest = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + selectorBytes));
+		__m128i mask = _mm_cmpeq_epi8(selectors, _mm_set1_epi8((1 << _Bits) - 1));
+		int mask16 = _mm_movemask_epi8(mask);
+		unsigned char mask0 = static_cast<unsigned char>(mask16 & 255);
+		unsigned char mask1 = static_cast<unsigned char>(mask16 >> 8);
+
+		__m128i shuffle = Decode_Shuffle_Mask(tables, mask0, mask1);
+		__m128i result = _mm_or_si128(_mm_shuffle_epi8(rest, shuffle), _mm_andnot_si128(mask, selectors));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), result);
+
+		return data + selectorBytes + tables.count[mask0] + tables.count[mask1];
+	}
+
+	inline unsigned char const* Decode_Bytes_Group(DecodeTables const& tables, unsigned char const* data, unsigned char* buffer, int bitsLog2) {
+		switch (bitsLog2) {
+		case 0:
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_setzero_si128());
+			return data;
+		case 1: {
+			if (!tables.ssse3) {
+				return Decode_Bytes_Group_Packed<2>(data, buffer);
+			}
+			int packed;
+			memcpy(&packed, data, sizeof(packed));
+			// Spread each 2-bit selector into its own byte, first selector lives in the high bits
+			__m128i selector2 = _mm_cvtsi32_si128(packed);
+			__m128i selector22 = _mm_unpacklo_epi8(_mm_srli_epi16(selector2, 4), selector2);
+			__m128i selector2222 = _mm_unpacklo_epi8(_mm_srli_epi16(selector22, 2), selector22);
+			__m128i selectors = _mm_and_si128(selector2222, _mm_set1_epi8(3));
+			return Decode_Bytes_Group_Escaped<2>(tables, data, buffer, selectors);
+		}
+		case 2: {
+			if (!tables.ssse3) {
+				return Decode_Bytes_Group_Packed<4>(data, buffer);
+			}
+			__m128i selector4 = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(data));
+			__m128i selector44 = _mm_unpacklo_epi8(_mm_srli_epi16(selector4, 4), selector4);
+			__m128i selectors = _mm_and_si128(selector44, _mm_set1_epi8(15));
+			return Decode_Bytes_Group_Escaped<4>(tables, data, buffer, selectors);
+		}
+		default:
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_loadu_si128(reinterpret_cast<__m128i const*>(data)));
+			return data + Constants::BYTE_GROUP_SIZE;
+		}
+	}
+
+	inline __m128i Unzigzag_8(__m128i value) {
+		__m128i low = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(value, _mm_set1_epi8(1)));
+		__m128i high = _mm_and_si128(_mm_srli_epi16(value, 1), _mm_set1_epi8(127));
+		return _mm_xor_si128(low, high);
+	}
+#else
+	struct DecodeTables {
+
+	};
+
+	inline DecodeTables const& Decode_Tables() {
+		static const DecodeTables tables;
+		return tables;
+	}
+
+	inline unsigned char const* Decode_Bytes_Group(DecodeTables const&, unsigned char const* data, unsigned char* buffer, int bitsLog2) {
+		switch (bitsLog2) {
+		case 0:
+			memset(buffer, 0, Constants::BYTE_GROUP_SIZE);
+			return data;
+		case 1:
+			return Decode_Bytes_Group_Packed<2>(data, buffer);
+		case 2:
+			return Decode_Bytes_Group_Packed<4>(data, buffer);
+		default:
+			memcpy(buffer, data, Constants::BYTE_GROUP_SIZE);
+			return data + Constants::BYTE_GROUP_SIZE;
+		}
+	}
+#endif
+
+	/// <summary>
+	/// Decodes one channel of a vertex block, the header holds a 2-bit width for each group of 16 bytes.
+	/// </summary>
+	/// <returns>Pointer past the consumed data or nullptr if the stream is truncated</returns>
+	inline unsigned char const* Decode_Bytes(DecodeTables const& tables, unsigned char const* data, unsigned char const* dataEnd, unsigned char* buffer, size_t bufferSize) {
+		size_t headerSize = ((bufferSize / Constants::BYTE_GROUP_SIZE) + 3) / 4;
+		if (size_t(dataEnd - data) < headerSize) {
+			return nullptr;
+		}
+
+		unsigned char const* header = data;
+		data += headerSize;
+
+		for (size_t i = 0; i < bufferSize; i += Constants::BYTE_GROUP_SIZE) {
+			// Every group may read up to the decode limit without further checks
+			if (size_t(dataEnd - data) < Constants::BYTE_GROUP_DECODE_LIMIT) {
+				return nullptr;
+			}
+
+			size_t headerOffset = i / Constants::BYTE_GROUP_SIZE;
+			int bitsLog2 = (header[headerOffset / 4] >> ((headerOffset % 4) * 2)) & 3;
+			data = Decode_Bytes_Group(tables, data, buffer + i, bitsLog2);
+		}
+
+		return data;
+	}
+
+	inline unsigned char const* Decode_Vertex_Block(DecodeTables const& tables, unsigned char const* data, unsigned char const* dataEnd, unsigned char* vertexData,
+		size_t vertexCount, size_t vertexSize, unsigned char lastVertex[256]) {
+		size_t vertexCountAligned = (vertexCount + Constants::BYTE_GROUP_SIZE - 1) & ~(Constants::BYTE_GROUP_SIZE - 1);
+
+#ifdef SIMD_SSE
+		// Four byte channels are decoded together then transposed back into vertex order
+		alignas(16) unsigned char buffer[4][Constants::VERTEX_BLOCK_MAX_SIZE];
+
+		for (size_t k = 0; k < vertexSize; k += 4) {
+			for (size_t channel = 0; channel < 4; ++channel) {
+				data = Decode_Bytes(tables, data, dataEnd, buffer[channel], vertexCountAligned);
+				if (!data) {
+					return nullptr;
+				}
+			}
+
+			int previous;
+			memcpy(&previous, lastVertex + k, sizeof(previous));
+			__m128i prefix = _mm_set1_epi32(previous);
+
+			for (size_t i = 0; i < vertexCount; i += 16) {
+				__m128i row0 = _mm_load_si128(reinterpret_cast<__m128i const*>(buffer[0] + i));
+				__m128i row1 = _mm_load_si128(reinterpret_cast<__m128i const*>(buffer[1] + i));
+				__m128i row2 = _mm_load_si128(reinterpret_cast<__m128i const*>(buffer[2] + i));
+				__m128i row3 = _mm_load_si128(reinterpret_cast<__m128i const*>(buffer[3] + i));
+
+				__m128i temp0 = _mm_unpacklo_epi8(row0, row1);
+				__m128i temp1 = _mm_unpackhi_epi8(row0, row1);
+				__m128i temp2 = _mm_unpacklo_epi8(row2, row3);
+				__m128i temp3 = _mm_unpackhi_epi8(row2, row3);
+
+				// Each register holds four vertices of four bytes
+				__m128i vertices[4] = {
+					_mm_unpacklo_epi16(temp0, temp2),
+					_mm_unpackhi_epi16(temp0, temp2),
+					_mm_unpacklo_epi16(temp1, temp3),
+					_mm_unpackhi_epi16(temp1, temp3)
+				};
+
+				for (size_t group = 0; group < 4; ++group) {
+					// Prefix sum of byte deltas across the four vertices
+					__m128i sum = Unzigzag_8(vertices[group]);
+					sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+					sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+					sum = _mm_add_epi8(sum, prefix);
+					prefix = _mm_shuffle_epi32(sum, 0xff);
+
+					size_t vertexIndex = i + group * 4;
+					for (size_t lane = 0; lane < 4 && vertexIndex + lane < vertexCount; ++lane) {
+						int value = _mm_cvtsi128_si32(sum);
+						memcpy(vertexData + (vertexIndex + lane) * vertexSize + k, &value, sizeof(value));
+						sum = _mm_srli_si128(sum, 4);
+					}
+				}
+			}
+		}
+#else
+		unsigned char buffer[Constants::VERTEX_BLOCK_MAX_SIZE];
+
+		for (size_t k = 0; k < vertexSize; ++k) {
+			data = Decode_Bytes(tables, data, dataEnd, buffer, vertexCountAligned);
+			if (!data) {
+				return nullptr;
+			}
+
+			unsigned char previous = lastVertex[k];
+			for (size_t i = 0; i < vertexCount; ++i) {
+				unsigned char value = static_cast<unsigned char>(Unzigzag_8(buffer[i]) + previous);
+				vertexData[i * vertexSize + k] = value;
+				previous = value;
+			}
+		}
+#endif
+
+		memcpy(lastVertex, vertexData + (vertexCount - 1) * vertexSize, vertexSize);
+		return data;
+	}
+
+	/// <summary>
+	/// Decodes an attribute stream (mode ATTRIBUTES).
+	/// </summary>
+	/// <param name="destination">vertexCount * vertexSize bytes</param>
+	/// <param name="vertexSize">Multiple of 4, at most 256</param>
+	/// <returns>False if the stream is malformed or of an unsupported version</returns>
+	inline bool Decode_Vertex_Buffer(void* destination, size_t vertexCount, size_t vertexSize, unsigned char const* buffer, size_t bufferSize) {
+		if (vertexSize == 0 || vertexSize > 256 || vertexSize % 4 != 0) {
+			return false;
+		}
+
+		unsigned char* vertexData = static_cast<unsigned char*>(destination);
+		unsigned char const* data = buffer;
+		unsigned char const* dataEnd = buffer + bufferSize;
+
+		if (bufferSize < 1 + vertexSize) {
+			return false;
+		}
+
+		unsigned char header = *data++;
+		if ((header & 0xf0) != Constants::VERTEX_HEADER || (header & 0x0f) != 0) {
+			return false;
+		}
+
+		// First vertex is stored at the end of the stream as the initial delta baseline
+		unsigned char lastVertex[256];
+		memcpy(lastVertex, dataEnd - vertexSize, vertexSize);
+
+		DecodeTables const& tables = Decode_Tables();
+		size_t blockSize = Vertex_Block_Size(vertexSize);
+
+		for (size_t offset = 0; offset < vertexCount; offset += blockSize) {
+			size_t count = std::min(blockSize, vertexCount - offset);
+			data = Decode_Vertex_Block(tables, data, dataEnd, vertexData + offset * vertexSize, count, vertexSize, lastVertex);
+			if (!data) {
+				return false;
+			}
+		}
+
+		size_t tailSize = vertexSize < Constants::TAIL_MAX_SIZE ? Constants::TAIL_MAX_SIZE : vertexSize;
+		return size_t(dataEnd - data) == tailSize;
+	}
+
+	/// <summary>
+	/// Decodes a triangle list (mode TRIANGLES), triangles are rebuilt from a 16 entry edge fifo and a 16 entry vertex fifo.
+	/// </summary>
+	/// <param name="indexCount">Multiple of 3</param>
+	/// <param name="indexSize">2 or 4</param>
+	inline bool Decode_Index_Buffer(void* destination, size_t indexCount, size_t indexSize, unsigned char const* buffer, size_t bufferSize) {
+		if (indexCount % 3 != 0 || (indexSize != 2 && indexSize != 4)) {
+			return false;
+		}
+
+		// Header, one code per triangle and the codeaux table
+		if (bufferSize < 1 + indexCount / 3 + Constants::INDEX_TAIL_SIZE) {
+			return false;
+		}
+
+		if ((buffer[0] & 0xf0) != Constants::INDEX_HEADER || (buffer[0] & 0x0f) != 1) {
+			return false;
+		}
+
+		unsigned int edgeFifo[16][2];
+		unsigned int vertexFifo[16];
+		memset(edgeFifo, -1, sizeof(edgeFifo));
+		memset(vertexFifo, -1, sizeof(vertexFifo));
+		size_t edgeFifoOffset = 0;
+		size_t vertexFifoOffset = 0;
+
+		auto pushEdge = [&](unsigned int a, unsigned int b) {
+			edgeFifo[edgeFifoOffset][0] = a;
+			edgeFifo[edgeFifoOffset][1] = b;
+			edgeFifoOffset = (edgeFifoOffset + 1) & 15;
+		};
+
+		// Vertices are always written, 'condition' only decides whether the fifo advances
+		auto pushVertex = [&](unsigned int v, size_t condition) {
+			vertexFifo[vertexFifoOffset] = v;
+			vertexFifoOffset = (vertexFifoOffset + condition) & 15;
+		};
+
+		unsigned int next = 0;
+		unsigned int last = 0;
+
+		unsigned char const* code = buffer + 1;
+		unsigned char const* data = code + indexCount / 3;
+		unsigned char const* dataSafeEnd = buffer + bufferSize - Constants::INDEX_TAIL_SIZE;
+		unsigned char const* codeAuxTable = dataSafeEnd;
+
+		for (size_t i = 0; i < indexCount; i += 3) {
+			// A triangle reads at most 16 bytes: a codeaux byte and three 5 byte varints
+			if (data > dataSafeEnd) {
+				return false;
+			}
+
+			unsigned char codeTriangle = *code++;
+
+			if (codeTriangle < 0xf0) {
+				// Triangle shares an edge with a recent triangle
+				int fe = codeTriangle >> 4;
+				unsigned int a = edgeFifo[(edgeFifoOffset - 1 - fe) & 15][0];
+				unsigned int b = edgeFifo[(edgeFifoOffset - 1 - fe) & 15][1];
+				unsigned int c = 0;
+
+				int fec = codeTriangle & 15;
+				if (fec < Constants::EDGE_FIFO_CACHE_LIMIT) {
+					unsigned int cached = vertexFifo[(vertexFifoOffset - 1 - fec) & 15];
+					c = fec == 0 ? next : cached;
+					size_t isNext = fec == 0;
+					next += static_cast<unsigned int>(isNext);
+					pushVertex(c, isNext);
+				}
+				else {
+					// 13 and 14 encode last-1 and last+1, 15 a delta encoded index
+					last = c = fec != 15 ? last + (fec - (fec ^ 3)) : Decode_Index(data, last);
+					pushVertex(c, 1);
+				}
+
+				pushEdge(c, b);
+				pushEdge(a, c);
+
+				Write_Triangle(destination, i, indexSize, a, b, c);
+			}
+			else if (codeTriangle < 0xfe) {
+				// Fast path: first vertex is 'next', the other two are read through the codeaux table
+				unsigned char codeAux = codeAuxTable[codeTriangle & 15];
+				int feb = codeAux >> 4;
+				int fec = codeAux & 15;
+
+				unsigned int a = next++;
+
+				unsigned int cachedB = vertexFifo[(vertexFifoOffset - feb) & 15];
+				unsigned int b = feb == 0 ? next : cachedB;
+				size_t isNextB = feb == 0;
+				next += static_cast<unsigned int>(isNextB);
+
+				unsigned int cachedC = vertexFifo[(vertexFifoOffset - fec) & 15];
+				unsigned int c = fec == 0 ? next : cachedC;
+				size_t isNextC = fec == 0;
+				next += static_cast<unsigned int>(isNextC);
+
+				Write_Triangle(destination, i, indexSize, a, b, c);
+
+				pushVertex(a, 1);
+				pushVertex(b, isNextB);
+				pushVertex(c, isNextC);
+
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+			else {
+				// Slow path: codeaux is stored as a full byte
+				unsigned char codeAux = *data++;
+				int fea = codeTriangle == 0xfe ? 0 : 15;
+				int feb = codeAux >> 4;
+				int fec = codeAux & 15;
+
+				// A zero codeaux outside of the table restarts the 'next' counter
+				if (codeAux == 0) {
+					next = 0;
+				}
+
+				unsigned int a = fea == 0 ? next++ : 0;
+				unsigned int b = feb == 0 ? next++ : vertexFifo[(vertexFifoOffset - feb) & 15];
+				unsigned int c = fec == 0 ? next++ : vertexFifo[(vertexFifoOffset - fec) & 15];
+
+				if (fea == 15) {
+					last = a = Decode_Index(data, last);
+				}
+				if (feb == 15) {
+					last = b = Decode_Index(data, last);
+				}
+				if (fec == 15) {
+					last = c = Decode_Index(data, last);
+				}
+
+				Write_Triangle(destination, i, indexSize, a, b, c);
+
+				pushVertex(a, 1);
+				pushVertex(b, (feb == 0) | (feb == 15));
+				pushVertex(c, (fec == 0) | (fec == 15));
+
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+		}
+
+		// All data must be consumed up to the codeaux table
+		return data == dataSafeEnd;
+	}
+
+	/// <summary>
+	/// Decodes an arbitrary index list (mode INDICES), every index is a delta from one of two baselines.
+	/// </summary>
+	/// <param name="indexSize">2 or 4</param>
+	inline bool Decode_Index_Sequence(void* destination, size_t indexCount, size_t indexSize, unsigned char const* buffer, size_t bufferSize) {
+		if (indexSize != 2 && indexSize != 4) {
+			return false;
+		}
+
+		// Header, at least one byte per index and the tail
+		if (bufferSize < 1 + indexCount + Constants::SEQUENCE_TAIL_SIZE) {
+			return false;
+		}
+
+		if ((buffer[0] & 0xf0) != Constants::SEQUENCE_HEADER || (buffer[0] & 0x0f) != 1) {
+			return false;
+		}
+
+		unsigned char const* data = buffer + 1;
+		unsigned char const* dataSafeEnd = buffer + bufferSize - Constants::SEQUENCE_TAIL_SIZE;
+
+		unsigned int last[2] = { 0, 0 };
+
+		for (size_t i = 0; i < indexCount; ++i) {
+			// An index reads at most 5 bytes, the tail covers the overrun
+			if (data >= dataSafeEnd) {
+				return false;
+			}
+
+			unsigned int value = Decode_VByte(data);
+			// Low bit selects the baseline
+			unsigned int current = value & 1;
+			value >>= 1;
+
+			unsigned int delta = (value >> 1) ^ -int(value & 1);
+			unsigned int index = last[current] + delta;
+			last[current] = index;
+
+			Write_Index(destination, i, indexSize, index);
+		}
+
+		return data == dataSafeEnd;
+	}
+
+	template <class _Ty>
+	inline _Ty Round_To_Signed(float value) {
+		return static_cast<_Ty>(int(value + (value >= 0.0f ? 0.5f : -0.5f)));
+	}
+
+	/// <summary>
+	/// Reconstructs unit vectors from octahedral x/y, z holds the encoding of 1.0 and w is passed through.
+	/// </summary>
+	template <class _Ty>
+	inline void Decode_Octahedral_Filter_Scalar(_Ty* data, size_t count) {
+		constexpr float maximum = float((1 << (sizeof(_Ty) * 8 - 1)) - 1);
+
+		for (size_t i = 0; i < count; ++i) {
+			float x = float(data[i * 4 + 0]);
+			float y = float(data[i * 4 + 1]);
+			float z = float(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+
+			// Fold back the lower hemisphere
+			float t = z >= 0.0f ? 0.0f : z;
+			x += x >= 0.0f ? t : -t;
+			y += y >= 0.0f ? t : -t;
+
+			float scale = maximum / std::sqrt(x * x + y * y + z * z);
+
+			data[i * 4 + 0] = Round_To_Signed<_Ty>(x * scale);
+			data[i * 4 + 1] = Round_To_Signed<_Ty>(y * scale);
+			data[i * 4 + 2] = Round_To_Signed<_Ty>(z * scale);
+		}
+	}
+
+	/// <summary>
+	/// Reconstructs quaternions from the three smallest components, the largest component index is stored in the low bits of w.
+	/// </summary>
+	inline void Decode_Quaternion_Filter_Scalar(short* data, size_t count) {
+		const float scale = 1.0f / std::sqrt(2.0f);
+
+		for (size_t i = 0; i < count; ++i) {
+			// Low 2 bits of the encoded 1.0 are replaced by the component index
+			int encodedOne = data[i * 4 + 3] | 3;
+			float componentScale = scale / float(encodedOne);
+
+			float x = float(data[i * 4 + 0]) * componentScale;
+			float y = float(data[i * 4 + 1]) * componentScale;
+			float z = float(data[i * 4 + 2]) * componentScale;
+
+			// Clamped to avoid NaN from precision errors
+			float ww = 1.0f - x * x - y * y - z * z;
+			float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+			int largest = data[i * 4 + 3] & 3;
+
+			data[i * 4 + ((largest + 1) & 3)] = Round_To_Signed<short>(x * 32767.0f);
+			data[i * 4 + ((largest + 2) & 3)] = Round_To_Signed<short>(y * 32767.0f);
+			data[i * 4 + ((largest + 3) & 3)] = Round_To_Signed<short>(z * 32767.0f);
+			data[i * 4 + ((largest + 0) & 3)] = Round_To_Signed<short>(w * 32767.0f);
+		}
+	}
+
+	/// <summary>
+	/// Expands 24-bit signed mantissa and 8-bit signed exponent pairs into floats.
+	/// </summary>
+	inline void Decode_Exponential_Filter_Scalar(unsigned int* data, size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			unsigned int value = data[i];
+			int mantissa = int(value << 8) >> 8;
+			int exponent = int(value) >> 24;
+
+			// ldexp(mantissa, exponent) without the library call
+			unsigned int bits = unsigned(exponent + 127) << 23;
+			float result;
+			memcpy(&result, &bits, sizeof(result));
+			result *= float(mantissa);
+			memcpy(&data[i], &result, sizeof(result));
+		}
+	}
+
+#ifdef SIMD_SSE
+	inline void Decode_Octahedral_Filter(short* data, size_t count) {
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			__m128 vertices0 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 0) * 4]));
+			__m128 vertices1 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 2) * 4]));
+
+			// x/y pairs and z/w pairs of four vertices
+			__m128i xy = _mm_castps_si128(_mm_shuffle_ps(vertices0, vertices1, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i zw = _mm_castps_si128(_mm_shuffle_ps(vertices0, vertices1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+			__m128i xi = _mm_srai_epi32(_mm_slli_epi32(xy, 16), 16);
+			__m128i yi = _mm_srai_epi32(xy, 16);
+			// z is never negative so it does not need sign extension
+			__m128i zi = _mm_and_si128(zw, _mm_set1_epi32(0x7fff));
+
+			__m128 x = _mm_cvtepi32_ps(xi);
+			__m128 y = _mm_cvtepi32_ps(yi);
+			__m128 z = _mm_sub_ps(_mm_cvtepi32_ps(zi), _mm_add_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y)));
+
+			// Fold back the lower hemisphere
+			__m128 t = _mm_min_ps(z, _mm_setzero_ps());
+			x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, sign)));
+			y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, sign)));
+
+			__m128 lengthSquared = _mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z)));
+			__m128 scale = _mm_div_ps(_mm_set1_ps(32767.0f), _mm_sqrt_ps(lengthSquared));
+
+			__m128i xr = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+			__m128i yr = _mm_cvtps_epi32(_mm_mul_ps(y, scale));
+			__m128i zr = _mm_cvtps_epi32(_mm_mul_ps(z, scale));
+
+			// Interleave back to x, y, z, 0 then restore w
+			__m128i xz = _mm_or_si128(_mm_and_si128(xr, _mm_set1_epi32(0xffff)), _mm_slli_epi32(zr, 16));
+			__m128i y0 = _mm_and_si128(yr, _mm_set1_epi32(0xffff));
+
+			__m128i result0 = _mm_unpacklo_epi16(xz, y0);
+			__m128i result1 = _mm_unpackhi_epi16(xz, y0);
+
+			const __m128i maskW = _mm_set1_epi64x(static_cast<long long>(0xffff000000000000ull));
+			result0 = _mm_or_si128(result0, _mm_and_si128(_mm_castps_si128(vertices0), maskW));
+			result1 = _mm_or_si128(result1, _mm_and_si128(_mm_castps_si128(vertices1), maskW));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&data[(i + 0) * 4]), result0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&data[(i + 2) * 4]), result1);
+		}
+
+		Decode_Octahedral_Filter_Scalar(data + i * 4, count - i);
+	}
+
+	inline unsigned long long Rotate_Left(unsigned long long value, int shift) {
+		shift &= 63;
+		return shift == 0 ? value : (value << shift) | (value >> (64 - shift));
+	}
+
+	inline void Decode_Quaternion_Filter(short* data, size_t count) {
+		const float scale = 1.0f / std::sqrt(2.0f);
+		size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			__m128 quaternions0 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 0) * 4]));
+			__m128 quaternions1 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 2) * 4]));
+
+			__m128i xy = _mm_castps_si128(_mm_shuffle_ps(quaternions0, quaternions1, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i zc = _mm_castps_si128(_mm_shuffle_ps(quaternions0, quaternions1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+			__m128i xi = _mm_srai_epi32(_mm_slli_epi32(xy, 16), 16);
+			__m128i yi = _mm_srai_epi32(xy, 16);
+			__m128i zi = _mm_srai_epi32(_mm_slli_epi32(zc, 16), 16);
+			__m128i ci = _mm_srai_epi32(zc, 16);
+
+			// Encoded 1.0 with the component index bits set
+			__m128i one = _mm_or_si128(ci, _mm_set1_epi32(3));
+			__m128 componentScale = _mm_div_ps(_mm_set1_ps(scale), _mm_cvtepi32_ps(one));
+
+			__m128 x = _mm_mul_ps(_mm_cvtepi32_ps(xi), componentScale);
+			__m128 y = _mm_mul_ps(_mm_cvtepi32_ps(yi), componentScale);
+			__m128 z = _mm_mul_ps(_mm_cvtepi32_ps(zi), componentScale);
+
+			__m128 ww = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+			__m128 w = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+			const __m128 maximum = _mm_set1_ps(32767.0f);
+			__m128i xr = _mm_cvtps_epi32(_mm_mul_ps(x, maximum));
+			__m128i yr = _mm_cvtps_epi32(_mm_mul_ps(y, maximum));
+			__m128i zr = _mm_cvtps_epi32(_mm_mul_ps(z, maximum));
+			__m128i wr = _mm_cvtps_epi32(_mm_mul_ps(w, maximum));
+
+			// Packed as w, x, y, z then rotated so w lands on the largest component
+			__m128i xz = _mm_or_si128(_mm_and_si128(xr, _mm_set1_epi32(0xffff)), _mm_slli_epi32(zr, 16));
+			__m128i wy = _mm_or_si128(_mm_and_si128(wr, _mm_set1_epi32(0xffff)), _mm_slli_epi32(yr, 16));
+
+			unsigned long long packed[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&packed[0]), _mm_unpacklo_epi16(wy, xz));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&packed[2]), _mm_unpackhi_epi16(wy, xz));
+
+			for (size_t lane = 0; lane < 4; ++lane) {
+				int largest = data[(i + lane) * 4 + 3] & 3;
+				unsigned long long rotated = Rotate_Left(packed[lane], largest * 16);
+				memcpy(&data[(i + lane) * 4], &rotated, sizeof(rotated));
+			}
+		}
+
+		Decode_Quaternion_Filter_Scalar(data + i * 4, count - i);
+	}
+
+	inline void Decode_Exponential_Filter(unsigned int* data, size_t count) {
+		size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			__m128i value = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&data[i]));
+
+			__m128i mantissa = _mm_srai_epi32(_mm_slli_epi32(value, 8), 8);
+			__m128i exponent = _mm_srai_epi32(value, 24);
+
+			__m128 power = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23));
+			__m128 result = _mm_mul_ps(power, _mm_cvtepi32_ps(mantissa));
+
+			_mm_storeu_ps(reinterpret_cast<float*>(&data[i]), result);
+		}
+
+		Decode_Exponential_Filter_Scalar(data + i, count - i);
+	}
+#else
+	inline void Decode_Octahedral_Filter(short* data, size_t count) {
+		Decode_Octahedral_Filter_Scalar(data, count);
+	}
+
+	inline void Decode_Quaternion_Filter(short* data, size_t count) {
+		Decode_Quaternion_Filter_Scalar(data, count);
+	}
+
+	inline void Decode_Exponential_Filter(unsigned int* data, size_t count) {
+		Decode_Exponential_Filter_Scalar(data, count);
+	}
+#endif
+
+	inline void Decode_Octahedral_Filter(signed char* data, size_t count) {
+		Decode_Octahedral_Filter_Scalar(data, count);
+	}
+
+	/// <summary>
+	/// Applies a filter in place on decoded attribute data.
+	/// </summary>
+	/// <returns>False if the filter does not support the stride</returns>
+	inline bool Apply_Filter(Filter filter, void* data, size_t count, size_t stride) {
+		switch (filter) {
+		case Filter::None:
+			return true;
+		case Filter::Octahedral:
+			if (stride == 4) {
+				Decode_Octahedral_Filter(static_cast<signed char*>(data), count);
+				return true;
+			}
+			else if (stride == 8) {
+				Decode_Octahedral_Filter(static_cast<short*>(data), count);
+				return true;
+			}
+			return false;
+		case Filter::Quaternion:
+			if (stride == 8) {
+				Decode_Quaternion_Filter(static_cast<short*>(data), count);
+				return true;
+			}
+			return false;
+		case Filter::Exponential:
+			if (stride % 4 == 0) {
+				Decode_Exponential_Filter(static_cast<unsigned int*>(data), count * (stride / 4));
+				return true;
+			}
+			return false;
+		}
+
+		return false;
+	}
+
+	inline Mode Convert_To_Mode(std::string const& value) {
+		if (value == GLTF::Constants::MESHOPT_MODE_ATTRIBUTES) {
+			return Mode::Attributes;
+		}
+		else if (value == GLTF::Constants::MESHOPT_MODE_TRIANGLES) {
+			return Mode::Triangles;
+		}
+		else if (value == GLTF::Constants::MESHOPT_MODE_INDICES) {
+			return Mode::Indices;
+		}
+
+		throw std::invalid_argument(FILE_FUNCTION_LINE + ": unknown mode '" + value + "'.");
+	}
+
+	inline Filter Convert_To_Filter(std::string const& value) {
+		if (value == GLTF::Constants::MESHOPT_FILTER_NONE) {
+			return Filter::None;
+		}
+		else if (value == GLTF::Constants::MESHOPT_FILTER_OCTAHEDRAL) {
+			return Filter::Octahedral;
+		}
+		else if (value == GLTF::Constants::MESHOPT_FILTER_QUATERNION) {
+			return Filter::Quaternion;
+		}
+		else if (value == GLTF::Constants::MESHOPT_FILTER_EXPONENTIAL) {
+			return Filter::Exponential;
+		}
+
+		throw std::invalid_argument(FILE_FUNCTION_LINE + ": unknown filter '" + value + "'.");
+	}
+}
+
+namespace GLTF {
+	/// <summary>
+	/// EXT_meshopt_compression object of a bufferView, describes where the compressed stream lives.
+	/// The bufferView itself is the destination of the decoded data.
+	/// </summary>
+	struct MeshoptCompression : public GLTFProperty {
+		// Required, Index To Buffer holding the compressed stream
+		index_type buffer;
+		// Optional, defaults to Zero(0)
+		integer_type byteOffset = 0;
+		// Required, length of the compressed stream
+		integer_type byteLength;
+		// Required, size of each decoded element
+		integer_type byteStride;
+		// Required, number of decoded elements
+		integer_type count;
+		Meshopt::Mode mode;
+		Meshopt::Filter filter;
+
+		MeshoptCompression(type_json_object const& sourceObject) : GLTFProperty(sourceObject),
+			buffer(Get_Required_Value<JsonParse::JsonInteger>(FILE_FUNCTION_LINE, sourceObject, Constants::BUFFER)),
+			byteOffset(Get_Optional_Value<JsonParse::JsonInteger>(sourceObject, Constants::BYTE_OFFSET)),
+			byteLength(Get_Required_Value<JsonParse::JsonInteger>(FILE_FUNCTION_LINE, sourceObject, Constants::BYTE_LENGTH)),
+			byteStride(Get_Required_Value<JsonParse::JsonInteger>(FILE_FUNCTION_LINE, sourceObject, Constants::BYTE_STRIDE)),
+			count(Get_Required_Value<JsonParse::JsonInteger>(FILE_FUNCTION_LINE, sourceObject, Constants::COUNT)),
+			mode(Meshopt::Convert_To_Mode(Get_Required_Value<JsonParse::JsonString>(FILE_FUNCTION_LINE, sourceObject, Constants::MODE))),
+			filter(Meshopt::Convert_To_Filter(Get_Optional_Value<JsonParse::JsonString>(sourceObject, Constants::FILTER, Constants::MESHOPT_FILTER_NONE))) {
+
+		}
+
+		MeshoptCompression() = default;
+		MeshoptCompression(MeshoptCompression const&) = default;
+		MeshoptCompression(MeshoptCompression&&) = default;
+
+		MeshoptCompression& operator=(MeshoptCompression const&) = default;
+		MeshoptCompression& operator=(MeshoptCompression&&) = default;
+
+		/// <summary>
+		/// Buffers marked as fallback only reserve space for decoded data, they may not have a uri.
+		/// </summary>
+		static bool Is_Fallback_Buffer(Buffer const& buffer) {
+			type_json_object extension = Get_Extension(buffer, Constants::EXT_MESHOPT_COMPRESSION);
+			return extension && Get_Optional_Value<JsonParse::JsonBoolean>(extension, Constants::FALLBACK, false);
+		}
+
+		/// <summary>
+		/// Decodes the stream into the bufferView's data.
+		/// </summary>
+		/// <param name="source">Data of the buffer at 'buffer', the stream starts at 'byteOffset'</param>
+		/// <param name="destination">Data of the bufferView, at least count * byteStride bytes</param>
+		/// <returns>False if the stream is malformed or does not fit</returns>
+		bool Decode(unsigned char const* source, size_t sourceSize, unsigned char* destination, size_t destinationSize) const {
+			size_t decodedSize = size_t(count) * size_t(byteStride);
+			if (size_t(byteOffset) + size_t(byteLength) > sourceSize || decodedSize > destinationSize) {
+				return false;
+			}
+
+			unsigned char const* stream = source + byteOffset;
+
+			switch (mode) {
+			case Meshopt::Mode::Attributes:
+				return Meshopt::Decode_Vertex_Buffer(destination, size_t(count), size_t(byteStride), stream, size_t(byteLength)) &&
+					Meshopt::Apply_Filter(filter, destination, size_t(count), size_t(byteStride));
+			case Meshopt::Mode::Triangles:
+				return Meshopt::Decode_Index_Buffer(destination, size_t(count), size_t(byteStride), stream, size_t(byteLength));
+			case Meshopt::Mode::Indices:
+				return Meshopt::Decode_Index_Sequence(destination, size_t(count), size_t(byteStride), stream, size_t(byteLength));
+			}
+
+			return false;
+		}
+	};
+
+	/// <summary>
+	/// Validator handler for EXT_meshopt_compression, checks both the bufferView and the buffer form.
+	/// </summary>
+	inline void Validate_Meshopt_Compression(Validator& validator, type_json_object const& extension) {
+		if (std::find(validator.nameBreadCrumbs.cbegin(), validator.nameBreadCrumbs.cend(), Constants::BUFFER_VIEWS) == validator.nameBreadCrumbs.cend()) {
+			validator.Boolean(FILE_FUNCTION_LINE, extension, Constants::FALLBACK);
+			return;
+		}
+
+		validator.Index(FILE_FUNCTION_LINE, extension, Constants::BUFFER, Constants::BUFFERS, true);
+		validator.Integer(FILE_FUNCTION_LINE, extension, Constants::BYTE_OFFSET, &Validator::GreaterEqualZero);
+		validator.Integer(FILE_FUNCTION_LINE, extension, Constants::BYTE_LENGTH, &Validator::GreaterEqualOne, true);
+		validator.Integer(FILE_FUNCTION_LINE, extension, Constants::BYTE_STRIDE, &Validator::GreaterEqualOne, true);
+		validator.Integer(FILE_FUNCTION_LINE, extension, Constants::COUNT, &Validator::GreaterEqualOne, true);
+		validator.String(FILE_FUNCTION_LINE, extension, Constants::MODE, nullptr, true);
+		validator.String(FILE_FUNCTION_LINE, extension, Constants::FILTER);
+
+		type_json_string modeElement = Get_Optional_Element<JsonParse::JsonString>(extension, Constants::MODE);
+		type_json_integer strideElement = Get_Optional_Element<JsonParse::JsonInteger>(extension, Constants::BYTE_STRIDE);
+		type_json_integer countElement = Get_Optional_Element<JsonParse::JsonInteger>(extension, Constants::COUNT);
+		type_json_string filterElement = Get_Optional_Element<JsonParse::JsonString>(extension, Constants::FILTER);
+		if (!modeElement || !strideElement || !countElement) {
+			// Missing or mismatched elements are already reported
+			return;
+		}
+
+		integer_type stride = strideElement->value;
+
+		if (modeElement->value == Constants::MESHOPT_MODE_ATTRIBUTES) {
+			if (stride % 4 != 0 || stride > 256) {
+				validator.errors.push_back(Validator::GLTFError(extension, strideElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, strideElement) + " must be divisible by 4 and <= 256 for ATTRIBUTES."));
+			}
+		}
+		else if (modeElement->value == Constants::MESHOPT_MODE_TRIANGLES || modeElement->value == Constants::MESHOPT_MODE_INDICES) {
+			if (stride != 2 && stride != 4) {
+				validator.errors.push_back(Validator::GLTFError(extension, strideElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, strideElement) + " must be 2 or 4 for " + modeElement->value + "."));
+			}
+			if (modeElement->value == Constants::MESHOPT_MODE_TRIANGLES && countElement->value % 3 != 0) {
+				validator.errors.push_back(Validator::GLTFError(extension, countElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, countElement) + " must be divisible by 3 for TRIANGLES."));
+			}
+		}
+		else {
+			validator.errors.push_back(Validator::GLTFError(extension, modeElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, modeElement) + " must be " +
+				Constants::MESHOPT_MODE_ATTRIBUTES + ", " + Constants::MESHOPT_MODE_TRIANGLES + ", or " + Constants::MESHOPT_MODE_INDICES + "."));
+		}
+
+		if (filterElement && filterElement->value != Constants::MESHOPT_FILTER_NONE) {
+			if (modeElement->value != Constants::MESHOPT_MODE_ATTRIBUTES) {
+				validator.errors.push_back(Validator::GLTFError(extension, filterElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, filterElement) + " requires mode ATTRIBUTES."));
+			}
+			else if (filterElement->value == Constants::MESHOPT_FILTER_OCTAHEDRAL) {
+				if (stride != 4 && stride != 8) {
+					validator.errors.push_back(Validator::GLTFError(extension, strideElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, strideElement) + " must be 4 or 8 for OCTAHEDRAL."));
+				}
+			}
+			else if (filterElement->value == Constants::MESHOPT_FILTER_QUATERNION) {
+				if (stride != 8) {
+					validator.errors.push_back(Validator::GLTFError(extension, strideElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, strideElement) + " must be 8 for QUATERNION."));
+				}
+			}
+			else if (filterElement->value != Constants::MESHOPT_FILTER_EXPONENTIAL) {
+				validator.errors.push_back(Validator::GLTFError(extension, filterElement, validator.ErrorMessageValue(FILE_FUNCTION_LINE, filterElement) + " must be " +
+					Constants::MESHOPT_FILTER_NONE + ", " + Constants::MESHOPT_FILTER_OCTAHEDRAL + ", " + Constants::MESHOPT_FILTER_QUATERNION + ", or " + Constants::MESHOPT_FILTER_EXPONENTIAL + "."));
+			}
+		}
+	}
+}
@@ -0,0 +1,565 @@
+#pragma once
+#include "MeshoptDecoder.hpp"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Encoder matching MeshoptDecoder.hpp, used to produce EXT_meshopt_compression streams and test data
+namespace Meshopt {
+	/// <summary>
+	/// Worst-case size of an encoded attribute stream.
+	/// </summary>
+	inline size_t Encode_Vertex_Buffer_Bound(size_t vertexCount, size_t vertexSize) {
+		size_t blockSize = Vertex_Block_Size(vertexSize);
+		size_t blockCount = (vertexCount + blockSize - 1) / blockSize;
+		size_t blockHeaderSize = (blockSize / Constants::BYTE_GROUP_SIZE + 3) / 4;
+		size_t tailSize = vertexSize < Constants::TAIL_MAX_SIZE ? Constants::TAIL_MAX_SIZE : vertexSize;
+		return 1 + blockCount * vertexSize * (blockHeaderSize + blockSize) + tailSize;
+	}
+
+	/// <summary>
+	/// Worst-case size of an encoded triangle list.
+	/// </summary>
+	inline size_t Encode_Index_Buffer_Bound(size_t indexCount, size_t vertexCount) {
+		unsigned int vertexBits = 1;
+		while (vertexBits < 32 && vertexCount > size_t(1) << vertexBits) {
+			++vertexBits;
+		}
+		// Code byte, codeaux byte and three zigzag varints
+		unsigned int vertexGroups = (vertexBits + 1 + 6) / 7;
+		return 1 + (indexCount / 3) * (2 + 3 * vertexGroups) + Constants::INDEX_TAIL_SIZE;
+	}
+
+	/// <summary>
+	/// Worst-case size of an encoded index sequence.
+	/// </summary>
+	inline size_t Encode_Index_Sequence_Bound(size_t indexCount, size_t vertexCount) {
+		unsigned int vertexBits = 1;
+		while (vertexBits < 32 && vertexCount > size_t(1) << vertexBits) {
+			++vertexBits;
+		}
+		// Zigzag sign bit and baseline bit
+		unsigned int vertexGroups = (vertexBits + 1 + 1 + 6) / 7;
+		return 1 + indexCount * vertexGroups + Constants::SEQUENCE_TAIL_SIZE;
+	}
+
+	inline unsigned char Zigzag_8(unsigned char value) {
+		return static_cast<unsigned char>((static_cast<signed char>(value) >> 7) ^ (value << 1));
+	}
+
+	inline void Encode_VByte(unsigned char*& data, unsigned int value) {
+		do {
+			*data++ = static_cast<unsigned char>((value & 127) | (value > 127 ? 128 : 0));
+			value >>= 7;
+		} while (value);
+	}
+
+	inline void Encode_Index(unsigned char*& data, unsigned int index, unsigned int last) {
+		unsigned int delta = index - last;
+		unsigned int value = (delta << 1) ^ (int(delta) >> 31);
+		Encode_VByte(data, value);
+	}
+
+	/// <summary>
+	/// Encoded size of a byte group for a selector width.
+	/// </summary>
+	/// <returns>size_t(-1) when 'bits' cannot represent the group</returns>
+	inline size_t Encode_Bytes_Group_Measure(unsigned char const* buffer, int bits) {
+		if (bits == 1) {
+			for (size_t i = 0; i < Constants::BYTE_GROUP_SIZE; ++i) {
+				if (buffer[i] != 0) {
+					return size_t(-1);
+				}
+			}
+			return 0;
+		}
+
+		if (bits == 8) {
+			return Constants::BYTE_GROUP_SIZE;
+		}
+
+		size_t result = Constants::BYTE_GROUP_SIZE * bits / 8;
+		unsigned char sentinel = static_cast<unsigned char>((1 << bits) - 1);
+		for (size_t i = 0; i < Constants::BYTE_GROUP_SIZE; ++i) {
+			result += buffer[i] >= sentinel;
+		}
+		return result;
+	}
+
+	inline unsigned char* Encode_Bytes_Group(unsigned char* data, unsigned char const* buffer, int bits) {
+		if (bits == 1) {
+			return data;
+		}
+
+		if (bits == 8) {
+			memcpy(data, buffer, Constants::BYTE_GROUP_SIZE);
+			return data + Constants::BYTE_GROUP_SIZE;
+		}
+
+		size_t perByte = 8 / bits;
+		unsigned char sentinel = static_cast<unsigned char>((1 << bits) - 1);
+
+		// Selectors, values that do not fit are replaced by the sentinel
+		for (size_t i = 0; i < Constants::BYTE_GROUP_SIZE; i += perByte) {
+			unsigned char byte = 0;
+			for (size_t k = 0; k < perByte; ++k) {
+				unsigned char encoded = buffer[i + k] >= sentinel ? sentinel : buffer[i + k];
+				byte = static_cast<unsigned char>((byte << bits) | encoded);
+			}
+			*data++ = byte;
+		}
+
+		// Escaped values
+		for (size_t i = 0; i < Constants::BYTE_GROUP_SIZE; ++i) {
+			if (buffer[i] >= sentinel) {
+				*data++ = buffer[i];
+			}
+		}
+
+		return data;
+	}
+
+	inline unsigned char* Encode_Bytes(unsigned char* data, unsigned char* dataEnd, unsigned char const* buffer, size_t bufferSize) {
+		unsigned char* header = data;
+		size_t headerSize = ((bufferSize / Constants::BYTE_GROUP_SIZE) + 3) / 4;
+		if (size_t(dataEnd - data) < headerSize) {
+			return nullptr;
+		}
+
+		data += headerSize;
+		memset(header, 0, headerSize);
+
+		for (size_t i = 0; i < bufferSize; i += Constants::BYTE_GROUP_SIZE) {
+			// Keep the decoder's read limit valid for every group
+			if (size_t(dataEnd - data) < Constants::BYTE_GROUP_DECODE_LIMIT) {
+				return nullptr;
+			}
+
+			int bestBits = 8;
+			size_t bestSize = Encode_Bytes_Group_Measure(buffer + i, 8);
+			for (int bits = 1; bits < 8; bits *= 2) {
+				size_t size = Encode_Bytes_Group_Measure(buffer + i, bits);
+				if (size < bestSize) {
+					bestBits = bits;
+					bestSize = size;
+				}
+			}
+
+			int bitsLog2 = bestBits == 1 ? 0 : bestBits == 2 ? 1 : bestBits == 4 ? 2 : 3;
+			size_t headerOffset = i / Constants::BYTE_GROUP_SIZE;
+			header[headerOffset / 4] |= static_cast<unsigned char>(bitsLog2 << ((headerOffset % 4) * 2));
+
+			data = Encode_Bytes_Group(data, buffer + i, bestBits);
+		}
+
+		return data;
+	}
+
+	inline unsigned char* Encode_Vertex_Block(unsigned char* data, unsigned char* dataEnd, unsigned char const* vertexData, size_t vertexCount, size_t vertexSize, unsigned char lastVertex[256]) {
+		unsigned char buffer[Constants::VERTEX_BLOCK_MAX_SIZE];
+		// Padding past vertexCount is encoded as zero deltas
+		memset(buffer, 0, sizeof(buffer));
+
+		size_t vertexCountAligned = (vertexCount + Constants::BYTE_GROUP_SIZE - 1) & ~(Constants::BYTE_GROUP_SIZE - 1);
+
+		for (size_t k = 0; k < vertexSize; ++k) {
+			unsigned char previous = lastVertex[k];
+			for (size_t i = 0; i < vertexCount; ++i) {
+				unsigned char value = vertexData[i * vertexSize + k];
+				buffer[i] = Zigzag_8(static_cast<unsigned char>(value - previous));
+				previous = value;
+			}
+
+			data = Encode_Bytes(data, dataEnd, buffer, vertexCountAligned);
+			if (!data) {
+				return nullptr;
+			}
+		}
+
+		memcpy(lastVertex, vertexData + (vertexCount - 1) * vertexSize, vertexSize);
+		return data;
+	}
+
+	/// <summary>
+	/// Encodes an attribute stream (mode ATTRIBUTES).
+	/// </summary>
+	/// <param name="vertexSize">Multiple of 4, at most 256</param>
+	/// <returns>Encoded data, empty if the parameters are invalid</returns>
+	inline std::vector<unsigned char> Encode_Vertex_Buffer(void const* vertices, size_t vertexCount, size_t vertexSize) {
+		if (vertexSize == 0 || vertexSize > 256 || vertexSize % 4 != 0) {
+			return std::vector<unsigned char>();
+		}
+
+		std::vector<unsigned char> buffer(Encode_Vertex_Buffer_Bound(vertexCount, vertexSize));
+		unsigned char const* vertexData = static_cast<unsigned char const*>(vertices);
+		unsigned char* data = buffer.data();
+		unsigned char* dataEnd = buffer.data() + buffer.size();
+
+		*data++ = Constants::VERTEX_HEADER;
+
+		unsigned char firstVertex[256] = {};
+		if (vertexCount > 0) {
+			memcpy(firstVertex, vertexData, vertexSize);
+		}
+
+		unsigned char lastVertex[256] = {};
+		memcpy(lastVertex, firstVertex, vertexSize);
+
+		size_t blockSize = Vertex_Block_Size(vertexSize);
+		for (size_t offset = 0; offset < vertexCount; offset += blockSize) {
+			size_t count = std::min(blockSize, vertexCount - offset);
+			data = Encode_Vertex_Block(data, dataEnd, vertexData + offset * vertexSize, count, vertexSize, lastVertex);
+			if (!data) {
+				return std::vector<unsigned char>();
+			}
+		}
+
+		// First vertex padded to the tail size, gives the decoder its baseline and read padding
+		if (vertexSize < Constants::TAIL_MAX_SIZE) {
+			memset(data, 0, Constants::TAIL_MAX_SIZE - vertexSize);
+			data += Constants::TAIL_MAX_SIZE - vertexSize;
+		}
+		memcpy(data, firstVertex, vertexSize);
+		data += vertexSize;
+
+		buffer.resize(data - buffer.data());
+		return buffer;
+	}
+
+	/// <summary>
+	/// Encodes a triangle list (mode TRIANGLES), works best on vertex cache optimized and vertex fetch ordered meshes.
+	/// Triangle order is kept but the vertices of a triangle may be rotated, winding is unchanged.
+	/// </summary>
+	/// <param name="indexCount">Multiple of 3</param>
+	inline std::vector<unsigned char> Encode_Index_Buffer(unsigned int const* indices, size_t indexCount, size_t vertexCount) {
+		if (indexCount % 3 != 0) {
+			return std::vector<unsigned char>();
+		}
+
+		// Codeaux pairs of (feb, fec) that can be referenced by a single code nibble
+		static const unsigned char codeAuxTable[16] = {
+			0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69,
+			0, 0
+		};
+		static const unsigned int triangleOrder[3][3] = {
+			{ 0, 1, 2 },
+			{ 1, 2, 0 },
+			{ 2, 0, 1 }
+		};
+
+		std::vector<unsigned char> buffer(Encode_Index_Buffer_Bound(indexCount, vertexCount));
+		buffer[0] = static_cast<unsigned char>(Constants::INDEX_HEADER | 1);
+
+		unsigned int edgeFifo[16][2];
+		unsigned int vertexFifo[16];
+		memset(edgeFifo, -1, sizeof(edgeFifo));
+		memset(vertexFifo, -1, sizeof(vertexFifo));
+		size_t edgeFifoOffset = 0;
+		size_t vertexFifoOffset = 0;
+
+		auto findEdge = [&](unsigned int a, unsigned int b, unsigned int c) -> int {
+			for (int i = 0; i < 16; ++i) {
+				size_t index = (edgeFifoOffset - 1 - i) & 15;
+				unsigned int e0 = edgeFifo[index][0];
+				unsigned int e1 = edgeFifo[index][1];
+				if (e0 == a && e1 == b) {
+					return (i << 2) | 0;
+				}
+				if (e0 == b && e1 == c) {
+					return (i << 2) | 1;
+				}
+				if (e0 == c && e1 == a) {
+					return (i << 2) | 2;
+				}
+			}
+			return -1;
+		};
+
+		auto findVertex = [&](unsigned int v) -> int {
+			for (int i = 0; i < 16; ++i) {
+				if (vertexFifo[(vertexFifoOffset - 1 - i) & 15] == v) {
+					return i;
+				}
+			}
+			return -1;
+		};
+
+		auto pushEdge = [&](unsigned int a, unsigned int b) {
+			edgeFifo[edgeFifoOffset][0] = a;
+			edgeFifo[edgeFifoOffset][1] = b;
+			edgeFifoOffset = (edgeFifoOffset + 1) & 15;
+		};
+
+		auto pushVertex = [&](unsigned int v) {
+			vertexFifo[vertexFifoOffset] = v;
+			vertexFifoOffset = (vertexFifoOffset + 1) & 15;
+		};
+
+		unsigned int next = 0;
+		unsigned int last = 0;
+
+		unsigned char* code = buffer.data() + 1;
+		unsigned char* data = code + indexCount / 3;
+		unsigned char* dataSafeEnd = buffer.data() + buffer.size() - Constants::INDEX_TAIL_SIZE;
+
+		for (size_t i = 0; i < indexCount; i += 3) {
+			if (data > dataSafeEnd) {
+				return std::vector<unsigned char>();
+			}
+
+			int edge = findEdge(indices[i + 0], indices[i + 1], indices[i + 2]);
+
+			if (edge >= 0 && (edge >> 2) < 15) {
+				unsigned int const* order = triangleOrder[edge & 3];
+				unsigned int a = indices[i + order[0]];
+				unsigned int b = indices[i + order[1]];
+				unsigned int c = indices[i + order[2]];
+
+				int fe = edge >> 2;
+				int fc = findVertex(c);
+				int fec = (fc >= 1 && fc < Constants::EDGE_FIFO_CACHE_LIMIT) ? fc : (c == next) ? (++next, 0) : 15;
+
+				// Strip-like sequences step the last free index by one
+				if (fec == 15 && c + 1 == last) {
+					fec = 13;
+					last = c;
+				}
+				if (fec == 15 && c == last + 1) {
+					fec = 14;
+					last = c;
+				}
+
+				*code++ = static_cast<unsigned char>((fe << 4) | fec);
+
+				if (fec == 15) {
+					Encode_Index(data, c, last);
+					last = c;
+				}
+
+				if (fec == 0 || fec >= Constants::EDGE_FIFO_CACHE_LIMIT) {
+					pushVertex(c);
+				}
+
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+			else {
+				// Rotate so the first vertex is most likely 'next'
+				int rotation = indices[i + 1] == next ? 1 : indices[i + 2] == next ? 2 : 0;
+				unsigned int const* order = triangleOrder[rotation];
+				unsigned int a = indices[i + order[0]];
+				unsigned int b = indices[i + order[1]];
+				unsigned int c = indices[i + order[2]];
+
+				// Restart 'next' when a new disconnected range starts at zero
+				bool reset = false;
+				if (a == 0 && b == 1 && c == 2 && next > 0) {
+					reset = true;
+					next = 0;
+					// Old fifo entries must not be referenced after the restart
+					memset(vertexFifo, -1, sizeof(vertexFifo));
+				}
+
+				int fb = findVertex(b);
+				int fc = findVertex(c);
+
+				int fea = (a == next) ? (++next, 0) : 15;
+				int feb = (fb >= 0 && fb < 14) ? (fb + 1) : (b == next) ? (++next, 0) : 15;
+				int fec = (fc >= 0 && fc < 14) ? (fc + 1) : (c == next) ? (++next, 0) : 15;
+
+				unsigned char codeAux = static_cast<unsigned char>((feb << 4) | fec);
+				int codeAuxIndex = -1;
+				for (int k = 0; k < 14; ++k) {
+					if (codeAuxTable[k] == codeAux) {
+						codeAuxIndex = k;
+						break;
+					}
+				}
+
+				if (fea == 0 && codeAuxIndex >= 0 && !reset) {
+					*code++ = static_cast<unsigned char>((15 << 4) | codeAuxIndex);
+				}
+				else {
+					*code++ = static_cast<unsigned char>((15 << 4) | 14 | fea);
+					*data++ = codeAux;
+				}
+
+				if (fea == 15) {
+					Encode_Index(data, a, last);
+					last = a;
+				}
+				if (feb == 15) {
+					Encode_Index(data, b, last);
+					last = b;
+				}
+				if (fec == 15) {
+					Encode_Index(data, c, last);
+					last = c;
+				}
+
+				if (fea == 0 || fea == 15) {
+					pushVertex(a);
+				}
+				if (feb == 0 || feb == 15) {
+					pushVertex(b);
+				}
+				if (fec == 0 || fec == 15) {
+					pushVertex(c);
+				}
+
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+		}
+
+		if (data > dataSafeEnd) {
+			return std::vector<unsigned char>();
+		}
+
+		// Codeaux table doubles as the decoder's read padding
+		memcpy(data, codeAuxTable, Constants::INDEX_TAIL_SIZE);
+		data += Constants::INDEX_TAIL_SIZE;
+
+		buffer.resize(data - buffer.data());
+		return buffer;
+	}
+
+	/// <summary>
+	/// Encodes an arbitrary index list (mode INDICES).
+	/// </summary>
+	inline std::vector<unsigned char> Encode_Index_Sequence(unsigned int const* indices, size_t indexCount, size_t vertexCount) {
+		std::vector<unsigned char> buffer(Encode_Index_Sequence_Bound(indexCount, vertexCount));
+		buffer[0] = static_cast<unsigned char>(Constants::SEQUENCE_HEADER | 1);
+
+		unsigned int last[2] = { 0, 0 };
+		unsigned int current = 0;
+
+		unsigned char* data = buffer.data() + 1;
+		unsigned char* dataSafeEnd = buffer.data() + buffer.size() - Constants::SEQUENCE_TAIL_SIZE;
+
+		for (size_t i = 0; i < indexCount; ++i) {
+			if (data >= dataSafeEnd) {
+				return std::vector<unsigned char>();
+			}
+
+			unsigned int index = indices[i];
+
+			// Switch baselines when the delta no longer fits in a single byte
+			int distance = int(index - last[current]);
+			current ^= static_cast<unsigned int>((distance < 0 ? -distance : distance) >= 30);
+
+			unsigned int delta = index - last[current];
+			unsigned int value = (delta << 1) ^ (int(delta) >> 31);
+			Encode_VByte(data, (value << 1) | current);
+
+			last[current] = index;
+		}
+
+		if (data > dataSafeEnd) {
+			return std::vector<unsigned char>();
+		}
+
+		memset(data, 0, Constants::SEQUENCE_TAIL_SIZE);
+		data += Constants::SEQUENCE_TAIL_SIZE;
+
+		buffer.resize(data - buffer.data());
+		return buffer;
+	}
+
+	inline int Quantize_Snorm(float value, int bits) {
+		const float scale = float((1 << (bits - 1)) - 1);
+		float round = value >= 0.0f ? 0.5f : -0.5f;
+		value = value >= -1.0f ? value : -1.0f;
+		value = value <= 1.0f ? value : 1.0f;
+		return int(value * scale + round);
+	}
+
+	/// <summary>
+	/// Octahedral encoding of unit vectors for the OCTAHEDRAL filter.
+	/// </summary>
+	/// <param name="stride">4 (8-bit) or 8 (16-bit)</param>
+	/// <param name="bits">Precision of x/y, at most stride * 2</param>
+	/// <param name="data">count * 4 floats, w is stored at full precision</param>
+	inline void Encode_Octahedral_Filter(void* destination, size_t count, size_t stride, int bits, float const* data) {
+		int byteBits = int(stride * 2);
+
+		for (size_t i = 0; i < count; ++i) {
+			float const* n = &data[i * 4];
+
+			float nx = n[0], ny = n[1], nz = n[2], nw = n[3];
+			float length = std::fabs(nx) + std::fabs(ny) + std::fabs(nz);
+			float scale = length == 0.0f ? 0.0f : 1.0f / length;
+			nx *= scale;
+			ny *= scale;
+
+			float u = nz >= 0.0f ? nx : (1.0f - std::fabs(ny)) * (nx >= 0.0f ? 1.0f : -1.0f);
+			float v = nz >= 0.0f ? ny : (1.0f - std::fabs(nx)) * (ny >= 0.0f ? 1.0f : -1.0f);
+
+			int encoded[4] = { Quantize_Snorm(u, bits), Quantize_Snorm(v, bits), Quantize_Snorm(1.0f, bits), Quantize_Snorm(nw, byteBits) };
+
+			for (size_t k = 0; k < 4; ++k) {
+				if (stride == 4) {
+					static_cast<signed char*>(destination)[i * 4 + k] = static_cast<signed char>(encoded[k]);
+				}
+				else {
+					static_cast<short*>(destination)[i * 4 + k] = static_cast<short>(encoded[k]);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Smallest three encoding of unit quaternions for the QUATERNION filter, output stride is 8.
+	/// </summary>
+	/// <param name="bits">Precision of each component, [4, 16]</param>
+	inline void Encode_Quaternion_Filter(void* destination, size_t count, int bits, float const* data) {
+		const float scaler = std::sqrt(2.0f);
+
+		for (size_t i = 0; i < count; ++i) {
+			float const* q = &data[i * 4];
+			short* d = &static_cast<short*>(destination)[i * 4];
+
+			int largest = 0;
+			for (int k = 1; k < 4; ++k) {
+				largest = std::fabs(q[k]) > std::fabs(q[largest]) ? k : largest;
+			}
+
+			// q and -q are the same rotation, the largest component is made positive
+			float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+			d[0] = static_cast<short>(Quantize_Snorm(q[(largest + 1) & 3] * scaler * sign, bits));
+			d[1] = static_cast<short>(Quantize_Snorm(q[(largest + 2) & 3] * scaler * sign, bits));
+			d[2] = static_cast<short>(Quantize_Snorm(q[(largest + 3) & 3] * scaler * sign, bits));
+			d[3] = static_cast<short>((Quantize_Snorm(1.0f, bits) & ~3) | largest);
+		}
+	}
+
+	/// <summary>
+	/// Mantissa and exponent encoding of floats for the EXPONENTIAL filter.
+	/// </summary>
+	/// <param name="stride">Multiple of 4</param>
+	/// <param name="bits">Mantissa precision including sign, [1, 24]</param>
+	inline void Encode_Exponential_Filter(void* destination, size_t count, size_t stride, int bits, float const* data) {
+		unsigned int* d = static_cast<unsigned int*>(destination);
+		size_t floatCount = count * (stride / sizeof(float));
+
+		for (size_t i = 0; i < floatCount; ++i) {
+			int exponent;
+			std::frexp(data[i], &exponent);
+
+			// Leave 'bits' for the mantissa, clamped to keep 2^exponent a normal float
+			exponent -= bits - 1;
+			exponent = exponent < -100 ? -100 : exponent;
+
+			int mantissa = int(std::ldexp(data[i], -exponent) + (data[i] >= 0.0f ? 0.5f : -0.5f));
+			// Rounding may overflow the mantissa into the next power of two
+			if (mantissa >= (1 << (bits - 1)) || mantissa < -(1 << (bits - 1))) {
+				++exponent;
+				mantissa = int(std::ldexp(data[i], -exponent) + (data[i] >= 0.0f ? 0.5f : -0.5f));
+			}
+
+			d[i] = (unsigned(mantissa) & 0xffffff) | (unsigned(exponent) << 24);
+		}
+	}
+}
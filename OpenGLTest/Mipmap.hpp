@@ -0,0 +1,406 @@
+#pragma once
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Mip chains built on the CPU, filtered in linear space so they can be uploaded or baked instead of generated on the GPU
+namespace Mipmap {
+	// Floats filtered by one task, rows are grouped until a task has at least this many
+	constexpr size_t ROW_CHUNK_FLOATS = 1 << 16;
+	// Support radius of the windowed sinc filters, in destination pixels
+	constexpr float SINC_RADIUS = 3.0f;
+	// Shape of the Kaiser window, higher is smoother with less ringing
+	constexpr float KAISER_ALPHA = 4.0f;
+	// Halvings of the alpha scale searched for when preserving coverage
+	constexpr int COVERAGE_ITERATIONS = 16;
+	// Alpha scales searched for when preserving coverage lie in [0, MAXIMUM_ALPHA_SCALE]
+	constexpr float MAXIMUM_ALPHA_SCALE = 16.0f;
+	// Entries of the linear to sRGB table, fine enough that every byte rounds the same as the exact curve
+	constexpr size_t SRGB_TABLE_SIZE = 1 << 16;
+
+	enum class Filter {
+		// Average of the pixels under each destination pixel, cheapest and softest
+		Box,
+		// Sinc windowed by a Kaiser window, sharp with little ringing
+		Kaiser,
+		// Lanczos 3, sharpest with visible ringing on hard edges
+		Lanczos
+	};
+
+	struct MipSettings {
+		Filter filter = Filter::Box;
+		// Colour channels are stored in sRGB, they are converted to linear before filtering
+		bool srgb = false;
+		// Cutoff of an alphaMode MASK material, negative when alpha coverage does not need to be preserved
+		float alphaCutoff = -1.0f;
+	};
+
+	inline int Level_Count(int width, int height) {
+		int levels = 1;
+		for (int size = std::max(width, height); size > 1; size /= 2) {
+			++levels;
+		}
+		return levels;
+	}
+
+	inline int Level_Size(int size, int level) {
+		return std::max(size >> level, 1);
+	}
+
+	/// <summary>
+	/// Channel holding alpha, -1 when there is none. Two channel images are luminance and alpha.
+	/// </summary>
+	inline int Alpha_Channel(int channels) {
+		return channels == 4 ? 3 : channels == 2 ? 1 : -1;
+	}
+
+	inline float Srgb_To_Linear(float value) {
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline float Linear_To_Srgb(float value) {
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	inline float const* Srgb_Decode_Table() {
+		static std::vector<float> const table = []() {
+			std::vector<float> values(256);
+			for (size_t index = 0; index < values.size(); ++index) {
+				values[index] = Srgb_To_Linear(float(index) / 255.0f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	inline unsigned char const* Srgb_Encode_Table() {
+		static std::vector<unsigned char> const table = []() {
+			std::vector<unsigned char> values(SRGB_TABLE_SIZE);
+			for (size_t index = 0; index < values.size(); ++index) {
+				values[index] = (unsigned char)std::lround(Linear_To_Srgb(float(index) / float(SRGB_TABLE_SIZE - 1)) * 255.0f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	/// <summary>
+	/// Filter weights for every destination pixel along one axis, padded to the same number of taps so the kernels have no inner branches.
+	/// Taps that fall outside the image are folded into the edge pixel.
+	/// </summary>
+	struct Taps {
+		int count = 0;
+		std::vector<int> first;
+		std::vector<float> weights;
+
+		Taps() = default;
+		Taps(Taps const&) = default;
+		Taps(Taps&&) = default;
+
+		Taps& operator=(Taps const&) = default;
+		Taps& operator=(Taps&&) = default;
+	};
+
+	inline double Bessel_I0(double value) {
+		double sum = 1.0;
+		double term = 1.0;
+		double half = value * 0.5;
+		for (int k = 1; k < 32 && term > sum * 1e-12; ++k) {
+			term *= (half / k) * (half / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	inline double Sinc(double value) {
+		if (std::abs(value) < 1e-8) {
+			return 1.0;
+		}
+		double angle = 3.14159265358979323846 * value;
+		return std::sin(angle) / angle;
+	}
+
+	/// <param name="distance">Distance from the destination pixel centre, in destination pixels</param>
+	inline double Filter_Weight(Filter filter, double distance) {
+		distance = std::abs(distance);
+		switch (filter) {
+		case Filter::Box:
+			return distance <= 0.5 ? 1.0 : 0.0;
+		case Filter::Kaiser: {
+			if (distance >= SINC_RADIUS) {
+				return 0.0;
+			}
+			double ratio = distance / SINC_RADIUS;
+			return Sinc(distance) * Bessel_I0(KAISER_ALPHA * std::sqrt(1.0 - ratio * ratio)) / Bessel_I0(KAISER_ALPHA);
+		}
+		case Filter::Lanczos:
+			return distance < SINC_RADIUS ? Sinc(distance) * Sinc(distance / SINC_RADIUS) : 0.0;
+		}
+		return 0.0;
+	}
+
+	inline double Filter_Radius(Filter filter) {
+		return filter == Filter::Box ? 0.5 : double(SINC_RADIUS);
+	}
+
+	inline Taps Filter_Taps(int source, int destination, Filter filter) {
+		Taps taps;
+		double scale = double(source) / double(destination);
+		double radius = Filter_Radius(filter) * scale;
+		std::vector<std::vector<double>> weights(destination);
+		taps.first.resize(destination);
+		for (int pixel = 0; pixel < destination; ++pixel) {
+			double centre = (pixel + 0.5) * scale;
+			int low = int(std::floor(centre - radius - 0.5));
+			int high = int(std::ceil(centre + radius - 0.5));
+			int first = std::max(low, 0);
+			int last = std::min(high, source - 1);
+			std::vector<double>& pixelWeights = weights[pixel];
+			pixelWeights.assign(size_t(last - first + 1), 0.0);
+			double total = 0.0;
+			for (int index = low; index <= high; ++index) {
+				double weight = Filter_Weight(filter, (index + 0.5 - centre) / scale);
+				pixelWeights[size_t(std::clamp(index, first, last) - first)] += weight;
+				total += weight;
+			}
+			for (double& weight : pixelWeights) {
+				weight /= total;
+			}
+			// Trim zero weights off both ends, the box filter reaches one pixel further than it samples
+			size_t begin = 0;
+			size_t end = pixelWeights.size();
+			while (end - begin > 1 && pixelWeights[begin] == 0.0) {
+				++begin;
+			}
+			while (end - begin > 1 && pixelWeights[end - 1] == 0.0) {
+				--end;
+			}
+			pixelWeights = std::vector<double>(pixelWeights.begin() + begin, pixelWeights.begin() + end);
+			taps.first[pixel] = first + int(begin);
+			taps.count = std::max(taps.count, int(pixelWeights.size()));
+		}
+		taps.weights.assign(size_t(destination) * size_t(taps.count), 0.0f);
+		for (int pixel = 0; pixel < destination; ++pixel) {
+			// Padding taps have no weight, pull the window back so they still read inside the image
+			int shift = std::max(taps.first[pixel] + taps.count - source, 0);
+			taps.first[pixel] -= shift;
+			for (size_t tap = 0; tap < weights[pixel].size(); ++tap) {
+				taps.weights[size_t(pixel) * size_t(taps.count) + size_t(shift) + tap] = float(weights[pixel][tap]);
+			}
+		}
+		return taps;
+	}
+
+	inline void For_Rows(ThreadPool* pool, size_t rows, size_t rowFloats, std::function<void(size_t, size_t)> const& function) {
+		size_t grain = std::max(ROW_CHUNK_FLOATS / std::max(rowFloats, size_t(1)), size_t(1));
+		if (pool == nullptr) {
+			function(0, rows);
+			return;
+		}
+		pool->Parallel_For(rows, grain, function);
+	}
+
+	/// <summary>
+	/// destination = sum of weights[tap] * rows[tap], every row 'length' floats long.
+	/// </summary>
+	inline void Weighted_Row_Sum(float const* const* rows, float const* weights, int taps, float* destination, size_t length) {
+		size_t index = 0;
+#if defined(SIMD_AVX2)
+		if (Simd::Has_Avx2()) {
+			for (; index + 8 <= length; index += 8) {
+				__m256 sum = _mm256_setzero_ps();
+				for (int tap = 0; tap < taps; ++tap) {
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[tap]), _mm256_loadu_ps(rows[tap] + index)));
+				}
+				_mm256_storeu_ps(destination + index, sum);
+			}
+		}
+#endif
+#if defined(SIMD_SSE)
+		for (; index + 4 <= length; index += 4) {
+			__m128 sum = _mm_setzero_ps();
+			for (int tap = 0; tap < taps; ++tap) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(rows[tap] + index)));
+			}
+			_mm_storeu_ps(destination + index, sum);
+		}
+#endif
+		for (; index < length; ++index) {
+			float sum = 0.0f;
+			for (int tap = 0; tap < taps; ++tap) {
+				sum += weights[tap] * rows[tap][index];
+			}
+			destination[index] = sum;
+		}
+	}
+
+	/// <summary>
+	/// Filters one row along x, pixels are 'channels' floats.
+	/// </summary>
+	inline void Filter_Row(float const* source, Taps const& taps, int destinationWidth, int channels, float* destination) {
+#if defined(SIMD_SSE)
+		if (channels == 4) {
+			for (int pixel = 0; pixel < destinationWidth; ++pixel) {
+				float const* weights = taps.weights.data() + size_t(pixel) * size_t(taps.count);
+				float const* read = source + size_t(taps.first[pixel]) * 4;
+				__m128 sum = _mm_setzero_ps();
+				for (int tap = 0; tap < taps.count; ++tap) {
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(read + size_t(tap) * 4)));
+				}
+				_mm_storeu_ps(destination + size_t(pixel) * 4, sum);
+			}
+			return;
+		}
+#endif
+		for (int pixel = 0; pixel < destinationWidth; ++pixel) {
+			float const* weights = taps.weights.data() + size_t(pixel) * size_t(taps.count);
+			float const* read = source + size_t(taps.first[pixel]) * size_t(channels);
+			for (int channel = 0; channel < channels; ++channel) {
+				float sum = 0.0f;
+				for (int tap = 0; tap < taps.count; ++tap) {
+					sum += weights[tap] * read[size_t(tap) * size_t(channels) + size_t(channel)];
+				}
+				destination[size_t(pixel) * size_t(channels) + size_t(channel)] = sum;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Resamples a float image, y first so the x pass runs over the fewer rows.
+	/// </summary>
+	inline std::vector<float> Resample(std::vector<float> const& source, int width, int height, int channels, int destinationWidth, int destinationHeight, Filter filter, ThreadPool* pool = nullptr) {
+		Taps rowTaps = Filter_Taps(height, destinationHeight, filter);
+		Taps columnTaps = Filter_Taps(width, destinationWidth, filter);
+		size_t rowFloats = size_t(width) * size_t(channels);
+		size_t destinationRowFloats = size_t(destinationWidth) * size_t(channels);
+
+		std::vector<float> columns(size_t(destinationHeight) * rowFloats);
+		For_Rows(pool, size_t(destinationHeight), rowFloats * size_t(rowTaps.count), [&](size_t begin, size_t end) {
+			std::vector<float const*> rows(size_t(rowTaps.count));
+			for (size_t row = begin; row < end; ++row) {
+				for (int tap = 0; tap < rowTaps.count; ++tap) {
+					rows[size_t(tap)] = source.data() + size_t(rowTaps.first[row] + tap) * rowFloats;
+				}
+				Weighted_Row_Sum(rows.data(), rowTaps.weights.data() + row * size_t(rowTaps.count), rowTaps.count, columns.data() + row * rowFloats, rowFloats);
+			}
+		});
+
+		std::vector<float> destination(size_t(destinationHeight) * destinationRowFloats);
+		For_Rows(pool, size_t(destinationHeight), destinationRowFloats * size_t(columnTaps.count), [&](size_t begin, size_t end) {
+			for (size_t row = begin; row < end; ++row) {
+				Filter_Row(columns.data() + row * rowFloats, columnTaps, destinationWidth, channels, destination.data() + row * destinationRowFloats);
+			}
+		});
+		return destination;
+	}
+
+	inline std::vector<float> To_Linear(unsigned char const* pixels, size_t pixelCount, int channels, bool srgb, ThreadPool* pool = nullptr) {
+		std::vector<float> linear(pixelCount * size_t(channels));
+		float const* decode = Srgb_Decode_Table();
+		int alpha = Alpha_Channel(channels);
+		For_Rows(pool, pixelCount, size_t(channels), [&](size_t begin, size_t end) {
+			for (size_t pixel = begin; pixel < end; ++pixel) {
+				for (int channel = 0; channel < channels; ++channel) {
+					size_t index = pixel * size_t(channels) + size_t(channel);
+					linear[index] = srgb && channel != alpha ? decode[pixels[index]] : float(pixels[index]) * (1.0f / 255.0f);
+				}
+			}
+		});
+		return linear;
+	}
+
+	/// <summary>
+	/// Quantizes a filtered level, colour channels are rounded in sRGB space when 'srgb' is set.
+	/// </summary>
+	/// <param name="alphaScale">Multiplies alpha before it is clamped, used to preserve coverage</param>
+	inline std::vector<unsigned char> From_Linear(std::vector<float> const& linear, int channels, bool srgb, float alphaScale = 1.0f, ThreadPool* pool = nullptr) {
+		size_t pixelCount = linear.size() / size_t(channels);
+		std::vector<unsigned char> pixels(linear.size());
+		unsigned char const* encode = Srgb_Encode_Table();
+		int alpha = Alpha_Channel(channels);
+		For_Rows(pool, pixelCount, size_t(channels), [&](size_t begin, size_t end) {
+			for (size_t pixel = begin; pixel < end; ++pixel) {
+				for (int channel = 0; channel < channels; ++channel) {
+					size_t index = pixel * size_t(channels) + size_t(channel);
+					float value = std::clamp(channel == alpha ? linear[index] * alphaScale : linear[index], 0.0f, 1.0f);
+					if (srgb && channel != alpha) {
+						pixels[index] = encode[size_t(value * float(SRGB_TABLE_SIZE - 1) + 0.5f)];
+					}
+					else {
+						pixels[index] = (unsigned char)(value * 255.0f + 0.5f);
+					}
+				}
+			}
+		});
+		return pixels;
+	}
+
+	/// <summary>
+	/// Fraction of pixels that pass an alpha test at 'cutoff' once alpha is multiplied by 'scale' and rounded to a byte, as From_Linear stores it.
+	/// </summary>
+	inline float Alpha_Coverage(std::vector<float> const& linear, int channels, float cutoff, float scale = 1.0f) {
+		int alpha = Alpha_Channel(channels);
+		size_t pixelCount = linear.size() / size_t(channels);
+		if (alpha < 0 || pixelCount == 0) {
+			return 1.0f;
+		}
+		size_t covered = 0;
+		for (size_t pixel = 0; pixel < pixelCount; ++pixel) {
+			float value = std::clamp(linear[pixel * size_t(channels) + size_t(alpha)] * scale, 0.0f, 1.0f);
+			covered += float((unsigned char)(value * 255.0f + 0.5f)) / 255.0f > cutoff;
+		}
+		return float(covered) / float(pixelCount);
+	}
+
+	/// <summary>
+	/// Alpha scale that brings the coverage of a level closest to 'coverage', filtering blurs alpha so cutout materials thin out in the distance without it.
+	/// </summary>
+	inline float Coverage_Scale(std::vector<float> const& linear, int channels, float cutoff, float coverage) {
+		float low = 0.0f;
+		float high = MAXIMUM_ALPHA_SCALE;
+		for (int iteration = 0; iteration < COVERAGE_ITERATIONS; ++iteration) {
+			float middle = (low + high) * 0.5f;
+			if (Alpha_Coverage(linear, channels, cutoff, middle) < coverage) {
+				low = middle;
+			}
+			else {
+				high = middle;
+			}
+		}
+		float lowError = std::abs(Alpha_Coverage(linear, channels, cutoff, low) - coverage);
+		float highError = std::abs(Alpha_Coverage(linear, channels, cutoff, high) - coverage);
+		return lowError < highError ? low : high;
+	}
+
+	/// <summary>
+	/// Builds every level below the top of an 8 bit image, each level is filtered from the one above in linear space.
+	/// Levels can be uploaded with glTextureSubImage2D as they are, or baked next to the source.
+	/// </summary>
+	/// <returns>Levels 1 to Level_Count - 1, tightly packed</returns>
+	inline std::vector<std::vector<unsigned char>> Generate(unsigned char const* pixels, int width, int height, int channels, MipSettings const& settings, ThreadPool* pool = nullptr) {
+		if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": cannot build mipmaps for a " + std::to_string(width) + 'x' + std::to_string(height) + " image with " + std::to_string(channels) + " channels.");
+		}
+		std::vector<std::vector<unsigned char>> levels;
+		std::vector<float> linear = To_Linear(pixels, size_t(width) * size_t(height), channels, settings.srgb, pool);
+		bool preserveCoverage = settings.alphaCutoff >= 0.0f && Alpha_Channel(channels) >= 0;
+		float coverage = preserveCoverage ? Alpha_Coverage(linear, channels, settings.alphaCutoff) : 1.0f;
+		int levelCount = Level_Count(width, height);
+		for (int level = 1; level < levelCount; ++level) {
+			int levelWidth = Level_Size(width, level);
+			int levelHeight = Level_Size(height, level);
+			linear = Resample(linear, Level_Size(width, level - 1), Level_Size(height, level - 1), channels, levelWidth, levelHeight, settings.filter, pool);
+			// Only the stored level is scaled, the next level is filtered from unscaled alpha
+			float alphaScale = preserveCoverage ? Coverage_Scale(linear, channels, settings.alphaCutoff, coverage) : 1.0f;
+			levels.emplace_back(From_Linear(linear, channels, settings.srgb, alphaScale, pool));
+		}
+		return levels;
+	}
+}
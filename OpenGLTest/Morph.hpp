@@ -0,0 +1,331 @@
+#pragma once
+#include "Simd.hpp"
+#include "AccessorData.hpp"
+#include <GLAD\gl.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Morph target blending, targets are stored as runs of moving vertices so cost follows the vertices a target moves
+namespace Morph {
+	enum Stream : unsigned {
+		Position,
+		Normal,
+		Tangent,
+		StreamCount
+	};
+
+	// Floats per vertex of each stream, tangents keep w from the base attribute
+	constexpr static unsigned STREAM_WIDTH[StreamCount] = { 3, 3, 4 };
+
+	// Still vertices between two moving ones are stored as zero deltas when the gap is at most this, fewer and longer runs
+	constexpr static unsigned RUN_MERGE_GAP = 8;
+	// Gap used to coalesce the ranges uploaded after blending
+	constexpr static unsigned UPLOAD_MERGE_GAP = 256;
+
+	/// <summary>
+	/// Vertices [firstVertex, firstVertex + vertexCount), deltas of stream s start at deltaOffset * STREAM_WIDTH[s].
+	/// </summary>
+	struct Run {
+		unsigned firstVertex;
+		unsigned vertexCount;
+		unsigned deltaOffset;
+	};
+
+	struct SparseTarget {
+		std::vector<Run> runs;
+		// Empty when the target does not morph the stream
+		std::vector<float> deltas[StreamCount];
+	};
+
+	/// <summary>
+	/// Base attributes and sparse targets of a primitive.
+	/// </summary>
+	struct MorphMesh {
+		size_t vertexCount = 0;
+		// Empty when the primitive has no such attribute
+		std::vector<float> base[StreamCount];
+		std::vector<SparseTarget> targets;
+		// Union of the runs of every target, the only vertices blending can change
+		std::vector<Run> affected;
+
+		MorphMesh() = default;
+
+		/// <param name="threshold">Deltas at most this are treated as not moving the vertex</param>
+		MorphMesh(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Mesh::Primitive const& primitive, float threshold = 0.0f) {
+			std::string const semantics[StreamCount] = { GLTF::Constants::ATTRIBUTE_POSITION, GLTF::Constants::ATTRIBUTE_NORMAL, GLTF::Constants::ATTRIBUTE_TANGENT };
+
+			for (unsigned stream = 0; stream < StreamCount; ++stream) {
+				decltype(primitive.attributes)::const_iterator found = primitive.attributes.find(semantics[stream]);
+				if (found != primitive.attributes.cend()) {
+					base[stream] = GLTF::Read_Accessor_Float(doc, buffers, found->second);
+				}
+			}
+			if (base[Position].empty()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": primitive has no POSITION.");
+			}
+			vertexCount = base[Position].size() / 3;
+			for (unsigned stream = 0; stream < StreamCount; ++stream) {
+				if (!base[stream].empty() && base[stream].size() != vertexCount * STREAM_WIDTH[stream]) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": primitive attributes have different counts.");
+				}
+			}
+
+			size_t targetCount = 0;
+			for (decltype(primitive.targets)::const_reference target : primitive.targets) {
+				targetCount = std::max(targetCount, target.second.size());
+			}
+
+			for (size_t target = 0; target < targetCount; ++target) {
+				// Dense deltas of this target, tangent deltas are VEC3 and widened to 4 with w = 0
+				std::vector<float> dense[StreamCount];
+				for (unsigned stream = 0; stream < StreamCount; ++stream) {
+					decltype(primitive.targets)::const_iterator found = primitive.targets.find(semantics[stream]);
+					if (base[stream].empty() || found == primitive.targets.cend() || target >= found->second.size() || found->second[target] == GLTF::index_type(-1)) {
+						continue;
+					}
+
+					std::vector<float> values = GLTF::Read_Accessor_Float(doc, buffers, found->second[target]);
+					if (values.size() != vertexCount * 3) {
+						throw std::runtime_error(FILE_FUNCTION_LINE + ": morph target " + std::to_string(target) + " " + semantics[stream] + " count does not match the primitive.");
+					}
+					if (STREAM_WIDTH[stream] == 3) {
+						dense[stream] = std::move(values);
+					}
+					else {
+						dense[stream].assign(vertexCount * 4, 0.0f);
+						for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+							std::copy(values.data() + vertex * 3, values.data() + vertex * 3 + 3, dense[stream].data() + vertex * 4);
+						}
+					}
+				}
+
+				Add_Target(dense, threshold);
+			}
+		}
+
+		MorphMesh(MorphMesh const&) = default;
+		MorphMesh(MorphMesh&&) = default;
+
+		MorphMesh& operator=(MorphMesh const&) = default;
+		MorphMesh& operator=(MorphMesh&&) = default;
+
+		/// <summary>
+		/// Appends a target from dense deltas and widens 'affected' by the vertices it moves.
+		/// </summary>
+		/// <param name="dense">vertexCount * STREAM_WIDTH[s] floats for stream s, empty for streams the target does not morph</param>
+		/// <param name="threshold">Deltas at most this are treated as not moving the vertex</param>
+		void Add_Target(std::vector<float> const (&dense)[StreamCount], float threshold = 0.0f) {
+			// Vertices in the affected runs stay affected, their runs are rebuilt with the new ones
+			std::vector<bool> anyMoving(vertexCount, false);
+			for (Run const& run : affected) {
+				std::fill(anyMoving.begin() + run.firstVertex, anyMoving.begin() + run.firstVertex + run.vertexCount, true);
+			}
+
+			std::vector<bool> moving(vertexCount, false);
+			for (unsigned stream = 0; stream < StreamCount; ++stream) {
+				unsigned width = STREAM_WIDTH[stream];
+				if (!dense[stream].empty() && dense[stream].size() != vertexCount * width) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": target deltas do not match the vertex count.");
+				}
+				for (size_t vertex = 0; vertex < vertexCount && !dense[stream].empty(); ++vertex) {
+					for (unsigned component = 0; component < width; ++component) {
+						if (std::fabs(dense[stream][vertex * width + component]) > threshold) {
+							moving[vertex] = true;
+							anyMoving[vertex] = true;
+							break;
+						}
+					}
+				}
+			}
+
+			SparseTarget sparse;
+			sparse.runs = Build_Runs(moving, RUN_MERGE_GAP);
+			for (unsigned stream = 0; stream < StreamCount; ++stream) {
+				if (dense[stream].empty()) {
+					continue;
+				}
+				unsigned width = STREAM_WIDTH[stream];
+				for (Run const& run : sparse.runs) {
+					float const* first = dense[stream].data() + size_t(run.firstVertex) * width;
+					sparse.deltas[stream].insert(sparse.deltas[stream].end(), first, first + size_t(run.vertexCount) * width);
+				}
+			}
+			targets.emplace_back(std::move(sparse));
+			affected = Build_Runs(anyMoving, UPLOAD_MERGE_GAP);
+		}
+
+		size_t MemoryUsage() const {
+			size_t bytes = affected.size() * sizeof(Run);
+			for (SparseTarget const& target : targets) {
+				bytes += target.runs.size() * sizeof(Run);
+				for (unsigned stream = 0; stream < StreamCount; ++stream) {
+					bytes += target.deltas[stream].size() * sizeof(float);
+				}
+			}
+			return bytes;
+		}
+
+		/// <summary>
+		/// Groups flagged vertices into runs, gaps of at most 'mergeGap' unflagged vertices are included.
+		/// </summary>
+		static std::vector<Run> Build_Runs(std::vector<bool> const& flagged, unsigned mergeGap) {
+			std::vector<Run> runs;
+			unsigned offset = 0;
+			size_t vertex = 0;
+			while (vertex < flagged.size()) {
+				if (!flagged[vertex]) {
+					++vertex;
+					continue;
+				}
+
+				size_t first = vertex;
+				size_t last = vertex;
+				for (size_t next = vertex + 1; next < flagged.size() && next - last <= size_t(mergeGap) + 1; ++next) {
+					if (flagged[next]) {
+						last = next;
+					}
+				}
+
+				Run run;
+				run.firstVertex = static_cast<unsigned>(first);
+				run.vertexCount = static_cast<unsigned>(last - first + 1);
+				run.deltaOffset = offset;
+				offset += run.vertexCount;
+				runs.emplace_back(run);
+				vertex = last + 1;
+			}
+			return runs;
+		}
+	};
+
+	/// <summary>
+	/// Blended attributes of one mesh instance.
+	/// </summary>
+	struct MorphOutput {
+		std::vector<float> streams[StreamCount];
+		// Vertex ranges changed by the last Blend, first and count
+		std::vector<std::pair<size_t, size_t>> dirtyRanges;
+		std::vector<float> lastWeights;
+		bool initialized = false;
+	};
+
+	struct Settings {
+		// Targets with a smaller absolute weight are skipped
+		float weightEpsilon = 1e-4f;
+	};
+
+	struct Statistics {
+		size_t targetsBlended = 0;
+		size_t targetsSkipped = 0;
+		size_t verticesWritten = 0;
+	};
+
+	/// <summary>
+	/// destination[i] += weight * delta[i] for 'count' floats.
+	/// </summary>
+	inline void Accumulate(float* destination, float const* delta, size_t count, float weight) {
+		size_t index = 0;
+#if defined(SIMD_AVX2)
+		if (Simd::Has_Avx2()) {
+			__m256 weight8 = _mm256_set1_ps(weight);
+			for (; index + 8 <= count; index += 8) {
+				_mm256_storeu_ps(destination + index, _mm256_add_ps(_mm256_loadu_ps(destination + index), _mm256_mul_ps(weight8, _mm256_loadu_ps(delta + index))));
+			}
+		}
+#endif
+#if defined(SIMD_SSE)
+		__m128 weight4 = _mm_set1_ps(weight);
+		for (; index + 4 <= count; index += 4) {
+			_mm_storeu_ps(destination + index, _mm_add_ps(_mm_loadu_ps(destination + index), _mm_mul_ps(weight4, _mm_loadu_ps(delta + index))));
+		}
+#endif
+		for (; index < count; ++index) {
+			destination[index] += weight * delta[index];
+		}
+	}
+
+	/// <summary>
+	/// output = base + sum(weights[t] * target t), only the affected vertices are rewritten and only when the weights changed.
+	/// </summary>
+	inline Statistics Blend(MorphMesh const& mesh, float const* weights, size_t weightCount, MorphOutput& output, Settings const& settings = Settings()) {
+		Statistics statistics;
+		output.dirtyRanges.clear();
+
+		if (!output.initialized) {
+			for (unsigned stream = 0; stream < StreamCount; ++stream) {
+				output.streams[stream] = mesh.base[stream];
+			}
+			output.lastWeights.clear();
+			output.dirtyRanges.emplace_back(0, mesh.vertexCount);
+			output.initialized = true;
+		}
+
+		size_t count = std::min(weightCount, mesh.targets.size());
+		if (output.lastWeights.size() == count && std::equal(weights, weights + count, output.lastWeights.cbegin())) {
+			return statistics;
+		}
+		output.lastWeights.assign(weights, weights + count);
+
+		// Back to the base pose
+		for (unsigned stream = 0; stream < StreamCount; ++stream) {
+			if (mesh.base[stream].empty()) {
+				continue;
+			}
+			unsigned width = STREAM_WIDTH[stream];
+			for (Run const& run : mesh.affected) {
+				std::copy(mesh.base[stream].data() + size_t(run.firstVertex) * width, mesh.base[stream].data() + size_t(run.firstVertex + run.vertexCount) * width,
+					output.streams[stream].data() + size_t(run.firstVertex) * width);
+			}
+		}
+
+		for (size_t target = 0; target < count; ++target) {
+			float weight = weights[target];
+			if (std::fabs(weight) < settings.weightEpsilon) {
+				++statistics.targetsSkipped;
+				continue;
+			}
+			++statistics.targetsBlended;
+
+			SparseTarget const& sparse = mesh.targets[target];
+			for (unsigned stream = 0; stream < StreamCount; ++stream) {
+				if (sparse.deltas[stream].empty()) {
+					continue;
+				}
+				unsigned width = STREAM_WIDTH[stream];
+				for (Run const& run : sparse.runs) {
+					Accumulate(output.streams[stream].data() + size_t(run.firstVertex) * width, sparse.deltas[stream].data() + size_t(run.deltaOffset) * width, size_t(run.vertexCount) * width, weight);
+				}
+			}
+			for (Run const& run : sparse.runs) {
+				statistics.verticesWritten += run.vertexCount;
+			}
+		}
+
+		if (output.dirtyRanges.empty()) {
+			for (Run const& run : mesh.affected) {
+				output.dirtyRanges.emplace_back(run.firstVertex, run.vertexCount);
+			}
+		}
+		return statistics;
+	}
+
+	/// <summary>
+	/// Uploads the ranges changed by the last Blend, 0 skips a stream. Buffers hold one tightly packed stream each.
+	/// </summary>
+	inline void Upload_Dirty_Ranges(MorphOutput const& output, GLuint const buffers[StreamCount]) {
+		for (unsigned stream = 0; stream < StreamCount; ++stream) {
+			if (buffers[stream] == 0 || output.streams[stream].empty()) {
+				continue;
+			}
+			GLsizeiptr vertexSize = GLsizeiptr(STREAM_WIDTH[stream] * sizeof(float));
+			for (std::pair<size_t, size_t> const& range : output.dirtyRanges) {
+				glNamedBufferSubData(buffers[stream], GLintptr(range.first) * vertexSize, GLsizeiptr(range.second) * vertexSize,
+					output.streams[stream].data() + range.first * STREAM_WIDTH[stream]);
+			}
+		}
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "GLTF.hpp"
+#include <cmath>
+#include <vector>
+
+/// <summary>
+/// Local TRS of nodes stored as separate streams, indexed by slot.
+/// Animation writes into these streams and the scene graph reads them to build local matrices.
+/// </summary>
+struct NodeTransforms {
+	// x, y, z per slot
+	std::vector<float> translation;
+	// x, y, z, w per slot
+	std::vector<float> rotation;
+	// x, y, z per slot
+	std::vector<float> scale;
+	// Morph target weights, weightCount[slot] floats starting at weightOffset[slot]
+	std::vector<float> weights;
+	std::vector<unsigned> weightOffset;
+	std::vector<unsigned> weightCount;
+	// Set when translation, rotation or scale of the slot changed, cleared by SceneGraph::Update
+	std::vector<unsigned char> dirty;
+
+	NodeTransforms() = default;
+	NodeTransforms(NodeTransforms const&) = default;
+	NodeTransforms(NodeTransforms&&) = default;
+
+	NodeTransforms& operator=(NodeTransforms const&) = default;
+	NodeTransforms& operator=(NodeTransforms&&) = default;
+
+	size_t Size() const {
+		return weightOffset.size();
+	}
+
+	/// <returns>Slot of the new node</returns>
+	size_t Add(float const nodeTranslation[3], float const nodeRotation[4], float const nodeScale[3], std::vector<float> const& nodeWeights = std::vector<float>()) {
+		size_t slot = Size();
+		translation.insert(translation.end(), nodeTranslation, nodeTranslation + 3);
+		rotation.insert(rotation.end(), nodeRotation, nodeRotation + 4);
+		scale.insert(scale.end(), nodeScale, nodeScale + 3);
+		weightOffset.emplace_back(static_cast<unsigned>(weights.size()));
+		weightCount.emplace_back(static_cast<unsigned>(nodeWeights.size()));
+		weights.insert(weights.end(), nodeWeights.cbegin(), nodeWeights.cend());
+		dirty.emplace_back(1);
+		return slot;
+	}
+
+	void Mark_Dirty(size_t slot) {
+		dirty[slot] = 1;
+	}
+
+	/// <summary>
+	/// Appends one node of a document, a node defined by 'matrix' is decomposed into TRS.
+	/// </summary>
+	/// <returns>Slot of the node</returns>
+	size_t Add_Node(GLTF::GLTFDoc const& doc, GLTF::Node const& node) {
+		float nodeTranslation[3];
+		float nodeRotation[4];
+		float nodeScale[3];
+
+		if (Is_Identity(node.matrix)) {
+			for (size_t i = 0; i < 3; ++i) {
+				nodeTranslation[i] = float(node.translation[i]);
+				nodeScale[i] = float(node.scale[i]);
+			}
+			for (size_t i = 0; i < 4; ++i) {
+				nodeRotation[i] = float(node.rotation[i]);
+			}
+		}
+		else {
+			Decompose(node.matrix, nodeTranslation, nodeRotation, nodeScale);
+		}
+
+		// Node weights override the mesh default, otherwise one weight per morph target
+		std::vector<float> nodeWeights(node.weights.cbegin(), node.weights.cend());
+		if (nodeWeights.empty() && node.mesh != GLTF::index_type(-1) && node.mesh < doc.meshes.size()) {
+			GLTF::Mesh const& mesh = doc.meshes[node.mesh];
+			nodeWeights.assign(mesh.weights.cbegin(), mesh.weights.cend());
+			if (nodeWeights.empty() && !mesh.primitives.empty() && !mesh.primitives[0].targets.empty()) {
+				nodeWeights.resize(mesh.primitives[0].targets.cbegin()->second.size(), 0.0f);
+			}
+		}
+
+		return Add(nodeTranslation, nodeRotation, nodeScale, nodeWeights);
+	}
+
+	/// <summary>
+	/// Appends every node of a document in document order.
+	/// </summary>
+	/// <returns>Slot of node 0, node N is at the returned slot + N</returns>
+	size_t Add_Document(GLTF::GLTFDoc const& doc) {
+		size_t base = Size();
+		for (GLTF::Node const& node : doc.nodes) {
+			Add_Node(doc, node);
+		}
+		return base;
+	}
+
+	static bool Is_Identity(GLTF::number_type const matrix[16]) {
+		for (size_t i = 0; i < 16; ++i) {
+			if (matrix[i] != ((i % 5) == 0 ? 1.0 : 0.0)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Splits a column-major affine matrix without shear into translation, rotation quaternion and scale.
+	/// </summary>
+	static void Decompose(GLTF::number_type const matrix[16], float outTranslation[3], float outRotation[4], float outScale[3]) {
+		outTranslation[0] = float(matrix[12]);
+		outTranslation[1] = float(matrix[13]);
+		outTranslation[2] = float(matrix[14]);
+
+		double columns[3][3];
+		for (size_t column = 0; column < 3; ++column) {
+			double length = std::sqrt(matrix[column * 4 + 0] * matrix[column * 4 + 0] + matrix[column * 4 + 1] * matrix[column * 4 + 1] + matrix[column * 4 + 2] * matrix[column * 4 + 2]);
+			outScale[column] = float(length);
+			for (size_t row = 0; row < 3; ++row) {
+				columns[column][row] = length > 0.0 ? matrix[column * 4 + row] / length : 0.0;
+			}
+		}
+
+		// Mirrored basis, flip one axis so the rotation is proper
+		double determinant = columns[0][0] * (columns[1][1] * columns[2][2] - columns[2][1] * columns[1][2]) -
+			columns[1][0] * (columns[0][1] * columns[2][2] - columns[2][1] * columns[0][2]) +
+			columns[2][0] * (columns[0][1] * columns[1][2] - columns[1][1] * columns[0][2]);
+		if (determinant < 0.0) {
+			outScale[0] = -outScale[0];
+			for (size_t row = 0; row < 3; ++row) {
+				columns[0][row] = -columns[0][row];
+			}
+		}
+
+		// m[row][column] = columns[column][row]
+		double trace = columns[0][0] + columns[1][1] + columns[2][2];
+		double x, y, z, w;
+		if (trace > 0.0) {
+			double s = std::sqrt(trace + 1.0) * 2.0;
+			w = 0.25 * s;
+			x = (columns[1][2] - columns[2][1]) / s;
+			y = (columns[2][0] - columns[0][2]) / s;
+			z = (columns[0][1] - columns[1][0]) / s;
+		}
+		else if (columns[0][0] > columns[1][1] && columns[0][0] > columns[2][2]) {
+			double s = std::sqrt(1.0 + columns[0][0] - columns[1][1] - columns[2][2]) * 2.0;
+			w = (columns[1][2] - columns[2][1]) / s;
+			x = 0.25 * s;
+			y = (columns[1][0] + columns[0][1]) / s;
+			z = (columns[2][0] + columns[0][2]) / s;
+		}
+		else if (columns[1][1] > columns[2][2]) {
+			double s = std::sqrt(1.0 + columns[1][1] - columns[0][0] - columns[2][2]) * 2.0;
+			w = (columns[2][0] - columns[0][2]) / s;
+			x = (columns[1][0] + columns[0][1]) / s;
+			y = 0.25 * s;
+			z = (columns[2][1] + columns[1][2]) / s;
+		}
+		else {
+			double s = std::sqrt(1.0 + columns[2][2] - columns[0][0] - columns[1][1]) * 2.0;
+			w = (columns[0][1] - columns[1][0]) / s;
+			x = (columns[2][0] + columns[0][2]) / s;
+			y = (columns[2][1] + columns[1][2]) / s;
+			z = 0.25 * s;
+		}
+
+		outRotation[0] = float(x);
+		outRotation[1] = float(y);
+		outRotation[2] = float(z);
+		outRotation[3] = float(w);
+	}
+};
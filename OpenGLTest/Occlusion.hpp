@@ -0,0 +1,427 @@
+#pragma once
+#include "Simd.hpp"
+#include "Bounds.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// CPU occlusion culling, occluders are rasterized into a small depth buffer and instance boxes are tested against its max depth pyramid
+namespace Occlusion {
+	// Screen tiles rasterized independently, the width is a multiple of the 8 pixel spans
+	constexpr unsigned TILE_WIDTH = 64;
+	constexpr unsigned TILE_HEIGHT = 32;
+	// Clip w below this is treated as crossing the near plane
+	constexpr float NEAR_W = 0.0001f;
+	// Occluded boxes need their nearest depth this far behind the occluders, absorbs float error
+	constexpr float DEPTH_BIAS = 0.00001f;
+	// Boxes per task when testing with a pool
+	constexpr size_t PARALLEL_GRAIN = 1024;
+
+	/// <summary>
+	/// Triangles drawn into the depth buffer, usually a few hundred per object from a simplified LOD.
+	/// Occluders must be solid from every side they are seen, any face is drawn regardless of winding.
+	/// </summary>
+	struct OccluderMesh {
+		// x, y, z per vertex
+		std::vector<float> positions;
+		std::vector<unsigned> indices;
+
+		OccluderMesh() = default;
+		OccluderMesh(std::vector<float> _positions, std::vector<unsigned> _indices) : positions(std::move(_positions)), indices(std::move(_indices)) {
+
+		}
+
+		OccluderMesh(OccluderMesh const&) = default;
+		OccluderMesh(OccluderMesh&&) = default;
+
+		OccluderMesh& operator=(OccluderMesh const&) = default;
+		OccluderMesh& operator=(OccluderMesh&&) = default;
+	};
+
+	struct Statistics {
+		size_t occluderTriangles = 0;
+		// Triangles left after near plane and off screen rejection
+		size_t rasterizedTriangles = 0;
+		size_t tested = 0;
+		size_t occluded = 0;
+		double rasterizeMilliseconds = 0.0;
+		double testMilliseconds = 0.0;
+
+		void Reset() {
+			*this = Statistics();
+		}
+	};
+
+	/// <summary>
+	/// Per frame: Begin with the camera, Add_Occluder for each occluder, Render, then Visible or Cull for the instances.
+	/// Depth is window z in [0, 1], 1 is the far plane, and row 0 is the bottom of the screen.
+	/// </summary>
+	class OcclusionCuller {
+		// Screen space triangle with edge functions E(x, y) = a x + b y + c, inside when all three are >= 0
+		struct Triangle {
+			float edgeA[3];
+			float edgeB[3];
+			float edgeC[3];
+			// depth = depthC + depthX x + depthY y
+			float depthC;
+			float depthX;
+			float depthY;
+			int minX;
+			int minY;
+			int maxX;
+			int maxY;
+		};
+
+		unsigned _width;
+		unsigned _height;
+		unsigned _tilesX;
+		unsigned _tilesY;
+		glm::mat4 _viewProjection = glm::mat4(1.0f);
+		std::vector<Triangle> _triangles;
+		std::vector<std::vector<unsigned>> _bins;
+		// Level 0 is the depth buffer, each next level holds the max of 2x2 texels
+		std::vector<std::vector<float>> _levels;
+		std::vector<unsigned> _levelWidth;
+		std::vector<unsigned> _levelHeight;
+
+		void Setup_Triangle(glm::vec4 const& clip0, glm::vec4 const& clip1, glm::vec4 const& clip2) {
+			++statistics.occluderTriangles;
+			// Clipping against the near plane is skipped, dropping an occluder only makes culling more conservative
+			if (clip0.w < NEAR_W || clip1.w < NEAR_W || clip2.w < NEAR_W) {
+				return;
+			}
+
+			glm::vec3 screen[3];
+			glm::vec4 const* clip[3] = { &clip0, &clip1, &clip2 };
+			for (size_t vertex = 0; vertex < 3; ++vertex) {
+				float inverseW = 1.0f / clip[vertex]->w;
+				screen[vertex].x = (clip[vertex]->x * inverseW * 0.5f + 0.5f) * _width;
+				screen[vertex].y = (clip[vertex]->y * inverseW * 0.5f + 0.5f) * _height;
+				screen[vertex].z = clip[vertex]->z * inverseW * 0.5f + 0.5f;
+			}
+
+			float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+			if (std::fabs(area) < 1e-8f) {
+				return;
+			}
+			if (area < 0.0f) {
+				std::swap(screen[1], screen[2]);
+				area = -area;
+			}
+			if (screen[0].z > 1.0f && screen[1].z > 1.0f && screen[2].z > 1.0f) {
+				return;
+			}
+
+			Triangle triangle;
+			triangle.minX = std::max(0, int(std::floor(std::min({ screen[0].x, screen[1].x, screen[2].x }))));
+			triangle.minY = std::max(0, int(std::floor(std::min({ screen[0].y, screen[1].y, screen[2].y }))));
+			triangle.maxX = std::min(int(_width) - 1, int(std::ceil(std::max({ screen[0].x, screen[1].x, screen[2].x }))));
+			triangle.maxY = std::min(int(_height) - 1, int(std::ceil(std::max({ screen[0].y, screen[1].y, screen[2].y }))));
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+				return;
+			}
+
+			for (size_t edge = 0; edge < 3; ++edge) {
+				glm::vec3 const& a = screen[edge];
+				glm::vec3 const& b = screen[(edge + 1) % 3];
+				triangle.edgeA[edge] = a.y - b.y;
+				triangle.edgeB[edge] = b.x - a.x;
+				triangle.edgeC[edge] = -(triangle.edgeA[edge] * a.x + triangle.edgeB[edge] * a.y);
+			}
+			triangle.depthX = ((screen[1].z - screen[0].z) * (screen[2].y - screen[0].y) - (screen[2].z - screen[0].z) * (screen[1].y - screen[0].y)) / area;
+			triangle.depthY = ((screen[2].z - screen[0].z) * (screen[1].x - screen[0].x) - (screen[1].z - screen[0].z) * (screen[2].x - screen[0].x)) / area;
+			triangle.depthC = screen[0].z - triangle.depthX * screen[0].x - triangle.depthY * screen[0].y;
+
+			unsigned index = unsigned(_triangles.size());
+			_triangles.emplace_back(triangle);
+			++statistics.rasterizedTriangles;
+			for (unsigned tileY = unsigned(triangle.minY) / TILE_HEIGHT; tileY <= unsigned(triangle.maxY) / TILE_HEIGHT; ++tileY) {
+				for (unsigned tileX = unsigned(triangle.minX) / TILE_WIDTH; tileX <= unsigned(triangle.maxX) / TILE_WIDTH; ++tileX) {
+					_bins[tileY * _tilesX + tileX].emplace_back(index);
+				}
+			}
+		}
+
+		void Rasterize_Tile(unsigned tile) {
+			int tileMinX = int(tile % _tilesX * TILE_WIDTH);
+			int tileMinY = int(tile / _tilesX * TILE_HEIGHT);
+			int tileMaxX = std::min(tileMinX + int(TILE_WIDTH), int(_width)) - 1;
+			int tileMaxY = std::min(tileMinY + int(TILE_HEIGHT), int(_height)) - 1;
+			float* depth = _levels[0].data();
+
+			for (unsigned index : _bins[tile]) {
+				Triangle const& triangle = _triangles[index];
+				// Spans start on 8 pixel boundaries, tiles and the buffer width are multiples of 8
+				int minX = std::max(triangle.minX, tileMinX) & ~7;
+				int maxX = std::min(triangle.maxX, tileMaxX);
+				int minY = std::max(triangle.minY, tileMinY);
+				int maxY = std::min(triangle.maxY, tileMaxY);
+
+				for (int y = minY; y <= maxY; ++y) {
+					float pixelY = float(y) + 0.5f;
+					float* row = depth + size_t(y) * _width;
+#if defined(SIMD_AVX2)
+					if (Simd::Has_Avx2()) {
+						__m256 laneOffset = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+						__m256 rowEdge[3];
+						__m256 edgeA[3];
+						for (size_t edge = 0; edge < 3; ++edge) {
+							rowEdge[edge] = _mm256_set1_ps(triangle.edgeB[edge] * pixelY + triangle.edgeC[edge]);
+							edgeA[edge] = _mm256_set1_ps(triangle.edgeA[edge]);
+						}
+						__m256 rowDepth = _mm256_set1_ps(triangle.depthY * pixelY + triangle.depthC);
+						__m256 depthX = _mm256_set1_ps(triangle.depthX);
+						for (int x = minX; x <= maxX; x += 8) {
+							__m256 pixelX = _mm256_add_ps(_mm256_set1_ps(float(x)), laneOffset);
+							__m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[0], pixelX), rowEdge[0]), _mm256_setzero_ps(), _CMP_GE_OQ);
+							inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[1], pixelX), rowEdge[1]), _mm256_setzero_ps(), _CMP_GE_OQ));
+							inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[2], pixelX), rowEdge[2]), _mm256_setzero_ps(), _CMP_GE_OQ));
+							if (_mm256_movemask_ps(inside) == 0) {
+								continue;
+							}
+							__m256 pixelDepth = _mm256_add_ps(_mm256_mul_ps(depthX, pixelX), rowDepth);
+							__m256 current = _mm256_loadu_ps(row + x);
+							_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, pixelDepth), inside));
+						}
+						continue;
+					}
+#endif
+#if defined(SIMD_SSE)
+					__m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+					__m128 rowEdge[3];
+					__m128 edgeA[3];
+					for (size_t edge = 0; edge < 3; ++edge) {
+						rowEdge[edge] = _mm_set1_ps(triangle.edgeB[edge] * pixelY + triangle.edgeC[edge]);
+						edgeA[edge] = _mm_set1_ps(triangle.edgeA[edge]);
+					}
+					__m128 rowDepth = _mm_set1_ps(triangle.depthY * pixelY + triangle.depthC);
+					__m128 depthX = _mm_set1_ps(triangle.depthX);
+					for (int x = minX; x <= maxX; x += 4) {
+						__m128 pixelX = _mm_add_ps(_mm_set1_ps(float(x)), laneOffset);
+						__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], pixelX), rowEdge[0]), _mm_setzero_ps());
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], pixelX), rowEdge[1]), _mm_setzero_ps()));
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], pixelX), rowEdge[2]), _mm_setzero_ps()));
+						if (_mm_movemask_ps(inside) == 0) {
+							continue;
+						}
+						__m128 pixelDepth = _mm_add_ps(_mm_mul_ps(depthX, pixelX), rowDepth);
+						__m128 current = _mm_loadu_ps(row + x);
+						// SSE2 select, min is only taken where inside
+						__m128 nearer = _mm_min_ps(current, pixelDepth);
+						_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+					}
+#else
+					for (int x = minX; x <= maxX; ++x) {
+						float pixelX = float(x) + 0.5f;
+						if (triangle.edgeA[0] * pixelX + triangle.edgeB[0] * pixelY + triangle.edgeC[0] >= 0.0f &&
+							triangle.edgeA[1] * pixelX + triangle.edgeB[1] * pixelY + triangle.edgeC[1] >= 0.0f &&
+							triangle.edgeA[2] * pixelX + triangle.edgeB[2] * pixelY + triangle.edgeC[2] >= 0.0f) {
+							row[x] = std::min(row[x], triangle.depthC + triangle.depthX * pixelX + triangle.depthY * pixelY);
+						}
+					}
+#endif
+				}
+			}
+		}
+
+		void Build_Pyramid() {
+			for (size_t level = 1; level < _levels.size(); ++level) {
+				std::vector<float> const& source = _levels[level - 1];
+				std::vector<float>& destination = _levels[level];
+				unsigned sourceWidth = _levelWidth[level - 1];
+				unsigned sourceHeight = _levelHeight[level - 1];
+				for (unsigned y = 0; y < _levelHeight[level]; ++y) {
+					// Odd sizes repeat the last row or column
+					float const* row0 = source.data() + size_t(std::min(y * 2, sourceHeight - 1)) * sourceWidth;
+					float const* row1 = source.data() + size_t(std::min(y * 2 + 1, sourceHeight - 1)) * sourceWidth;
+					for (unsigned x = 0; x < _levelWidth[level]; ++x) {
+						unsigned x0 = std::min(x * 2, sourceWidth - 1);
+						unsigned x1 = std::min(x * 2 + 1, sourceWidth - 1);
+						destination[size_t(y) * _levelWidth[level] + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+					}
+				}
+			}
+		}
+
+	public:
+		Statistics statistics;
+
+		/// <param name="width">Rounded up to a multiple of 8</param>
+		OcclusionCuller(unsigned width = 256, unsigned height = 128) : _width((std::max(width, 8u) + 7) & ~7u), _height(std::max(height, 1u)) {
+			_tilesX = (_width + TILE_WIDTH - 1) / TILE_WIDTH;
+			_tilesY = (_height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+			_bins.resize(size_t(_tilesX) * _tilesY);
+
+			unsigned levelWidth = _width;
+			unsigned levelHeight = _height;
+			for (;;) {
+				_levelWidth.emplace_back(levelWidth);
+				_levelHeight.emplace_back(levelHeight);
+				_levels.emplace_back(size_t(levelWidth) * levelHeight, 1.0f);
+				if (levelWidth == 1 && levelHeight == 1) {
+					break;
+				}
+				levelWidth = std::max(1u, (levelWidth + 1) / 2);
+				levelHeight = std::max(1u, (levelHeight + 1) / 2);
+			}
+		}
+
+		unsigned Width() const {
+			return _width;
+		}
+
+		unsigned Height() const {
+			return _height;
+		}
+
+		size_t LevelCount() const {
+			return _levels.size();
+		}
+
+		float const* Depth(size_t level = 0) const {
+			return _levels[level].data();
+		}
+
+		/// <summary>
+		/// Clears the depth buffer and occluders.
+		/// </summary>
+		/// <param name="viewProjection">projection * view, OpenGL clip space</param>
+		void Begin(glm::mat4 const& viewProjection) {
+			_viewProjection = viewProjection;
+			_triangles.clear();
+			for (std::vector<unsigned>& bin : _bins) {
+				bin.clear();
+			}
+			std::fill(_levels[0].begin(), _levels[0].end(), 1.0f);
+		}
+
+		void Add_Occluder(OccluderMesh const& mesh, glm::mat4 const& world) {
+			glm::mat4 transform = _viewProjection * world;
+			std::vector<glm::vec4> clip(mesh.positions.size() / 3);
+			for (size_t vertex = 0; vertex < clip.size(); ++vertex) {
+				clip[vertex] = transform * glm::vec4(mesh.positions[vertex * 3], mesh.positions[vertex * 3 + 1], mesh.positions[vertex * 3 + 2], 1.0f);
+			}
+			for (size_t index = 0; index + 2 < mesh.indices.size(); index += 3) {
+				if (mesh.indices[index] < clip.size() && mesh.indices[index + 1] < clip.size() && mesh.indices[index + 2] < clip.size()) {
+					Setup_Triangle(clip[mesh.indices[index]], clip[mesh.indices[index + 1]], clip[mesh.indices[index + 2]]);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Rasterizes the occluders, tiles in parallel when a pool is given, and builds the pyramid.
+		/// </summary>
+		void Render(ThreadPool* pool = nullptr) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			size_t tileCount = _bins.size();
+			if (pool) {
+				pool->Parallel_For(tileCount, 1, [this](size_t begin, size_t end) {
+					for (size_t tile = begin; tile < end; ++tile) {
+						Rasterize_Tile(unsigned(tile));
+					}
+				});
+			}
+			else {
+				for (size_t tile = 0; tile < tileCount; ++tile) {
+					Rasterize_Tile(unsigned(tile));
+				}
+			}
+			Build_Pyramid();
+			statistics.rasterizeMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		/// <summary>
+		/// Conservative test of a world space box against the occluders drawn this frame.
+		/// </summary>
+		/// <returns>False only when every pixel the box covers has an occluder in front of the box</returns>
+		bool Visible(AABB const& box) const {
+			float minX = std::numeric_limits<float>::max();
+			float minY = std::numeric_limits<float>::max();
+			float maxX = -std::numeric_limits<float>::max();
+			float maxY = -std::numeric_limits<float>::max();
+			float nearest = std::numeric_limits<float>::max();
+			// A corner is the sum of one term per axis, 6 column products instead of 8 matrix products
+			glm::vec4 axisTerms[3][2];
+			for (glm::length_t axis = 0; axis < 3; ++axis) {
+				axisTerms[axis][0] = _viewProjection[axis] * box.minimum[axis];
+				axisTerms[axis][1] = _viewProjection[axis] * box.maximum[axis];
+			}
+			for (unsigned corner = 0; corner < 8; ++corner) {
+				glm::vec4 clip = _viewProjection[3] + axisTerms[0][corner & 1] + axisTerms[1][(corner >> 1) & 1] + axisTerms[2][(corner >> 2) & 1];
+				if (clip.w < NEAR_W) {
+					// The box reaches the camera
+					return true;
+				}
+				float inverseW = 1.0f / clip.w;
+				float x = (clip.x * inverseW * 0.5f + 0.5f) * _width;
+				float y = (clip.y * inverseW * 0.5f + 0.5f) * _height;
+				minX = std::min(minX, x);
+				maxX = std::max(maxX, x);
+				minY = std::min(minY, y);
+				maxY = std::max(maxY, y);
+				nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+			}
+
+			int pixelMinX = std::max(0, int(std::floor(minX)));
+			int pixelMinY = std::max(0, int(std::floor(minY)));
+			int pixelMaxX = std::min(int(_width) - 1, int(std::floor(maxX)));
+			int pixelMaxY = std::min(int(_height) - 1, int(std::floor(maxY)));
+			if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) {
+				// Off screen, the frustum culler decides these
+				return true;
+			}
+
+			// Coarsest level where the rectangle spans at most 2x2 texels
+			size_t level = 0;
+			while (level + 1 < _levels.size() && ((pixelMaxX >> level) - (pixelMinX >> level) > 1 || (pixelMaxY >> level) - (pixelMinY >> level) > 1)) {
+				++level;
+			}
+			float const* depth = _levels[level].data();
+			unsigned width = _levelWidth[level];
+			for (int y = pixelMinY >> level; y <= pixelMaxY >> level; ++y) {
+				for (int x = pixelMinX >> level; x <= pixelMaxX >> level; ++x) {
+					if (nearest <= depth[size_t(y) * width + x] + DEPTH_BIAS) {
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		/// <summary>
+		/// Removes occluded entries from a visible list, such as the output of a FrustumCuller.
+		/// </summary>
+		/// <param name="bounds">World space boxes indexed by the entries of visible</param>
+		void Cull(AABB const* bounds, std::vector<unsigned>& visible, ThreadPool* pool = nullptr) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			size_t count = visible.size();
+			std::vector<unsigned char> keep(count);
+			auto test = [&](size_t begin, size_t end) {
+				for (size_t index = begin; index < end; ++index) {
+					keep[index] = Visible(bounds[visible[index]]);
+				}
+			};
+			if (pool) {
+				pool->Parallel_For(count, PARALLEL_GRAIN, test);
+			}
+			else {
+				test(0, count);
+			}
+
+			size_t written = 0;
+			for (size_t index = 0; index < count; ++index) {
+				visible[written] = visible[index];
+				written += keep[index];
+			}
+			visible.resize(written);
+
+			statistics.tested += count;
+			statistics.occluded += count - written;
+			statistics.testMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	};
+}
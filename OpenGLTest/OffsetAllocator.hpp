@@ -0,0 +1,407 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+/// <summary>
+/// Two level segregated fit (TLSF) allocator of ranges within a space of abstract units, vertices or indices for BufferArena.
+/// Free ranges are kept in bins whose sizes step like a small float, 3 mantissa bits over 5 exponent bits,
+/// so allocating and freeing are a couple of bit scans whatever the number of ranges.
+/// Freed ranges merge with free neighbours, nothing here knows about GL.
+/// </summary>
+class OffsetAllocator {
+public:
+	constexpr static uint32_t NO_SPACE = UINT32_MAX;
+
+	/// <summary>
+	/// A range moved by Defragment, from and to are offsets in units.
+	/// </summary>
+	struct Move {
+		uint32_t allocation;
+		uint32_t from;
+		uint32_t to;
+		uint32_t size;
+	};
+
+private:
+	constexpr static uint32_t MANTISSA_BITS = 3;
+	constexpr static uint32_t MANTISSA_VALUE = 1 << MANTISSA_BITS;
+	constexpr static uint32_t MANTISSA_MASK = MANTISSA_VALUE - 1;
+	constexpr static uint32_t TOP_BINS = 32;
+	constexpr static uint32_t BINS_PER_TOP = 8;
+	constexpr static uint32_t BINS = TOP_BINS * BINS_PER_TOP;
+	constexpr static uint32_t NONE = UINT32_MAX;
+
+	struct Node {
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		// Free list of the node's bin
+		uint32_t binPrevious = NONE;
+		uint32_t binNext = NONE;
+		// Nodes either side in offset order
+		uint32_t neighbourPrevious = NONE;
+		uint32_t neighbourNext = NONE;
+		bool used = false;
+		bool live = false;
+	};
+
+	uint32_t _size;
+	uint32_t _free = 0;
+	uint32_t _topBins = 0;
+	uint8_t _usedBins[TOP_BINS] = {};
+	uint32_t _binHeads[BINS];
+	std::vector<Node> _nodes;
+	std::vector<uint32_t> _unusedNodes;
+	// Node with the highest offset, Grow extends it
+	uint32_t _last = NONE;
+
+	static uint32_t Lowest_Bit(uint32_t value) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return uint32_t(index);
+#else
+		return uint32_t(__builtin_ctz(value));
+#endif
+	}
+
+	static uint32_t Highest_Bit(uint32_t value) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse(&index, value);
+		return uint32_t(index);
+#else
+		return 31u - uint32_t(__builtin_clz(value));
+#endif
+	}
+
+	/// <summary>
+	/// Lowest set bit at or above start, NONE when there is none.
+	/// </summary>
+	static uint32_t Bit_After(uint32_t mask, uint32_t start) {
+		uint32_t masked = start < 32 ? mask & ~((1u << start) - 1u) : 0u;
+		return masked ? Lowest_Bit(masked) : NONE;
+	}
+
+	/// <summary>
+	/// Smallest bin all of whose ranges hold size units.
+	/// </summary>
+	static uint32_t Bin_Round_Up(uint32_t size) {
+		uint32_t exponent = 0;
+		uint32_t mantissa;
+		if (size < MANTISSA_VALUE) {
+			mantissa = size;
+		}
+		else {
+			uint32_t mantissaStart = Highest_Bit(size) - MANTISSA_BITS;
+			exponent = mantissaStart + 1;
+			mantissa = (size >> mantissaStart) & MANTISSA_MASK;
+			if (size & ((1u << mantissaStart) - 1u)) {
+				++mantissa;
+			}
+		}
+		// A mantissa carry moves into the exponent
+		return (exponent << MANTISSA_BITS) + mantissa;
+	}
+
+	/// <summary>
+	/// Bin a free range of size units is filed under, its ranges hold at least the bin's size.
+	/// </summary>
+	static uint32_t Bin_Round_Down(uint32_t size) {
+		uint32_t exponent = 0;
+		uint32_t mantissa;
+		if (size < MANTISSA_VALUE) {
+			mantissa = size;
+		}
+		else {
+			uint32_t mantissaStart = Highest_Bit(size) - MANTISSA_BITS;
+			exponent = mantissaStart + 1;
+			mantissa = (size >> mantissaStart) & MANTISSA_MASK;
+		}
+		return (exponent << MANTISSA_BITS) | mantissa;
+	}
+
+	uint32_t New_Node() {
+		uint32_t index;
+		if (!_unusedNodes.empty()) {
+			index = _unusedNodes.back();
+			_unusedNodes.pop_back();
+			_nodes[index] = Node();
+		}
+		else {
+			index = uint32_t(_nodes.size());
+			_nodes.emplace_back();
+		}
+		_nodes[index].live = true;
+		return index;
+	}
+
+	void Release_Node(uint32_t index) {
+		_nodes[index].live = false;
+		_unusedNodes.emplace_back(index);
+	}
+
+	void Insert_Free(uint32_t index) {
+		Node& node = _nodes[index];
+		uint32_t bin = Bin_Round_Down(node.size);
+		uint32_t top = bin / BINS_PER_TOP;
+		_topBins |= 1u << top;
+		_usedBins[top] |= uint8_t(1u << (bin % BINS_PER_TOP));
+		node.used = false;
+		node.binPrevious = NONE;
+		node.binNext = _binHeads[bin];
+		if (node.binNext != NONE) {
+			_nodes[node.binNext].binPrevious = index;
+		}
+		_binHeads[bin] = index;
+		_free += node.size;
+	}
+
+	void Remove_Free(uint32_t index) {
+		Node& node = _nodes[index];
+		if (node.binPrevious != NONE) {
+			_nodes[node.binPrevious].binNext = node.binNext;
+		}
+		else {
+			uint32_t bin = Bin_Round_Down(node.size);
+			_binHeads[bin] = node.binNext;
+			if (node.binNext == NONE) {
+				uint32_t top = bin / BINS_PER_TOP;
+				_usedBins[top] &= uint8_t(~(1u << (bin % BINS_PER_TOP)));
+				if (_usedBins[top] == 0) {
+					_topBins &= ~(1u << top);
+				}
+			}
+		}
+		if (node.binNext != NONE) {
+			_nodes[node.binNext].binPrevious = node.binPrevious;
+		}
+		node.binPrevious = NONE;
+		node.binNext = NONE;
+		_free -= node.size;
+	}
+
+	/// <summary>
+	/// Removes a free node and gives its range to its previous neighbour.
+	/// </summary>
+	void Merge_Into_Previous(uint32_t index) {
+		Node& node = _nodes[index];
+		Node& previous = _nodes[node.neighbourPrevious];
+		previous.size += node.size;
+		previous.neighbourNext = node.neighbourNext;
+		if (node.neighbourNext != NONE) {
+			_nodes[node.neighbourNext].neighbourPrevious = node.neighbourPrevious;
+		}
+		if (_last == index) {
+			_last = node.neighbourPrevious;
+		}
+		Release_Node(index);
+	}
+
+	void Check(uint32_t allocation) const {
+		if (allocation >= _nodes.size() || !_nodes[allocation].live || !_nodes[allocation].used) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": " + std::to_string(allocation) + " is not an allocation.");
+		}
+	}
+
+public:
+	/// <param name="size">Units that can be allocated</param>
+	OffsetAllocator(uint32_t size) : _size(0) {
+		for (uint32_t& head : _binHeads) {
+			head = NONE;
+		}
+		Grow(size);
+	}
+
+	OffsetAllocator(OffsetAllocator const&) = default;
+	OffsetAllocator(OffsetAllocator&&) = default;
+
+	OffsetAllocator& operator=(OffsetAllocator const&) = default;
+	OffsetAllocator& operator=(OffsetAllocator&&) = default;
+
+	/// <returns>Handle for Offset, Size and Free, NO_SPACE when no free range holds size units</returns>
+	uint32_t Allocate(uint32_t size) {
+		if (size == 0) {
+			size = 1;
+		}
+		uint32_t minimum = Bin_Round_Up(size);
+		if (minimum >= BINS) {
+			return NO_SPACE;
+		}
+		uint32_t top = minimum / BINS_PER_TOP;
+		uint32_t index = NONE;
+		uint32_t inTop = Bit_After(_usedBins[top], minimum % BINS_PER_TOP);
+		if (inTop != NONE) {
+			index = _binHeads[top * BINS_PER_TOP + inTop];
+		}
+		else {
+			top = Bit_After(_topBins, top + 1);
+			if (top != NONE) {
+				index = _binHeads[top * BINS_PER_TOP + Lowest_Bit(_usedBins[top])];
+			}
+			else {
+				// Only the bin below can hold a range that fits, only some of its ranges do
+				for (index = _binHeads[Bin_Round_Down(size)]; index != NONE && _nodes[index].size < size; index = _nodes[index].binNext) {
+
+				}
+				if (index == NONE) {
+					return NO_SPACE;
+				}
+			}
+		}
+
+		Remove_Free(index);
+		Node& node = _nodes[index];
+		node.used = true;
+		uint32_t remainder = node.size - size;
+		node.size = size;
+		if (remainder > 0) {
+			uint32_t split = New_Node();
+			// node may have moved when the nodes grew
+			Node& allocated = _nodes[index];
+			Node& rest = _nodes[split];
+			rest.offset = allocated.offset + size;
+			rest.size = remainder;
+			rest.neighbourPrevious = index;
+			rest.neighbourNext = allocated.neighbourNext;
+			if (allocated.neighbourNext != NONE) {
+				_nodes[allocated.neighbourNext].neighbourPrevious = split;
+			}
+			allocated.neighbourNext = split;
+			if (_last == index) {
+				_last = split;
+			}
+			Insert_Free(split);
+		}
+		return index;
+	}
+
+	/// <summary>
+	/// Returns a range, it merges with free ranges either side.
+	/// </summary>
+	void Free(uint32_t allocation) {
+		Check(allocation);
+		uint32_t index = allocation;
+		Node& node = _nodes[index];
+		node.used = false;
+		uint32_t next = node.neighbourNext;
+		if (next != NONE && !_nodes[next].used) {
+			Remove_Free(next);
+			Merge_Into_Previous(next);
+		}
+		uint32_t previous = _nodes[index].neighbourPrevious;
+		if (previous != NONE && !_nodes[previous].used) {
+			Remove_Free(previous);
+			Merge_Into_Previous(index);
+			index = previous;
+		}
+		Insert_Free(index);
+	}
+
+	/// <summary>
+	/// Adds units at the end of the space, allocations keep their offsets.
+	/// </summary>
+	void Grow(uint32_t size) {
+		if (size <= _size) {
+			return;
+		}
+		uint32_t added = size - _size;
+		if (_last != NONE && !_nodes[_last].used) {
+			Remove_Free(_last);
+			_nodes[_last].size += added;
+			Insert_Free(_last);
+		}
+		else {
+			uint32_t index = New_Node();
+			Node& node = _nodes[index];
+			node.offset = _size;
+			node.size = added;
+			node.neighbourPrevious = _last;
+			if (_last != NONE) {
+				_nodes[_last].neighbourNext = index;
+			}
+			_last = index;
+			Insert_Free(index);
+		}
+		_size = size;
+	}
+
+	/// <summary>
+	/// Packs every allocation towards offset 0 in offset order, leaving one free range at the end.
+	/// Handles stay valid, the caller copies each moved range, moves are in increasing offset order and never move a range up.
+	/// </summary>
+	std::vector<Move> Defragment() {
+		std::vector<Move> moves;
+		uint32_t first = NONE;
+		for (uint32_t index = _last; index != NONE; index = _nodes[index].neighbourPrevious) {
+			first = index;
+		}
+		uint32_t cursor = 0;
+		uint32_t previous = NONE;
+		for (uint32_t index = first; index != NONE;) {
+			uint32_t next = _nodes[index].neighbourNext;
+			Node& node = _nodes[index];
+			if (node.used) {
+				if (node.offset != cursor) {
+					moves.push_back({ index, node.offset, cursor, node.size });
+					node.offset = cursor;
+				}
+				cursor += node.size;
+				node.neighbourPrevious = previous;
+				if (previous != NONE) {
+					_nodes[previous].neighbourNext = index;
+				}
+				previous = index;
+			}
+			else {
+				Remove_Free(index);
+				Release_Node(index);
+			}
+			index = next;
+		}
+		if (previous != NONE) {
+			_nodes[previous].neighbourNext = NONE;
+		}
+		_last = previous;
+		uint32_t size = _size;
+		_size = cursor;
+		Grow(size);
+		return moves;
+	}
+
+	uint32_t Offset(uint32_t allocation) const {
+		Check(allocation);
+		return _nodes[allocation].offset;
+	}
+
+	uint32_t Size(uint32_t allocation) const {
+		Check(allocation);
+		return _nodes[allocation].size;
+	}
+
+	/// <returns>Units in the whole space</returns>
+	uint32_t Capacity() const {
+		return _size;
+	}
+
+	uint32_t Free_Units() const {
+		return _free;
+	}
+
+	/// <returns>Units in the largest free range, what Allocate is sure to succeed with is at most this</returns>
+	uint32_t Largest_Free() const {
+		uint32_t largest = 0;
+		for (uint32_t index = _last; index != NONE; index = _nodes[index].neighbourPrevious) {
+			if (!_nodes[index].used && _nodes[index].size > largest) {
+				largest = _nodes[index].size;
+			}
+		}
+		return largest;
+	}
+};
@@ -0,0 +1,538 @@
+#pragma once
+#include "Simd.hpp"
+#include "AccessorData.hpp"
+#include "Bounds.hpp"
+#include "BVH.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Ray queries against triangles, a BVH per mesh (bottom level) and a BVH over placed meshes (top level)
+namespace RayCast {
+	// Triangles tested together at a leaf, leaves hold at most BVH::MAX_LEAF_SIZE
+	constexpr size_t TRIANGLE_LANES = 8;
+	// Rays traversed together by Intersect_Packet
+	constexpr size_t PACKET_SIZE = 4;
+	// Determinants below this are rays parallel to the triangle
+	constexpr float PARALLEL_EPSILON = 1e-12f;
+
+	using Ray = BVH::Ray;
+
+	struct Hit {
+		unsigned triangle = unsigned(-1);
+		float distance = std::numeric_limits<float>::max();
+		// Barycentrics of vertex 1 and 2
+		float u = 0.0f;
+		float v = 0.0f;
+
+		bool Valid() const {
+			return triangle != unsigned(-1);
+		}
+	};
+
+	/// <summary>
+	/// Bottom level: a BVH over the triangles of one mesh, queries are const and safe from any number of threads.
+	/// Triangles are stored in leaf order as vertex 0 and two edges, ready for Moller-Trumbore.
+	/// </summary>
+	class TriangleBVH {
+		BVH _bvh;
+		// Structure of arrays in leaf order, padded by TRIANGLE_LANES so a leaf can always load a full block
+		std::vector<float> _vertex[3];
+		std::vector<float> _edge1[3];
+		std::vector<float> _edge2[3];
+
+		/// <summary>
+		/// Tests [first, first + count) of the leaf order, keeps the closest hit below hit.distance.
+		/// </summary>
+		void Intersect_Leaf(Ray const& ray, unsigned first, unsigned count, Hit& hit) const {
+#if defined(SIMD_AVX2)
+			if (Simd::Has_Avx2()) {
+				for (unsigned block = 0; block < count; block += 8) {
+					__m256 directionX = _mm256_set1_ps(ray.direction.x);
+					__m256 directionY = _mm256_set1_ps(ray.direction.y);
+					__m256 directionZ = _mm256_set1_ps(ray.direction.z);
+					size_t offset = size_t(first) + block;
+					__m256 edge1X = _mm256_loadu_ps(_edge1[0].data() + offset);
+					__m256 edge1Y = _mm256_loadu_ps(_edge1[1].data() + offset);
+					__m256 edge1Z = _mm256_loadu_ps(_edge1[2].data() + offset);
+					__m256 edge2X = _mm256_loadu_ps(_edge2[0].data() + offset);
+					__m256 edge2Y = _mm256_loadu_ps(_edge2[1].data() + offset);
+					__m256 edge2Z = _mm256_loadu_ps(_edge2[2].data() + offset);
+
+					// p = direction x edge2, determinant = edge1 . p
+					__m256 pX = _mm256_sub_ps(_mm256_mul_ps(directionY, edge2Z), _mm256_mul_ps(directionZ, edge2Y));
+					__m256 pY = _mm256_sub_ps(_mm256_mul_ps(directionZ, edge2X), _mm256_mul_ps(directionX, edge2Z));
+					__m256 pZ = _mm256_sub_ps(_mm256_mul_ps(directionX, edge2Y), _mm256_mul_ps(directionY, edge2X));
+					__m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge1X, pX), _mm256_mul_ps(edge1Y, pY)), _mm256_mul_ps(edge1Z, pZ));
+					__m256 absolute = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), determinant);
+					__m256 valid = _mm256_cmp_ps(absolute, _mm256_set1_ps(PARALLEL_EPSILON), _CMP_GT_OQ);
+					__m256 inverse = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+					__m256 tX = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_loadu_ps(_vertex[0].data() + offset));
+					__m256 tY = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_loadu_ps(_vertex[1].data() + offset));
+					__m256 tZ = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_loadu_ps(_vertex[2].data() + offset));
+					__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tX, pX), _mm256_mul_ps(tY, pY)), _mm256_mul_ps(tZ, pZ)), inverse);
+
+					// q = t x edge1
+					__m256 qX = _mm256_sub_ps(_mm256_mul_ps(tY, edge1Z), _mm256_mul_ps(tZ, edge1Y));
+					__m256 qY = _mm256_sub_ps(_mm256_mul_ps(tZ, edge1X), _mm256_mul_ps(tX, edge1Z));
+					__m256 qZ = _mm256_sub_ps(_mm256_mul_ps(tX, edge1Y), _mm256_mul_ps(tY, edge1X));
+					__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(directionX, qX), _mm256_mul_ps(directionY, qY)), _mm256_mul_ps(directionZ, qZ)), inverse);
+					__m256 distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge2X, qX), _mm256_mul_ps(edge2Y, qY)), _mm256_mul_ps(edge2Z, qZ)), inverse);
+
+					valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_GE_OQ));
+					valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ));
+					valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+					valid = _mm256_and_ps(valid, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+					valid = _mm256_and_ps(valid, _mm256_cmp_ps(distance, _mm256_set1_ps(std::min(hit.distance, ray.maxDistance)), _CMP_LT_OQ));
+					int mask = _mm256_movemask_ps(valid);
+					if (count - block < 8) {
+						mask &= (1 << (count - block)) - 1;
+					}
+					if (mask == 0) {
+						continue;
+					}
+
+					float distances[8];
+					float us[8];
+					float vs[8];
+					_mm256_storeu_ps(distances, distance);
+					_mm256_storeu_ps(us, u);
+					_mm256_storeu_ps(vs, v);
+					for (unsigned lane = 0; lane < 8; ++lane) {
+						if ((mask >> lane) & 1 && distances[lane] < hit.distance) {
+							hit.triangle = _bvh.indices[offset + lane];
+							hit.distance = distances[lane];
+							hit.u = us[lane];
+							hit.v = vs[lane];
+						}
+					}
+				}
+				return;
+			}
+#endif
+#if defined(SIMD_SSE)
+			for (unsigned block = 0; block < count; block += 4) {
+				__m128 directionX = _mm_set1_ps(ray.direction.x);
+				__m128 directionY = _mm_set1_ps(ray.direction.y);
+				__m128 directionZ = _mm_set1_ps(ray.direction.z);
+				size_t offset = size_t(first) + block;
+				__m128 edge1X = _mm_loadu_ps(_edge1[0].data() + offset);
+				__m128 edge1Y = _mm_loadu_ps(_edge1[1].data() + offset);
+				__m128 edge1Z = _mm_loadu_ps(_edge1[2].data() + offset);
+				__m128 edge2X = _mm_loadu_ps(_edge2[0].data() + offset);
+				__m128 edge2Y = _mm_loadu_ps(_edge2[1].data() + offset);
+				__m128 edge2Z = _mm_loadu_ps(_edge2[2].data() + offset);
+
+				// p = direction x edge2, determinant = edge1 . p
+				__m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+				__m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+				__m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+				__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+				__m128 absolute = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+				__m128 valid = _mm_cmpgt_ps(absolute, _mm_set1_ps(PARALLEL_EPSILON));
+				__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+				__m128 tX = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(_vertex[0].data() + offset));
+				__m128 tY = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(_vertex[1].data() + offset));
+				__m128 tZ = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(_vertex[2].data() + offset));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tX, pX), _mm_mul_ps(tY, pY)), _mm_mul_ps(tZ, pZ)), inverse);
+
+				// q = t x edge1
+				__m128 qX = _mm_sub_ps(_mm_mul_ps(tY, edge1Z), _mm_mul_ps(tZ, edge1Y));
+				__m128 qY = _mm_sub_ps(_mm_mul_ps(tZ, edge1X), _mm_mul_ps(tX, edge1Z));
+				__m128 qZ = _mm_sub_ps(_mm_mul_ps(tX, edge1Y), _mm_mul_ps(tY, edge1X));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverse);
+				__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverse);
+
+				valid = _mm_and_ps(valid, _mm_cmpge_ps(u, _mm_setzero_ps()));
+				valid = _mm_and_ps(valid, _mm_cmpge_ps(v, _mm_setzero_ps()));
+				valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+				valid = _mm_and_ps(valid, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+				valid = _mm_and_ps(valid, _mm_cmplt_ps(distance, _mm_set1_ps(std::min(hit.distance, ray.maxDistance))));
+				int mask = _mm_movemask_ps(valid);
+				if (count - block < 4) {
+					mask &= (1 << (count - block)) - 1;
+				}
+				if (mask == 0) {
+					continue;
+				}
+
+				float distances[4];
+				float us[4];
+				float vs[4];
+				_mm_storeu_ps(distances, distance);
+				_mm_storeu_ps(us, u);
+				_mm_storeu_ps(vs, v);
+				for (unsigned lane = 0; lane < 4; ++lane) {
+					if ((mask >> lane) & 1 && distances[lane] < hit.distance) {
+						hit.triangle = _bvh.indices[offset + lane];
+						hit.distance = distances[lane];
+						hit.u = us[lane];
+						hit.v = vs[lane];
+					}
+				}
+			}
+#else
+			for (unsigned index = first; index < first + count; ++index) {
+				glm::vec3 edge1(_edge1[0][index], _edge1[1][index], _edge1[2][index]);
+				glm::vec3 edge2(_edge2[0][index], _edge2[1][index], _edge2[2][index]);
+				glm::vec3 p = glm::cross(ray.direction, edge2);
+				float determinant = glm::dot(edge1, p);
+				if (std::fabs(determinant) <= PARALLEL_EPSILON) {
+					continue;
+				}
+				float inverse = 1.0f / determinant;
+				glm::vec3 t = ray.origin - glm::vec3(_vertex[0][index], _vertex[1][index], _vertex[2][index]);
+				float u = glm::dot(t, p) * inverse;
+				glm::vec3 q = glm::cross(t, edge1);
+				float v = glm::dot(ray.direction, q) * inverse;
+				float distance = glm::dot(edge2, q) * inverse;
+				if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f && distance < std::min(hit.distance, ray.maxDistance)) {
+					hit.triangle = _bvh.indices[index];
+					hit.distance = distance;
+					hit.u = u;
+					hit.v = v;
+				}
+			}
+#endif
+		}
+
+	public:
+		TriangleBVH() = default;
+
+		/// <param name="positions">x, y, z of each vertex, 'stride' floats apart</param>
+		/// <param name="indices">Three per triangle</param>
+		TriangleBVH(float const* positions, size_t vertexCount, size_t stride, unsigned const* indices, size_t indexCount, ThreadPool* pool = nullptr) {
+			size_t triangleCount = indexCount / 3;
+			std::vector<AABB> bounds(triangleCount);
+			for (size_t triangle = 0; triangle < triangleCount; ++triangle) {
+				for (size_t corner = 0; corner < 3; ++corner) {
+					unsigned vertex = indices[triangle * 3 + corner];
+					if (vertex >= vertexCount) {
+						throw std::out_of_range(FILE_FUNCTION_LINE + ": index " + std::to_string(vertex) + " of triangle " + std::to_string(triangle) + " is past the last vertex");
+					}
+					float const* position = positions + vertex * stride;
+					bounds[triangle].Grow(glm::vec3(position[0], position[1], position[2]));
+				}
+			}
+			_bvh.Build(bounds, pool);
+
+			for (size_t axis = 0; axis < 3; ++axis) {
+				_vertex[axis].assign(triangleCount + TRIANGLE_LANES, 0.0f);
+				_edge1[axis].assign(triangleCount + TRIANGLE_LANES, 0.0f);
+				_edge2[axis].assign(triangleCount + TRIANGLE_LANES, 0.0f);
+			}
+			for (size_t order = 0; order < triangleCount; ++order) {
+				unsigned const* triangle = indices + size_t(_bvh.indices[order]) * 3;
+				float const* position0 = positions + triangle[0] * stride;
+				float const* position1 = positions + triangle[1] * stride;
+				float const* position2 = positions + triangle[2] * stride;
+				for (size_t axis = 0; axis < 3; ++axis) {
+					_vertex[axis][order] = position0[axis];
+					_edge1[axis][order] = position1[axis] - position0[axis];
+					_edge2[axis][order] = position2[axis] - position0[axis];
+				}
+			}
+		}
+
+		TriangleBVH(std::vector<float> const& positions, std::vector<unsigned> const& indices, ThreadPool* pool = nullptr) :
+			TriangleBVH(positions.data(), positions.size() / 3, 3, indices.data(), indices.size(), pool) {
+
+		}
+
+		TriangleBVH(TriangleBVH const&) = default;
+		TriangleBVH(TriangleBVH&&) = default;
+
+		TriangleBVH& operator=(TriangleBVH const&) = default;
+		TriangleBVH& operator=(TriangleBVH&&) = default;
+
+		size_t TriangleCount() const {
+			return _bvh.indices.size();
+		}
+
+		AABB Bounds() const {
+			return _bvh.Empty() ? AABB() : _bvh.nodes[0].Bounds();
+		}
+
+		size_t MemoryUsage() const {
+			return _bvh.nodes.size() * sizeof(BVH::Node) + _bvh.indices.size() * sizeof(unsigned) + _vertex[0].size() * sizeof(float) * 9;
+		}
+
+		/// <summary>
+		/// Closest triangle along the ray, both faces count.
+		/// </summary>
+		/// <returns>True when hit was replaced by a closer hit</returns>
+		bool Intersect(Ray const& ray, Hit& hit) const {
+			if (_bvh.Empty()) {
+				return false;
+			}
+			unsigned previous = hit.triangle;
+			float previousDistance = hit.distance;
+			std::vector<BVH::Node> const& nodes = _bvh.nodes;
+			glm::vec3 inverseDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+			unsigned stack[BVH::STACK_SIZE];
+			size_t top = 0;
+			stack[top++] = 0;
+			while (top > 0) {
+				BVH::Node const& node = nodes[stack[--top]];
+				if (node.Leaf()) {
+					Intersect_Leaf(ray, node.leftFirst, node.count, hit);
+					continue;
+				}
+
+				float limit = std::min(hit.distance, ray.maxDistance);
+				float entries[2];
+				bool hits[2];
+				for (unsigned child = 0; child < 2; ++child) {
+					BVH::Node const& box = nodes[node.leftFirst + child];
+					float entryDistance = 0.0f;
+					float exitDistance = limit;
+					for (glm::length_t axis = 0; axis < 3; ++axis) {
+						float a = (box.minimum[axis] - ray.origin[axis]) * inverseDirection[axis];
+						float b = (box.maximum[axis] - ray.origin[axis]) * inverseDirection[axis];
+						entryDistance = std::max(entryDistance, std::min(a, b));
+						exitDistance = std::min(exitDistance, std::max(a, b));
+					}
+					entries[child] = entryDistance;
+					hits[child] = entryDistance <= exitDistance;
+				}
+				// Nearer child on top of the stack
+				unsigned nearChild = entries[1] < entries[0] ? 1 : 0;
+				if (hits[1 - nearChild]) {
+					stack[top++] = node.leftFirst + 1 - nearChild;
+				}
+				if (hits[nearChild]) {
+					stack[top++] = node.leftFirst + nearChild;
+				}
+			}
+			return hit.triangle != previous || hit.distance != previousDistance;
+		}
+
+		/// <summary>
+		/// Closest hits of up to PACKET_SIZE rays traversed together, nodes are tested for all rays at once.
+		/// Pays off for coherent rays such as neighbouring pixels.
+		/// </summary>
+		void Intersect_Packet(Ray const* rays, size_t count, Hit* hits) const {
+			count = std::min(count, PACKET_SIZE);
+			if (_bvh.Empty() || count == 0) {
+				return;
+			}
+			std::vector<BVH::Node> const& nodes = _bvh.nodes;
+			float origin[3][PACKET_SIZE] = {};
+			float inverseDirection[3][PACKET_SIZE] = {};
+			float limit[PACKET_SIZE] = {};
+			for (size_t ray = 0; ray < count; ++ray) {
+				for (glm::length_t axis = 0; axis < 3; ++axis) {
+					origin[axis][ray] = rays[ray].origin[axis];
+					inverseDirection[axis][ray] = 1.0f / rays[ray].direction[axis];
+				}
+			}
+			unsigned active = (1u << count) - 1;
+
+			unsigned stack[BVH::STACK_SIZE];
+			size_t top = 0;
+			stack[top++] = 0;
+			while (top > 0) {
+				BVH::Node const& node = nodes[stack[--top]];
+				for (size_t ray = 0; ray < count; ++ray) {
+					limit[ray] = std::min(hits[ray].distance, rays[ray].maxDistance);
+				}
+
+				unsigned mask;
+#if defined(SIMD_AVX2) || defined(SIMD_SSE)
+				__m128 entryDistance = _mm_setzero_ps();
+				__m128 exitDistance = _mm_loadu_ps(limit);
+				for (size_t axis = 0; axis < 3; ++axis) {
+					__m128 rayOrigin = _mm_loadu_ps(origin[axis]);
+					__m128 rayInverse = _mm_loadu_ps(inverseDirection[axis]);
+					__m128 a = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minimum[axis]), rayOrigin), rayInverse);
+					__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maximum[axis]), rayOrigin), rayInverse);
+					entryDistance = _mm_max_ps(entryDistance, _mm_min_ps(a, b));
+					exitDistance = _mm_min_ps(exitDistance, _mm_max_ps(a, b));
+				}
+				mask = unsigned(_mm_movemask_ps(_mm_cmple_ps(entryDistance, exitDistance))) & active;
+#else
+				mask = 0;
+				for (size_t ray = 0; ray < count; ++ray) {
+					float entryDistance = 0.0f;
+					float exitDistance = limit[ray];
+					for (size_t axis = 0; axis < 3; ++axis) {
+						float a = (node.minimum[axis] - origin[axis][ray]) * inverseDirection[axis][ray];
+						float b = (node.maximum[axis] - origin[axis][ray]) * inverseDirection[axis][ray];
+						entryDistance = std::max(entryDistance, std::min(a, b));
+						exitDistance = std::min(exitDistance, std::max(a, b));
+					}
+					mask |= unsigned(entryDistance <= exitDistance) << ray;
+				}
+#endif
+				if (mask == 0) {
+					continue;
+				}
+				if (node.Leaf()) {
+					for (size_t ray = 0; ray < count; ++ray) {
+						if ((mask >> ray) & 1) {
+							Intersect_Leaf(rays[ray], node.leftFirst, node.count, hits[ray]);
+						}
+					}
+				}
+				else {
+					// Order by the first active ray, coherent rays agree on it
+					size_t leader = 0;
+					while (!((mask >> leader) & 1)) {
+						++leader;
+					}
+					BVH::Node const& left = nodes[node.leftFirst];
+					BVH::Node const& right = nodes[node.leftFirst + 1];
+					float leftDistance = 0.0f;
+					float rightDistance = 0.0f;
+					for (size_t axis = 0; axis < 3; ++axis) {
+						float leftCenter = (left.minimum[axis] + left.maximum[axis]) * 0.5f - origin[axis][leader];
+						float rightCenter = (right.minimum[axis] + right.maximum[axis]) * 0.5f - origin[axis][leader];
+						leftDistance += leftCenter * leftCenter;
+						rightDistance += rightCenter * rightCenter;
+					}
+					unsigned nearChild = rightDistance < leftDistance ? 1 : 0;
+					stack[top++] = node.leftFirst + 1 - nearChild;
+					stack[top++] = node.leftFirst + nearChild;
+				}
+			}
+		}
+	};
+
+	struct SceneHit {
+		unsigned instance = unsigned(-1);
+		Hit hit;
+
+		bool Valid() const {
+			return instance != unsigned(-1);
+		}
+	};
+
+	/// <summary>
+	/// Top level: placed instances of shared TriangleBVHs under one BVH of their world boxes.
+	/// Rays are moved into each instance's object space, distances stay in world units along the given direction.
+	/// </summary>
+	class Scene {
+		struct Instance {
+			std::shared_ptr<TriangleBVH const> mesh;
+			glm::mat4 world;
+			glm::mat4 inverseWorld;
+		};
+
+		std::vector<Instance> _instances;
+		std::vector<AABB> _bounds;
+		BVH _bvh;
+
+	public:
+		Scene() = default;
+		Scene(Scene const&) = default;
+		Scene(Scene&&) = default;
+
+		Scene& operator=(Scene const&) = default;
+		Scene& operator=(Scene&&) = default;
+
+		size_t InstanceCount() const {
+			return _instances.size();
+		}
+
+		/// <returns>Index of the instance, reported in SceneHit::instance</returns>
+		unsigned Add_Instance(std::shared_ptr<TriangleBVH const> mesh, glm::mat4 const& world) {
+			_instances.push_back({ std::move(mesh), world, glm::inverse(world) });
+			_bounds.emplace_back(Transform_AABB(_instances.back().mesh->Bounds(), world));
+			return unsigned(_instances.size() - 1);
+		}
+
+		void Set_Transform(unsigned instance, glm::mat4 const& world) {
+			_instances[instance].world = world;
+			_instances[instance].inverseWorld = glm::inverse(world);
+			_bounds[instance] = Transform_AABB(_instances[instance].mesh->Bounds(), world);
+		}
+
+		/// <summary>
+		/// Rebuilds the top level after adding instances, call Refit instead when only transforms changed.
+		/// </summary>
+		void Build(ThreadPool* pool = nullptr) {
+			_bvh.Build(_bounds, pool);
+		}
+
+		void Refit() {
+			_bvh.Refit(_bounds.data());
+		}
+
+		SceneHit Intersect(Ray const& ray) const {
+			SceneHit result;
+			_bvh.Ray_Cast(ray, [&](unsigned instance, Ray const& current, float& distance) {
+				Instance const& placed = _instances[instance];
+				Ray local;
+				local.origin = glm::vec3(placed.inverseWorld * glm::vec4(current.origin, 1.0f));
+				local.direction = glm::vec3(placed.inverseWorld * glm::vec4(current.direction, 0.0f));
+				local.maxDistance = current.maxDistance;
+				Hit hit;
+				if (placed.mesh->Intersect(local, hit) && hit.Valid()) {
+					result.instance = instance;
+					result.hit = hit;
+					distance = hit.distance;
+					return true;
+				}
+				return false;
+			});
+			return result;
+		}
+
+		void Intersect_Batch(Ray const* rays, size_t count, SceneHit* hits, ThreadPool& pool) const {
+			pool.Parallel_For(count, 64, [&](size_t begin, size_t end) {
+				for (size_t index = begin; index < end; ++index) {
+					hits[index] = Intersect(rays[index]);
+				}
+			});
+		}
+	};
+
+	/// <summary>
+	/// Builds the bottom levels of many meshes, each build on its own task.
+	/// </summary>
+	inline std::vector<std::shared_ptr<TriangleBVH const>> Build_Meshes(std::vector<std::vector<float>> const& positions, std::vector<std::vector<unsigned>> const& indices, ThreadPool& pool) {
+		std::vector<std::shared_ptr<TriangleBVH const>> meshes(positions.size());
+		pool.Parallel_For(positions.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t mesh = begin; mesh < end; ++mesh) {
+				meshes[mesh] = std::make_shared<TriangleBVH const>(positions[mesh], indices[mesh]);
+			}
+		});
+		return meshes;
+	}
+
+	/// <summary>
+	/// Positions and triangle indices of a TRIANGLES primitive, primitives without indices are numbered in order.
+	/// </summary>
+	inline void Primitive_Triangles(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Mesh::Primitive const& primitive, std::vector<float>& positions, std::vector<unsigned>& indices) {
+		// glTF mode 4, TRIANGLES
+		if (primitive.mode != 4) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": only TRIANGLES primitives can be ray cast");
+		}
+		auto position = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_POSITION);
+		if (position == primitive.attributes.cend()) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": primitive has no POSITION");
+		}
+		positions = GLTF::Read_Accessor_Float(doc, buffers, position->second);
+		if (primitive.indices != GLTF::index_type(-1)) {
+			indices = GLTF::Read_Accessor_Unsigned(doc, buffers, primitive.indices);
+		}
+		else {
+			indices.resize(positions.size() / 3);
+			for (size_t index = 0; index < indices.size(); ++index) {
+				indices[index] = unsigned(index);
+			}
+		}
+		indices.resize(indices.size() / 3 * 3);
+	}
+}
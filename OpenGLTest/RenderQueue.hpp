@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Frame draw packets ordered by a 64 bit state key, sorted with an LSD radix sort and submitted in key order.
+// Nothing here touches GL so queues can be filled, sorted and walked on the CPU alone.
+namespace RenderQueue {
+	// Field widths of a key, they add up to 64
+	constexpr uint32_t PASS_BITS = 2;
+	constexpr uint32_t PROGRAM_BITS = 10;
+	constexpr uint32_t FORMAT_BITS = 8;
+	constexpr uint32_t MATERIAL_BITS = 14;
+	constexpr uint32_t TEXTURES_BITS = 14;
+	constexpr uint32_t DEPTH_BITS = 16;
+
+	constexpr uint32_t MAX_DEPTH = (1u << DEPTH_BITS) - 1;
+	// Below this many packets Sort uses an insertion sort, the histograms cost more than they save
+	constexpr size_t INSERTION_SORT_LIMIT = 64;
+
+	// Passes are drawn in this order, glTF alphaMode OPAQUE, MASK and BLEND
+	enum class Pass : uint32_t {
+		Opaque = 0,
+		Masked = 1,
+		Transparent = 2,
+		Overlay = 3
+	};
+
+	// Bits of the mask Submit passes, set for each field that differs from the previous packet
+	constexpr uint32_t CHANGED_PASS = 1;
+	constexpr uint32_t CHANGED_PROGRAM = 2;
+	constexpr uint32_t CHANGED_FORMAT = 4;
+	constexpr uint32_t CHANGED_MATERIAL = 8;
+	constexpr uint32_t CHANGED_TEXTURES = 16;
+
+	/// <summary>
+	/// State of one draw. Program, format, material and textures are small indexes the caller assigns (a slot in its own
+	/// table of programs, vertex array formats, materials and texture sets), not GL names.
+	/// Depth is a quantized view distance, see Quantize_Depth.
+	/// </summary>
+	struct Fields {
+		Pass pass = Pass::Opaque;
+		uint32_t program = 0;
+		uint32_t format = 0;
+		uint32_t material = 0;
+		uint32_t textures = 0;
+		uint32_t depth = 0;
+	};
+
+	/// <summary>
+	/// A queued draw, index is the caller's handle for whatever the draw needs (an entity, a mesh range, a command).
+	/// </summary>
+	struct Packet {
+		uint64_t key;
+		uint32_t index;
+		uint32_t padding;
+	};
+
+	struct Statistics {
+		size_t packets = 0;
+		// Radix passes run and skipped because every key shared the digit
+		size_t radixPasses = 0;
+		size_t skippedPasses = 0;
+		// Fields that changed between consecutive submitted packets
+		size_t stateChanges = 0;
+		double sortMilliseconds = 0.0;
+		double submitMilliseconds = 0.0;
+
+		void Reset() {
+			packets = 0;
+			radixPasses = 0;
+			skippedPasses = 0;
+			stateChanges = 0;
+			sortMilliseconds = 0.0;
+			submitMilliseconds = 0.0;
+		}
+	};
+
+	/// <summary>
+	/// Maps a view space distance linearly between the near and far planes onto the depth field, clamping outside them.
+	/// </summary>
+	inline uint32_t Quantize_Depth(float distance, float nearPlane, float farPlane) {
+		float normalised = (distance - nearPlane) / (farPlane - nearPlane);
+		normalised = std::min(std::max(normalised, 0.0f), 1.0f);
+		return uint32_t(normalised * float(MAX_DEPTH) + 0.5f);
+	}
+
+	/// <summary>
+	/// Transparent draws must blend back to front so depth leads their key, inverted so the farthest sorts first.
+	/// Every other pass sorts by state and then front to back, so early depth testing rejects what is hidden.
+	/// </summary>
+	inline bool Depth_Leads(Pass pass) {
+		return pass == Pass::Transparent;
+	}
+
+	/// <summary>
+	/// Packs the fields into a key, from the high bits:
+	/// opaque, masked and overlay are pass, program, format, material, textures, depth;
+	/// transparent is pass, inverted depth, program, format, material, textures.
+	/// </summary>
+	inline uint64_t Make_Key(Fields const& fields) {
+		if (fields.program >> PROGRAM_BITS || fields.format >> FORMAT_BITS || fields.material >> MATERIAL_BITS || fields.textures >> TEXTURES_BITS || fields.depth > MAX_DEPTH) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": program " + std::to_string(fields.program) + ", format " + std::to_string(fields.format) + ", material " + std::to_string(fields.material) + ", textures " + std::to_string(fields.textures) + " or depth " + std::to_string(fields.depth) + " does not fit the key.");
+		}
+		uint64_t state = uint64_t(fields.program);
+		state = (state << FORMAT_BITS) | fields.format;
+		state = (state << MATERIAL_BITS) | fields.material;
+		state = (state << TEXTURES_BITS) | fields.textures;
+		uint64_t key = uint64_t(fields.pass) << (64 - PASS_BITS);
+		if (Depth_Leads(fields.pass)) {
+			return key | (uint64_t(MAX_DEPTH - fields.depth) << (64 - PASS_BITS - DEPTH_BITS)) | state;
+		}
+		return key | (state << DEPTH_BITS) | fields.depth;
+	}
+
+	inline Fields Decode_Key(uint64_t key) {
+		Fields fields;
+		fields.pass = Pass(key >> (64 - PASS_BITS));
+		uint64_t state;
+		if (Depth_Leads(fields.pass)) {
+			fields.depth = MAX_DEPTH - uint32_t((key >> (64 - PASS_BITS - DEPTH_BITS)) & MAX_DEPTH);
+			state = key;
+		}
+		else {
+			fields.depth = uint32_t(key & MAX_DEPTH);
+			state = key >> DEPTH_BITS;
+		}
+		fields.textures = uint32_t(state & ((1u << TEXTURES_BITS) - 1));
+		state >>= TEXTURES_BITS;
+		fields.material = uint32_t(state & ((1u << MATERIAL_BITS) - 1));
+		state >>= MATERIAL_BITS;
+		fields.format = uint32_t(state & ((1u << FORMAT_BITS) - 1));
+		state >>= FORMAT_BITS;
+		fields.program = uint32_t(state & ((1u << PROGRAM_BITS) - 1));
+		return fields;
+	}
+
+	/// <returns>CHANGED_ bits of the fields that differ</returns>
+	inline uint32_t Changed_Fields(Fields const& previous, Fields const& current) {
+		return (previous.pass != current.pass ? CHANGED_PASS : 0) |
+			(previous.program != current.program ? CHANGED_PROGRAM : 0) |
+			(previous.format != current.format ? CHANGED_FORMAT : 0) |
+			(previous.material != current.material ? CHANGED_MATERIAL : 0) |
+			(previous.textures != current.textures ? CHANGED_TEXTURES : 0);
+	}
+
+	/// <summary>
+	/// Stable ascending sort of packets by key, a byte at a time from the lowest. All eight histograms are counted in one
+	/// read, then bytes every key shares are skipped, usually the pass and program bytes, so most frames take few passes.
+	/// </summary>
+	/// <param name="scratch">Resized to match packets, kept by the caller so sorting does not allocate each frame</param>
+	/// <returns>Radix passes run, Statistics counts the skipped ones from this</returns>
+	inline size_t Radix_Sort(std::vector<Packet>& packets, std::vector<Packet>& scratch) {
+		if (packets.size() < INSERTION_SORT_LIMIT) {
+			for (size_t index = 1; index < packets.size(); ++index) {
+				Packet packet = packets[index];
+				size_t hole = index;
+				for (; hole > 0 && packets[hole - 1].key > packet.key; --hole) {
+					packets[hole] = packets[hole - 1];
+				}
+				packets[hole] = packet;
+			}
+			return 0;
+		}
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (Packet const& packet : packets) {
+			for (size_t digit = 0; digit < 8; ++digit) {
+				++histograms[digit][(packet.key >> (digit * 8)) & 0xFF];
+			}
+		}
+		scratch.resize(packets.size());
+		size_t passes = 0;
+		for (size_t digit = 0; digit < 8; ++digit) {
+			std::array<uint32_t, 256>& histogram = histograms[digit];
+			if (histogram[(packets.front().key >> (digit * 8)) & 0xFF] == packets.size()) {
+				continue;
+			}
+			uint32_t offset = 0;
+			for (uint32_t& count : histogram) {
+				uint32_t bucket = count;
+				count = offset;
+				offset += bucket;
+			}
+			for (Packet const& packet : packets) {
+				scratch[histogram[(packet.key >> (digit * 8)) & 0xFF]++] = packet;
+			}
+			packets.swap(scratch);
+			++passes;
+		}
+		return passes;
+	}
+
+	/// <summary>
+	/// Linear buffer of a frame's draw packets. Push in any order, Sort once, then Submit walks them in key order
+	/// and reports which fields changed so the caller only binds those.
+	/// </summary>
+	class RenderQueue {
+		std::vector<Packet> _packets;
+		std::vector<Packet> _scratch;
+		bool _sorted = true;
+
+	public:
+		Statistics statistics;
+
+		RenderQueue() = default;
+		RenderQueue(RenderQueue const&) = delete;
+		RenderQueue& operator=(RenderQueue const&) = delete;
+
+		/// <summary>
+		/// Drops the previous frame's packets, the buffers keep their capacity.
+		/// </summary>
+		void Clear() {
+			_packets.clear();
+			_sorted = true;
+		}
+
+		void Reserve(size_t packets) {
+			_packets.reserve(packets);
+			_scratch.reserve(packets);
+		}
+
+		void Push(uint64_t key, uint32_t index) {
+			_packets.push_back({ key, index, 0 });
+			_sorted = false;
+		}
+
+		void Push(Fields const& fields, uint32_t index) {
+			Push(Make_Key(fields), index);
+		}
+
+		void Sort() {
+			if (_sorted) {
+				return;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			size_t passes = Radix_Sort(_packets, _scratch);
+			_sorted = true;
+			statistics.radixPasses += passes;
+			statistics.skippedPasses += _packets.size() < INSERTION_SORT_LIMIT ? 0 : 8 - passes;
+			statistics.sortMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		/// <summary>
+		/// Sorts if needed and calls draw for each packet in key order. The first packet reports every field as changed.
+		/// </summary>
+		/// <param name="draw">Called with the packet, its decoded fields and the CHANGED_ bits since the previous packet</param>
+		void Submit(std::function<void(Packet const& packet, Fields const& fields, uint32_t changed)> const& draw) {
+			Sort();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Fields previous;
+			for (size_t index = 0; index < _packets.size(); ++index) {
+				Fields fields = Decode_Key(_packets[index].key);
+				uint32_t changed = index == 0 ? CHANGED_PASS | CHANGED_PROGRAM | CHANGED_FORMAT | CHANGED_MATERIAL | CHANGED_TEXTURES : Changed_Fields(previous, fields);
+				for (uint32_t bits = changed; bits != 0; bits &= bits - 1) {
+					++statistics.stateChanges;
+				}
+				draw(_packets[index], fields, changed);
+				previous = fields;
+			}
+			statistics.packets += _packets.size();
+			statistics.submitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		/// <summary>
+		/// Packets in key order after Sort, in push order before it.
+		/// </summary>
+		std::vector<Packet> const& Packets() const {
+			return _packets;
+		}
+
+		size_t Size() const {
+			return _packets.size();
+		}
+	};
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "Buffer.hpp"
+#include <GLAD\gl.h>
+#include <cstring>
+#include <vector>
+
+/// <summary>
+/// Persistently mapped buffer for data written every frame, uniforms, storage blocks and instance attributes.
+/// It is split into regions, the CPU bump allocates from one region while the GPU reads the others,
+/// a fence per region stops the CPU from writing a region before the GPU is done with it.
+/// </summary>
+class RingBuffer : public Buffer {
+public:
+	constexpr static unsigned REGIONS = 3;
+
+	/// <summary>
+	/// Room in the current region, data is written through the mapping and offset is where the GPU sees it.
+	/// </summary>
+	struct Allocation {
+		void* data = nullptr;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+
+		bool Valid() const {
+			return data != nullptr;
+		}
+	};
+
+private:
+	GLsizeiptr _regionSize;
+	unsigned char* _mapped;
+	GLsync _fences[REGIONS] = {};
+	unsigned _region = 0;
+	// Bytes used in the current region
+	GLsizeiptr _head = 0;
+	GLsizeiptr _uniformAlignment;
+	GLsizeiptr _storageAlignment;
+
+	static GLsizeiptr QueryAlignment(GLenum name) {
+		GLint alignment = 0;
+		glGetIntegerv(name, &alignment);
+		return alignment > 0 ? GLsizeiptr(alignment) : 1;
+	}
+
+public:
+	/// <param name="regionSize">Bytes that can be allocated each frame</param>
+	RingBuffer(GLsizeiptr regionSize) : Buffer(regionSize * REGIONS, PersistentBufferT()), _regionSize(regionSize),
+		_mapped(static_cast<unsigned char*>(glMapNamedBufferRange(_bufferId, 0, _bufferSize, PERSISTENT_BUFFER_FLAGS))),
+		_uniformAlignment(QueryAlignment(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)), _storageAlignment(QueryAlignment(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT)) {
+
+	}
+
+	virtual ~RingBuffer() {
+		for (GLsync fence : _fences) {
+			if (fence) {
+				glDeleteSync(fence);
+			}
+		}
+		glUnmapNamedBuffer(_bufferId);
+	}
+
+	/// <summary>
+	/// Moves to the next region and waits until the GPU has finished reading it, every earlier allocation is then invalid.
+	/// </summary>
+	void BeginFrame() {
+		_region = (_region + 1) % REGIONS;
+		_head = 0;
+		GLsync& fence = _fences[_region];
+		if (fence) {
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	/// <summary>
+	/// Call after the draws reading the current region have been issued.
+	/// </summary>
+	void EndFrame() {
+		if (_fences[_region]) {
+			glDeleteSync(_fences[_region]);
+		}
+		_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	/// <param name="alignment">The offset is a multiple of this, see UniformAlignment and StorageAlignment</param>
+	/// <returns>Invalid when the region is full</returns>
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+		GLintptr offset = _regionSize * _region;
+		GLsizeiptr start = (offset + _head + alignment - 1) / alignment * alignment - offset;
+		Allocation allocation;
+		if (size < 0 || start + size > _regionSize) {
+			return allocation;
+		}
+		_head = start + size;
+		allocation.offset = offset + start;
+		allocation.data = _mapped + allocation.offset;
+		allocation.size = size;
+		return allocation;
+	}
+
+	/// <summary>
+	/// Allocates and copies in one step.
+	/// Named apart from Push, a pointer and byte count would otherwise pick Push(_Ty const&, alignment) and copy the pointer.
+	/// </summary>
+	Allocation Push_Bytes(void const* data, GLsizeiptr size, GLsizeiptr alignment = 16) {
+		Allocation allocation = Allocate(size, alignment);
+		if (allocation.Valid()) {
+			std::memcpy(allocation.data, data, size_t(size));
+		}
+		return allocation;
+	}
+
+	template <class _Ty>
+	Allocation Push(_Ty const& value, GLsizeiptr alignment = 16) {
+		return Push_Bytes(&value, GLsizeiptr(sizeof(_Ty)), alignment);
+	}
+
+	template <class _Ty>
+	Allocation Push(std::vector<_Ty> const& values, GLsizeiptr alignment = 16) {
+		return Push_Bytes(values.data(), GLsizeiptr(sizeof(_Ty) * values.size()), alignment);
+	}
+
+	/// <summary>
+	/// Binds an allocation made with UniformAlignment to a uniform block binding.
+	/// </summary>
+	void BindUniform(GLuint binding, Allocation const& allocation) const {
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, _bufferId, allocation.offset, allocation.size);
+	}
+
+	/// <summary>
+	/// Binds an allocation made with StorageAlignment to a shader storage block binding.
+	/// </summary>
+	void BindStorage(GLuint binding, Allocation const& allocation) const {
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, _bufferId, allocation.offset, allocation.size);
+	}
+
+	GLsizeiptr UniformAlignment() const {
+		return _uniformAlignment;
+	}
+
+	GLsizeiptr StorageAlignment() const {
+		return _storageAlignment;
+	}
+
+	GLsizeiptr RegionSize() const {
+		return _regionSize;
+	}
+
+	/// <returns>Bytes allocated from the current region</returns>
+	GLsizeiptr Used() const {
+		return _head;
+	}
+};
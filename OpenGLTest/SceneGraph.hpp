@@ -0,0 +1,336 @@
+#pragma once
+#include "Simd.hpp"
+#include "NodeTransforms.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+/// <summary>
+/// Node hierarchy flattened in depth first order, a parent is always before its children and the subtree of node i is [i, subtreeEnd[i]).
+/// Every array is indexed by slot, the slots of 'transforms' are the same slots.
+/// Update only rebuilds local matrices of dirty nodes and world matrices of the subtrees below them.
+/// </summary>
+class SceneGraph {
+public:
+	struct Statistics {
+		size_t localMatrices = 0;
+		size_t worldMatrices = 0;
+
+		void Reset() {
+			localMatrices = 0;
+			worldMatrices = 0;
+		}
+	};
+
+	static constexpr unsigned NO_PARENT = unsigned(-1);
+	// Below this many nodes Update(ThreadPool&) does not split the work
+	static constexpr size_t PARALLEL_MINIMUM = 4096;
+
+	NodeTransforms transforms;
+	std::vector<unsigned> parent;
+	std::vector<unsigned> subtreeEnd;
+	std::vector<GLTF::index_type> mesh;
+	std::vector<glm::mat4> local;
+	std::vector<glm::mat4> world;
+	Statistics statistics;
+
+private:
+	// Subtrees updated by one task, the parent of 'root' is in _topNodes
+	struct Job {
+		unsigned root;
+		unsigned end;
+	};
+
+	std::vector<unsigned> _topNodes;
+	std::vector<Job> _jobs;
+	std::vector<unsigned char> _worldChanged;
+	size_t _partitionJobs = 0;
+
+	/// <summary>
+	/// destination = a * b, column major, destination may not alias a or b.
+	/// </summary>
+	static void Multiply(glm::mat4 const& a, glm::mat4 const& b, glm::mat4& destination) {
+		float const* left = &a[0][0];
+		float const* right = &b[0][0];
+		float* result = &destination[0][0];
+#if defined(SIMD_AVX2)
+		if (Simd::Has_Avx2()) {
+			// Two columns of b per register, each lane broadcasts its own column's elements
+			__m256 a0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(left));
+			__m256 a1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(left + 4));
+			__m256 a2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(left + 8));
+			__m256 a3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(left + 12));
+			for (size_t column = 0; column < 16; column += 8) {
+				__m256 columns = _mm256_loadu_ps(right + column);
+				__m256 sum = _mm256_mul_ps(a0, _mm256_shuffle_ps(columns, columns, _MM_SHUFFLE(0, 0, 0, 0)));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(a1, _mm256_shuffle_ps(columns, columns, _MM_SHUFFLE(1, 1, 1, 1))));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(a2, _mm256_shuffle_ps(columns, columns, _MM_SHUFFLE(2, 2, 2, 2))));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(a3, _mm256_shuffle_ps(columns, columns, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm256_storeu_ps(result + column, sum);
+			}
+			return;
+		}
+#endif
+#if defined(SIMD_SSE)
+		__m128 a0 = _mm_loadu_ps(left);
+		__m128 a1 = _mm_loadu_ps(left + 4);
+		__m128 a2 = _mm_loadu_ps(left + 8);
+		__m128 a3 = _mm_loadu_ps(left + 12);
+		for (size_t column = 0; column < 16; column += 4) {
+			__m128 sum = _mm_mul_ps(a0, _mm_set1_ps(right[column]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(right[column + 1])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(right[column + 2])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(right[column + 3])));
+			_mm_storeu_ps(result + column, sum);
+		}
+#else
+		for (size_t column = 0; column < 4; ++column) {
+			for (size_t row = 0; row < 4; ++row) {
+				result[column * 4 + row] = left[row] * right[column * 4] + left[4 + row] * right[column * 4 + 1] + left[8 + row] * right[column * 4 + 2] + left[12 + row] * right[column * 4 + 3];
+			}
+		}
+#endif
+	}
+
+	/// <summary>
+	/// Updates the slots [begin, end), which must be whole subtrees whose parents are up to date.
+	/// </summary>
+	/// <param name="dirtyEnd">Slots before this get new world matrices, set when the parent of 'begin' changed</param>
+	/// <returns>Local and world matrices rebuilt</returns>
+	std::pair<size_t, size_t> Update_Range(size_t begin, size_t end, size_t dirtyEnd) {
+		size_t localCount = 0;
+		size_t worldCount = 0;
+		for (size_t slot = begin; slot < end; ++slot) {
+			if (transforms.dirty[slot]) {
+				transforms.dirty[slot] = 0;
+				Local_Matrix(transforms.translation.data() + slot * 3, transforms.rotation.data() + slot * 4, transforms.scale.data() + slot * 3, local[slot]);
+				dirtyEnd = std::max(dirtyEnd, size_t(subtreeEnd[slot]));
+				++localCount;
+			}
+			if (slot < dirtyEnd) {
+				if (parent[slot] == NO_PARENT) {
+					world[slot] = local[slot];
+				}
+				else {
+					Multiply(world[parent[slot]], local[slot], world[slot]);
+				}
+				++worldCount;
+			}
+		}
+		return { localCount, worldCount };
+	}
+
+	/// <summary>
+	/// Splits the hierarchy into subtrees of at most Size() / jobCount nodes, nodes above them are updated before the jobs.
+	/// </summary>
+	void Partition(size_t jobCount) {
+		_topNodes.clear();
+		_jobs.clear();
+		_partitionJobs = jobCount;
+
+		size_t grain = std::max(Size() / jobCount, size_t(1));
+		for (size_t slot = 0; slot < Size();) {
+			if (subtreeEnd[slot] - slot <= grain) {
+				// Neighbouring small subtrees under the same parent share a job
+				if (!_jobs.empty() && _jobs.back().end == slot && parent[_jobs.back().root] == parent[slot] && subtreeEnd[slot] - _jobs.back().root <= grain) {
+					_jobs.back().end = subtreeEnd[slot];
+				}
+				else {
+					_jobs.push_back({ unsigned(slot), subtreeEnd[slot] });
+				}
+				slot = subtreeEnd[slot];
+			}
+			else {
+				_topNodes.emplace_back(unsigned(slot));
+				++slot;
+			}
+		}
+	}
+
+public:
+	/// <summary>
+	/// Column major translation * rotation * scale, rotation is an x, y, z, w quaternion.
+	/// </summary>
+	static void Local_Matrix(float const translation[3], float const rotation[4], float const scale[3], glm::mat4& destination) {
+		float x = rotation[0];
+		float y = rotation[1];
+		float z = rotation[2];
+		float w = rotation[3];
+
+		destination[0][0] = (1.0f - 2.0f * (y * y + z * z)) * scale[0];
+		destination[0][1] = (2.0f * (x * y + z * w)) * scale[0];
+		destination[0][2] = (2.0f * (x * z - y * w)) * scale[0];
+		destination[0][3] = 0.0f;
+		destination[1][0] = (2.0f * (x * y - z * w)) * scale[1];
+		destination[1][1] = (1.0f - 2.0f * (x * x + z * z)) * scale[1];
+		destination[1][2] = (2.0f * (y * z + x * w)) * scale[1];
+		destination[1][3] = 0.0f;
+		destination[2][0] = (2.0f * (x * z + y * w)) * scale[2];
+		destination[2][1] = (2.0f * (y * z - x * w)) * scale[2];
+		destination[2][2] = (1.0f - 2.0f * (x * x + y * y)) * scale[2];
+		destination[2][3] = 0.0f;
+		destination[3][0] = translation[0];
+		destination[3][1] = translation[1];
+		destination[3][2] = translation[2];
+		destination[3][3] = 1.0f;
+	}
+
+	SceneGraph() = default;
+	SceneGraph(SceneGraph const&) = default;
+	SceneGraph(SceneGraph&&) = default;
+
+	SceneGraph& operator=(SceneGraph const&) = default;
+	SceneGraph& operator=(SceneGraph&&) = default;
+
+	size_t Size() const {
+		return parent.size();
+	}
+
+	/// <summary>
+	/// Appends the node trees of a scene, nodes of the document not in the scene are skipped.
+	/// Documents without scenes add every node without a parent as a root.
+	/// </summary>
+	/// <param name="scene">Scene to add, -1 for the document's default scene</param>
+	/// <returns>Slot of each document node, -1 for skipped nodes, pass to Animation::Instance::nodeSlots</returns>
+	std::vector<unsigned> Add_Document(GLTF::GLTFDoc const& doc, GLTF::index_type scene = GLTF::index_type(-1)) {
+		std::vector<GLTF::index_type> roots;
+		if (doc.scenes.empty()) {
+			std::vector<bool> isChild(doc.nodes.size(), false);
+			for (GLTF::Node const& node : doc.nodes) {
+				for (GLTF::index_type child : node.children) {
+					if (child < doc.nodes.size()) {
+						isChild[child] = true;
+					}
+				}
+			}
+			for (size_t node = 0; node < doc.nodes.size(); ++node) {
+				if (!isChild[node]) {
+					roots.emplace_back(GLTF::index_type(node));
+				}
+			}
+		}
+		else {
+			if (scene == GLTF::index_type(-1)) {
+				scene = doc.scene == GLTF::index_type(-1) ? 0 : doc.scene;
+			}
+			if (scene >= doc.scenes.size()) {
+				throw std::out_of_range(FILE_FUNCTION_LINE + ": scene " + std::to_string(scene) + " does not exist");
+			}
+			roots = doc.scenes[scene].nodes;
+		}
+
+		std::vector<unsigned> nodeSlots(doc.nodes.size(), unsigned(-1));
+		// Depth first with an explicit stack, children are pushed in reverse to keep document order between siblings
+		std::vector<std::pair<GLTF::index_type, unsigned>> stack;
+		for (auto root = roots.crbegin(); root != roots.crend(); ++root) {
+			stack.emplace_back(*root, NO_PARENT);
+		}
+		std::vector<unsigned> open;
+		while (!stack.empty()) {
+			GLTF::index_type node = stack.back().first;
+			unsigned parentSlot = stack.back().second;
+			stack.pop_back();
+
+			if (node >= doc.nodes.size()) {
+				throw std::out_of_range(FILE_FUNCTION_LINE + ": node " + std::to_string(node) + " does not exist");
+			}
+			if (nodeSlots[node] != unsigned(-1)) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": node " + std::to_string(node) + " has more than one parent");
+			}
+
+			// Close the subtrees of nodes that are not ancestors of this node
+			while (!open.empty() && open.back() != parentSlot) {
+				subtreeEnd[open.back()] = unsigned(Size());
+				open.pop_back();
+			}
+
+			GLTF::Node const& source = doc.nodes[node];
+			unsigned slot = unsigned(transforms.Add_Node(doc, source));
+			nodeSlots[node] = slot;
+			parent.emplace_back(parentSlot);
+			subtreeEnd.emplace_back(slot + 1);
+			mesh.emplace_back(source.mesh);
+			open.emplace_back(slot);
+
+			for (auto child = source.children.crbegin(); child != source.children.crend(); ++child) {
+				stack.emplace_back(*child, slot);
+			}
+		}
+		while (!open.empty()) {
+			subtreeEnd[open.back()] = unsigned(Size());
+			open.pop_back();
+		}
+
+		local.resize(Size(), glm::mat4(1.0f));
+		world.resize(Size(), glm::mat4(1.0f));
+		_worldChanged.resize(Size(), 0);
+		_partitionJobs = 0;
+		return nodeSlots;
+	}
+
+	/// <summary>
+	/// Rebuilds the matrices changed since the last update on the calling thread.
+	/// </summary>
+	void Update() {
+		std::pair<size_t, size_t> counts = Update_Range(0, Size(), 0);
+		statistics.localMatrices += counts.first;
+		statistics.worldMatrices += counts.second;
+	}
+
+	/// <summary>
+	/// Rebuilds the matrices changed since the last update, independent subtrees are updated in parallel.
+	/// </summary>
+	void Update(ThreadPool& pool) {
+		if (Size() < PARALLEL_MINIMUM || pool.ThreadCount() == 0) {
+			Update();
+			return;
+		}
+
+		// Several jobs per thread so one deep subtree does not hold up the others
+		size_t jobCount = (pool.ThreadCount() + 1) * 4;
+		if (_partitionJobs != jobCount) {
+			Partition(jobCount);
+		}
+
+		// Nodes above the jobs, in depth first order so parents are done first
+		for (unsigned slot : _topNodes) {
+			bool parentChanged = parent[slot] != NO_PARENT && _worldChanged[parent[slot]];
+			_worldChanged[slot] = 0;
+			if (transforms.dirty[slot]) {
+				transforms.dirty[slot] = 0;
+				Local_Matrix(transforms.translation.data() + slot * 3, transforms.rotation.data() + slot * 4, transforms.scale.data() + slot * 3, local[slot]);
+				++statistics.localMatrices;
+				parentChanged = true;
+			}
+			if (parentChanged) {
+				if (parent[slot] == NO_PARENT) {
+					world[slot] = local[slot];
+				}
+				else {
+					Multiply(world[parent[slot]], local[slot], world[slot]);
+				}
+				_worldChanged[slot] = 1;
+				++statistics.worldMatrices;
+			}
+		}
+
+		std::vector<std::pair<size_t, size_t>> counts(_jobs.size());
+		pool.Parallel_For(_jobs.size(), 1, [this, &counts](size_t begin, size_t end) {
+			for (size_t index = begin; index < end; ++index) {
+				Job const& job = _jobs[index];
+				unsigned jobParent = parent[job.root];
+				bool parentChanged = jobParent != NO_PARENT && _worldChanged[jobParent];
+				counts[index] = Update_Range(job.root, job.end, parentChanged ? job.end : 0);
+			}
+		});
+		for (std::pair<size_t, size_t> const& count : counts) {
+			statistics.localMatrices += count.first;
+			statistics.worldMatrices += count.second;
+		}
+	}
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include "GLTF.hpp"
+#include "AccessorData.hpp"
+#include "Bounds.hpp"
+#include "SceneGraph.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+namespace GLTF {
+	/// <summary>
+	/// Accessors of the EXT_mesh_gpu_instancing attributes of a node, empty when the node does not use the extension.
+	/// </summary>
+	inline std::vector<index_type> Node_Instance_Accessors(Node const& node) {
+		std::vector<index_type> accessors;
+		type_json_object extension = Get_Extension(node, Constants::EXT_MESH_GPU_INSTANCING);
+		type_json_object attributes = extension ? Get_Optional_Element<JsonParse::JsonObject>(extension, Constants::ATTRIBUTES) : nullptr;
+		if (!attributes) {
+			return accessors;
+		}
+		for (std::pair<std::string, type_json_element> const& attribute : attributes->attributes) {
+			if (attribute.second->type == JsonParse::Type::Integer) {
+				accessors.emplace_back(index_type(std::static_pointer_cast<JsonParse::JsonInteger>(attribute.second)->value));
+			}
+		}
+		return accessors;
+	}
+
+	/// <summary>
+	/// Validator handler for EXT_mesh_gpu_instancing, per instance TRANSLATION, ROTATION and SCALE of a node's mesh.
+	/// Every attribute must have the same count, names other than the three are application specific and start with '_'.
+	/// </summary>
+	inline void Validate_Mesh_Gpu_Instancing(Validator& validator, type_json_object const& extension) {
+		if (std::find(validator.nameBreadCrumbs.cbegin(), validator.nameBreadCrumbs.cend(), Constants::NODES) == validator.nameBreadCrumbs.cend()) {
+			validator.errors.push_back(Validator::GLTFError(extension, extension, validator.ErrorMessageStart(FILE_FUNCTION_LINE) + " " + Constants::EXT_MESH_GPU_INSTANCING + " is only valid on nodes."));
+			return;
+		}
+		validator.Object(FILE_FUNCTION_LINE, extension, Constants::ATTRIBUTES, nullptr, true);
+		type_json_object attributes = Get_Optional_Element<JsonParse::JsonObject>(extension, Constants::ATTRIBUTES);
+		if (!attributes) {
+			return;
+		}
+
+		Validator::ManageBreadCrumb crumbs(validator, Constants::ATTRIBUTES);
+		integer_type count = -1;
+		for (std::pair<std::string, type_json_element> const& attribute : attributes->attributes) {
+			validator.Index(FILE_FUNCTION_LINE, attributes, attribute.first, Constants::ACCESSORS, true);
+			if (attribute.second->type != JsonParse::Type::Integer) {
+				continue;
+			}
+			integer_type index = std::static_pointer_cast<JsonParse::JsonInteger>(attribute.second)->value;
+			if (index < 0 || size_t(index) >= validator.accessorsInfo.size()) {
+				// Reported by Index
+				continue;
+			}
+			Validator::AccessorInfo const& accessor = validator.accessorsInfo[size_t(index)];
+			std::string expectedType;
+			if (attribute.first == Constants::INSTANCE_TRANSLATION || attribute.first == Constants::INSTANCE_SCALE) {
+				expectedType = "VEC3";
+			}
+			else if (attribute.first == Constants::INSTANCE_ROTATION) {
+				expectedType = "VEC4";
+			}
+			else if (attribute.first.empty() || attribute.first[0] != '_') {
+				validator.errors.push_back(Validator::GLTFError(attributes, attribute.second, validator.ErrorMessageStart(FILE_FUNCTION_LINE) + attribute.first + " must be " +
+					Constants::INSTANCE_TRANSLATION + ", " + Constants::INSTANCE_ROTATION + ", " + Constants::INSTANCE_SCALE + ", or start with '_'."));
+			}
+			if (!expectedType.empty() && accessor.accessorType != expectedType) {
+				validator.errors.push_back(Validator::GLTFError(attributes, attribute.second, validator.ErrorMessageStart(FILE_FUNCTION_LINE) + attribute.first +
+					" accessor.type:" + accessor.accessorType + " must be '" + expectedType + "'."));
+			}
+			if (count == -1) {
+				count = accessor.count;
+			}
+			else if (accessor.count != count) {
+				validator.errors.push_back(Validator::GLTFError(attributes, attribute.second, validator.ErrorMessageStart(FILE_FUNCTION_LINE) + attribute.first +
+					" accessor.count:" + std::to_string(accessor.count) + " must match the other attributes:" + std::to_string(count) + "."));
+			}
+		}
+	}
+}
+
+// Scene compilation for instanced drawing, nodes that draw the same mesh the same way become one batch
+namespace SceneInstancing {
+	/// <summary>
+	/// Instances that draw one mesh, every primitive of the mesh is drawn once for all of them with its own material.
+	/// Instances index the instance arrays built by Instance_Bounds.
+	/// </summary>
+	struct Batch {
+		GLTF::index_type mesh;
+		std::vector<unsigned> instances;
+	};
+
+	/// <summary>
+	/// Local transform of each EXT_mesh_gpu_instancing instance of a node, applied after the node's world matrix.
+	/// Attributes the node leaves out are the identity, empty when the node does not use the extension.
+	/// </summary>
+	/// <param name="buffers">Spans over the document buffers, the attribute accessors must be readable</param>
+	inline std::vector<glm::mat4> Read_Node_Instances(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Node const& node) {
+		std::vector<glm::mat4> instances;
+		GLTF::type_json_object extension = GLTF::Get_Extension(node, GLTF::Constants::EXT_MESH_GPU_INSTANCING);
+		GLTF::type_json_object attributes = extension ? GLTF::Get_Optional_Element<JsonParse::JsonObject>(extension, GLTF::Constants::ATTRIBUTES) : nullptr;
+		if (!attributes) {
+			return instances;
+		}
+		auto read = [&](std::string const& name, size_t components) {
+			GLTF::index_type accessor = GLTF::Get_Optional_Value<JsonParse::JsonInteger>(attributes, name, GLTF::index_type(-1));
+			std::vector<float> values;
+			if (accessor != GLTF::index_type(-1)) {
+				values = GLTF::Read_Accessor_Float(doc, buffers, accessor);
+				if (values.size() % components != 0) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": " + GLTF::Constants::EXT_MESH_GPU_INSTANCING + " " + name + " of node '" + node.name + "' is not " + std::to_string(components) + " components.");
+				}
+			}
+			return values;
+		};
+		std::vector<float> translation = read(GLTF::Constants::INSTANCE_TRANSLATION, 3);
+		std::vector<float> rotation = read(GLTF::Constants::INSTANCE_ROTATION, 4);
+		std::vector<float> scale = read(GLTF::Constants::INSTANCE_SCALE, 3);
+		size_t count = std::max(std::max(translation.size() / 3, rotation.size() / 4), scale.size() / 3);
+		if ((!translation.empty() && translation.size() / 3 != count) || (!rotation.empty() && rotation.size() / 4 != count) || (!scale.empty() && scale.size() / 3 != count)) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": " + GLTF::Constants::EXT_MESH_GPU_INSTANCING + " attributes of node '" + node.name + "' have different counts.");
+		}
+
+		float const identityTranslation[3] = { 0.0f, 0.0f, 0.0f };
+		float const identityRotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		float const identityScale[3] = { 1.0f, 1.0f, 1.0f };
+		instances.resize(count);
+		for (size_t instance = 0; instance < count; ++instance) {
+			SceneGraph::Local_Matrix(translation.empty() ? identityTranslation : translation.data() + instance * 3, rotation.empty() ? identityRotation : rotation.data() + instance * 4,
+				scale.empty() ? identityScale : scale.data() + instance * 3, instances[instance]);
+		}
+		return instances;
+	}
+
+	/// <summary>
+	/// EXT_mesh_gpu_instancing transforms of every node in the scene, indexed by slot.
+	/// </summary>
+	/// <param name="nodeSlots">Slot of each document node, as returned by SceneGraph::Add_Document</param>
+	/// <param name="meshes">Only nodes drawing one of these meshes are read, every node when empty, for documents whose buffers are streamed</param>
+	inline void Read_Scene_Instances(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, std::vector<unsigned> const& nodeSlots, std::vector<std::vector<glm::mat4>>& slotInstances,
+		std::vector<GLTF::index_type> const& meshes = {}) {
+		for (size_t node = 0; node < doc.nodes.size() && node < nodeSlots.size(); ++node) {
+			unsigned slot = nodeSlots[node];
+			GLTF::Node const& source = doc.nodes[node];
+			if (slot == unsigned(-1) || source.mesh == GLTF::index_type(-1) || (!meshes.empty() && std::find(meshes.begin(), meshes.end(), source.mesh) == meshes.end())) {
+				continue;
+			}
+			if (slotInstances.size() <= slot) {
+				slotInstances.resize(size_t(slot) + 1);
+			}
+			slotInstances[slot] = Read_Node_Instances(doc, buffers, source);
+		}
+	}
+
+	/// <summary>
+	/// World space bounds and matrices of everything drawn, one instance per node with a mesh or one per GPU instance of nodes using EXT_mesh_gpu_instancing.
+	/// </summary>
+	/// <param name="slotInstances">GPU instances indexed by slot, see Read_Scene_Instances</param>
+	/// <param name="meshBounds">Object space bounds indexed by document mesh</param>
+	/// <param name="slots">Scene slot of each instance, a slot repeats for each of its GPU instances</param>
+	inline void Instance_Bounds(SceneGraph const& scene, std::vector<std::vector<glm::mat4>> const& slotInstances, std::vector<AABB> const& meshBounds,
+		std::vector<AABB>& bounds, std::vector<unsigned>& slots, std::vector<glm::mat4>& worlds) {
+		bounds.clear();
+		slots.clear();
+		worlds.clear();
+		for (size_t slot = 0; slot < scene.Size(); ++slot) {
+			GLTF::index_type mesh = scene.mesh[slot];
+			if (mesh == GLTF::index_type(-1) || mesh >= meshBounds.size() || meshBounds[mesh].Empty()) {
+				continue;
+			}
+			if (slot < slotInstances.size() && !slotInstances[slot].empty()) {
+				for (glm::mat4 const& instance : slotInstances[slot]) {
+					worlds.emplace_back(scene.world[slot] * instance);
+					bounds.emplace_back(Transform_AABB(meshBounds[mesh], worlds.back()));
+					slots.emplace_back(unsigned(slot));
+				}
+			}
+			else {
+				worlds.emplace_back(scene.world[slot]);
+				bounds.emplace_back(Transform_AABB(meshBounds[mesh], worlds.back()));
+				slots.emplace_back(unsigned(slot));
+			}
+		}
+	}
+
+	/// <summary>
+	/// Rewrites the bounds of the instances of meshes whose bounds changed, in place of Instance_Bounds while the instance list stays the same.
+	/// Slots with GPU instances are skipped, their one stand in instance becomes several and only Instance_Bounds can make that change.
+	/// </summary>
+	/// <param name="batches">Built by Compile over the current instances, they find the instances of each mesh</param>
+	/// <param name="changed">Indexed by document mesh, nonzero for meshes whose meshBounds changed</param>
+	/// <returns>Instances whose bounds were rewritten</returns>
+	inline std::vector<unsigned> Patch_Instance_Bounds(std::vector<Batch> const& batches, std::vector<unsigned char> const& changed, std::vector<std::vector<glm::mat4>> const& slotInstances,
+		std::vector<AABB> const& meshBounds, std::vector<unsigned> const& slots, std::vector<glm::mat4> const& worlds, std::vector<AABB>& bounds) {
+		std::vector<unsigned> patched;
+		for (Batch const& batch : batches) {
+			if (batch.mesh >= changed.size() || !changed[batch.mesh]) {
+				continue;
+			}
+			for (unsigned instance : batch.instances) {
+				unsigned slot = slots[instance];
+				if (slot < slotInstances.size() && !slotInstances[slot].empty()) {
+					continue;
+				}
+				bounds[instance] = Transform_AABB(meshBounds[batch.mesh], worlds[instance]);
+				patched.emplace_back(instance);
+			}
+		}
+		return patched;
+	}
+
+	/// <summary>
+	/// Groups the instances by mesh so each mesh primitive is one draw for all of them.
+	/// Skinned nodes deform their own copy of the mesh, each is a batch of its own.
+	/// </summary>
+	/// <param name="nodeSlots">Slot of each document node, as returned by SceneGraph::Add_Document</param>
+	/// <param name="slots">Scene slot of each instance, from Instance_Bounds</param>
+	inline std::vector<Batch> Compile(GLTF::GLTFDoc const& doc, SceneGraph const& scene, std::vector<unsigned> const& nodeSlots, std::vector<unsigned> const& slots) {
+		std::vector<unsigned char> skinned(scene.Size(), 0);
+		for (size_t node = 0; node < doc.nodes.size() && node < nodeSlots.size(); ++node) {
+			if (nodeSlots[node] != unsigned(-1) && doc.nodes[node].skin != GLTF::index_type(-1)) {
+				skinned[nodeSlots[node]] = 1;
+			}
+		}
+
+		std::vector<Batch> batches;
+		// Batch of each mesh drawn without a skin
+		std::map<GLTF::index_type, size_t> meshBatches;
+		for (unsigned instance = 0; instance < unsigned(slots.size()); ++instance) {
+			unsigned slot = slots[instance];
+			GLTF::index_type mesh = scene.mesh[slot];
+			if (skinned[slot]) {
+				batches.push_back({ mesh, { instance } });
+				continue;
+			}
+			std::pair<std::map<GLTF::index_type, size_t>::iterator, bool> found = meshBatches.emplace(mesh, batches.size());
+			if (found.second) {
+				batches.push_back({ mesh, {} });
+			}
+			batches[found.first->second].instances.emplace_back(instance);
+		}
+		return batches;
+	}
+}
@@ -31,6 +31,9 @@ unsigned int Compile_Shader(unsigned int type, const std::string& source) {
 		else if (type == GL_VERTEX_SHADER) {
 			throw std::exception(("Failed to compile fragment shader: " + message).data());
 		}
+		else if (type == GL_COMPUTE_SHADER) {
+			throw std::exception(("Failed to compile compute shader: " + message).data());
+		}
 		else {
 			throw std::exception(("Failed to compile unknown shader: " + message).data());
 		}
@@ -101,13 +104,64 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 }
 
 Shader::~Shader() {
-	glDeleteShader(programId);
+	glDeleteProgram(programId);
 }
 
 void Shader::Use() {
 	glUseProgram(programId);
 }
 
+ComputeShader::ComputeShader(const char* computePath) {
+	std::string computeCode;
+	std::ifstream cShaderFile;
+	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+	try {
+		cShaderFile.open(computePath);
+		std::stringstream cShaderStream;
+		cShaderStream << cShaderFile.rdbuf();
+		cShaderFile.close();
+		computeCode = cShaderStream.str();
+	}
+	catch (std::ifstream::failure e) {
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+	}
+
+	unsigned int cs = Compile_Shader(GL_COMPUTE_SHADER, computeCode);
+	programId = glCreateProgram();
+	glAttachShader(programId, cs);
+	glLinkProgram(programId);
+
+	int result;
+	glGetProgramiv(programId, GL_LINK_STATUS, &result);
+	glDeleteShader(cs);
+
+	if (result == GL_FALSE) {
+		int length;
+		glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &length);
+
+		std::string message(length, char(0));
+
+		glGetProgramInfoLog(programId, length, &length, message.data());
+		glDeleteProgram(programId);
+
+		throw std::exception(("Failed to link compute shader: " + message).data());
+	}
+}
+
+ComputeShader::~ComputeShader() {
+	glDeleteProgram(programId);
+}
+
+void ComputeShader::Use() {
+	glUseProgram(programId);
+}
+
+void ComputeShader::Dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) {
+	glUseProgram(programId);
+	glDispatchCompute(groupsX, groupsY, groupsZ);
+}
+
 void Shader::SetBool(const std::string& name, bool value) const {
 	glProgramUniform1i(programId, glGetUniformLocation(programId, name.c_str()), value);
 	//glUniform1i(glGetUniformLocation(programId, name.c_str()), value);
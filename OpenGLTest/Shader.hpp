@@ -27,6 +27,17 @@ public:
 	void SetMat4(const std::string& name, glm::mat4& value) const;
 };
 
+class ComputeShader {
+public:
+	unsigned int programId;
+
+	ComputeShader(const char* computePath);
+	~ComputeShader();
+
+	void Use();
+	void Dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1);
+};
+
 struct GLShader {
 	struct Config {	
 		std::vector<std::pair<std::string, std::string>> replacementsVertex;
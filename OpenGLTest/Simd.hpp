@@ -0,0 +1,71 @@
+#pragma once
+// Instruction set selection for the CPU kernels.
+// MSVC allows every intrinsic regardless of /arch, but only defines __AVX__/__AVX2__ when building with /arch:AVX or /arch:AVX2.
+// The project builds with the default /arch so the binary runs on any x64 CPU: SIMD_AVX2 only says the 8-wide paths are
+// compiled in, kernels pick them at run time with Simd::Has_Avx2() and fall back to the 4-wide SIMD_SSE paths or scalar code.
+// SIMD_SSE paths only use SSE2, which every x64 CPU has, except for SSSE3 byte shuffles that are checked with Simd::Has_Ssse3().
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) || defined(__SSSE3__)
+#define SIMD_SSE 1
+#endif
+
+// Other compilers only accept AVX2 intrinsics in code built for AVX2
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define SIMD_AVX2 1
+#endif
+
+namespace Simd {
+	/// <summary>
+	/// True when SSSE3 instructions such as _mm_shuffle_epi8 may run. The CPU is queried once.
+	/// </summary>
+	inline bool Has_Ssse3() {
+#if defined(__SSSE3__)
+		return true;
+#elif defined(_MSC_VER)
+		static bool const available = [] {
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 9)) != 0;
+		}();
+		return available;
+#else
+		return false;
+#endif
+	}
+
+	/// <summary>
+	/// True when the AVX2 paths are compiled in and this CPU can run them: AVX2 and FMA, with the OS saving the YMM registers.
+	/// The CPU is queried once, kernels test this before their 8-wide loops rather than per element.
+	/// </summary>
+	inline bool Has_Avx2() {
+#if defined(__AVX2__)
+		// Built for AVX2 everywhere, the binary does not start without it
+		return true;
+#elif defined(SIMD_AVX2)
+		static bool const available = [] {
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) {
+				return false;
+			}
+			__cpuid(info, 1);
+			bool fma = (info[2] & (1 << 12)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			// XCR0 bits 1 and 2, SSE and AVX state
+			if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}();
+		return available;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,681 @@
+#pragma once
+#include "Simd.hpp"
+#include "AccessorData.hpp"
+#include "NodeTransforms.hpp"
+#include "Buffer.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// CPU skinning of glTF primitives, also the reference for GPU skinning
+namespace Skinning {
+	enum class Method : unsigned char {
+		LinearBlend,
+		DualQuaternion
+	};
+
+	/// <summary>
+	/// Output vertex, normal and tangent are zero when the source has none.
+	/// </summary>
+	struct SkinnedVertex {
+		float position[3];
+		float normal[3];
+		float tangent[4];
+	};
+
+	/// <summary>
+	/// Rigid part of a joint matrix as a unit dual quaternion (x, y, z, w), scale is kept separately and applied first.
+	/// </summary>
+	struct DualQuaternion {
+		float real[4];
+		float dual[4];
+		float scale[4];
+	};
+
+	/// <summary>
+	/// Joints and inverse bind matrices of a GLTF::Skin.
+	/// </summary>
+	struct SkinData {
+		std::string name;
+		// Node index of every joint
+		std::vector<unsigned> joints;
+		std::vector<glm::mat4> inverseBindMatrices;
+
+		SkinData() = default;
+
+		SkinData(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Skin const& skin) : name(skin.name) {
+			for (GLTF::index_type joint : skin.joints) {
+				joints.emplace_back(static_cast<unsigned>(joint));
+			}
+
+			inverseBindMatrices.resize(joints.size(), glm::mat4(1.0f));
+			if (skin.inverseBindMatrices != GLTF::index_type(-1)) {
+				std::vector<float> matrices = GLTF::Read_Accessor_Float(doc, buffers, skin.inverseBindMatrices);
+				if (matrices.size() != joints.size() * 16) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": skin '" + name + "' inverseBindMatrices count does not match joints.");
+				}
+				for (size_t joint = 0; joint < joints.size(); ++joint) {
+					std::copy(matrices.data() + joint * 16, matrices.data() + joint * 16 + 16, &inverseBindMatrices[joint][0][0]);
+				}
+			}
+		}
+
+		SkinData(SkinData const&) = default;
+		SkinData(SkinData&&) = default;
+
+		SkinData& operator=(SkinData const&) = default;
+		SkinData& operator=(SkinData&&) = default;
+	};
+
+	/// <summary>
+	/// Bind pose streams of a skinned primitive.
+	/// </summary>
+	struct SkinnedMesh {
+		size_t vertexCount = 0;
+		// 3 floats per vertex, padded so the last vertex can be loaded as 4 floats
+		std::vector<float> positions;
+		std::vector<float> normals;
+		// 4 floats per vertex, w is the handedness
+		std::vector<float> tangents;
+		// 4 per vertex from JOINTS_0
+		std::vector<unsigned short> joints;
+		// 4 per vertex from WEIGHTS_0, normalized to sum to 1
+		std::vector<float> weights;
+		unsigned maxJoint = 0;
+
+		SkinnedMesh() = default;
+
+		SkinnedMesh(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Mesh::Primitive const& primitive) {
+			auto attribute = [&](std::string const& semantic) {
+				decltype(primitive.attributes)::const_iterator found = primitive.attributes.find(semantic);
+				return found == primitive.attributes.cend() ? GLTF::index_type(-1) : found->second;
+			};
+
+			GLTF::index_type position = attribute(GLTF::Constants::ATTRIBUTE_POSITION);
+			GLTF::index_type joint = attribute(GLTF::Constants::ATTRIBUTE_JOINTS_0);
+			GLTF::index_type weight = attribute(GLTF::Constants::ATTRIBUTE_WEIGHTS_0);
+			if (position == GLTF::index_type(-1) || joint == GLTF::index_type(-1) || weight == GLTF::index_type(-1)) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": primitive requires POSITION, JOINTS_0 and WEIGHTS_0 to be skinned.");
+			}
+
+			positions = GLTF::Read_Accessor_Float(doc, buffers, position);
+			vertexCount = positions.size() / 3;
+			positions.resize(positions.size() + 1, 0.0f);
+
+			GLTF::index_type normal = attribute(GLTF::Constants::ATTRIBUTE_NORMAL);
+			if (normal != GLTF::index_type(-1)) {
+				normals = GLTF::Read_Accessor_Float(doc, buffers, normal);
+				normals.resize(normals.size() + 1, 0.0f);
+			}
+			GLTF::index_type tangent = attribute(GLTF::Constants::ATTRIBUTE_TANGENT);
+			if (tangent != GLTF::index_type(-1)) {
+				tangents = GLTF::Read_Accessor_Float(doc, buffers, tangent);
+			}
+
+			std::vector<unsigned int> jointIndices = GLTF::Read_Accessor_Unsigned(doc, buffers, joint);
+			weights = GLTF::Read_Accessor_Float(doc, buffers, weight);
+			if (jointIndices.size() != vertexCount * 4 || weights.size() != vertexCount * 4 ||
+				(!normals.empty() && normals.size() != vertexCount * 3 + 1) || (!tangents.empty() && tangents.size() != vertexCount * 4)) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": primitive attributes have different counts.");
+			}
+
+			joints.resize(jointIndices.size());
+			for (size_t index = 0; index < jointIndices.size(); ++index) {
+				joints[index] = static_cast<unsigned short>(jointIndices[index]);
+				maxJoint = std::max(maxJoint, jointIndices[index]);
+			}
+
+			for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+				float* vertexWeights = weights.data() + vertex * 4;
+				float sum = vertexWeights[0] + vertexWeights[1] + vertexWeights[2] + vertexWeights[3];
+				if (sum > 0.0f) {
+					for (size_t index = 0; index < 4; ++index) {
+						vertexWeights[index] /= sum;
+					}
+				}
+			}
+		}
+
+		SkinnedMesh(SkinnedMesh const&) = default;
+		SkinnedMesh(SkinnedMesh&&) = default;
+
+		SkinnedMesh& operator=(SkinnedMesh const&) = default;
+		SkinnedMesh& operator=(SkinnedMesh&&) = default;
+	};
+
+	/// <summary>
+	/// Joint matrices of a skin, inverse(mesh world) * joint world * inverse bind matrix.
+	/// </summary>
+	/// <param name="worldMatrices">World matrix of every node of the document, indexed by node</param>
+	/// <param name="meshWorld">World matrix of the node using the skin, glTF ignores it for skinned meshes so pass identity to render in world space</param>
+	/// <param name="nodeSlots">Maps document nodes to indices of worldMatrices, null when worldMatrices is in document order</param>
+	inline void Build_Palette(SkinData const& skin, glm::mat4 const* worldMatrices, glm::mat4 const& meshWorld, std::vector<glm::mat4>& palette, unsigned const* nodeSlots = nullptr) {
+		glm::mat4 meshWorldInverse = glm::inverse(meshWorld);
+		palette.resize(skin.joints.size());
+		for (size_t joint = 0; joint < skin.joints.size(); ++joint) {
+			size_t node = nodeSlots ? nodeSlots[skin.joints[joint]] : skin.joints[joint];
+			palette[joint] = meshWorldInverse * worldMatrices[node] * skin.inverseBindMatrices[joint];
+		}
+	}
+
+	/// <summary>
+	/// Converts joint matrices for dual quaternion skinning, shear is lost.
+	/// </summary>
+	inline void Build_Dual_Quaternions(std::vector<glm::mat4> const& palette, std::vector<DualQuaternion>& dualQuaternions) {
+		dualQuaternions.resize(palette.size());
+		for (size_t joint = 0; joint < palette.size(); ++joint) {
+			GLTF::number_type matrix[16];
+			for (size_t index = 0; index < 16; ++index) {
+				matrix[index] = (&palette[joint][0][0])[index];
+			}
+
+			float translation[3];
+			float rotation[4];
+			float scale[3];
+			NodeTransforms::Decompose(matrix, translation, rotation, scale);
+
+			DualQuaternion& result = dualQuaternions[joint];
+			std::copy(rotation, rotation + 4, result.real);
+			// dual = 0.5 * (translation, 0) * real
+			result.dual[0] = 0.5f * (rotation[3] * translation[0] + translation[1] * rotation[2] - translation[2] * rotation[1]);
+			result.dual[1] = 0.5f * (rotation[3] * translation[1] + translation[2] * rotation[0] - translation[0] * rotation[2]);
+			result.dual[2] = 0.5f * (rotation[3] * translation[2] + translation[0] * rotation[1] - translation[1] * rotation[0]);
+			result.dual[3] = -0.5f * (translation[0] * rotation[0] + translation[1] * rotation[1] + translation[2] * rotation[2]);
+			std::copy(scale, scale + 3, result.scale);
+			result.scale[3] = 1.0f;
+		}
+	}
+
+#ifdef SIMD_SSE
+	inline __m128 Normalize_3(__m128 vector) {
+		__m128 squares = _mm_mul_ps(vector, vector);
+		squares = _mm_and_ps(squares, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+		__m128 sum = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_div_ps(vector, _mm_sqrt_ps(_mm_max_ps(sum, _mm_set1_ps(1e-20f))));
+	}
+
+	inline __m128 Cross(__m128 a, __m128 b) {
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 result = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(result, result, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	/// <summary>
+	/// c0 * x + c1 * y + c2 * z + c3 * w
+	/// </summary>
+	inline __m128 Transform(__m128 const columns[4], float x, float y, float z, float w) {
+		return _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(x)), _mm_mul_ps(columns[1], _mm_set1_ps(y))),
+			_mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(z)), _mm_mul_ps(columns[3], _mm_set1_ps(w))));
+	}
+#endif
+
+#ifdef SIMD_AVX2
+	/// <summary>
+	/// Matrix held as columns 0|1 and 2|3, c0 * x + c1 * y + c2 * z + c3 * w
+	/// </summary>
+	inline __m128 Transform(__m256 columns01, __m256 columns23, float x, float y, float z, float w) {
+		__m256 xy = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(x)), _mm_set1_ps(y), 1);
+		__m256 zw = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(z)), _mm_set1_ps(w), 1);
+		__m256 result = _mm256_add_ps(_mm256_mul_ps(columns01, xy), _mm256_mul_ps(columns23, zw));
+		return _mm_add_ps(_mm256_castps256_ps128(result), _mm256_extractf128_ps(result, 1));
+	}
+#endif
+
+	/// <summary>
+	/// Linear blend skinning of vertices [begin, end), normals and tangents use the blended matrix and are renormalized.
+	/// </summary>
+	/// <param name="destination">Output for vertex 0 of the mesh</param>
+	inline void Skin_Linear_Blend_Scalar(SkinnedMesh const& mesh, glm::mat4 const* palette, size_t begin, size_t end, SkinnedVertex* destination) {
+		bool hasNormals = !mesh.normals.empty();
+		bool hasTangents = !mesh.tangents.empty();
+
+		for (size_t vertex = begin; vertex < end; ++vertex) {
+			unsigned short const* joints = mesh.joints.data() + vertex * 4;
+			float const* weights = mesh.weights.data() + vertex * 4;
+			float const* position = mesh.positions.data() + vertex * 3;
+			SkinnedVertex& output = destination[vertex];
+
+			// Rows 0 to 2 of the blended matrix, column major
+			float matrix[12] = {};
+			for (size_t influence = 0; influence < 4; ++influence) {
+				glm::mat4 const& joint = palette[joints[influence]];
+				for (size_t column = 0; column < 4; ++column) {
+					for (size_t row = 0; row < 3; ++row) {
+						matrix[column * 3 + row] += weights[influence] * joint[column][row];
+					}
+				}
+			}
+
+			auto transform = [&](float const* source, float w, float* result) {
+				for (size_t row = 0; row < 3; ++row) {
+					result[row] = matrix[row] * source[0] + matrix[3 + row] * source[1] + matrix[6 + row] * source[2] + matrix[9 + row] * w;
+				}
+			};
+			auto normalize = [](float* vector) {
+				float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+				float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+				for (size_t index = 0; index < 3; ++index) {
+					vector[index] *= inverse;
+				}
+			};
+
+			transform(position, 1.0f, output.position);
+			std::fill(output.normal, output.normal + 3, 0.0f);
+			std::fill(output.tangent, output.tangent + 4, 0.0f);
+			if (hasNormals) {
+				transform(mesh.normals.data() + vertex * 3, 0.0f, output.normal);
+				normalize(output.normal);
+			}
+			if (hasTangents) {
+				transform(mesh.tangents.data() + vertex * 4, 0.0f, output.tangent);
+				normalize(output.tangent);
+				output.tangent[3] = mesh.tangents[vertex * 4 + 3];
+			}
+		}
+	}
+
+#ifdef SIMD_SSE
+	/// <summary>
+	/// Skin_Linear_Blend_Scalar with 4-wide matrix columns, or pairs of columns 8-wide when 'avx2' is set.
+	/// </summary>
+	inline void Skin_Linear_Blend_Simd(SkinnedMesh const& mesh, glm::mat4 const* palette, size_t begin, size_t end, SkinnedVertex* destination, bool avx2) {
+		bool hasNormals = !mesh.normals.empty();
+		bool hasTangents = !mesh.tangents.empty();
+
+		for (size_t vertex = begin; vertex < end; ++vertex) {
+			unsigned short const* joints = mesh.joints.data() + vertex * 4;
+			float const* weights = mesh.weights.data() + vertex * 4;
+			float const* position = mesh.positions.data() + vertex * 3;
+			SkinnedVertex& output = destination[vertex];
+
+#if defined(SIMD_AVX2)
+			if (avx2) {
+				__m256 weight = _mm256_set1_ps(weights[0]);
+				__m256 columns01 = _mm256_mul_ps(weight, _mm256_loadu_ps(&palette[joints[0]][0][0]));
+				__m256 columns23 = _mm256_mul_ps(weight, _mm256_loadu_ps(&palette[joints[0]][2][0]));
+				for (size_t influence = 1; influence < 4; ++influence) {
+					weight = _mm256_set1_ps(weights[influence]);
+					columns01 = _mm256_add_ps(columns01, _mm256_mul_ps(weight, _mm256_loadu_ps(&palette[joints[influence]][0][0])));
+					columns23 = _mm256_add_ps(columns23, _mm256_mul_ps(weight, _mm256_loadu_ps(&palette[joints[influence]][2][0])));
+				}
+
+				// Stores are 4 wide and ordered so each spills into the next field before it is written
+				_mm_storeu_ps(output.position, Transform(columns01, columns23, position[0], position[1], position[2], 1.0f));
+				if (hasNormals) {
+					float const* normal = mesh.normals.data() + vertex * 3;
+					_mm_storeu_ps(output.normal, Normalize_3(Transform(columns01, columns23, normal[0], normal[1], normal[2], 0.0f)));
+				}
+				else {
+					_mm_storeu_ps(output.normal, _mm_setzero_ps());
+				}
+				if (hasTangents) {
+					float const* tangent = mesh.tangents.data() + vertex * 4;
+					_mm_storeu_ps(output.tangent, Normalize_3(Transform(columns01, columns23, tangent[0], tangent[1], tangent[2], 0.0f)));
+					output.tangent[3] = tangent[3];
+				}
+				else {
+					_mm_storeu_ps(output.tangent, _mm_setzero_ps());
+				}
+				continue;
+			}
+#endif
+			__m128 columns[4];
+			__m128 weight = _mm_set1_ps(weights[0]);
+			for (size_t column = 0; column < 4; ++column) {
+				columns[column] = _mm_mul_ps(weight, _mm_loadu_ps(&palette[joints[0]][column][0]));
+			}
+			for (size_t influence = 1; influence < 4; ++influence) {
+				weight = _mm_set1_ps(weights[influence]);
+				for (size_t column = 0; column < 4; ++column) {
+					columns[column] = _mm_add_ps(columns[column], _mm_mul_ps(weight, _mm_loadu_ps(&palette[joints[influence]][column][0])));
+				}
+			}
+
+			// Stores are 4 wide and ordered so each spills into the next field before it is written
+			_mm_storeu_ps(output.position, Transform(columns, position[0], position[1], position[2], 1.0f));
+			if (hasNormals) {
+				float const* normal = mesh.normals.data() + vertex * 3;
+				_mm_storeu_ps(output.normal, Normalize_3(Transform(columns, normal[0], normal[1], normal[2], 0.0f)));
+			}
+			else {
+				_mm_storeu_ps(output.normal, _mm_setzero_ps());
+			}
+			if (hasTangents) {
+				float const* tangent = mesh.tangents.data() + vertex * 4;
+				_mm_storeu_ps(output.tangent, Normalize_3(Transform(columns, tangent[0], tangent[1], tangent[2], 0.0f)));
+				output.tangent[3] = tangent[3];
+			}
+			else {
+				_mm_storeu_ps(output.tangent, _mm_setzero_ps());
+			}
+		}
+	}
+#endif
+
+	/// <summary>
+	/// Linear blend skinning of vertices [begin, end), see Skin_Linear_Blend_Scalar.
+	/// </summary>
+	inline void Skin_Linear_Blend(SkinnedMesh const& mesh, glm::mat4 const* palette, size_t begin, size_t end, SkinnedVertex* destination) {
+#ifdef SIMD_SSE
+		Skin_Linear_Blend_Simd(mesh, palette, begin, end, destination, Simd::Has_Avx2());
+#else
+		Skin_Linear_Blend_Scalar(mesh, palette, begin, end, destination);
+#endif
+	}
+
+	/// <summary>
+	/// Dual quaternion skinning of vertices [begin, end), avoids the volume loss of linear blending at twisting joints.
+	/// Joint scale is blended linearly and applied before the rotation.
+	/// </summary>
+	/// <param name="destination">Output for vertex 0 of the mesh</param>
+	inline void Skin_Dual_Quaternion_Scalar(SkinnedMesh const& mesh, DualQuaternion const* dualQuaternions, size_t begin, size_t end, SkinnedVertex* destination) {
+		bool hasNormals = !mesh.normals.empty();
+		bool hasTangents = !mesh.tangents.empty();
+
+		for (size_t vertex = begin; vertex < end; ++vertex) {
+			unsigned short const* joints = mesh.joints.data() + vertex * 4;
+			float const* weights = mesh.weights.data() + vertex * 4;
+			float const* position = mesh.positions.data() + vertex * 3;
+			SkinnedVertex& output = destination[vertex];
+
+			// Blend in the hemisphere of the first joint so antipodal rotations do not cancel
+			float signedWeights[4];
+			float const* pivot = dualQuaternions[joints[0]].real;
+			for (size_t influence = 0; influence < 4; ++influence) {
+				float const* real = dualQuaternions[joints[influence]].real;
+				float dot = pivot[0] * real[0] + pivot[1] * real[1] + pivot[2] * real[2] + pivot[3] * real[3];
+				signedWeights[influence] = dot < 0.0f ? -weights[influence] : weights[influence];
+			}
+
+			float real[4] = {};
+			float dual[4] = {};
+			float scale[3] = {};
+			for (size_t influence = 0; influence < 4; ++influence) {
+				DualQuaternion const& joint = dualQuaternions[joints[influence]];
+				for (size_t index = 0; index < 4; ++index) {
+					real[index] += signedWeights[influence] * joint.real[index];
+					dual[index] += signedWeights[influence] * joint.dual[index];
+				}
+				for (size_t index = 0; index < 3; ++index) {
+					scale[index] += weights[influence] * joint.scale[index];
+				}
+			}
+
+			float length = std::sqrt(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+			float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+			for (size_t index = 0; index < 4; ++index) {
+				real[index] *= inverseLength;
+				dual[index] *= inverseLength;
+			}
+
+			auto cross = [](float const* a, float const* b, float* result) {
+				result[0] = a[1] * b[2] - a[2] * b[1];
+				result[1] = a[2] * b[0] - a[0] * b[2];
+				result[2] = a[0] * b[1] - a[1] * b[0];
+			};
+			auto rotate = [&](float const* vector, float* result) {
+				float inner[3];
+				cross(real, vector, inner);
+				for (size_t index = 0; index < 3; ++index) {
+					inner[index] += real[3] * vector[index];
+				}
+				float outer[3];
+				cross(real, inner, outer);
+				for (size_t index = 0; index < 3; ++index) {
+					result[index] = vector[index] + 2.0f * outer[index];
+				}
+			};
+			auto normalize = [](float* vector) {
+				float vectorLength = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+				float inverse = vectorLength > 0.0f ? 1.0f / vectorLength : 0.0f;
+				for (size_t index = 0; index < 3; ++index) {
+					vector[index] *= inverse;
+				}
+			};
+
+			float translation[3];
+			cross(real, dual, translation);
+			for (size_t index = 0; index < 3; ++index) {
+				translation[index] = 2.0f * (real[3] * dual[index] - dual[3] * real[index] + translation[index]);
+			}
+
+			float point[3] = { position[0] * scale[0], position[1] * scale[1], position[2] * scale[2] };
+			rotate(point, output.position);
+			for (size_t index = 0; index < 3; ++index) {
+				output.position[index] += translation[index];
+			}
+
+			std::fill(output.normal, output.normal + 3, 0.0f);
+			std::fill(output.tangent, output.tangent + 4, 0.0f);
+			if (hasNormals) {
+				float const* normal = mesh.normals.data() + vertex * 3;
+				float direction[3] = { normal[0] / scale[0], normal[1] / scale[1], normal[2] / scale[2] };
+				rotate(direction, output.normal);
+				normalize(output.normal);
+			}
+			if (hasTangents) {
+				float const* tangent = mesh.tangents.data() + vertex * 4;
+				float direction[3] = { tangent[0] * scale[0], tangent[1] * scale[1], tangent[2] * scale[2] };
+				rotate(direction, output.tangent);
+				normalize(output.tangent);
+				output.tangent[3] = tangent[3];
+			}
+		}
+	}
+
+#ifdef SIMD_SSE
+	/// <summary>
+	/// Skin_Dual_Quaternion_Scalar 4-wide, the real and dual parts are blended together 8-wide when 'avx2' is set.
+	/// </summary>
+	inline void Skin_Dual_Quaternion_Simd(SkinnedMesh const& mesh, DualQuaternion const* dualQuaternions, size_t begin, size_t end, SkinnedVertex* destination, bool avx2) {
+		bool hasNormals = !mesh.normals.empty();
+		bool hasTangents = !mesh.tangents.empty();
+
+		for (size_t vertex = begin; vertex < end; ++vertex) {
+			unsigned short const* joints = mesh.joints.data() + vertex * 4;
+			float const* weights = mesh.weights.data() + vertex * 4;
+			float const* position = mesh.positions.data() + vertex * 3;
+			SkinnedVertex& output = destination[vertex];
+
+			// Blend in the hemisphere of the first joint so antipodal rotations do not cancel
+			float signedWeights[4];
+			float const* pivot = dualQuaternions[joints[0]].real;
+			for (size_t influence = 0; influence < 4; ++influence) {
+				float const* real = dualQuaternions[joints[influence]].real;
+				float dot = pivot[0] * real[0] + pivot[1] * real[1] + pivot[2] * real[2] + pivot[3] * real[3];
+				signedWeights[influence] = dot < 0.0f ? -weights[influence] : weights[influence];
+			}
+
+			__m128 real;
+			__m128 dual;
+			__m128 scale = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(dualQuaternions[joints[0]].scale));
+#if defined(SIMD_AVX2)
+			if (avx2) {
+				__m256 blended = _mm256_mul_ps(_mm256_set1_ps(signedWeights[0]), _mm256_loadu_ps(dualQuaternions[joints[0]].real));
+				for (size_t influence = 1; influence < 4; ++influence) {
+					blended = _mm256_add_ps(blended, _mm256_mul_ps(_mm256_set1_ps(signedWeights[influence]), _mm256_loadu_ps(dualQuaternions[joints[influence]].real)));
+					scale = _mm_add_ps(scale, _mm_mul_ps(_mm_set1_ps(weights[influence]), _mm_loadu_ps(dualQuaternions[joints[influence]].scale)));
+				}
+				real = _mm256_castps256_ps128(blended);
+				dual = _mm256_extractf128_ps(blended, 1);
+			}
+			else
+#endif
+			{
+				real = _mm_mul_ps(_mm_set1_ps(signedWeights[0]), _mm_loadu_ps(dualQuaternions[joints[0]].real));
+				dual = _mm_mul_ps(_mm_set1_ps(signedWeights[0]), _mm_loadu_ps(dualQuaternions[joints[0]].dual));
+				for (size_t influence = 1; influence < 4; ++influence) {
+					__m128 weight = _mm_set1_ps(signedWeights[influence]);
+					real = _mm_add_ps(real, _mm_mul_ps(weight, _mm_loadu_ps(dualQuaternions[joints[influence]].real)));
+					dual = _mm_add_ps(dual, _mm_mul_ps(weight, _mm_loadu_ps(dualQuaternions[joints[influence]].dual)));
+					scale = _mm_add_ps(scale, _mm_mul_ps(_mm_set1_ps(weights[influence]), _mm_loadu_ps(dualQuaternions[joints[influence]].scale)));
+				}
+			}
+			// Normalize by the length of the real part
+			__m128 squares = _mm_mul_ps(real, real);
+			__m128 sum = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+			sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(sum, _mm_set1_ps(1e-20f))));
+			real = _mm_mul_ps(real, inverseLength);
+			dual = _mm_mul_ps(dual, inverseLength);
+
+			__m128 realW = _mm_shuffle_ps(real, real, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 dualW = _mm_shuffle_ps(dual, dual, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 two = _mm_set1_ps(2.0f);
+			// translation = 2 * (real.w * dual.xyz - dual.w * real.xyz + real.xyz x dual.xyz)
+			__m128 translation = _mm_mul_ps(two, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(realW, dual), _mm_mul_ps(dualW, real)), Cross(real, dual)));
+			// v + 2 * real.xyz x (real.xyz x v + real.w * v)
+			auto rotate = [&](__m128 vector) {
+				return _mm_add_ps(vector, _mm_mul_ps(two, Cross(real, _mm_add_ps(Cross(real, vector), _mm_mul_ps(realW, vector)))));
+			};
+
+			__m128 point = _mm_mul_ps(_mm_setr_ps(position[0], position[1], position[2], 0.0f), scale);
+			_mm_storeu_ps(output.position, _mm_add_ps(rotate(point), translation));
+			if (hasNormals) {
+				float const* normal = mesh.normals.data() + vertex * 3;
+				__m128 direction = _mm_div_ps(_mm_setr_ps(normal[0], normal[1], normal[2], 0.0f), scale);
+				_mm_storeu_ps(output.normal, Normalize_3(rotate(direction)));
+			}
+			else {
+				_mm_storeu_ps(output.normal, _mm_setzero_ps());
+			}
+			if (hasTangents) {
+				float const* tangent = mesh.tangents.data() + vertex * 4;
+				__m128 direction = _mm_mul_ps(_mm_setr_ps(tangent[0], tangent[1], tangent[2], 0.0f), scale);
+				_mm_storeu_ps(output.tangent, Normalize_3(rotate(direction)));
+				output.tangent[3] = tangent[3];
+			}
+			else {
+				_mm_storeu_ps(output.tangent, _mm_setzero_ps());
+			}
+		}
+	}
+#endif
+
+	/// <summary>
+	/// Dual quaternion skinning of vertices [begin, end), see Skin_Dual_Quaternion_Scalar.
+	/// </summary>
+	inline void Skin_Dual_Quaternion(SkinnedMesh const& mesh, DualQuaternion const* dualQuaternions, size_t begin, size_t end, SkinnedVertex* destination) {
+#ifdef SIMD_SSE
+		Skin_Dual_Quaternion_Simd(mesh, dualQuaternions, begin, end, destination, Simd::Has_Avx2());
+#else
+		Skin_Dual_Quaternion_Scalar(mesh, dualQuaternions, begin, end, destination);
+#endif
+	}
+
+	/// <summary>
+	/// One mesh to skin, 'palette' is used by LinearBlend and 'dualQuaternions' by DualQuaternion.
+	/// </summary>
+	struct SkinJob {
+		SkinnedMesh const* mesh = nullptr;
+		Method method = Method::LinearBlend;
+		glm::mat4 const* palette = nullptr;
+		DualQuaternion const* dualQuaternions = nullptr;
+		size_t paletteSize = 0;
+		// mesh->vertexCount vertices
+		SkinnedVertex* destination = nullptr;
+	};
+
+	/// <summary>
+	/// Skins every job on the pool, large meshes are split into ranges of 'grain' vertices.
+	/// </summary>
+	inline void Skin_Meshes(std::vector<SkinJob> const& jobs, ThreadPool& pool = Default_Thread_Pool(), size_t grain = 4096) {
+		struct Range {
+			SkinJob const* job;
+			size_t begin;
+			size_t end;
+		};
+
+		std::vector<Range> ranges;
+		for (SkinJob const& job : jobs) {
+			if (job.mesh->vertexCount > 0 && size_t(job.mesh->maxJoint) >= job.paletteSize) {
+				throw std::out_of_range(FILE_FUNCTION_LINE + ": mesh references joint " + std::to_string(job.mesh->maxJoint) + " of a " + std::to_string(job.paletteSize) + " joint palette.");
+			}
+			for (size_t begin = 0; begin < job.mesh->vertexCount; begin += grain) {
+				ranges.push_back({ &job, begin, std::min(begin + grain, job.mesh->vertexCount) });
+			}
+		}
+
+		pool.Parallel_For(ranges.size(), 1, [&](size_t first, size_t last) {
+			for (size_t index = first; index < last; ++index) {
+				Range const& range = ranges[index];
+				if (range.job->method == Method::DualQuaternion) {
+					Skin_Dual_Quaternion(*range.job->mesh, range.job->dualQuaternions, range.begin, range.end, range.job->destination);
+				}
+				else {
+					Skin_Linear_Blend(*range.job->mesh, range.job->palette, range.begin, range.end, range.job->destination);
+				}
+			}
+		});
+	}
+
+	/// <summary>
+	/// Persistently mapped vertex buffer split into regions, the CPU writes one region while the GPU draws from the others.
+	/// </summary>
+	class SkinnedVertexBuffer : public Buffer {
+	public:
+		constexpr static unsigned REGIONS = 3;
+
+	private:
+		size_t _vertexCapacity;
+		SkinnedVertex* _mapped;
+		GLsync _fences[REGIONS] = {};
+		unsigned _region = 0;
+
+	public:
+		SkinnedVertexBuffer(size_t vertexCapacity) : Buffer(GLsizeiptr(sizeof(SkinnedVertex) * vertexCapacity * REGIONS), PersistentBufferT()), _vertexCapacity(vertexCapacity),
+			_mapped(static_cast<SkinnedVertex*>(glMapNamedBufferRange(_bufferId, 0, _bufferSize, PERSISTENT_BUFFER_FLAGS))) {
+
+		}
+
+		virtual ~SkinnedVertexBuffer() {
+			for (GLsync fence : _fences) {
+				if (fence) {
+					glDeleteSync(fence);
+				}
+			}
+			glUnmapNamedBuffer(_bufferId);
+		}
+
+		size_t VertexCapacity() const {
+			return _vertexCapacity;
+		}
+
+		/// <summary>
+		/// Moves to the next region and waits until the GPU has finished reading it.
+		/// </summary>
+		/// <returns>Room for VertexCapacity() vertices</returns>
+		SkinnedVertex* BeginFrame() {
+			_region = (_region + 1) % REGIONS;
+			GLsync& fence = _fences[_region];
+			if (fence) {
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+
+				}
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+			return _mapped + _vertexCapacity * _region;
+		}
+
+		/// <summary>
+		/// Call after the draws reading the current region have been issued.
+		/// </summary>
+		void EndFrame() {
+			_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		/// <returns>Byte offset of the current region, for glVertexArrayVertexBuffer</returns>
+		GLintptr Offset() const {
+			return GLintptr(sizeof(SkinnedVertex) * _vertexCapacity * _region);
+		}
+	};
+}
@@ -0,0 +1,753 @@
+#pragma once
+#include "AccessorData.hpp"
+#include "AccessorRange.hpp"
+#include "Bounds.hpp"
+#include "DataStream.hpp"
+#include "JsonParse.hpp"
+#include "Ktx2.hpp"
+#include "MeshoptDecoder.hpp"
+#include "SceneGraph.hpp"
+#include "SceneInstancing.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Progressive loading of a glTF document, meshes are published as soon as the bufferViews they read are in memory
+namespace Streaming {
+	// Reads in flight at once, kept low so newly visible meshes do not queue behind far away ones
+	constexpr size_t MAX_IN_FLIGHT = 4;
+	// Images are requested at this fraction of the priority of the meshes that use them, geometry is shown first
+	constexpr float IMAGE_PRIORITY_SCALE = 0.5f;
+	// Priority of instances outside of the view relative to ones inside
+	constexpr float OFFSCREEN_PRIORITY_SCALE = 0.05f;
+	// Instances closer than this count as touching the camera, keeps the size estimate finite
+	constexpr float MINIMUM_DISTANCE = 1e-3f;
+
+	enum class State : unsigned char {
+		Pending,
+		Loading,
+		Ready,
+		Failed,
+		Cancelled
+	};
+
+	struct Statistics {
+		size_t bytesRead = 0;
+		size_t meshesReady = 0;
+		size_t imagesReady = 0;
+		// Time from opening the document until the first mesh was published, negative until then
+		double firstMeshMilliseconds = -1.0;
+	};
+
+	/// <summary>
+	/// A glTF document whose buffers are read in the background one bufferView at a time.
+	/// The JSON is parsed when opened, so the scene, cameras and declared bounds are usable straight away.
+	/// Call Pump once a frame on one thread, it publishes finished meshes and images and starts the next reads in priority order.
+	/// </summary>
+	class DocumentStream {
+		struct Job {
+			std::future<void> done;
+			std::vector<GLTF::index_type> views;
+			GLTF::index_type image = GLTF::index_type(-1);
+		};
+
+		std::filesystem::path _directory;
+		GLTF::GLTFDoc _doc;
+		ThreadPool& _pool;
+		std::vector<std::vector<unsigned char>> _buffers;
+		// Buffers decoded from data uris when opened, nothing is read from disk for them
+		std::vector<unsigned char> _resident;
+		// Written by jobs, the bytes of a view are complete once its state is Ready
+		std::unique_ptr<std::atomic<State>[]> _viewState;
+		std::vector<std::vector<GLTF::index_type>> _meshViews;
+		std::vector<std::vector<GLTF::index_type>> _meshImages;
+		std::vector<std::vector<GLTF::index_type>> _imageMeshes;
+		std::vector<State> _meshState;
+		std::vector<float> _meshPriority;
+		std::vector<State> _imageState;
+		std::vector<std::vector<unsigned char>> _imageData;
+		std::vector<AABB> _placeholderBounds;
+		std::vector<GLTF::index_type> _pendingMeshes;
+		std::vector<GLTF::index_type> _pendingImages;
+		std::vector<GLTF::index_type> _readyMeshes;
+		std::vector<GLTF::index_type> _readyImages;
+		// Views of every animation sampler and skin, read together before any mesh
+		std::vector<GLTF::index_type> _animationViews;
+		State _animationState = State::Pending;
+		bool _animationPublished = false;
+		std::vector<Job> _jobs;
+		std::atomic<bool> _cancelled{ false };
+		std::atomic<size_t> _bytesRead{ 0 };
+		std::chrono::steady_clock::time_point _opened;
+		Statistics _statistics;
+
+		static GLTF::GLTFDoc Open_Document(std::filesystem::path const& path) {
+			std::pair<std::shared_ptr<JsonParse::JsonElement>, JsonParse::JsonReader::Statistics> json = JsonParse::JsonReader::Parse_Json(path);
+			if (!json.first || json.first->type != JsonParse::Type::Object) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": '" + path.string() + "' is not a glTF document.");
+			}
+			std::shared_ptr<JsonParse::JsonObject> object = std::static_pointer_cast<JsonParse::JsonObject>(json.first);
+			std::map<std::string, void(*)(GLTF::Validator&, GLTF::type_json_object const&)> extensionHandlers = {
+				{ GLTF::Constants::EXT_MESHOPT_COMPRESSION, &GLTF::Validate_Meshopt_Compression },
+				{ GLTF::Constants::KHR_TEXTURE_BASISU, &GLTF::Validate_Texture_Basisu },
+				{ GLTF::Constants::EXT_MESH_GPU_INSTANCING, &GLTF::Validate_Mesh_Gpu_Instancing }
+			};
+			GLTF::Validator validate(object, extensionHandlers);
+			if (!validate.errors.empty()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": '" + path.string() + "' failed validation with " + std::to_string(validate.errors.size()) + " errors.");
+			}
+			return GLTF::GLTFDoc(object);
+		}
+
+		std::filesystem::path Resolve_Uri(std::string const& uri) const {
+			std::filesystem::path path(uri);
+			return path.is_relative() ? _directory / path : path;
+		}
+
+		/// <summary>
+		/// Bounds from the declared min/max of POSITION, empty when a primitive does not declare them.
+		/// </summary>
+		AABB Declared_Mesh_Bounds(GLTF::Mesh const& mesh) const {
+			AABB bounds;
+			for (GLTF::Mesh::Primitive const& primitive : mesh.primitives) {
+				auto position = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_POSITION);
+				if (position == primitive.attributes.cend() || position->second >= _doc.accessors.size()) {
+					continue;
+				}
+				GLTF::Accessor const& accessor = _doc.accessors[position->second];
+				if (accessor.min.size() != 3 || accessor.max.size() != 3) {
+					return AABB();
+				}
+				GLTF::AccessorRange range;
+				range.minimum = accessor.min;
+				range.maximum = accessor.max;
+				range = GLTF::Normalized_Range(accessor, std::move(range));
+				bounds.Grow(AABB(glm::vec3(float(range.minimum[0]), float(range.minimum[1]), float(range.minimum[2])),
+					glm::vec3(float(range.maximum[0]), float(range.maximum[1]), float(range.maximum[2]))));
+			}
+			return bounds;
+		}
+
+		/// <summary>
+		/// Ready once every view is, otherwise the first failure or cancellation, otherwise Loading.
+		/// </summary>
+		State Views_State(std::vector<GLTF::index_type> const& views) const {
+			State result = State::Ready;
+			for (GLTF::index_type view : views) {
+				State state = _viewState[view].load(std::memory_order_acquire);
+				if (state == State::Failed || state == State::Cancelled) {
+					return state;
+				}
+				if (state != State::Ready) {
+					result = State::Loading;
+				}
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// Runs on the pool, reads or decodes each view into its buffer.
+		/// </summary>
+		void Read_Views(std::vector<GLTF::index_type> const& views) {
+			std::map<GLTF::index_type, std::ifstream> files;
+			auto readRange = [&](GLTF::index_type bufferIndex, size_t offset, size_t length, unsigned char* destination) {
+				std::ifstream& file = files[bufferIndex];
+				if (!file.is_open()) {
+					std::filesystem::path path = Resolve_Uri(_doc.buffers[bufferIndex].uri);
+					file.open(path, std::ifstream::binary);
+					if (!file.is_open()) {
+						throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to open file '" + path.string() + "'.");
+					}
+				}
+				file.seekg(std::streamoff(offset));
+				file.read(reinterpret_cast<char*>(destination), std::streamsize(length));
+				if (!file) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": buffer '" + _doc.buffers[bufferIndex].uri + "' is shorter than its byteLength.");
+				}
+				_bytesRead += length;
+			};
+
+			for (GLTF::index_type viewIndex : views) {
+				if (_cancelled) {
+					_viewState[viewIndex].store(State::Cancelled, std::memory_order_release);
+					continue;
+				}
+				GLTF::BufferView const& view = _doc.bufferViews[viewIndex];
+				std::vector<unsigned char>& buffer = _buffers[view.buffer];
+				if (size_t(view.byteOffset) + size_t(view.byteLength) > buffer.size()) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": bufferView '" + view.name + "' is outside of its buffer.");
+				}
+				unsigned char* destination = buffer.data() + size_t(view.byteOffset);
+
+				GLTF::type_json_object extension = GLTF::Get_Extension(view, GLTF::Constants::EXT_MESHOPT_COMPRESSION);
+				if (extension) {
+					// Only the compressed range is read, the stream is then decoded from the start of it
+					GLTF::MeshoptCompression compression(extension);
+					std::vector<unsigned char> stream;
+					unsigned char const* source = nullptr;
+					if (_resident[compression.buffer]) {
+						source = _buffers[compression.buffer].data() + size_t(compression.byteOffset);
+						if (size_t(compression.byteOffset) + size_t(compression.byteLength) > _buffers[compression.buffer].size()) {
+							throw std::runtime_error(FILE_FUNCTION_LINE + ": compressed bufferView '" + view.name + "' is outside of its buffer.");
+						}
+					}
+					else {
+						stream.resize(size_t(compression.byteLength));
+						readRange(compression.buffer, size_t(compression.byteOffset), stream.size(), stream.data());
+						source = stream.data();
+					}
+					compression.byteOffset = 0;
+					if (!compression.Decode(source, size_t(compression.byteLength), destination, size_t(view.byteLength))) {
+						throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to decode " + GLTF::Constants::EXT_MESHOPT_COMPRESSION + " bufferView '" + view.name + "'.");
+					}
+				}
+				else {
+					readRange(view.buffer, size_t(view.byteOffset), size_t(view.byteLength), destination);
+				}
+				_viewState[viewIndex].store(State::Ready, std::memory_order_release);
+			}
+		}
+
+		/// <summary>
+		/// Runs on the pool, reads an image file without decoding it.
+		/// </summary>
+		void Read_Image(GLTF::index_type imageIndex) {
+			std::filesystem::path path = Resolve_Uri(_doc.images[imageIndex].uri);
+			std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+			if (!file.is_open()) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to open file '" + path.string() + "'.");
+			}
+			std::vector<unsigned char>& data = _imageData[imageIndex];
+			data.resize(size_t(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+			if (!file) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to read file '" + path.string() + "'.");
+			}
+			_bytesRead += data.size();
+		}
+
+		/// <summary>
+		/// Marks the views that nobody is reading yet as Loading and starts a job for them.
+		/// </summary>
+		void Request_Views(std::vector<GLTF::index_type> const& views) {
+			Job job;
+			for (GLTF::index_type view : views) {
+				State expected = State::Pending;
+				if (_viewState[view].compare_exchange_strong(expected, State::Loading)) {
+					job.views.emplace_back(view);
+				}
+			}
+			if (job.views.empty()) {
+				return;
+			}
+			job.done = _pool.Submit([this, requested = job.views]() {
+				Read_Views(requested);
+			});
+			_jobs.emplace_back(std::move(job));
+		}
+
+		void Request_Image(GLTF::index_type image) {
+			_imageState[image] = State::Loading;
+			GLTF::Image const& source = _doc.images[image];
+			if (source.bufferView != GLTF::index_type(-1)) {
+				// Copied out of the buffer once the view is in memory
+				Request_Views({ source.bufferView });
+				return;
+			}
+			Job job;
+			job.image = image;
+			job.done = _pool.Submit([this, image]() {
+				Read_Image(image);
+			});
+			_jobs.emplace_back(std::move(job));
+		}
+
+		float Image_Priority(GLTF::index_type image) const {
+			float priority = -1.0f;
+			for (GLTF::index_type mesh : _imageMeshes[image]) {
+				if (_meshState[mesh] != State::Cancelled) {
+					priority = std::max(priority, _meshPriority[mesh] * IMAGE_PRIORITY_SCALE);
+				}
+			}
+			return priority;
+		}
+
+	public:
+		// Failures of background reads, the meshes and images that needed them are marked Failed
+		std::vector<std::string> errors;
+
+		/// <summary>
+		/// Parses and validates the document, buffers and images embedded as data uris are decoded here.
+		/// Nothing is read from disk until Pump.
+		/// </summary>
+		DocumentStream(std::filesystem::path const& path, ThreadPool& pool = Default_Thread_Pool()) :
+			_directory(path.parent_path()), _doc(Open_Document(path)), _pool(pool), _opened(std::chrono::steady_clock::now()) {
+			_buffers.resize(_doc.buffers.size());
+			_resident.assign(_doc.buffers.size(), 0);
+			for (size_t index = 0; index < _doc.buffers.size(); ++index) {
+				GLTF::Buffer const& buffer = _doc.buffers[index];
+				if (buffer.uri.find(GLTF::Constants::STREAM_DATA) == 0) {
+					_buffers[index] = DataStreamBase64(buffer.uri).binaryData;
+					if (_buffers[index].size() < size_t(buffer.byteLength)) {
+						throw std::runtime_error(FILE_FUNCTION_LINE + ": buffer data not of expected byteLength:" + std::to_string(buffer.byteLength) + ".");
+					}
+					_resident[index] = 1;
+				}
+				else if (buffer.uri.empty() && !GLTF::MeshoptCompression::Is_Fallback_Buffer(buffer)) {
+					throw std::runtime_error(FILE_FUNCTION_LINE + ": buffer " + std::to_string(index) + " has no uri, binary glTF is not supported.");
+				}
+				else {
+					_buffers[index].assign(size_t(buffer.byteLength), 0);
+				}
+			}
+
+			_viewState.reset(new std::atomic<State>[_doc.bufferViews.size()]);
+			for (size_t index = 0; index < _doc.bufferViews.size(); ++index) {
+				GLTF::BufferView const& view = _doc.bufferViews[index];
+				bool compressed = bool(GLTF::Get_Extension(view, GLTF::Constants::EXT_MESHOPT_COMPRESSION));
+				// Views of embedded buffers are already in memory, uncompressed views of fallback buffers have nothing to read
+				bool ready = !compressed && (_resident[view.buffer] || GLTF::MeshoptCompression::Is_Fallback_Buffer(_doc.buffers[view.buffer]));
+				_viewState[index].store(ready ? State::Ready : State::Pending);
+			}
+
+			_imageState.assign(_doc.images.size(), State::Pending);
+			_imageData.resize(_doc.images.size());
+			_imageMeshes.resize(_doc.images.size());
+			for (size_t index = 0; index < _doc.images.size(); ++index) {
+				GLTF::Image const& image = _doc.images[index];
+				if (image.uri.find(GLTF::Constants::STREAM_DATA) == 0) {
+					_imageData[index] = DataStreamBase64(image.uri).binaryData;
+					_imageState[index] = State::Ready;
+					_readyImages.emplace_back(GLTF::index_type(index));
+				}
+				else {
+					_pendingImages.emplace_back(GLTF::index_type(index));
+				}
+			}
+
+			auto addAccessor = [&](std::vector<GLTF::index_type>& views, GLTF::index_type accessorIndex) {
+				if (accessorIndex >= _doc.accessors.size()) {
+					return;
+				}
+				GLTF::Accessor const& accessor = _doc.accessors[accessorIndex];
+				if (accessor.bufferView != GLTF::index_type(-1)) {
+					views.emplace_back(accessor.bufferView);
+				}
+				if (accessor.sparse.definedInFile) {
+					views.emplace_back(accessor.sparse.indices.bufferView);
+					views.emplace_back(accessor.sparse.values.bufferView);
+				}
+			};
+			auto addTexture = [&](std::vector<GLTF::index_type>& images, GLTF::index_type textureIndex) {
+				if (textureIndex < _doc.textures.size() && GLTF::Texture_Source(_doc.textures[textureIndex]) < _doc.images.size()) {
+					images.emplace_back(GLTF::Texture_Source(_doc.textures[textureIndex]));
+				}
+			};
+
+			_meshViews.resize(_doc.meshes.size());
+			_meshImages.resize(_doc.meshes.size());
+			_meshState.assign(_doc.meshes.size(), State::Pending);
+			_meshPriority.assign(_doc.meshes.size(), 0.0f);
+			// GPU instances of a node are read with its mesh, so a published mesh can be placed straight away
+			for (GLTF::Node const& node : _doc.nodes) {
+				if (node.mesh < _doc.meshes.size()) {
+					for (GLTF::index_type accessor : GLTF::Node_Instance_Accessors(node)) {
+						addAccessor(_meshViews[node.mesh], accessor);
+					}
+				}
+			}
+			for (size_t index = 0; index < _doc.meshes.size(); ++index) {
+				std::vector<GLTF::index_type>& views = _meshViews[index];
+				std::vector<GLTF::index_type>& images = _meshImages[index];
+				for (GLTF::Mesh::Primitive const& primitive : _doc.meshes[index].primitives) {
+					for (auto const& attribute : primitive.attributes) {
+						addAccessor(views, attribute.second);
+					}
+					addAccessor(views, primitive.indices);
+					for (auto const& target : primitive.targets) {
+						for (GLTF::index_type accessor : target.second) {
+							addAccessor(views, accessor);
+						}
+					}
+					if (primitive.material < _doc.materials.size()) {
+						GLTF::Material const& material = _doc.materials[primitive.material];
+						addTexture(images, material.pbrMetallicRoughness.baseColorTexture.index);
+						addTexture(images, material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+						addTexture(images, material.normalTexture.index);
+						addTexture(images, material.occlusionTexture.index);
+						addTexture(images, material.emissiveTexture.index);
+					}
+				}
+				std::sort(views.begin(), views.end());
+				views.erase(std::unique(views.begin(), views.end()), views.end());
+				std::sort(images.begin(), images.end());
+				images.erase(std::unique(images.begin(), images.end()), images.end());
+				for (GLTF::index_type image : images) {
+					_imageMeshes[image].emplace_back(GLTF::index_type(index));
+				}
+				_placeholderBounds.emplace_back(Declared_Mesh_Bounds(_doc.meshes[index]));
+				_pendingMeshes.emplace_back(GLTF::index_type(index));
+			}
+
+			for (GLTF::Animation const& animation : _doc.animations) {
+				for (GLTF::Animation::Sampler const& sampler : animation.samplers) {
+					addAccessor(_animationViews, sampler.input);
+					addAccessor(_animationViews, sampler.output);
+				}
+			}
+			for (GLTF::Skin const& skin : _doc.skins) {
+				addAccessor(_animationViews, skin.inverseBindMatrices);
+			}
+			std::sort(_animationViews.begin(), _animationViews.end());
+			_animationViews.erase(std::unique(_animationViews.begin(), _animationViews.end()), _animationViews.end());
+			if (Views_State(_animationViews) == State::Ready) {
+				_animationState = State::Ready;
+			}
+		}
+
+		DocumentStream(DocumentStream const&) = delete;
+		DocumentStream& operator=(DocumentStream const&) = delete;
+
+		/// <summary>
+		/// Cancels and waits for the reads in flight, they write into this object.
+		/// </summary>
+		~DocumentStream() {
+			_cancelled = true;
+			for (Job& job : _jobs) {
+				job.done.wait();
+			}
+		}
+
+		GLTF::GLTFDoc const& Document() const {
+			return _doc;
+		}
+
+		/// <summary>
+		/// Spans over every buffer, only the bytes of views that are Ready hold data.
+		/// </summary>
+		std::vector<GLTF::BufferSpan> Spans() const {
+			std::vector<GLTF::BufferSpan> spans;
+			for (std::vector<unsigned char> const& buffer : _buffers) {
+				spans.emplace_back(buffer);
+			}
+			return spans;
+		}
+
+		/// <summary>
+		/// Object space bounds of each mesh from the declared POSITION min/max, drawn in place of a mesh until it is Ready.
+		/// Empty for meshes that do not declare them.
+		/// </summary>
+		std::vector<AABB> const& Placeholder_Bounds() const {
+			return _placeholderBounds;
+		}
+
+		State Mesh_State(GLTF::index_type mesh) const {
+			return _meshState.at(mesh);
+		}
+
+		State Image_State(GLTF::index_type image) const {
+			return _imageState.at(image);
+		}
+
+		/// <summary>
+		/// State of the animation keyframes and skin inverse bind matrices, Ready straight away when they are embedded or there are none.
+		/// </summary>
+		State Animation_State() const {
+			return _animationState;
+		}
+
+		/// <summary>
+		/// Encoded bytes of an image, the file or bufferView contents as is, empty until the image is Ready.
+		/// </summary>
+		std::vector<unsigned char> const& Image_Data(GLTF::index_type image) const {
+			return _imageData.at(image);
+		}
+
+		/// <summary>
+		/// Sets the order meshes are read in, the highest first. Meshes with a negative priority are not read until it is raised.
+		/// </summary>
+		/// <param name="priority">One value per mesh, see Mesh_Priorities</param>
+		void Prioritize(std::vector<float> const& priority) {
+			if (priority.size() != _meshPriority.size()) {
+				throw std::out_of_range(FILE_FUNCTION_LINE + ": expected " + std::to_string(_meshPriority.size()) + " priorities, got " + std::to_string(priority.size()) + ".");
+			}
+			_meshPriority = priority;
+		}
+
+		/// <summary>
+		/// Collects finished reads, publishes meshes and images whose data is complete and starts reads up to MAX_IN_FLIGHT.
+		/// </summary>
+		void Pump() {
+			for (size_t index = 0; index < _jobs.size();) {
+				Job& job = _jobs[index];
+				if (job.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+					++index;
+					continue;
+				}
+				try {
+					job.done.get();
+					if (job.image != GLTF::index_type(-1)) {
+						_imageState[job.image] = State::Ready;
+						_readyImages.emplace_back(job.image);
+					}
+				}
+				catch (std::exception const& exception) {
+					errors.emplace_back(exception.what());
+					for (GLTF::index_type view : job.views) {
+						if (_viewState[view].load() != State::Ready) {
+							_viewState[view].store(State::Failed);
+						}
+					}
+					if (job.image != GLTF::index_type(-1)) {
+						_imageState[job.image] = State::Failed;
+					}
+				}
+				_jobs[index] = std::move(_jobs.back());
+				_jobs.pop_back();
+			}
+
+			// Publish meshes whose views are all in memory
+			for (size_t index = 0; index < _pendingMeshes.size();) {
+				GLTF::index_type mesh = _pendingMeshes[index];
+				State state = _meshState[mesh] == State::Cancelled ? State::Cancelled : Views_State(_meshViews[mesh]);
+				if (state == State::Loading) {
+					++index;
+					continue;
+				}
+				_meshState[mesh] = state;
+				if (state == State::Ready) {
+					_readyMeshes.emplace_back(mesh);
+					if (_statistics.meshesReady++ == 0) {
+						_statistics.firstMeshMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _opened).count();
+					}
+				}
+				_pendingMeshes[index] = _pendingMeshes.back();
+				_pendingMeshes.pop_back();
+			}
+
+			if (_animationState == State::Loading) {
+				_animationState = Views_State(_animationViews);
+			}
+
+			// Images stored in bufferViews are copied out once the view is in memory
+			for (size_t index = 0; index < _pendingImages.size();) {
+				GLTF::index_type image = _pendingImages[index];
+				GLTF::Image const& source = _doc.images[image];
+				if (_imageState[image] == State::Loading && source.bufferView != GLTF::index_type(-1)) {
+					State state = Views_State({ source.bufferView });
+					if (state == State::Ready) {
+						GLTF::BufferView const& view = _doc.bufferViews[source.bufferView];
+						std::vector<unsigned char> const& buffer = _buffers[view.buffer];
+						_imageData[image].assign(buffer.begin() + size_t(view.byteOffset), buffer.begin() + size_t(view.byteOffset + view.byteLength));
+						_imageState[image] = State::Ready;
+						_readyImages.emplace_back(image);
+					}
+					else if (state != State::Loading) {
+						_imageState[image] = state;
+					}
+				}
+				if (_imageState[image] == State::Ready || _imageState[image] == State::Failed || _imageState[image] == State::Cancelled) {
+					_pendingImages[index] = _pendingImages.back();
+					_pendingImages.pop_back();
+					continue;
+				}
+				++index;
+			}
+			_statistics.imagesReady = _doc.images.size() - _pendingImages.size();
+
+			// Keyframes and skins are small and every animated node needs them, they go first
+			if (_animationState == State::Pending && !_cancelled) {
+				_animationState = State::Loading;
+				Request_Views(_animationViews);
+			}
+
+			while (_jobs.size() < MAX_IN_FLIGHT && !_cancelled) {
+				GLTF::index_type bestMesh = GLTF::index_type(-1);
+				float meshPriority = -1.0f;
+				for (GLTF::index_type mesh : _pendingMeshes) {
+					if (_meshState[mesh] == State::Pending && _meshPriority[mesh] >= 0.0f && (bestMesh == GLTF::index_type(-1) || _meshPriority[mesh] > meshPriority)) {
+						bestMesh = mesh;
+						meshPriority = _meshPriority[mesh];
+					}
+				}
+				GLTF::index_type bestImage = GLTF::index_type(-1);
+				float imagePriority = -1.0f;
+				for (GLTF::index_type image : _pendingImages) {
+					if (_imageState[image] != State::Pending) {
+						continue;
+					}
+					// Images no mesh uses are read last
+					float priority = _imageMeshes[image].empty() ? 0.0f : Image_Priority(image);
+					if (priority >= 0.0f && (bestImage == GLTF::index_type(-1) || priority > imagePriority)) {
+						bestImage = image;
+						imagePriority = priority;
+					}
+				}
+
+				if (bestMesh == GLTF::index_type(-1) && bestImage == GLTF::index_type(-1)) {
+					break;
+				}
+				if (bestMesh != GLTF::index_type(-1) && (bestImage == GLTF::index_type(-1) || meshPriority >= imagePriority)) {
+					// Views shared with meshes already loading are not read twice, the mesh waits for them
+					_meshState[bestMesh] = State::Loading;
+					Request_Views(_meshViews[bestMesh]);
+				}
+				else {
+					Request_Image(bestImage);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Meshes published since the last call, their accessors and the EXT_mesh_gpu_instancing attributes of nodes drawing them can be read through Spans.
+		/// </summary>
+		std::vector<GLTF::index_type> Take_Ready_Meshes() {
+			std::vector<GLTF::index_type> ready;
+			ready.swap(_readyMeshes);
+			return ready;
+		}
+
+		/// <summary>
+		/// Replaces the declared min/max of the accessors of a Ready mesh with the range of their data, exporters omit them or get them wrong.
+		/// </summary>
+		/// <returns>Status of each accessor of GLTF::Mesh_Accessors as declared in the file</returns>
+		std::vector<GLTF::RangeStatus> Resolve_Mesh_Ranges(GLTF::index_type mesh) {
+			if (_meshState.at(mesh) != State::Ready) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": mesh " + std::to_string(mesh) + " is not Ready.");
+			}
+			return GLTF::Resolve_Accessor_Ranges(_doc, Spans(), GLTF::Mesh_Accessors(_doc.meshes[mesh]), _pool);
+		}
+
+		/// <summary>
+		/// Images published since the last call, see Image_Data.
+		/// </summary>
+		std::vector<GLTF::index_type> Take_Ready_Images() {
+			std::vector<GLTF::index_type> ready;
+			ready.swap(_readyImages);
+			return ready;
+		}
+
+		/// <summary>
+		/// True once, on the first call after the animation accessors and skin inverseBindMatrices can be read through Spans.
+		/// </summary>
+		bool Take_Ready_Animations() {
+			if (_animationState != State::Ready || _animationPublished) {
+				return false;
+			}
+			_animationPublished = true;
+			return true;
+		}
+
+		/// <summary>
+		/// Stops a mesh that has not started loading, views it shares with other meshes are still read for them.
+		/// </summary>
+		/// <returns>False if the mesh is already loading or finished</returns>
+		bool Cancel_Mesh(GLTF::index_type mesh) {
+			if (_meshState.at(mesh) != State::Pending) {
+				return false;
+			}
+			_meshState[mesh] = State::Cancelled;
+			return true;
+		}
+
+		/// <summary>
+		/// Stops every read, reads in flight stop at the next bufferView. Meshes not yet Ready end up Cancelled.
+		/// </summary>
+		void Cancel() {
+			_cancelled = true;
+			if (_animationState == State::Pending) {
+				_animationState = State::Cancelled;
+			}
+			for (GLTF::index_type mesh : _pendingMeshes) {
+				if (_meshState[mesh] == State::Pending) {
+					_meshState[mesh] = State::Cancelled;
+				}
+			}
+			for (GLTF::index_type image : _pendingImages) {
+				if (_imageState[image] == State::Pending) {
+					_imageState[image] = State::Cancelled;
+				}
+			}
+		}
+
+		/// <summary>
+		/// True once the animations and every mesh and image are Ready, Failed or Cancelled and no read is in flight.
+		/// </summary>
+		bool Done() const {
+			return _animationState != State::Pending && _animationState != State::Loading && _pendingMeshes.empty() && _pendingImages.empty() && _jobs.empty();
+		}
+
+		Statistics Stats() const {
+			Statistics statistics = _statistics;
+			statistics.bytesRead = _bytesRead.load();
+			return statistics;
+		}
+	};
+
+	/// <summary>
+	/// Streaming priority of each mesh, the screen space size of its largest instance as a fraction of half the screen height.
+	/// Instances outside of the frustum count for OFFSCREEN_PRIORITY_SCALE of their size, meshes without bounds get the highest priority.
+	/// </summary>
+	/// <param name="meshBounds">Object space bounds indexed by document mesh, such as DocumentStream::Placeholder_Bounds</param>
+	inline std::vector<float> Mesh_Priorities(SceneGraph const& scene, std::vector<AABB> const& meshBounds, glm::mat4 const& view, glm::mat4 const& projection) {
+		std::vector<float> priority(meshBounds.size(), 0.0f);
+		Frustum frustum(projection * view);
+		glm::vec3 camera(glm::inverse(view)[3]);
+		// cot(fovy / 2) for a perspective projection
+		float projectionScale = projection[1][1];
+		for (size_t slot = 0; slot < scene.Size(); ++slot) {
+			GLTF::index_type mesh = scene.mesh[slot];
+			if (mesh >= meshBounds.size()) {
+				continue;
+			}
+			if (meshBounds[mesh].Empty()) {
+				priority[mesh] = std::numeric_limits<float>::max();
+				continue;
+			}
+			AABB world = Transform_AABB(meshBounds[mesh], scene.world[slot]);
+			float radius = glm::length(world.Extent()) * 0.5f;
+			float distance = std::max(glm::length(world.Center() - camera) - radius, MINIMUM_DISTANCE);
+			float size = radius * projectionScale / distance;
+			unsigned mask = FRUSTUM_ALL_PLANES;
+			if (!frustum.Test(world, mask)) {
+				size *= OFFSCREEN_PRIORITY_SCALE;
+			}
+			priority[mesh] = std::max(priority[mesh], size);
+		}
+		return priority;
+	}
+
+	/// <summary>
+	/// Flat colour to sample in place of an image until it is Ready, chosen by how the materials use it.
+	/// Base colour textures take the material's baseColorFactor, normal maps a flat normal, everything else white.
+	/// </summary>
+	inline glm::vec4 Placeholder_Color(GLTF::GLTFDoc const& doc, GLTF::index_type image) {
+		auto uses = [&](GLTF::TextureInfo const& texture) {
+			return texture.index < doc.textures.size() && GLTF::Texture_Source(doc.textures[texture.index]) == image;
+		};
+		for (GLTF::Material const& material : doc.materials) {
+			if (uses(material.pbrMetallicRoughness.baseColorTexture)) {
+				GLTF::number_type const* factor = material.pbrMetallicRoughness.baseColorFactor;
+				return glm::vec4(float(factor[0]), float(factor[1]), float(factor[2]), float(factor[3]));
+			}
+			if (uses(material.normalTexture)) {
+				return glm::vec4(0.5f, 0.5f, 1.0f, 1.0f);
+			}
+		}
+		return glm::vec4(1.0f);
+	}
+}
@@ -5,7 +5,25 @@
 #include <vector>
 #include <string>
 #include <cmath>
-#include <stb_image.h>
+// Includes stb_image.h through Ktx2.hpp, which may only be included once per translation unit
+#include "TextureDecode.hpp"
+#include "TextureAtlas.hpp"
+
+inline GLenum Compressed_Internal_Format(BlockCompression::Format format, bool srgb) {
+	switch (format) {
+	case BlockCompression::Format::BC1:
+		return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BlockCompression::Format::BC3:
+		return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BlockCompression::Format::BC4:
+		return GL_COMPRESSED_RED_RGTC1;
+	case BlockCompression::Format::BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	case BlockCompression::Format::BC7:
+		return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+	throw std::runtime_error("Compressed_Internal_Format: Unknown block format.");
+}
 
 class Texture2D : Object {
 	GLuint textureId;
@@ -17,13 +35,7 @@ public:
 			throw std::invalid_argument("Texture2D: Width and Height must be greater than zero.");
 		}
 		if (mipmapLevels <= 0) {
-			int mipmaps = 0;
-			int temp = std::max(width, height);
-			while (temp != 1) {
-				temp /= 2;
-				++mipmaps;
-			}
-			mipmapLevels = mipmaps;
+			mipmapLevels = Mipmap::Level_Count(width, height);
 		}
 
 		glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
@@ -68,21 +80,160 @@ public:
 		glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		int mipmaps = 0;
-		int temp = std::max(_width, _height);
-		while (temp != 1) {
-			temp /= 2;
-			++mipmaps;
-		}
-
-		glTextureStorage2D(textureId, mipmaps, _internalFormat, _width, _height);
+		glTextureStorage2D(textureId, Mipmap::Level_Count(_width, _height), _internalFormat, _width, _height);
 
 		glTextureSubImage2D(textureId, 0, 0, 0, _width, _height, _dataFormat, GL_UNSIGNED_BYTE, imageData);
-		glGenerateMipmap(textureId);
+		glGenerateTextureMipmap(textureId);
 
 		stbi_image_free(imageData);
 	}
 
+	/// <summary>
+	/// Uploads an image decoded on another thread, only this part has to run on the GL thread.
+	/// Mipmaps built with the image are uploaded as they are, otherwise the GPU generates them.
+	/// </summary>
+	/// <param name="srgb">Colour data, stored as sRGB so sampling returns linear values</param>
+	Texture2D(TextureDecode::DecodedImage const& image, bool srgb = false) : _width(image.width), _height(image.height) {
+		if (!image.Valid()) {
+			throw std::runtime_error("Texture2D(TextureDecode::DecodedImage const&): image failed to decode, " + image.error + ".");
+		}
+
+		switch (image.channels) {
+		case 1:
+			_internalFormat = GL_R8;
+			_dataFormat = GL_RED;
+			break;
+		case 2:
+			_internalFormat = GL_RG8;
+			_dataFormat = GL_RG;
+			break;
+		case 4:
+			_internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			_dataFormat = GL_RGBA;
+			break;
+		default:
+			throw std::runtime_error("Texture2D(TextureDecode::DecodedImage const&): Unexpected number of channels " + std::to_string(image.channels) + ".");
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		GLsizei levels = Mipmap::Level_Count(_width, _height);
+		glTextureStorage2D(textureId, levels, _internalFormat, _width, _height);
+
+		// Rows of one and two channel images and of small levels are not 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(textureId, 0, 0, 0, _width, _height, _dataFormat, GL_UNSIGNED_BYTE, image.pixels.data());
+		if (image.mips.size() + 1 == size_t(levels)) {
+			for (GLsizei level = 1; level < levels; ++level) {
+				glTextureSubImage2D(textureId, level, 0, 0, Mipmap::Level_Size(_width, level), Mipmap::Level_Size(_height, level), _dataFormat, GL_UNSIGNED_BYTE, image.mips[size_t(level) - 1].data());
+			}
+		}
+		else {
+			glGenerateTextureMipmap(textureId);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	/// <summary>
+	/// Uploads block compressed levels as they are, nothing is decoded or generated.
+	/// </summary>
+	/// <param name="srgb">Colour data, only BC1, BC3 and BC7 have sRGB variants</param>
+	Texture2D(BlockCompression::CompressedImage const& image, bool srgb = false) : _width(image.width), _height(image.height),
+		_internalFormat(Compressed_Internal_Format(image.format, srgb)) {
+		if (image.Empty()) {
+			throw std::runtime_error("Texture2D(BlockCompression::CompressedImage const&): image has no levels.");
+		}
+		switch (BlockCompression::Format_Channels(image.format)) {
+		case 1:
+			_dataFormat = GL_RED;
+			break;
+		case 2:
+			_dataFormat = GL_RG;
+			break;
+		default:
+			_dataFormat = GL_RGBA;
+			break;
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		GLsizei levels = GLsizei(image.levels.size());
+		glTextureStorage2D(textureId, levels, _internalFormat, _width, _height);
+		for (GLsizei level = 0; level < levels; ++level) {
+			glCompressedTextureSubImage2D(textureId, level, 0, 0, Mipmap::Level_Size(_width, level), Mipmap::Level_Size(_height, level), _internalFormat,
+				GLsizei(image.levels[size_t(level)].size()), image.levels[size_t(level)].data());
+		}
+	}
+
+	/// <summary>
+	/// Uploads a KTX2 file level by level, levels that are not supercompressed are read straight from the file mapping.
+	/// </summary>
+	Texture2D(Ktx2::File const& file) : _width(file.Width()), _height(file.Height()) {
+		BlockCompression::Format block;
+		bool compressed = Ktx2::Block_Format(file.Format(), block);
+		bool srgb = Ktx2::Is_Srgb(file.Format());
+		if (compressed) {
+			_internalFormat = Compressed_Internal_Format(block, srgb);
+		}
+		switch (compressed ? BlockCompression::Format_Channels(block) : Ktx2::Raw_Channels(file.Format())) {
+		case 1:
+			_internalFormat = compressed ? _internalFormat : GL_R8;
+			_dataFormat = GL_RED;
+			break;
+		case 2:
+			_internalFormat = compressed ? _internalFormat : GL_RG8;
+			_dataFormat = GL_RG;
+			break;
+		default:
+			_internalFormat = compressed ? _internalFormat : (srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8);
+			_dataFormat = GL_RGBA;
+			break;
+		}
+		// Block formats cannot be rendered to, so their mipmaps are never generated
+		bool generate = file.Generate_Mipmaps() && !compressed;
+		GLsizei levels = generate ? Mipmap::Level_Count(_width, _height) : GLsizei(file.Level_Count());
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glTextureStorage2D(textureId, levels, _internalFormat, _width, _height);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (GLsizei level = 0; level < GLsizei(file.Level_Count()); ++level) {
+			std::vector<unsigned char> inflated;
+			std::pair<unsigned char const*, size_t> data = file.Level_View(level);
+			if (file.Scheme() != Ktx2::Supercompression::None) {
+				inflated = file.Level_Data(level);
+				data = { inflated.data(), inflated.size() };
+			}
+			GLsizei width = Mipmap::Level_Size(_width, level);
+			GLsizei height = Mipmap::Level_Size(_height, level);
+			if (compressed) {
+				glCompressedTextureSubImage2D(textureId, level, 0, 0, width, height, _internalFormat, GLsizei(data.second), data.first);
+			}
+			else {
+				glTextureSubImage2D(textureId, level, 0, 0, width, height, _dataFormat, GL_UNSIGNED_BYTE, data.first);
+			}
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (generate) {
+			glGenerateTextureMipmap(textureId);
+		}
+	}
+
 	~Texture2D() {
 		glDeleteTextures(1, &textureId);
 	}
@@ -101,12 +252,81 @@ public:
 		glTextureSubImage2D(textureId, 0, 0, 0, _width, _height, _dataFormat, GL_UNSIGNED_BYTE, bytes.data());
 	}
 
+	GLuint Id() const {
+		return textureId;
+	}
+
 	int Channels() {
 		switch (_dataFormat) {
 		case GL_RGBA:
 			return 4;
 		case GL_RGB:
 			return 3;
+		case GL_RG:
+			return 2;
+		case GL_RED:
+			return 1;
+		}
+	}
+};
+
+/// <summary>
+/// Equally sized layers sampled as one texture, the images packed together by TextureAtlas.
+/// </summary>
+class Texture2DArray : Object {
+	GLuint textureId;
+	GLsizei _width, _height, _layers, _levels;
+	GLenum _internalFormat, _dataFormat;
+public:
+	/// <summary>
+	/// Allocates every layer and level of a group, the layers are filled with Upload.
+	/// </summary>
+	Texture2DArray(TextureAtlas::Group const& group) : _width(group.width), _height(group.height), _layers(group.layers), _levels(group.levels) {
+		if (_width <= 0 || _height <= 0 || _layers <= 0) {
+			throw std::invalid_argument("Texture2DArray: Width, Height and Layers must be greater than zero.");
+		}
+		switch (group.channels) {
+		case 1:
+			_internalFormat = GL_R8;
+			_dataFormat = GL_RED;
+			break;
+		case 2:
+			_internalFormat = GL_RG8;
+			_dataFormat = GL_RG;
+			break;
+		case 4:
+			_internalFormat = group.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			_dataFormat = GL_RGBA;
+			break;
+		default:
+			throw std::runtime_error("Texture2DArray: Unexpected number of channels " + std::to_string(group.channels) + ".");
 		}
+
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureId);
+		// glTF wrap modes are the GL enumerants
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GLint(group.wrap));
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GLint(group.wrap));
+
+		glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, _levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glTextureStorage3D(textureId, _levels, _internalFormat, _width, _height, _layers);
+	}
+
+	~Texture2DArray() {
+		glDeleteTextures(1, &textureId);
+	}
+
+	/// <param name="levels">Level 0 first, as built by TextureAtlas::Compose_Layer</param>
+	void Upload(int layer, std::vector<std::vector<unsigned char>> const& levels) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (GLsizei level = 0; level < _levels && size_t(level) < levels.size(); ++level) {
+			glTextureSubImage3D(textureId, level, 0, 0, layer, Mipmap::Level_Size(_width, level), Mipmap::Level_Size(_height, level), 1, _dataFormat, GL_UNSIGNED_BYTE, levels[size_t(level)].data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	GLuint Id() const {
+		return textureId;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,497 @@
+#pragma once
+#include "GLTF.hpp"
+#include "Mipmap.hpp"
+#include "TextureDecode.hpp"
+#include "ThreadPool.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Packs small images into the layers of a few texture arrays so materials share textures instead of binding one each
+namespace TextureAtlas {
+	constexpr int PAGE_SIZE = 2048;
+	// Larger images are left as their own texture
+	constexpr int MAXIMUM_IMAGE_SIZE = 256;
+	// Levels kept by atlas pages, images are aligned so that none of these mix texels of two images
+	constexpr int PAGE_LEVELS = 5;
+	// GL_MAX_ARRAY_TEXTURE_LAYERS is at least 2048 in OpenGL 4.5
+	constexpr int MAXIMUM_LAYERS = 256;
+
+	struct PackSettings {
+		int pageSize = PAGE_SIZE;
+		int maximumImageSize = MAXIMUM_IMAGE_SIZE;
+		int pageLevels = PAGE_LEVELS;
+		int maximumLayers = MAXIMUM_LAYERS;
+	};
+
+	/// <summary>
+	/// Images start on multiples of this in a page, so level pageLevels - 1 still starts every image on a texel.
+	/// </summary>
+	inline int Page_Alignment(PackSettings const& settings) {
+		return 1 << (std::max(settings.pageLevels, 1) - 1);
+	}
+
+	/// <summary>
+	/// Edge texels repeated around each image in a page, bilinear filtering at the edges reads these instead of a neighbour.
+	/// </summary>
+	inline int Page_Border(PackSettings const& settings) {
+		return std::max(Page_Alignment(settings) / 2, 1);
+	}
+
+	struct Rect {
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+	};
+
+	/// <summary>
+	/// Skyline bin packer, each rectangle is placed where its top edge ends lowest.
+	/// </summary>
+	class SkylinePacker {
+		struct Segment {
+			int x;
+			int y;
+			int width;
+		};
+
+		int _width;
+		int _height;
+		std::vector<Segment> _skyline;
+		size_t _usedArea = 0;
+
+		/// <returns>Bottom of a rectangle placed at segment index, -1 when it does not fit</returns>
+		int Fit(size_t index, int width, int height) const {
+			if (_skyline[index].x + width > _width) {
+				return -1;
+			}
+			int y = 0;
+			int remaining = width;
+			for (size_t segment = index; remaining > 0; ++segment) {
+				y = std::max(y, _skyline[segment].y);
+				if (y + height > _height) {
+					return -1;
+				}
+				remaining -= _skyline[segment].width;
+			}
+			return y;
+		}
+
+	public:
+		SkylinePacker(int width, int height) : _width(width), _height(height), _skyline{ { 0, 0, width } } {
+
+		}
+
+		SkylinePacker(SkylinePacker const&) = default;
+		SkylinePacker(SkylinePacker&&) = default;
+
+		SkylinePacker& operator=(SkylinePacker const&) = default;
+		SkylinePacker& operator=(SkylinePacker&&) = default;
+
+		/// <returns>False when there is no room left for the rectangle</returns>
+		bool Insert(int width, int height, Rect& placed) {
+			if (width <= 0 || height <= 0) {
+				return false;
+			}
+			size_t bestIndex = _skyline.size();
+			int bestY = 0;
+			int bestTop = INT_MAX;
+			int bestWidth = INT_MAX;
+			for (size_t index = 0; index < _skyline.size(); ++index) {
+				int y = Fit(index, width, height);
+				// Ties go to the narrowest segment so wide gaps stay open for wide rectangles
+				if (y >= 0 && (y + height < bestTop || (y + height == bestTop && _skyline[index].width < bestWidth))) {
+					bestIndex = index;
+					bestY = y;
+					bestTop = y + height;
+					bestWidth = _skyline[index].width;
+				}
+			}
+			if (bestIndex == _skyline.size()) {
+				return false;
+			}
+			placed = { _skyline[bestIndex].x, bestY, width, height };
+			_usedArea += size_t(width) * size_t(height);
+
+			_skyline.insert(_skyline.begin() + bestIndex, { placed.x, bestTop, width });
+			// Segments under the new one are cut back or removed
+			for (size_t index = bestIndex + 1; index < _skyline.size();) {
+				Segment const& previous = _skyline[index - 1];
+				int overlap = previous.x + previous.width - _skyline[index].x;
+				if (overlap <= 0) {
+					break;
+				}
+				_skyline[index].x += overlap;
+				_skyline[index].width -= overlap;
+				if (_skyline[index].width > 0) {
+					break;
+				}
+				_skyline.erase(_skyline.begin() + index);
+			}
+			for (size_t index = 0; index + 1 < _skyline.size();) {
+				if (_skyline[index].y == _skyline[index + 1].y) {
+					_skyline[index].width += _skyline[index + 1].width;
+					_skyline.erase(_skyline.begin() + index + 1);
+				}
+				else {
+					++index;
+				}
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// Fraction of the area covered by rectangles.
+		/// </summary>
+		float Occupancy() const {
+			return float(_usedArea) / (float(_width) * float(_height));
+		}
+	};
+
+	/// <summary>
+	/// What the packer needs to know about an image, it never reads pixels.
+	/// </summary>
+	struct ImageInfo {
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		bool srgb = false;
+		// glTF wrap mode shared by every texture sampling the image, -1 when they differ
+		GLTF::integer_type wrap = GLTF::Enumerations::SamplerWrap::REPEAT;
+	};
+
+	/// <summary>
+	/// An image in a layer, rect is the image and area is what it fills with its border.
+	/// </summary>
+	struct Entry {
+		size_t image;
+		int layer;
+		Rect rect;
+		Rect area;
+	};
+
+	/// <summary>
+	/// One texture array, either whole images of the same size per layer or atlas pages of clamped images.
+	/// </summary>
+	struct Group {
+		int channels = 0;
+		bool srgb = false;
+		int width = 0;
+		int height = 0;
+		int levels = 1;
+		int layers = 0;
+		GLTF::integer_type wrap = GLTF::Enumerations::SamplerWrap::REPEAT;
+		bool atlas = false;
+		std::vector<Entry> entries;
+
+		Group() = default;
+		Group(Group const&) = default;
+		Group(Group&&) = default;
+
+		Group& operator=(Group const&) = default;
+		Group& operator=(Group&&) = default;
+	};
+
+	/// <summary>
+	/// Where an image ended up, texture coordinates are rewritten as uv * uvTransform.xy + uvTransform.zw.
+	/// </summary>
+	struct Placement {
+		// Texture array of the image, -1 when it is its own texture
+		int group = -1;
+		int layer = 0;
+		glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+		bool Packed() const {
+			return group >= 0;
+		}
+	};
+
+	struct Plan {
+		std::vector<Group> groups;
+		// Indexed like the images given to Pack
+		std::vector<Placement> placements;
+	};
+
+	/// <summary>
+	/// Wrap mode every texture sampling the image agrees on, -1 when they differ.
+	/// Images that are not sampled by any texture report REPEAT.
+	/// </summary>
+	inline GLTF::integer_type Image_Wrap(GLTF::GLTFDoc const& doc, GLTF::index_type image) {
+		GLTF::integer_type wrap = GLTF::Enumerations::SamplerWrap::REPEAT;
+		bool first = true;
+		for (GLTF::Texture const& texture : doc.textures) {
+			if (GLTF::Texture_Source(texture) != image) {
+				continue;
+			}
+			GLTF::integer_type wrapS = GLTF::Enumerations::SamplerWrap::REPEAT;
+			GLTF::integer_type wrapT = GLTF::Enumerations::SamplerWrap::REPEAT;
+			// Wraps missing from the sampler are read as 0, glTF defaults them to REPEAT
+			if (texture.sampler < doc.samplers.size()) {
+				wrapS = doc.samplers[texture.sampler].wrapS ? doc.samplers[texture.sampler].wrapS : wrapS;
+				wrapT = doc.samplers[texture.sampler].wrapT ? doc.samplers[texture.sampler].wrapT : wrapT;
+			}
+			if (wrapS != wrapT || (!first && wrapS != wrap)) {
+				return -1;
+			}
+			wrap = wrapS;
+			first = false;
+		}
+		return wrap;
+	}
+
+	/// <summary>
+	/// True for decoded images the packer accepts, block compressed and large images are uploaded on their own.
+	/// </summary>
+	inline bool Packable(TextureDecode::DecodedImage const& image, PackSettings const& settings = PackSettings()) {
+		return image.Valid() && image.compressed.Empty() && !image.pixels.empty() && std::max(image.width, image.height) <= settings.maximumImageSize &&
+			(image.channels == 1 || image.channels == 2 || image.channels == 4);
+	}
+
+	inline ImageInfo Image_Info(TextureDecode::DecodedImage const& image, GLTF::integer_type wrap) {
+		ImageInfo info;
+		info.width = image.width;
+		info.height = image.height;
+		info.channels = image.channels;
+		info.srgb = image.srgb;
+		info.wrap = wrap;
+		return info;
+	}
+
+	/// <summary>
+	/// Decides the texture arrays for a set of images.
+	/// Images of the same size and wrap mode become the layers of an array at full resolution, wrapping still works per layer.
+	/// The rest that clamp are packed with borders into atlas pages, which are then the layers of an array.
+	/// Anything else keeps an unpacked Placement.
+	/// </summary>
+	inline Plan Pack(std::vector<ImageInfo> const& images, PackSettings const& settings = PackSettings()) {
+		int alignment = Page_Alignment(settings);
+		int border = Page_Border(settings);
+		if (settings.pageSize % alignment != 0 || settings.maximumImageSize + 2 * border > settings.pageSize || settings.maximumLayers <= 0) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": page size must be a multiple of the alignment and fit the largest image with its border.");
+		}
+		Plan plan;
+		plan.placements.resize(images.size());
+
+		std::map<std::tuple<int, bool, GLTF::integer_type, int, int>, std::vector<size_t>> sameSize;
+		for (size_t image = 0; image < images.size(); ++image) {
+			ImageInfo const& info = images[image];
+			bool channels = info.channels == 1 || info.channels == 2 || info.channels == 4;
+			if (channels && info.wrap >= 0 && info.width > 0 && info.height > 0 && std::max(info.width, info.height) <= settings.maximumImageSize) {
+				sameSize[std::make_tuple(info.channels, info.srgb, info.wrap, info.width, info.height)].push_back(image);
+			}
+		}
+
+		std::map<std::pair<int, bool>, std::vector<size_t>> loose;
+		for (std::pair<std::tuple<int, bool, GLTF::integer_type, int, int> const, std::vector<size_t>> const& bucket : sameSize) {
+			ImageInfo const& first = images[bucket.second.front()];
+			if (bucket.second.size() < 2) {
+				if (first.wrap == GLTF::Enumerations::SamplerWrap::CLAMP_TO_EDGE) {
+					loose[std::make_pair(first.channels, first.srgb)].push_back(bucket.second.front());
+				}
+				continue;
+			}
+			for (size_t begin = 0; begin < bucket.second.size(); begin += size_t(settings.maximumLayers)) {
+				size_t end = std::min(begin + size_t(settings.maximumLayers), bucket.second.size());
+				Group group;
+				group.channels = first.channels;
+				group.srgb = first.srgb;
+				group.width = first.width;
+				group.height = first.height;
+				group.levels = Mipmap::Level_Count(first.width, first.height);
+				group.layers = int(end - begin);
+				group.wrap = first.wrap;
+				for (size_t index = begin; index < end; ++index) {
+					size_t image = bucket.second[index];
+					group.entries.push_back({ image, int(index - begin), { 0, 0, first.width, first.height }, { 0, 0, first.width, first.height } });
+					Placement& placement = plan.placements[image];
+					placement.group = int(plan.groups.size());
+					placement.layer = int(index - begin);
+				}
+				plan.groups.emplace_back(std::move(group));
+			}
+		}
+
+		// Packed in cells of the alignment, so every image starts on a texel down to the last page level
+		int cells = settings.pageSize / alignment;
+		auto cellWidth = [&](int size) {
+			return (size + 2 * border + alignment - 1) / alignment;
+		};
+		for (std::pair<std::pair<int, bool> const, std::vector<size_t>>& bucket : loose) {
+			if (bucket.second.size() < 2) {
+				continue;
+			}
+			// Tallest first keeps the skyline low
+			std::sort(bucket.second.begin(), bucket.second.end(), [&](size_t left, size_t right) {
+				int leftHeight = cellWidth(images[left].height);
+				int rightHeight = cellWidth(images[right].height);
+				return leftHeight != rightHeight ? leftHeight > rightHeight : cellWidth(images[left].width) > cellWidth(images[right].width);
+			});
+			Group group;
+			group.channels = bucket.first.first;
+			group.srgb = bucket.first.second;
+			group.width = settings.pageSize;
+			group.height = settings.pageSize;
+			group.levels = std::min(settings.pageLevels, Mipmap::Level_Count(settings.pageSize, settings.pageSize));
+			group.wrap = GLTF::Enumerations::SamplerWrap::CLAMP_TO_EDGE;
+			group.atlas = true;
+			std::vector<SkylinePacker> pages;
+			for (size_t image : bucket.second) {
+				ImageInfo const& info = images[image];
+				Rect cell;
+				size_t page = 0;
+				while (page < pages.size() && !pages[page].Insert(cellWidth(info.width), cellWidth(info.height), cell)) {
+					++page;
+				}
+				if (page == pages.size()) {
+					if (pages.size() == size_t(settings.maximumLayers)) {
+						continue;
+					}
+					pages.emplace_back(cells, cells);
+					pages.back().Insert(cellWidth(info.width), cellWidth(info.height), cell);
+				}
+				Rect area = { cell.x * alignment, cell.y * alignment, cell.width * alignment, cell.height * alignment };
+				Rect rect = { area.x + border, area.y + border, info.width, info.height };
+				group.entries.push_back({ image, int(page), rect, area });
+				Placement& placement = plan.placements[image];
+				placement.group = int(plan.groups.size());
+				placement.layer = int(page);
+				float size = float(settings.pageSize);
+				placement.uvTransform = glm::vec4(float(rect.width) / size, float(rect.height) / size, float(rect.x) / size, float(rect.y) / size);
+			}
+			group.layers = int(pages.size());
+			plan.groups.emplace_back(std::move(group));
+		}
+		return plan;
+	}
+
+	/// <summary>
+	/// Every level of one layer of a group, level 0 first.
+	/// Array layers use the mips built with the image when it has them, atlas pages are box filtered so no level mixes two images.
+	/// </summary>
+	/// <param name="images">Pixels of the images given to Pack, indexed the same way</param>
+	inline std::vector<std::vector<unsigned char>> Compose_Layer(Group const& group, int layer, std::vector<TextureDecode::DecodedImage const*> const& images, ThreadPool* pool = nullptr) {
+		Mipmap::MipSettings settings;
+		settings.filter = Mipmap::Filter::Box;
+		settings.srgb = group.srgb;
+		size_t pixelBytes = size_t(group.channels);
+		std::vector<std::vector<unsigned char>> levels;
+		if (!group.atlas) {
+			for (Entry const& entry : group.entries) {
+				if (entry.layer != layer) {
+					continue;
+				}
+				TextureDecode::DecodedImage const& image = *images.at(entry.image);
+				levels.push_back(image.pixels);
+				if (image.mips.size() + 1 == size_t(group.levels)) {
+					levels.insert(levels.end(), image.mips.begin(), image.mips.end());
+				}
+				else {
+					std::vector<std::vector<unsigned char>> mips = Mipmap::Generate(image.pixels.data(), image.width, image.height, image.channels, settings, pool);
+					levels.insert(levels.end(), std::make_move_iterator(mips.begin()), std::make_move_iterator(mips.end()));
+				}
+				return levels;
+			}
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": layer " + std::to_string(layer) + " has no image.");
+		}
+
+		std::vector<unsigned char> page(size_t(group.width) * size_t(group.height) * pixelBytes, 0);
+		for (Entry const& entry : group.entries) {
+			if (entry.layer != layer) {
+				continue;
+			}
+			TextureDecode::DecodedImage const& image = *images.at(entry.image);
+			// Edge texels repeat out to the edge of the area
+			int left = entry.area.x;
+			int right = entry.area.x + entry.area.width;
+			for (int y = entry.area.y; y < entry.area.y + entry.area.height; ++y) {
+				int sourceY = std::min(std::max(y - entry.rect.y, 0), image.height - 1);
+				unsigned char const* sourceRow = image.pixels.data() + size_t(sourceY) * size_t(image.width) * pixelBytes;
+				unsigned char* row = page.data() + size_t(y) * size_t(group.width) * pixelBytes;
+				for (int x = left; x < entry.rect.x; ++x) {
+					std::memcpy(row + size_t(x) * pixelBytes, sourceRow, pixelBytes);
+				}
+				std::memcpy(row + size_t(entry.rect.x) * pixelBytes, sourceRow, size_t(image.width) * pixelBytes);
+				for (int x = entry.rect.x + image.width; x < right; ++x) {
+					std::memcpy(row + size_t(x) * pixelBytes, sourceRow + size_t(image.width - 1) * pixelBytes, pixelBytes);
+				}
+			}
+		}
+		std::vector<std::vector<unsigned char>> mips = Mipmap::Generate(page.data(), group.width, group.height, group.channels, settings, pool);
+		mips.resize(std::min(mips.size(), size_t(group.levels - 1)));
+		levels.emplace_back(std::move(page));
+		levels.insert(levels.end(), std::make_move_iterator(mips.begin()), std::make_move_iterator(mips.end()));
+		return levels;
+	}
+
+	/// <summary>
+	/// A material texture after packing, image indexes the document and placement says where it now lives.
+	/// </summary>
+	struct TextureBinding {
+		GLTF::index_type image = GLTF::index_type(-1);
+		Placement placement;
+
+		bool Used() const {
+			return image != GLTF::index_type(-1);
+		}
+	};
+
+	struct MaterialTextures {
+		TextureBinding baseColor;
+		TextureBinding metallicRoughness;
+		TextureBinding normal;
+		TextureBinding occlusion;
+		TextureBinding emissive;
+	};
+
+	/// <summary>
+	/// The images each material samples, placements are filled in by Apply_Placements once images are packed.
+	/// </summary>
+	inline std::vector<MaterialTextures> Material_Textures(GLTF::GLTFDoc const& doc) {
+		auto binding = [&](GLTF::TextureInfo const& texture) {
+			TextureBinding result;
+			if (texture.index < doc.textures.size() && GLTF::Texture_Source(doc.textures[texture.index]) < doc.images.size()) {
+				result.image = GLTF::Texture_Source(doc.textures[texture.index]);
+			}
+			return result;
+		};
+		std::vector<MaterialTextures> materials;
+		for (GLTF::Material const& material : doc.materials) {
+			MaterialTextures textures;
+			textures.baseColor = binding(material.pbrMetallicRoughness.baseColorTexture);
+			textures.metallicRoughness = binding(material.pbrMetallicRoughness.metallicRoughnessTexture);
+			textures.normal = binding(material.normalTexture);
+			textures.occlusion = binding(material.occlusionTexture);
+			textures.emissive = binding(material.emissiveTexture);
+			materials.emplace_back(textures);
+		}
+		return materials;
+	}
+
+	/// <summary>
+	/// Points material textures at their texture array layer and rewrites their uv transform.
+	/// </summary>
+	/// <param name="placements">Indexed by document image</param>
+	inline void Apply_Placements(std::vector<MaterialTextures>& materials, std::vector<Placement> const& placements) {
+		auto apply = [&](TextureBinding& binding) {
+			if (binding.Used() && binding.image < placements.size()) {
+				binding.placement = placements[binding.image];
+			}
+		};
+		for (MaterialTextures& material : materials) {
+			apply(material.baseColor);
+			apply(material.metallicRoughness);
+			apply(material.normal);
+			apply(material.occlusion);
+			apply(material.emissive);
+		}
+	}
+}
@@ -0,0 +1,408 @@
+#pragma once
+#include "AccessorData.hpp"
+#include "BlockCompression.hpp"
+#include "DataStream.hpp"
+#include "Ktx2.hpp"
+#include "Mipmap.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Decoding of PNG and JPEG images to 8 bit pixels, off the GL thread so only the upload is left for it. KTX2 images are read as stored
+namespace TextureDecode {
+	// Bumped when processing changes so older cached copies are not read
+	constexpr uint32_t CACHE_VERSION = 2;
+
+	/// <summary>
+	/// Tightly packed 8 bit pixels, rows top to bottom unless flipped when decoded.
+	/// Three channel images are expanded to four so rows upload without unpack alignment concerns.
+	/// </summary>
+	struct DecodedImage {
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		std::vector<unsigned char> pixels;
+		// Levels below pixels when they were built on the CPU, see Mipmap::Generate
+		std::vector<std::vector<unsigned char>> mips;
+		// Block compressed copy of pixels and mips when one was requested, uploaded instead of them
+		BlockCompression::CompressedImage compressed;
+		// Pixels are sRGB encoded, known from the document or from a KTX2 format
+		bool srgb = false;
+		// Reason the image failed to decode, empty on success
+		std::string error;
+
+		DecodedImage() = default;
+		DecodedImage(DecodedImage const&) = default;
+		DecodedImage(DecodedImage&&) = default;
+
+		DecodedImage& operator=(DecodedImage const&) = default;
+		DecodedImage& operator=(DecodedImage&&) = default;
+
+		bool Valid() const {
+			return error.empty() && (!pixels.empty() || !compressed.Empty());
+		}
+	};
+
+	/// <summary>
+	/// Levels of a KTX2 file as a decoded image, block formats fill compressed and raw formats fill pixels and mips.
+	/// </summary>
+	inline DecodedImage From_Ktx2(Ktx2::File const& file) {
+		DecodedImage result;
+		result.width = file.Width();
+		result.height = file.Height();
+		result.srgb = Ktx2::Is_Srgb(file.Format());
+		BlockCompression::Format block;
+		if (Ktx2::Block_Format(file.Format(), block)) {
+			result.channels = BlockCompression::Format_Channels(block);
+			result.compressed.format = block;
+			result.compressed.width = file.Width();
+			result.compressed.height = file.Height();
+			for (int level = 0; level < file.Level_Count(); ++level) {
+				result.compressed.levels.emplace_back(file.Level_Data(level));
+			}
+			return result;
+		}
+		result.channels = Ktx2::Raw_Channels(file.Format());
+		result.pixels = file.Level_Data(0);
+		for (int level = 1; level < file.Level_Count(); ++level) {
+			result.mips.emplace_back(file.Level_Data(level));
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// The levels that would be uploaded for an image, the compressed copy when there is one.
+	/// </summary>
+	inline Ktx2::Image To_Ktx2(DecodedImage const& image) {
+		Ktx2::Image result;
+		result.width = image.width;
+		result.height = image.height;
+		if (!image.compressed.Empty()) {
+			result.format = Ktx2::Block_Vk_Format(image.compressed.format, image.srgb);
+			result.levels = image.compressed.levels;
+			return result;
+		}
+		result.format = Ktx2::Raw_Vk_Format(image.channels, image.srgb);
+		result.levels.push_back(image.pixels);
+		result.levels.insert(result.levels.end(), image.mips.begin(), image.mips.end());
+		return result;
+	}
+
+	/// <summary>
+	/// Decodes an encoded image on the calling thread, safe to call from several threads at once.
+	/// </summary>
+	/// <param name="flip">Store the bottom row first, glTF images are not flipped</param>
+	inline DecodedImage Decode_Image(unsigned char const* data, size_t size, bool flip = false) {
+		DecodedImage result;
+		if (Ktx2::Is_Ktx2(data, size)) {
+			// Stored top row first, flipping would need every block rewritten
+			try {
+				return From_Ktx2(Ktx2::File(std::vector<unsigned char>(data, data + size)));
+			}
+			catch (std::exception const& exception) {
+				result.error = exception.what();
+				return result;
+			}
+		}
+		int width;
+		int height;
+		int channels;
+		if (!stbi_info_from_memory(data, int(size), &width, &height, &channels)) {
+			result.error = stbi_failure_reason();
+			return result;
+		}
+		int desired = channels == 3 ? 4 : channels;
+
+		// Both the flip flag and the failure reason are thread local in stb_image
+		stbi_set_flip_vertically_on_load_thread(flip);
+		stbi_uc* pixels = stbi_load_from_memory(data, int(size), &width, &height, &channels, desired);
+		if (pixels == nullptr) {
+			result.error = stbi_failure_reason();
+			return result;
+		}
+		result.width = width;
+		result.height = height;
+		result.channels = desired;
+		result.pixels.assign(pixels, pixels + size_t(width) * size_t(height) * size_t(desired));
+		stbi_image_free(pixels);
+		return result;
+	}
+
+	inline DecodedImage Decode_Image(std::vector<unsigned char> const& encoded, bool flip = false) {
+		return Decode_Image(encoded.data(), encoded.size(), flip);
+	}
+
+	inline std::vector<unsigned char> Read_File(std::filesystem::path const& path) {
+		std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+		if (!file.is_open()) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to open file '" + path.string() + "'.");
+		}
+		std::vector<unsigned char> data(size_t(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+		if (!file) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": failed to read file '" + path.string() + "'.");
+		}
+		return data;
+	}
+
+	/// <summary>
+	/// Encoded bytes of an image stored in a bufferView, a data uri or a file next to the document.
+	/// </summary>
+	/// <param name="directory">Directory of the document, relative uris are resolved against it</param>
+	inline std::vector<unsigned char> Image_Bytes(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::index_type imageIndex, std::filesystem::path const& directory) {
+		GLTF::Image const& image = doc.images.at(imageIndex);
+		if (image.bufferView != GLTF::index_type(-1)) {
+			GLTF::BufferView const& view = doc.bufferViews.at(image.bufferView);
+			GLTF::BufferSpan const& buffer = buffers.at(view.buffer);
+			if (size_t(view.byteOffset) + size_t(view.byteLength) > buffer.size) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": image '" + image.name + "' reads outside of its buffer.");
+			}
+			return std::vector<unsigned char>(buffer.data + size_t(view.byteOffset), buffer.data + size_t(view.byteOffset) + size_t(view.byteLength));
+		}
+		if (image.uri.find(GLTF::Constants::STREAM_DATA) == 0) {
+			return DataStreamBase64(image.uri).binaryData;
+		}
+		if (image.uri.empty()) {
+			throw std::runtime_error(FILE_FUNCTION_LINE + ": image '" + image.name + "' has neither a uri nor a bufferView.");
+		}
+		std::filesystem::path path(image.uri);
+		return Read_File(path.is_relative() ? directory / path : path);
+	}
+
+	/// <summary>
+	/// True when a material samples the image as colour, base colour and emissive textures are stored in sRGB.
+	/// </summary>
+	inline bool Image_Is_Srgb(GLTF::GLTFDoc const& doc, GLTF::index_type image) {
+		auto uses = [&](GLTF::TextureInfo const& texture) {
+			return texture.index < doc.textures.size() && GLTF::Texture_Source(doc.textures[texture.index]) == image;
+		};
+		for (GLTF::Material const& material : doc.materials) {
+			if (uses(material.pbrMetallicRoughness.baseColorTexture) || uses(material.emissiveTexture)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// How the mip chain of an image is filtered, colour images are filtered in linear space and alphaMode MASK images keep their coverage.
+	/// </summary>
+	inline Mipmap::MipSettings Image_Mip_Settings(GLTF::GLTFDoc const& doc, GLTF::index_type image, Mipmap::Filter filter = Mipmap::Filter::Kaiser) {
+		Mipmap::MipSettings settings;
+		settings.filter = filter;
+		settings.srgb = Image_Is_Srgb(doc, image);
+		for (GLTF::Material const& material : doc.materials) {
+			GLTF::TextureInfo const& baseColor = material.pbrMetallicRoughness.baseColorTexture;
+			if (material.alphaMode == GLTF::Constants::ALPHA_MODE_MASK && baseColor.index < doc.textures.size() && GLTF::Texture_Source(doc.textures[baseColor.index]) == image) {
+				settings.alphaCutoff = float(material.alphaCutoff);
+			}
+		}
+		return settings;
+	}
+
+	/// <summary>
+	/// Block format for how materials sample an image: BC5 for normal maps, BC4 for occlusion only images and BC7 for everything else.
+	/// </summary>
+	inline BlockCompression::CompressSettings Image_Compression(GLTF::GLTFDoc const& doc, GLTF::index_type image, BlockCompression::Quality quality = BlockCompression::Quality::Normal) {
+		auto uses = [&](GLTF::TextureInfo const& texture) {
+			return texture.index < doc.textures.size() && GLTF::Texture_Source(doc.textures[texture.index]) == image;
+		};
+		bool normal = false;
+		bool occlusion = false;
+		bool other = false;
+		for (GLTF::Material const& material : doc.materials) {
+			normal |= uses(material.normalTexture);
+			occlusion |= uses(material.occlusionTexture);
+			other |= uses(material.pbrMetallicRoughness.baseColorTexture) || uses(material.pbrMetallicRoughness.metallicRoughnessTexture) || uses(material.emissiveTexture);
+		}
+		BlockCompression::CompressSettings settings;
+		settings.quality = quality;
+		if (normal && !occlusion && !other) {
+			settings.format = BlockCompression::Format::BC5;
+		}
+		else if (occlusion && !normal && !other) {
+			settings.format = BlockCompression::Format::BC4;
+		}
+		return settings;
+	}
+
+	/// <summary>
+	/// FNV-1a hash, names cached copies of images by their content.
+	/// </summary>
+	inline uint64_t Content_Hash(unsigned char const* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+		for (size_t index = 0; index < size; ++index) {
+			hash = (hash ^ data[index]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Path of the processed copy of an encoded image, it changes with the image and with every setting that changes the result.
+	/// </summary>
+	inline std::filesystem::path Cache_Path(std::filesystem::path const& directory, std::vector<unsigned char> const& encoded, Mipmap::MipSettings const& mipmaps, BlockCompression::CompressSettings const& compression) {
+		std::string settings = std::to_string(CACHE_VERSION) + ' ' + std::to_string(int(mipmaps.filter)) + ' ' + std::to_string(mipmaps.srgb) + ' ' + std::to_string(mipmaps.alphaCutoff) + ' ' +
+			std::to_string(int(compression.format)) + ' ' + std::to_string(int(compression.quality)) + ' ' + std::to_string(compression.channel);
+		uint64_t hash = Content_Hash(reinterpret_cast<unsigned char const*>(settings.data()), settings.size());
+		hash = Content_Hash(encoded.data(), encoded.size(), hash);
+		char name[17];
+		std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+		return directory / (std::string(name) + ".ktx2");
+	}
+
+	/// <summary>
+	/// Decodes images on a thread pool, each image is one task so many images spread over every core.
+	/// Results are collected with Take_Finished on the thread that uploads them.
+	/// Tasks own their input, the decoder can be destroyed with work in flight.
+	/// With a cache the processed image is kept as a KTX2 file, later runs read it instead of decoding and processing again.
+	/// </summary>
+	class TextureDecoder {
+		struct Task {
+			size_t key;
+			std::future<DecodedImage> result;
+		};
+
+		ThreadPool* _pool;
+		std::vector<Task> _tasks;
+		// Runs on the pool after each image decodes
+		std::function<void(size_t, DecodedImage&)> _process;
+		// Path of the processed copy of an image, empty to not cache it
+		std::function<std::filesystem::path(size_t, std::vector<unsigned char> const&)> _cache;
+
+		std::future<DecodedImage> Submit(size_t key, std::function<std::vector<unsigned char>()> read, bool flip) {
+			return _pool->Submit([key, read = std::move(read), flip, process = _process, cache = _cache]() {
+				std::vector<unsigned char> encoded = read();
+				// KTX2 sources are already stored as they upload, flipped images are not cached
+				std::filesystem::path cached;
+				if (cache && !flip && !Ktx2::Is_Ktx2(encoded.data(), encoded.size())) {
+					cached = cache(key, encoded);
+				}
+				std::error_code error;
+				if (!cached.empty() && std::filesystem::exists(cached, error)) {
+					try {
+						return From_Ktx2(Ktx2::File(cached));
+					}
+					catch (std::exception const&) {
+						// Unreadable copies are rebuilt below
+					}
+				}
+
+				DecodedImage image = Decode_Image(encoded, flip);
+				if (process && image.Valid()) {
+					process(key, image);
+				}
+				if (!cached.empty() && image.Valid()) {
+					// Written under another name first so a reader never maps a partial file, a failed write only costs the next run a decode
+					try {
+						std::filesystem::create_directories(cached.parent_path(), error);
+						std::filesystem::path partial = cached;
+						partial += ".partial" + std::to_string(key);
+						Ktx2::Write_File(partial, To_Ktx2(image));
+						std::filesystem::rename(partial, cached, error);
+						if (error) {
+							std::filesystem::remove(partial, error);
+						}
+					}
+					catch (std::exception const&) {
+					}
+				}
+				return image;
+			});
+		}
+
+		static DecodedImage Finish(Task& task) {
+			try {
+				return task.result.get();
+			}
+			catch (std::exception const& exception) {
+				DecodedImage failed;
+				failed.error = exception.what();
+				return failed;
+			}
+		}
+
+	public:
+		/// <param name="process">Called on the pool with every image that decoded, such as to build its mipmaps</param>
+		/// <param name="cache">Path of the KTX2 copy of an image from its key and encoded bytes, it must change whenever process would</param>
+		TextureDecoder(ThreadPool& pool = Default_Thread_Pool(), std::function<void(size_t, DecodedImage&)> process = nullptr,
+			std::function<std::filesystem::path(size_t, std::vector<unsigned char> const&)> cache = nullptr) : _pool(&pool), _process(std::move(process)), _cache(std::move(cache)) {
+
+		}
+
+		TextureDecoder(TextureDecoder&&) = default;
+		TextureDecoder& operator=(TextureDecoder&&) = default;
+
+		/// <param name="key">Returned with the result, such as the image index</param>
+		void Enqueue(size_t key, std::vector<unsigned char> encoded, bool flip = false) {
+			_tasks.push_back({ key, Submit(key, [encoded = std::move(encoded)]() {
+				return encoded;
+			}, flip) });
+		}
+
+		/// <summary>
+		/// Reads the file on the pool as well, so disk reads overlap with decoding.
+		/// </summary>
+		void Enqueue_File(size_t key, std::filesystem::path path, bool flip = false) {
+			_tasks.push_back({ key, Submit(key, [path = std::move(path)]() {
+				return Read_File(path);
+			}, flip) });
+		}
+
+		/// <summary>
+		/// Queues a document image under its index, bufferView bytes are copied so the buffers may be released afterwards.
+		/// </summary>
+		void Enqueue_Image(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::index_type image, std::filesystem::path const& directory) {
+			GLTF::Image const& source = doc.images.at(image);
+			if (source.bufferView == GLTF::index_type(-1) && !source.uri.empty() && source.uri.find(GLTF::Constants::STREAM_DATA) != 0) {
+				std::filesystem::path path(source.uri);
+				Enqueue_File(size_t(image), path.is_relative() ? directory / path : path);
+				return;
+			}
+			Enqueue(size_t(image), Image_Bytes(doc, buffers, image, directory));
+		}
+
+		size_t Pending() const {
+			return _tasks.size();
+		}
+
+		/// <summary>
+		/// Results of the tasks that have finished, does not block.
+		/// </summary>
+		std::vector<std::pair<size_t, DecodedImage>> Take_Finished() {
+			std::vector<std::pair<size_t, DecodedImage>> finished;
+			for (size_t index = 0; index < _tasks.size();) {
+				if (_tasks[index].result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+					++index;
+					continue;
+				}
+				finished.emplace_back(_tasks[index].key, Finish(_tasks[index]));
+				_tasks[index] = std::move(_tasks.back());
+				_tasks.pop_back();
+			}
+			return finished;
+		}
+
+		/// <summary>
+		/// Blocks until every queued image is decoded.
+		/// </summary>
+		std::vector<std::pair<size_t, DecodedImage>> Take_All() {
+			std::vector<std::pair<size_t, DecodedImage>> finished;
+			for (Task& task : _tasks) {
+				finished.emplace_back(task.key, Finish(task));
+			}
+			_tasks.clear();
+			return finished;
+		}
+	};
+}
@@ -0,0 +1,371 @@
+#pragma once
+#include "AccessorData.hpp"
+#include "GLTF.hpp"
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Which mip levels of streamed textures stay in memory under a budget, decided on the CPU without touching GL
+namespace TextureResidency {
+	// Levels this size or smaller are always resident, so every texture can be sampled
+	constexpr int TAIL_SIZE = 64;
+	// Level loads started per Update, spreads I/O over frames
+	constexpr int LOADS_PER_UPDATE = 4;
+
+	/// <summary>
+	/// Texels of level 0 that cover one screen pixel for a texture on a surface.
+	/// </summary>
+	/// <param name="uvPerWorldUnit">Texture coordinate units per world unit of the surface, see Uv_Density</param>
+	/// <param name="pixelsPerWorldUnit">Screen pixels one world unit covers, see Pixels_Per_World_Unit</param>
+	inline float Texels_Per_Pixel(int width, int height, float uvPerWorldUnit, float pixelsPerWorldUnit) {
+		return float(std::max(width, height)) * uvPerWorldUnit / std::max(pixelsPerWorldUnit, 1e-6f);
+	}
+
+	/// <summary>
+	/// Level sampled when texelsPerPixel texels of level 0 land on a pixel, the finest level worth keeping resident.
+	/// </summary>
+	inline float Required_Level(float texelsPerPixel) {
+		return texelsPerPixel > 1.0f ? std::log2(texelsPerPixel) : 0.0f;
+	}
+
+	/// <summary>
+	/// Screen pixels covered by one world unit at a view space distance, for a perspective projection.
+	/// </summary>
+	inline float Pixels_Per_World_Unit(glm::mat4 const& projection, float viewportHeight, float distance) {
+		return projection[1][1] * viewportHeight * 0.5f / std::max(distance, 1e-4f);
+	}
+
+	/// <summary>
+	/// Texture coordinate units per world unit of a triangle mesh, the square root of its uv area over its surface area.
+	/// </summary>
+	/// <returns>0 for meshes with no area</returns>
+	inline float Uv_Density(std::vector<float> const& positions, std::vector<float> const& uvs, std::vector<unsigned> const& indices) {
+		double worldArea = 0.0;
+		double uvArea = 0.0;
+		size_t vertices = std::min(positions.size() / 3, uvs.size() / 2);
+		for (size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3) {
+			unsigned a = indices[triangle];
+			unsigned b = indices[triangle + 1];
+			unsigned c = indices[triangle + 2];
+			if (a >= vertices || b >= vertices || c >= vertices) {
+				continue;
+			}
+			glm::vec3 pa(positions[a * 3], positions[a * 3 + 1], positions[a * 3 + 2]);
+			glm::vec3 pb(positions[b * 3], positions[b * 3 + 1], positions[b * 3 + 2]);
+			glm::vec3 pc(positions[c * 3], positions[c * 3 + 1], positions[c * 3 + 2]);
+			worldArea += 0.5 * double(glm::length(glm::cross(pb - pa, pc - pa)));
+			glm::vec2 ua(uvs[a * 2], uvs[a * 2 + 1]);
+			glm::vec2 ub(uvs[b * 2], uvs[b * 2 + 1]);
+			glm::vec2 uc(uvs[c * 2], uvs[c * 2 + 1]);
+			glm::vec2 edgeB = ub - ua;
+			glm::vec2 edgeC = uc - ua;
+			uvArea += 0.5 * std::abs(double(edgeB.x) * double(edgeC.y) - double(edgeB.y) * double(edgeC.x));
+		}
+		return worldArea > 0.0 ? float(std::sqrt(uvArea / worldArea)) : 0.0f;
+	}
+
+	/// <summary>
+	/// Uv_Density of the TEXCOORD_0 triangles of a mesh, primitives without them are skipped.
+	/// </summary>
+	inline float Mesh_Uv_Density(GLTF::GLTFDoc const& doc, std::vector<GLTF::BufferSpan> const& buffers, GLTF::Mesh const& mesh) {
+		std::vector<float> positions;
+		std::vector<float> uvs;
+		std::vector<unsigned> indices;
+		for (GLTF::Mesh::Primitive const& primitive : mesh.primitives) {
+			auto position = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_POSITION);
+			auto uv = primitive.attributes.find(GLTF::Constants::ATTRIBUTE_TEXCOORD_0);
+			// glTF mode 4, TRIANGLES
+			if (primitive.mode != 4 || position == primitive.attributes.cend() || uv == primitive.attributes.cend()) {
+				continue;
+			}
+			std::vector<float> primitivePositions = GLTF::Read_Accessor_Float(doc, buffers, position->second);
+			std::vector<float> primitiveUvs = GLTF::Read_Accessor_Float(doc, buffers, uv->second);
+			unsigned base = unsigned(positions.size() / 3);
+			size_t vertices = std::min(primitivePositions.size() / 3, primitiveUvs.size() / 2);
+			if (primitive.indices != GLTF::index_type(-1)) {
+				for (unsigned index : GLTF::Read_Accessor_Unsigned(doc, buffers, primitive.indices)) {
+					indices.emplace_back(base + index);
+				}
+			}
+			else {
+				for (unsigned index = 0; index < unsigned(vertices); ++index) {
+					indices.emplace_back(base + index);
+				}
+			}
+			indices.resize(indices.size() / 3 * 3);
+			primitivePositions.resize(vertices * 3);
+			primitiveUvs.resize(vertices * 2);
+			positions.insert(positions.end(), primitivePositions.begin(), primitivePositions.end());
+			uvs.insert(uvs.end(), primitiveUvs.begin(), primitiveUvs.end());
+		}
+		return Uv_Density(positions, uvs, indices);
+	}
+
+	/// <summary>
+	/// Size in bytes of each level of a texture, level 0 first.
+	/// </summary>
+	struct TextureDesc {
+		int width = 0;
+		int height = 0;
+		std::vector<size_t> levelBytes;
+	};
+
+	/// <summary>
+	/// Levels first to last, inclusive, to read and make resident.
+	/// </summary>
+	struct Load {
+		size_t texture;
+		int first;
+		int last;
+	};
+
+	/// <summary>
+	/// Levels finer than level were dropped, level is now the finest resident one.
+	/// </summary>
+	struct Eviction {
+		size_t texture;
+		int level;
+	};
+
+	struct Decisions {
+		std::vector<Load> loads;
+		std::vector<Eviction> evictions;
+	};
+
+	/// <summary>
+	/// Tracks the resident levels of every texture and decides loads and evictions each frame.
+	/// Each texture keeps its tail of small levels. Finer levels are loaded one at a time towards what the frame requested,
+	/// and when the budget is full the least recently used textures give up their finest levels first.
+	/// Nothing here touches GL, loads are carried out by the caller who reports back with Loaded or Failed.
+	/// </summary>
+	class Residency {
+		struct Texture {
+			TextureDesc desc;
+			// Finest level that is never evicted
+			int tail;
+			// Finest resident level, levels from here to the last are resident
+			int resident;
+			// Finest level requested this frame, levels count when nothing asked
+			int wanted;
+			bool loading = false;
+			// The tail could not be read, the texture is never loaded again
+			bool failed = false;
+			uint64_t lastUsed = 0;
+		};
+
+		size_t _budget;
+		size_t _used = 0;
+		uint64_t _frame = 1;
+		std::vector<Texture> _textures;
+
+		size_t Bytes(Texture const& texture, int first, int last) const {
+			size_t bytes = 0;
+			for (int level = first; level <= last; ++level) {
+				bytes += texture.desc.levelBytes[size_t(level)];
+			}
+			return bytes;
+		}
+
+		int Target(Texture const& texture) const {
+			return std::min(std::max(texture.wanted, 0), texture.tail);
+		}
+
+		/// <summary>
+		/// Texture whose finest level is cheapest to lose: unused for longest, then the most over resident.
+		/// </summary>
+		/// <returns>Textures count when nothing can be evicted</returns>
+		size_t Victim(size_t keep) const {
+			size_t victim = _textures.size();
+			for (size_t index = 0; index < _textures.size(); ++index) {
+				Texture const& texture = _textures[index];
+				if (index == keep || texture.loading || texture.resident >= texture.tail) {
+					continue;
+				}
+				// Levels a texture used this frame still needs are kept
+				bool used = texture.lastUsed == _frame;
+				if (used && texture.resident >= Target(texture)) {
+					continue;
+				}
+				if (victim == _textures.size()) {
+					victim = index;
+					continue;
+				}
+				Texture const& best = _textures[victim];
+				if (texture.lastUsed != best.lastUsed ? texture.lastUsed < best.lastUsed : Target(texture) - texture.resident > Target(best) - best.resident) {
+					victim = index;
+				}
+			}
+			return victim;
+		}
+
+		void Evict(size_t index, Decisions& decisions) {
+			Texture& texture = _textures[index];
+			_used -= texture.desc.levelBytes[size_t(texture.resident)];
+			++texture.resident;
+			if (!decisions.evictions.empty() && decisions.evictions.back().texture == index) {
+				decisions.evictions.back().level = texture.resident;
+			}
+			else {
+				decisions.evictions.push_back({ index, texture.resident });
+			}
+		}
+
+	public:
+		Residency(size_t budget) : _budget(budget) {
+
+		}
+
+		Residency(Residency const&) = default;
+		Residency(Residency&&) = default;
+
+		Residency& operator=(Residency const&) = default;
+		Residency& operator=(Residency&&) = default;
+
+		/// <summary>
+		/// Registers a texture, its tail is returned as a load by the next Update and is counted against the budget from now on.
+		/// </summary>
+		size_t Add(TextureDesc desc) {
+			if (desc.levelBytes.empty() || desc.width <= 0 || desc.height <= 0) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": texture has no levels.");
+			}
+			Texture texture;
+			int levels = int(desc.levelBytes.size());
+			texture.tail = levels - 1;
+			while (texture.tail > 0 && std::max(std::max(desc.width >> (texture.tail - 1), 1), std::max(desc.height >> (texture.tail - 1), 1)) <= TAIL_SIZE) {
+				--texture.tail;
+			}
+			texture.resident = levels;
+			texture.wanted = levels;
+			texture.desc = std::move(desc);
+			_textures.emplace_back(std::move(texture));
+			return _textures.size() - 1;
+		}
+
+		/// <summary>
+		/// Asks for a level this frame, the finest level asked for over the frame wins.
+		/// </summary>
+		void Request(size_t texture, float level) {
+			Texture& requested = _textures.at(texture);
+			requested.wanted = std::min(requested.wanted, int(std::floor(std::max(level, 0.0f))));
+			requested.lastUsed = _frame;
+		}
+
+		/// <summary>
+		/// Ends the frame. Evictions have already happened as far as the budget is concerned, loads have their bytes reserved.
+		/// </summary>
+		Decisions Update() {
+			Decisions decisions;
+			// Tails first, they are needed to draw at all and may go over the budget
+			for (size_t index = 0; index < _textures.size(); ++index) {
+				Texture& texture = _textures[index];
+				if (texture.resident == int(texture.desc.levelBytes.size()) && !texture.loading && !texture.failed) {
+					int last = int(texture.desc.levelBytes.size()) - 1;
+					_used += Bytes(texture, texture.tail, last);
+					texture.loading = true;
+					decisions.loads.push_back({ index, texture.tail, last });
+				}
+			}
+			// A smaller budget is met before anything new is loaded
+			while (_used > _budget) {
+				size_t victim = Victim(_textures.size());
+				if (victim == _textures.size()) {
+					break;
+				}
+				Evict(victim, decisions);
+			}
+
+			std::vector<size_t> candidates;
+			for (size_t index = 0; index < _textures.size(); ++index) {
+				Texture const& texture = _textures[index];
+				if (!texture.loading && !texture.failed && texture.lastUsed == _frame && Target(texture) < texture.resident) {
+					candidates.emplace_back(index);
+				}
+			}
+			// Furthest from what they need first
+			std::sort(candidates.begin(), candidates.end(), [&](size_t left, size_t right) {
+				int leftMissing = _textures[left].resident - Target(_textures[left]);
+				int rightMissing = _textures[right].resident - Target(_textures[right]);
+				return leftMissing != rightMissing ? leftMissing > rightMissing : left < right;
+			});
+			int started = 0;
+			for (size_t index : candidates) {
+				if (started == LOADS_PER_UPDATE) {
+					break;
+				}
+				Texture& texture = _textures[index];
+				int level = texture.resident - 1;
+				size_t cost = texture.desc.levelBytes[size_t(level)];
+				while (_used + cost > _budget) {
+					size_t victim = Victim(index);
+					if (victim == _textures.size()) {
+						break;
+					}
+					Evict(victim, decisions);
+				}
+				if (_used + cost > _budget) {
+					continue;
+				}
+				_used += cost;
+				texture.loading = true;
+				decisions.loads.push_back({ index, level, level });
+				++started;
+			}
+
+			for (Texture& texture : _textures) {
+				texture.wanted = int(texture.desc.levelBytes.size());
+			}
+			++_frame;
+			return decisions;
+		}
+
+		/// <summary>
+		/// A load from Update finished and its levels are in use.
+		/// </summary>
+		void Loaded(size_t texture, int first) {
+			Texture& loaded = _textures.at(texture);
+			loaded.resident = std::min(loaded.resident, first);
+			loaded.loading = false;
+		}
+
+		/// <summary>
+		/// A load from Update could not be read, its bytes are released.
+		/// </summary>
+		void Failed(size_t texture, int first, int last) {
+			Texture& failed = _textures.at(texture);
+			_used -= Bytes(failed, first, last);
+			failed.loading = false;
+			failed.failed = failed.resident == int(failed.desc.levelBytes.size());
+		}
+
+		int Resident_Level(size_t texture) const {
+			return _textures.at(texture).resident;
+		}
+
+		bool Loading(size_t texture) const {
+			return _textures.at(texture).loading;
+		}
+
+		size_t Texture_Count() const {
+			return _textures.size();
+		}
+
+		size_t Used_Bytes() const {
+			return _used;
+		}
+
+		size_t Budget() const {
+			return _budget;
+		}
+
+		void Set_Budget(size_t budget) {
+			_budget = budget;
+		}
+	};
+}
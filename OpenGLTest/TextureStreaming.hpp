@@ -0,0 +1,283 @@
+#pragma once
+#include <GLAD/gl.h>
+#include "Ktx2.hpp"
+#include "Mipmap.hpp"
+#include "Texture.hpp"
+#include "TextureDecode.hpp"
+#include "TextureResidency.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define FILE_FUNCTION_LINE std::string(__FILE__) + ':' + std::string(__FUNCTION__) + '@' + std::to_string(__LINE__)
+
+// Textures whose finer mip levels are read and uploaded while drawing, as TextureResidency decides
+namespace TextureStreaming {
+	// Upload ready bytes of one level, called on the thread pool
+	using LevelSource = std::function<std::vector<unsigned char>(int level)>;
+
+	/// <summary>
+	/// True when every level of a decoded image is present, only those can be streamed.
+	/// </summary>
+	inline bool Streamable(TextureDecode::DecodedImage const& image) {
+		if (!image.Valid()) {
+			return false;
+		}
+		if (!image.compressed.Empty()) {
+			return image.compressed.levels.size() == size_t(Mipmap::Level_Count(image.width, image.height));
+		}
+		return (image.channels == 1 || image.channels == 2 || image.channels == 4) && image.mips.size() + 1 == size_t(Mipmap::Level_Count(image.width, image.height));
+	}
+
+	/// <summary>
+	/// Owns the GL textures of streamed images. Each texture holds only its resident levels,
+	/// when the resident levels change it is re-created at the new size and the levels it keeps are copied on the GPU.
+	/// Reads run on the thread pool, Update uploads what finished and starts what the residency decided.
+	/// </summary>
+	class TextureStreamer {
+		struct Texture {
+			GLuint id = 0;
+			// Image level stored as level 0 of id, levels when nothing is resident
+			int base;
+			int width;
+			int height;
+			int levels;
+			GLenum internalFormat;
+			GLenum dataFormat;
+			bool compressed;
+			std::vector<size_t> levelBytes;
+			LevelSource source;
+		};
+
+		struct Pending {
+			TextureResidency::Load load;
+			std::future<std::vector<std::vector<unsigned char>>> data;
+		};
+
+		TextureResidency::Residency _residency;
+		ThreadPool* _pool;
+		std::vector<Texture> _textures;
+		std::vector<Pending> _pending;
+
+		/// <summary>
+		/// Replaces the texture with one holding levels base and coarser.
+		/// </summary>
+		/// <param name="levels">Data of levels base onwards that are not in the old texture</param>
+		void Reallocate(Texture& texture, int base, std::vector<std::vector<unsigned char>> const& levels) {
+			GLuint id;
+			glCreateTextures(GL_TEXTURE_2D, 1, &id);
+			glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+			glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, texture.levels - base > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			glTextureStorage2D(id, texture.levels - base, texture.internalFormat, Mipmap::Level_Size(texture.width, base), Mipmap::Level_Size(texture.height, base));
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for (int level = base; level < texture.levels; ++level) {
+				GLsizei width = Mipmap::Level_Size(texture.width, level);
+				GLsizei height = Mipmap::Level_Size(texture.height, level);
+				if (texture.id != 0 && level >= texture.base) {
+					glCopyImageSubData(texture.id, GL_TEXTURE_2D, level - texture.base, 0, 0, 0, id, GL_TEXTURE_2D, level - base, 0, 0, 0, width, height, 1);
+				}
+				else if (texture.compressed) {
+					std::vector<unsigned char> const& data = levels.at(size_t(level - base));
+					glCompressedTextureSubImage2D(id, level - base, 0, 0, width, height, texture.internalFormat, GLsizei(data.size()), data.data());
+				}
+				else {
+					glTextureSubImage2D(id, level - base, 0, 0, width, height, texture.dataFormat, GL_UNSIGNED_BYTE, levels.at(size_t(level - base)).data());
+				}
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			if (texture.id != 0) {
+				glDeleteTextures(1, &texture.id);
+			}
+			texture.id = id;
+			texture.base = base;
+		}
+
+		size_t Add(Texture texture) {
+			TextureResidency::TextureDesc desc;
+			desc.width = texture.width;
+			desc.height = texture.height;
+			desc.levelBytes = texture.levelBytes;
+			size_t index = _residency.Add(std::move(desc));
+			_textures.emplace_back(std::move(texture));
+			return index;
+		}
+
+		static void Raw_Formats(Texture& texture, int channels, bool srgb) {
+			texture.compressed = false;
+			switch (channels) {
+			case 1:
+				texture.internalFormat = GL_R8;
+				texture.dataFormat = GL_RED;
+				break;
+			case 2:
+				texture.internalFormat = GL_RG8;
+				texture.dataFormat = GL_RG;
+				break;
+			case 4:
+				texture.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+				texture.dataFormat = GL_RGBA;
+				break;
+			default:
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": Unexpected number of channels " + std::to_string(channels) + ".");
+			}
+		}
+
+	public:
+		/// <param name="budget">Bytes of texture levels kept resident, tails may go over it</param>
+		TextureStreamer(size_t budget, ThreadPool& pool = Default_Thread_Pool()) : _residency(budget), _pool(&pool) {
+
+		}
+
+		TextureStreamer(TextureStreamer const&) = delete;
+		TextureStreamer& operator=(TextureStreamer const&) = delete;
+
+		~TextureStreamer() {
+			// Reads in flight own their source, they finish on the pool and are dropped
+			for (Texture& texture : _textures) {
+				if (texture.id != 0) {
+					glDeleteTextures(1, &texture.id);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Streams a KTX2 file, levels are read from its mapping on the pool.
+		/// </summary>
+		size_t Add(std::shared_ptr<Ktx2::File const> file) {
+			Texture texture;
+			texture.width = file->Width();
+			texture.height = file->Height();
+			texture.levels = file->Level_Count();
+			texture.base = texture.levels;
+			BlockCompression::Format block;
+			if (Ktx2::Block_Format(file->Format(), block)) {
+				texture.compressed = true;
+				texture.internalFormat = Compressed_Internal_Format(block, Ktx2::Is_Srgb(file->Format()));
+				texture.dataFormat = GL_RGBA;
+			}
+			else {
+				Raw_Formats(texture, Ktx2::Raw_Channels(file->Format()), Ktx2::Is_Srgb(file->Format()));
+			}
+			for (int level = 0; level < texture.levels; ++level) {
+				texture.levelBytes.emplace_back(Ktx2::Level_Bytes(file->Format(), Mipmap::Level_Size(texture.width, level), Mipmap::Level_Size(texture.height, level)));
+			}
+			texture.source = [file](int level) {
+				return file->Level_Data(level);
+			};
+			return Add(std::move(texture));
+		}
+
+		/// <summary>
+		/// Streams a decoded image that is kept in memory, only the resident levels take texture memory.
+		/// </summary>
+		size_t Add(std::shared_ptr<TextureDecode::DecodedImage const> image) {
+			if (!Streamable(*image)) {
+				throw std::runtime_error(FILE_FUNCTION_LINE + ": image does not have every level.");
+			}
+			Texture texture;
+			texture.width = image->width;
+			texture.height = image->height;
+			texture.levels = Mipmap::Level_Count(image->width, image->height);
+			texture.base = texture.levels;
+			if (!image->compressed.Empty()) {
+				texture.compressed = true;
+				texture.internalFormat = Compressed_Internal_Format(image->compressed.format, image->srgb);
+				texture.dataFormat = GL_RGBA;
+				for (std::vector<unsigned char> const& level : image->compressed.levels) {
+					texture.levelBytes.emplace_back(level.size());
+				}
+				texture.source = [image](int level) {
+					return image->compressed.levels[size_t(level)];
+				};
+			}
+			else {
+				Raw_Formats(texture, image->channels, image->srgb);
+				texture.levelBytes.emplace_back(image->pixels.size());
+				for (std::vector<unsigned char> const& level : image->mips) {
+					texture.levelBytes.emplace_back(level.size());
+				}
+				texture.source = [image](int level) {
+					return level == 0 ? image->pixels : image->mips[size_t(level) - 1];
+				};
+			}
+			return Add(std::move(texture));
+		}
+
+		/// <summary>
+		/// Asks for the level a surface needs this frame, from how densely its texture coordinates cover the screen.
+		/// </summary>
+		void Request(size_t texture, float uvPerWorldUnit, float pixelsPerWorldUnit) {
+			Texture const& requested = _textures.at(texture);
+			float texels = TextureResidency::Texels_Per_Pixel(requested.width, requested.height, uvPerWorldUnit, pixelsPerWorldUnit);
+			_residency.Request(texture, TextureResidency::Required_Level(texels));
+		}
+
+		/// <summary>
+		/// Once per frame on the GL thread after the frame's requests: uploads finished reads, applies evictions and starts new reads.
+		/// </summary>
+		void Update() {
+			for (size_t index = 0; index < _pending.size();) {
+				Pending& pending = _pending[index];
+				if (pending.data.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+					++index;
+					continue;
+				}
+				TextureResidency::Load load = pending.load;
+				Texture& texture = _textures[load.texture];
+				try {
+					std::vector<std::vector<unsigned char>> levels = pending.data.get();
+					for (int level = load.first; level <= load.last; ++level) {
+						if (levels.at(size_t(level - load.first)).size() != texture.levelBytes[size_t(level)]) {
+							throw std::runtime_error(FILE_FUNCTION_LINE + ": level " + std::to_string(level) + " is the wrong size.");
+						}
+					}
+					Reallocate(texture, load.first, levels);
+					_residency.Loaded(load.texture, load.first);
+				}
+				catch (std::exception const&) {
+					_residency.Failed(load.texture, load.first, load.last);
+				}
+				_pending[index] = std::move(_pending.back());
+				_pending.pop_back();
+			}
+
+			TextureResidency::Decisions decisions = _residency.Update();
+			for (TextureResidency::Eviction const& eviction : decisions.evictions) {
+				Texture& texture = _textures[eviction.texture];
+				if (eviction.level > texture.base) {
+					Reallocate(texture, eviction.level, {});
+				}
+			}
+			for (TextureResidency::Load const& load : decisions.loads) {
+				LevelSource source = _textures[load.texture].source;
+				_pending.push_back({ load, _pool->Submit([source, load]() {
+					std::vector<std::vector<unsigned char>> levels;
+					for (int level = load.first; level <= load.last; ++level) {
+						levels.emplace_back(source(level));
+					}
+					return levels;
+				}) });
+			}
+		}
+
+		/// <summary>
+		/// Current texture, it changes whenever the resident levels do. 0 until the tail has been read.
+		/// </summary>
+		GLuint Id(size_t texture) const {
+			return _textures.at(texture).id;
+		}
+
+		TextureResidency::Residency const& Residency() const {
+			return _residency;
+		}
+	};
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Fixed set of worker threads shared by the CPU kernels, tasks run in submission order.
+/// </summary>
+class ThreadPool {
+	std::vector<std::thread> _workers;
+	std::queue<std::function<void()>> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _stopping = false;
+
+	void Worker() {
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+				if (_stopping && _tasks.empty()) {
+					return;
+				}
+				task = std::move(_tasks.front());
+				_tasks.pop();
+			}
+			task();
+		}
+	}
+
+public:
+	/// <param name="threadCount">Worker threads, callers of Parallel_For work as well</param>
+	ThreadPool(size_t threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1) {
+		for (size_t index = 0; index < threadCount; ++index) {
+			_workers.emplace_back(&ThreadPool::Worker, this);
+		}
+	}
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_wake.notify_all();
+		for (std::thread& worker : _workers) {
+			worker.join();
+		}
+	}
+
+	size_t ThreadCount() const {
+		return _workers.size();
+	}
+
+	template <class _Fn>
+	auto Submit(_Fn&& function) -> std::future<decltype(function())> {
+		using result_type = decltype(function());
+		std::shared_ptr<std::packaged_task<result_type()>> task = std::make_shared<std::packaged_task<result_type()>>(std::forward<_Fn>(function));
+		std::future<result_type> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_tasks.emplace([task]() { (*task)(); });
+		}
+		_wake.notify_one();
+		return result;
+	}
+
+	/// <summary>
+	/// Calls function(begin, end) over [0, count) in chunks of 'grain', blocks until every chunk is done.
+	/// The calling thread takes chunks too, so nested calls from inside a task cannot deadlock.
+	/// The first exception thrown by a chunk is rethrown here.
+	/// </summary>
+	void Parallel_For(size_t count, size_t grain, std::function<void(size_t, size_t)> const& function) {
+		grain = std::max(grain, size_t(1));
+		size_t chunks = (count + grain - 1) / grain;
+		if (chunks == 0) {
+			return;
+		}
+		if (chunks == 1 || _workers.empty()) {
+			function(0, count);
+			return;
+		}
+
+		struct Shared {
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> finished{ 0 };
+			std::exception_ptr exception;
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+		std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+
+		auto run = [shared, chunks, count, grain, &function]() {
+			for (size_t chunk = shared->next++; chunk < chunks; chunk = shared->next++) {
+				try {
+					function(chunk * grain, std::min(count, (chunk + 1) * grain));
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(shared->mutex);
+					if (!shared->exception) {
+						shared->exception = std::current_exception();
+					}
+				}
+				if (++shared->finished == chunks) {
+					std::lock_guard<std::mutex> lock(shared->mutex);
+					shared->done.notify_all();
+				}
+			}
+		};
+
+		size_t helpers = std::min(_workers.size(), chunks - 1);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (size_t index = 0; index < helpers; ++index) {
+				_tasks.emplace(run);
+			}
+		}
+		_wake.notify_all();
+
+		run();
+		{
+			std::unique_lock<std::mutex> lock(shared->mutex);
+			shared->done.wait(lock, [&]() { return shared->finished.load() == chunks; });
+		}
+		if (shared->exception) {
+			std::rethrow_exception(shared->exception);
+		}
+	}
+};
+
+/// <summary>
+/// Pool used by loaders and per-frame jobs, created on first use.
+/// </summary>
+inline ThreadPool& Default_Thread_Pool() {
+	static ThreadPool pool;
+	return pool;
+}
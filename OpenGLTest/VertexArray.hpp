@@ -45,6 +45,8 @@ public:
 					glVertexArrayAttribLFormat(vertexArray.idVertexArray, attributeId, attribute.count, type, attribute.offset);
 					break;
 				}
+				// Attributes read from the binding of the format that describes them
+				glVertexArrayAttribBinding(vertexArray.idVertexArray, attributeId, idBinding);
 				idAttributes.push_back(attributeId);
 				++attributeId;
 			}
@@ -81,6 +83,8 @@ public:
 					glVertexArrayAttribLFormat(vertexArray.idVertexArray, attributeId, attribute.count, type, attribute.offset);
 					break;
 				}
+				// Attributes read from the binding of the format that describes them
+				glVertexArrayAttribBinding(vertexArray.idVertexArray, attributeId, idBinding);
 				idAttributes.push_back(attributeId);
 				++attributeId;
 			}
@@ -238,6 +242,10 @@ public:
 		return true;
 	}	
 
+	GLuint VertexArrayId() const {
+		return idVertexArray;
+	}
+
 	void Bind() const {
 		glBindVertexArray(idVertexArray);
 	}
@@ -0,0 +1,92 @@
+#version 450 core
+
+layout (local_size_x = 64) in;
+
+// Matches IndirectDraw::DrawElementsIndirectCommand
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+// Matches IndirectDraw::DrawData
+struct DrawData {
+	mat4 world;
+	uint material;
+	int layer;
+	vec4 uvTransform;
+};
+
+// Matches GpuCulling::CullBounds, visible draws of a group are packed from first on unless the group is ordered
+struct CullBounds {
+	vec3 center;
+	float radius;
+	vec3 extent;
+	uint group;
+	uint first;
+	uint ordered;
+};
+
+layout (std430, binding = 0) readonly buffer Candidates {
+	DrawCommand candidates[];
+};
+
+layout (std430, binding = 1) readonly buffer CandidateData {
+	DrawData candidateData[];
+};
+
+layout (std430, binding = 2) readonly buffer Bounds {
+	CullBounds bounds[];
+};
+
+layout (std430, binding = 3) writeonly buffer Commands {
+	DrawCommand commands[];
+};
+
+layout (std430, binding = 4) writeonly buffer Draws {
+	DrawData draws[];
+};
+
+// Visible draws of each group, the draw count of its glMultiDrawElementsIndirectCount. Ordered groups start at their full count
+layout (std430, binding = 5) buffer Counts {
+	uint counts[];
+};
+
+// Inward facing, a point p is inside when dot(xyz, p) + w >= 0
+uniform vec4 planes[6];
+uniform uint candidateCount;
+
+void main() {
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= candidateCount) {
+		return;
+	}
+	// Same test as Culling::Test_One, the box and sphere reach towards each plane is added to the center's distance
+	CullBounds box = bounds[index];
+	bool visible = true;
+	for (int plane = 0; plane < 6; ++plane) {
+		float distance = dot(box.center, planes[plane].xyz) + planes[plane].w + box.radius + dot(box.extent, abs(planes[plane].xyz));
+		if (distance < 0.0) {
+			visible = false;
+			break;
+		}
+	}
+	DrawCommand command = candidates[index];
+	// Blended groups keep their back to front order, a culled draw stays in its slot and draws no instances
+	if (box.ordered != 0u) {
+		command.instanceCount = visible ? command.instanceCount : 0u;
+		command.baseInstance = index;
+		commands[index] = command;
+		draws[index] = candidateData[index];
+		return;
+	}
+	if (!visible) {
+		return;
+	}
+	uint slot = box.first + atomicAdd(counts[box.group], 1u);
+	command.baseInstance = slot;
+	commands[slot] = command;
+	draws[slot] = candidateData[index];
+}
@@ -2,14 +2,40 @@
 
 in vec3 vertexColour;
 in vec2 TexCoord;
+// Layer of baseColorArray to sample, -1 for texture1, with the uv transform of the image in that layer
+flat in int textureLayer;
+flat in vec4 uvTransform;
 
 out vec4 fragColour;
 
 layout (binding = 0) uniform sampler2D texture1;
 layout (binding = 1) uniform sampler2D texture2;
-uniform float ratio;
+// Base colors packed by TextureAtlas, on a unit of their own as one unit cannot serve two sampler types
+layout (binding = 2) uniform sampler2DArray baseColorArray;
+// Written once per frame into a RingBuffer, matches FrameUniforms in Application.cpp
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 cameraPosition;
+	vec4 cameraOrientation;
+	vec4 modelPosition;
+	vec4 modelOrientation;
+	float ratio;
+};
 
 void main() {
-	fragColour = mix(texture(texture1, TexCoord), texture(texture2, vec2(TexCoord.x, TexCoord.y)), ratio);// * vec4(vertexColour, 1.0f);
+	vec4 baseColour;
+	if (textureLayer < 0) {
+		baseColour = texture(texture1, TexCoord);
+	}
+	else if (uvTransform == vec4(1.0, 1.0, 0.0, 0.0)) {
+		// A whole layer, the array's wrap mode applies
+		baseColour = texture(baseColorArray, vec3(TexCoord, float(textureLayer)));
+	}
+	else {
+		// Part of an atlas page, only clamped images are packed so and the clamp keeps neighbours out
+		baseColour = texture(baseColorArray, vec3(clamp(TexCoord, 0.0, 1.0) * uvTransform.xy + uvTransform.zw, float(textureLayer)));
+	}
+	fragColour = mix(baseColour, texture(texture2, vec2(TexCoord.x, TexCoord.y)), ratio);// * vec4(vertexColour, 1.0f);
 	//fragColour = vec4(vertexColour, 1.0f);
 };
\ No newline at end of file
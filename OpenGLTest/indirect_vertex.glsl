@@ -0,0 +1,45 @@
+#version 460 core
+
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 aColour;
+layout (location = 2) in vec2 aTexCoord;
+
+// Written once per frame into a RingBuffer, matches FrameUniforms in Application.cpp
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 cameraPosition;
+	vec4 cameraOrientation;
+	vec4 modelPosition;
+	vec4 modelOrientation;
+	float ratio;
+};
+
+// Matches IndirectDraw::DrawData, baseInstance of each indirect command is the index of its first element
+struct DrawData {
+	mat4 world;
+	uint material;
+	int layer;
+	vec4 uvTransform;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+	DrawData draws[];
+};
+
+out vec3 vertexColour;
+out vec2 TexCoord;
+flat out uint materialIndex;
+// Where fragment.glsl samples the batch texture, see IndirectDraw::BatchLayer
+flat out int textureLayer;
+flat out vec4 uvTransform;
+
+void main() {
+	DrawData draw = draws[gl_BaseInstance + gl_InstanceID];
+	gl_Position = projection * view * draw.world * vec4(vertexPosition, 1.0);
+	vertexColour = aColour;
+	TexCoord = aTexCoord;
+	materialIndex = draw.material;
+	textureLayer = draw.layer;
+	uvTransform = draw.uvTransform;
+}
@@ -0,0 +1,40 @@
+#version 460 core
+
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 aColour;
+layout (location = 2) in vec2 aTexCoord;
+// Matches Mesh::InstanceData, advanced once per instance
+layout (location = 3) in vec4 instanceOrientation;
+layout (location = 4) in vec3 instancePosition;
+layout (location = 5) in float instanceScale;
+
+// Written once per frame into a RingBuffer, matches FrameUniforms in Application.cpp
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 cameraPosition;
+	vec4 cameraOrientation;
+	vec4 modelPosition;
+	vec4 modelOrientation;
+	float ratio;
+};
+
+out vec3 vertexColour;
+out vec2 TexCoord;
+// Nothing here samples a texture array, see fragment.glsl
+flat out int textureLayer;
+flat out vec4 uvTransform;
+
+vec3 QuaternionRotate(const vec4 quaternion, const vec3 point) {
+	vec3 rotateOne = vec3(quaternion.w * point + cross(quaternion.xyz, point));
+	return vec3(quaternion.w * rotateOne.xyz + dot(quaternion.xyz, point) * quaternion.xyz + cross(quaternion.xyz, rotateOne.xyz));
+};
+
+void main() {
+	// Same transform as vertex.glsl with the instance in place of the model uniforms
+	gl_Position = projection * vec4(QuaternionRotate(cameraOrientation, QuaternionRotate(instanceOrientation, vertexPosition * instanceScale) + instancePosition - cameraPosition.xyz), 1.0);
+	vertexColour = aColour;
+	TexCoord = aTexCoord;
+	textureLayer = -1;
+	uvTransform = vec4(1.0, 1.0, 0.0, 0.0);
+}
@@ -10,10 +10,16 @@ layout (location = 0) in vec3 vertexPosition;
 layout (location = 1) in vec3 aColour;
 layout (location = 2) in vec2 aTexCoord;
 
-uniform vec3 modelPosition;
-uniform vec4 modelOrientation;
-uniform vec3 cameraPosition;
-uniform vec4 cameraOrientation;
+// Written once per frame into a RingBuffer, matches FrameUniforms in Application.cpp
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 cameraPosition;
+	vec4 cameraOrientation;
+	vec4 modelPosition;
+	vec4 modelOrientation;
+	float ratio;
+};
 //struct model {
 //	vec3 orientation;
 //	vec4 position;
@@ -24,11 +30,12 @@ uniform vec4 cameraOrientation;
 //};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 out vec3 vertexColour;
 out vec2 TexCoord;
+// Nothing here samples a texture array, see fragment.glsl
+flat out int textureLayer;
+flat out vec4 uvTransform;
 
 vec4 QuaternionConjugate(vec4 quaternion) {
 	return vec4(-quaternion.x, -quaternion.y, -quaternion.z, quaternion.w);
@@ -63,7 +70,9 @@ void main() {
 	//gl_Position = projection * vec4(QuaternionRotate(modelOrientation, vertexPosition) + modelPosition, 1.0);
 
 	// Note: Thre result of QuaternionRotate is NOT being cast to a quaternion, the w component in gl_Position is interpreted differently
-	gl_Position = projection * vec4(QuaternionRotate(cameraOrientation, QuaternionRotate(modelOrientation, vertexPosition * .01f) + modelPosition - cameraPosition), 1.0);
+	gl_Position = projection * vec4(QuaternionRotate(cameraOrientation, QuaternionRotate(modelOrientation, vertexPosition * .01f) + modelPosition.xyz - cameraPosition.xyz), 1.0);
 	//gl_Position = projection * vec4(QuaternionRotate(QuaternionMultiply(cameraOrientation, modelOrientation), vertexPosition) + QuaternionRotate(cameraOrientation, modelPosition + cameraPosition), 1.0);
 	TexCoord = aTexCoord;
+	textureLayer = -1;
+	uvTransform = vec4(1.0, 1.0, 0.0, 0.0);
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "Tests.hpp"
+#include "Bounds.hpp"
+#include "JsonParse.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// Meshes published by Streaming::DocumentStream::Resolve_Mesh_Ranges must get the min/max of their data, a document with wrong and missing bounds is written to the temp directory
+// Streaming.hpp itself includes stb_image.h through Ktx2.hpp, which only Ktx2Tests.cpp may include, so its two calls are made here directly
+
+// Mesh 0 reaches outside its declared [0, 1] box and its indices declare no bounds, mesh 1 is not published
+std::vector<unsigned char> Range_Document_Bytes() {
+	float const positions[2][9] = { { 0.0f, 0.0f, 0.0f, 2.0f, 3.0f, -1.0f, 1.0f, -4.0f, 5.0f }, { 1.0f, 1.0f, 1.0f, 2.0f, 2.0f, 2.0f, 3.0f, 3.0f, 3.0f } };
+	unsigned short const indices[4] = { 0, 1, 2, 0 };
+	std::vector<unsigned char> bytes(80);
+	std::memcpy(bytes.data(), positions[0], sizeof(positions[0]));
+	std::memcpy(bytes.data() + 36, indices, sizeof(indices));
+	std::memcpy(bytes.data() + 44, positions[1], sizeof(positions[1]));
+	return bytes;
+}
+
+GLTF::GLTFDoc Range_Document() {
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "AccessorRangeTests.gltf";
+	std::ofstream(path) << R"({
+	"asset": { "version": "2.0" },
+	"buffers": [ { "uri": "ranges.bin", "byteLength": 80 } ],
+	"bufferViews": [
+		{ "buffer": 0, "byteOffset": 0, "byteLength": 36 },
+		{ "buffer": 0, "byteOffset": 36, "byteLength": 6 },
+		{ "buffer": 0, "byteOffset": 44, "byteLength": 36 }
+	],
+	"accessors": [
+		{ "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 1, 1 ] },
+		{ "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" },
+		{ "bufferView": 2, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ -10, -10, -10 ], "max": [ 10, 10, 10 ] }
+	],
+	"meshes": [
+		{ "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 1 } ] },
+		{ "primitives": [ { "attributes": { "POSITION": 2 } } ] }
+	],
+	"nodes": [ { "mesh": 0 }, { "mesh": 1 } ],
+	"scenes": [ { "nodes": [ 0, 1 ] } ],
+	"scene": 0
+})";
+	std::shared_ptr<JsonParse::JsonObject> object = std::static_pointer_cast<JsonParse::JsonObject>(JsonParse::JsonReader::Parse_Json(path).first);
+	GLTF::Validator validate(object);
+	TEST_CHECK(validate.errors.empty());
+	return GLTF::GLTFDoc(object);
+}
+
+Tests::Register accessorRangeStreamedMesh("Accessor_Range_Streamed_Mesh", [] {
+	GLTF::GLTFDoc doc = Range_Document();
+	std::vector<unsigned char> bytes = Range_Document_Bytes();
+	std::vector<GLTF::BufferSpan> spans = { GLTF::BufferSpan(bytes) };
+
+	std::vector<GLTF::index_type> accessors = GLTF::Mesh_Accessors(doc.meshes[0]);
+	TEST_CHECK((accessors == std::vector<GLTF::index_type>{ 0, 1 }));
+	std::vector<GLTF::RangeStatus> status = GLTF::Resolve_Accessor_Ranges(doc, spans, accessors, Default_Thread_Pool());
+	TEST_CHECK((status == std::vector<GLTF::RangeStatus>{ GLTF::RangeStatus::Invalid, GLTF::RangeStatus::Missing }));
+	TEST_CHECK((doc.accessors[0].min == std::vector<GLTF::number_type>{ 0.0, -4.0, -1.0 }));
+	TEST_CHECK((doc.accessors[0].max == std::vector<GLTF::number_type>{ 2.0, 3.0, 5.0 }));
+	TEST_CHECK((doc.accessors[1].min == std::vector<GLTF::number_type>{ 0.0 } && doc.accessors[1].max == std::vector<GLTF::number_type>{ 2.0 }));
+	// Accessors of meshes not yet published keep their declared bounds
+	TEST_CHECK((doc.accessors[2].min == std::vector<GLTF::number_type>{ -10.0, -10.0, -10.0 }));
+
+	AABB bounds = GLTF::Mesh_Bounds(doc, spans, doc.meshes[0]);
+	TEST_CHECK(bounds.minimum == glm::vec3(0.0f, -4.0f, -1.0f) && bounds.maximum == glm::vec3(2.0f, 3.0f, 5.0f));
+	// Resolved bounds are exact from then on
+	status = GLTF::Resolve_Accessor_Ranges(doc, spans, accessors, Default_Thread_Pool());
+	TEST_CHECK((status == std::vector<GLTF::RangeStatus>{ GLTF::RangeStatus::Exact, GLTF::RangeStatus::Exact }));
+
+	// The wider declared box of mesh 1 is conservative and is tightened to the data
+	status = GLTF::Resolve_Accessor_Ranges(doc, spans, GLTF::Mesh_Accessors(doc.meshes[1]), Default_Thread_Pool());
+	TEST_CHECK((status == std::vector<GLTF::RangeStatus>{ GLTF::RangeStatus::Conservative }));
+	TEST_CHECK((doc.accessors[2].min == std::vector<GLTF::number_type>{ 1.0, 1.0, 1.0 } && doc.accessors[2].max == std::vector<GLTF::number_type>{ 3.0, 3.0, 3.0 }));
+});
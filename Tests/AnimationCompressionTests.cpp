@@ -0,0 +1,129 @@
+#include "Tests.hpp"
+#include "AnimationCompression.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Compressed clips must evaluate within the tolerances of CompressionSettings, key reduction and quantization together
+
+// A node per channel group, baked at 60 keys per second as exporters write them. Translations swing over 'reach' units.
+Animation::Clip Baked_Clip(unsigned nodes, float reach, std::mt19937& random) {
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+	Animation::Clip clip;
+	clip.duration = 10.0f;
+	for (unsigned node = 0; node < nodes; ++node) {
+		for (Animation::Path path : { Animation::Path::Translation, Animation::Path::Rotation, Animation::Path::Scale }) {
+			Animation::SamplerData sampler;
+			sampler.width = path == Animation::Path::Rotation ? 4 : 3;
+			sampler.interpolation = Animation::Interpolation::Linear;
+			float frequency[4];
+			float phase[4];
+			float amplitude[4];
+			for (unsigned component = 0; component < 4; ++component) {
+				frequency[component] = 0.2f + std::fabs(signedUnit(random));
+				phase[component] = signedUnit(random) * 3.0f;
+				amplitude[component] = signedUnit(random) * (path == Animation::Path::Translation ? reach : 1.0f);
+			}
+			for (unsigned key = 0; key <= 600; ++key) {
+				float time = key / 60.0f;
+				float value[4];
+				for (unsigned component = 0; component < 4; ++component) {
+					value[component] = amplitude[component] * std::sin(frequency[component] * time + phase[component]) + (path == Animation::Path::Scale ? 1.0f : 0.0f);
+				}
+				if (path == Animation::Path::Rotation) {
+					value[3] += 2.0f;
+					Animation::Normalize_Quaternion(value);
+				}
+				sampler.times.push_back(time);
+				sampler.values.insert(sampler.values.end(), value, value + sampler.width);
+			}
+			sampler.values.resize(sampler.values.size() + Animation::VALUE_PADDING, 0.0f);
+			clip.samplers.push_back(sampler);
+			clip.channels.push_back({ unsigned(clip.samplers.size() - 1), node, path });
+		}
+	}
+	return clip;
+}
+
+// Largest difference between the two clips over many times, per path
+void Clip_Error(Animation::Clip const& source, Animation::Clip const& compressed, unsigned nodes, std::mt19937& random, float error[3]) {
+	NodeTransforms sourceTransforms;
+	NodeTransforms compressedTransforms;
+	float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	for (unsigned node = 0; node < nodes; ++node) {
+		sourceTransforms.Add(identity, identity, identity);
+		compressedTransforms.Add(identity, identity, identity);
+	}
+	std::uniform_real_distribution<float> clipTime(0.0f, 10.0f);
+	Animation::Evaluator sourceEvaluator;
+	Animation::Evaluator compressedEvaluator;
+	error[0] = error[1] = error[2] = 0.0f;
+	for (int sample = 0; sample < 2000; ++sample) {
+		std::vector<Animation::Instance> sourceInstance{ Animation::Instance(source, 0) };
+		std::vector<Animation::Instance> compressedInstance{ Animation::Instance(compressed, 0) };
+		sourceInstance[0].time = compressedInstance[0].time = clipTime(random);
+		sourceEvaluator.Evaluate(sourceInstance, sourceTransforms);
+		compressedEvaluator.Evaluate(compressedInstance, compressedTransforms);
+		for (size_t index = 0; index < sourceTransforms.translation.size(); ++index) {
+			error[0] = std::max(error[0], std::fabs(sourceTransforms.translation[index] - compressedTransforms.translation[index]));
+			error[2] = std::max(error[2], std::fabs(sourceTransforms.scale[index] - compressedTransforms.scale[index]));
+		}
+		for (size_t node = 0; node < nodes; ++node) {
+			error[1] = std::max(error[1], Animation::Key_Error(&sourceTransforms.rotation[node * 4], &compressedTransforms.rotation[node * 4], 4, true));
+		}
+	}
+}
+
+Tests::Register compressionTolerance("Animation_Compression_Tolerance", [] {
+	std::mt19937 random(3);
+	unsigned const nodes = 20;
+	// Ranges where 16 bit steps fit the tolerance and ones far too large for them
+	for (float reach : { 1.0f, 100.0f }) {
+		Animation::Clip source = Baked_Clip(nodes, reach, random);
+		for (bool quantize : { false, true }) {
+			Animation::CompressionSettings settings;
+			settings.quantize = quantize;
+			Animation::Clip compressed = source;
+			Animation::CompressionStatistics statistics = Animation::Compress(compressed, settings);
+			TEST_CHECK(statistics.keysAfter < statistics.keysBefore);
+			TEST_CHECK(statistics.quantizedSamplers + statistics.floatSamplers == (quantize ? source.samplers.size() : 0));
+			float error[3];
+			Clip_Error(source, compressed, nodes, random, error);
+			// Interpolating between kept keys and float rounding of the evaluation add a little on top of the key error
+			TEST_CHECK(error[0] <= settings.translationTolerance * 1.05f + reach * 1e-6f);
+			TEST_CHECK(error[1] <= settings.rotationTolerance * 1.05f);
+			TEST_CHECK(error[2] <= settings.scaleTolerance * 1.05f);
+			if (quantize && reach > 13.0f) {
+				// A half step of a 100 unit range is 7.6e-4, translations must stay as floats
+				for (Animation::ChannelData const& channel : compressed.channels) {
+					if (channel.path == Animation::Path::Translation) {
+						TEST_CHECK(compressed.samplers[channel.sampler].encoding == Animation::Encoding::Float);
+					}
+				}
+			}
+		}
+	}
+	TEST_CHECK(!Animation::CompressionSettings().quantize);
+});
+
+Tests::Register quantizeBound("Animation_Quantize_Bound", [] {
+	Animation::SamplerData sampler;
+	sampler.width = 3;
+	for (unsigned key = 0; key < 100; ++key) {
+		sampler.times.push_back(float(key));
+		sampler.values.insert(sampler.values.end(), { key * 0.01f, key * 1.0f, 0.0f });
+	}
+	sampler.values.resize(sampler.values.size() + Animation::VALUE_PADDING, 0.0f);
+	// 99 units over 65535 steps is 7.6e-4 per step
+	Animation::SamplerData tight = sampler;
+	TEST_CHECK(!Animation::Quantize(tight, false, 1e-4f));
+	TEST_CHECK(tight.encoding == Animation::Encoding::Float && tight.values == sampler.values);
+	Animation::SamplerData loose = sampler;
+	TEST_CHECK(Animation::Quantize(loose, false, 1e-3f));
+	TEST_CHECK(loose.encoding == Animation::Encoding::Range16);
+	float decoded[4];
+	for (size_t key = 0; key < sampler.KeyCount(); ++key) {
+		Animation::Decode_Key(loose, key, decoded);
+		TEST_CHECK(Animation::Key_Error(decoded, sampler.Value(key), 3, false) <= 1e-3f);
+	}
+});
@@ -0,0 +1,228 @@
+#include "Tests.hpp"
+#include "BVH.hpp"
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// BVH queries must return what testing every box would, before and after a refit, built serially or on the pool
+
+// Small boxes scattered through a cube 'spread' across, a few large ones among them
+std::vector<AABB> Scattered_Boxes(std::mt19937& random, size_t count, float spread) {
+	std::uniform_real_distribution<float> position(-spread * 0.5f, spread * 0.5f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	std::vector<AABB> boxes;
+	for (size_t box = 0; box < count; ++box) {
+		glm::vec3 center(position(random), position(random), position(random));
+		glm::vec3 half = glm::vec3(size(random), size(random), size(random)) * (box % 100 == 0 ? 10.0f : 1.0f);
+		boxes.emplace_back(center - half, center + half);
+	}
+	return boxes;
+}
+
+// Same slab test as the BVH, entry is 0 from inside the box
+bool Box_Entry(AABB const& box, BVH::Ray const& ray, float& entry) {
+	glm::vec3 inverseDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+	float entryDistance = 0.0f;
+	float exitDistance = ray.maxDistance;
+	for (glm::length_t axis = 0; axis < 3; ++axis) {
+		float a = (box.minimum[axis] - ray.origin[axis]) * inverseDirection[axis];
+		float b = (box.maximum[axis] - ray.origin[axis]) * inverseDirection[axis];
+		entryDistance = std::max(entryDistance, std::min(a, b));
+		exitDistance = std::min(exitDistance, std::max(a, b));
+	}
+	entry = entryDistance;
+	return entryDistance <= exitDistance;
+}
+
+// Every primitive in exactly one leaf, every node inside its parent and every primitive inside its leaf
+bool Tree_Consistent(BVH const& tree, std::vector<AABB> const& boxes) {
+	std::vector<unsigned> seen(boxes.size(), 0);
+	auto contains = [](AABB const& outer, AABB const& inner) {
+		return glm::all(glm::lessThanEqual(outer.minimum, inner.minimum)) && glm::all(glm::greaterThanEqual(outer.maximum, inner.maximum));
+	};
+	for (size_t index = 0; index < tree.nodes.size(); ++index) {
+		BVH::Node const& node = tree.nodes[index];
+		if (node.Leaf()) {
+			for (unsigned entry = node.leftFirst; entry < node.leftFirst + node.count; ++entry) {
+				++seen[tree.indices[entry]];
+				if (!contains(node.Bounds(), boxes[tree.indices[entry]])) {
+					return false;
+				}
+			}
+			continue;
+		}
+		// Children follow their parent
+		if (node.leftFirst <= index || node.leftFirst + 1 >= tree.nodes.size()) {
+			return false;
+		}
+		if (!contains(node.Bounds(), tree.nodes[node.leftFirst].Bounds()) || !contains(node.Bounds(), tree.nodes[node.leftFirst + 1].Bounds())) {
+			return false;
+		}
+	}
+	return std::all_of(seen.begin(), seen.end(), [](unsigned count) { return count == 1; });
+}
+
+std::vector<Frustum> Random_Frustums(std::mt19937& random, size_t count, float spread) {
+	std::uniform_real_distribution<float> position(-spread * 0.5f, spread * 0.5f);
+	std::vector<Frustum> frustums;
+	for (size_t frustum = 0; frustum < count; ++frustum) {
+		glm::vec3 eye(position(random), position(random), position(random));
+		glm::vec3 target(position(random), position(random), position(random));
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, spread * 0.5f);
+		frustums.emplace_back(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+	return frustums;
+}
+
+std::vector<BVH::Ray> Random_Rays(std::mt19937& random, size_t count, float spread) {
+	std::uniform_real_distribution<float> position(-spread * 0.5f, spread * 0.5f);
+	std::vector<BVH::Ray> rays;
+	for (size_t ray = 0; ray < count; ++ray) {
+		BVH::Ray cast;
+		cast.origin = glm::vec3(position(random), position(random), position(random));
+		cast.direction = glm::normalize(glm::vec3(position(random), position(random), position(random)));
+		cast.maxDistance = ray % 2 ? spread : cast.maxDistance;
+		rays.emplace_back(cast);
+	}
+	return rays;
+}
+
+// Frustum queries may return boxes outside the frustum from leaves that are partly in it, but never miss one
+bool Queries_Match(BVH const& tree, std::vector<AABB> const& boxes, std::vector<Frustum> const& frustums, std::vector<AABB> const& regions, std::vector<BVH::Ray> const& rays) {
+	bool matches = true;
+	std::vector<unsigned> results;
+	for (Frustum const& frustum : frustums) {
+		results.clear();
+		tree.Query_Frustum(frustum, results);
+		std::vector<unsigned char> found(boxes.size(), 0);
+		for (unsigned primitive : results) {
+			found[primitive] = 1;
+		}
+		for (size_t box = 0; box < boxes.size(); ++box) {
+			unsigned mask = FRUSTUM_ALL_PLANES;
+			matches = matches && (found[box] || !frustum.Test(boxes[box], mask));
+		}
+	}
+	for (AABB const& region : regions) {
+		results.clear();
+		tree.Query_AABB(region, results, boxes.data());
+		std::sort(results.begin(), results.end());
+		std::vector<unsigned> expected;
+		for (unsigned box = 0; box < unsigned(boxes.size()); ++box) {
+			if (boxes[box].Overlaps(region)) {
+				expected.emplace_back(box);
+			}
+		}
+		matches = matches && results == expected;
+	}
+	for (BVH::Ray const& ray : rays) {
+		BVH::RayHit hit = tree.Ray_Cast_Bounds(ray, boxes.data());
+		float nearest = ray.maxDistance;
+		bool any = false;
+		for (AABB const& box : boxes) {
+			float entry;
+			if (Box_Entry(box, ray, entry) && entry < nearest) {
+				nearest = entry;
+				any = true;
+			}
+		}
+		// Ties may report either box, the distance is the same
+		matches = matches && (hit.primitive != unsigned(-1)) == any && (!any || hit.distance == nearest);
+	}
+	return matches;
+}
+
+Tests::Register bvhMatchesBruteForce("BVH_Matches_Brute_Force", [] {
+	std::mt19937 random(32);
+	float const spread = 400.0f;
+	// Enough boxes for the pool to build subtrees in parallel
+	std::vector<AABB> boxes = Scattered_Boxes(random, BVH::PARALLEL_MINIMUM + 3000, spread);
+	std::vector<Frustum> frustums = Random_Frustums(random, 20, spread);
+	std::vector<AABB> regions = Scattered_Boxes(random, 50, spread);
+	for (AABB& region : regions) {
+		region = AABB(region.Center() - glm::vec3(20.0f), region.Center() + glm::vec3(20.0f));
+	}
+	std::vector<BVH::Ray> rays = Random_Rays(random, 200, spread);
+
+	for (bool parallel : { false, true }) {
+		BVH tree;
+		tree.Build(boxes, parallel ? &Default_Thread_Pool() : nullptr);
+		TEST_CHECK(Tree_Consistent(tree, boxes));
+		TEST_CHECK(Queries_Match(tree, boxes, frustums, regions, rays));
+
+		// Batches give the single query results
+		std::vector<std::vector<unsigned>> batched;
+		tree.Query_Frustums(frustums.data(), frustums.size(), batched, Default_Thread_Pool());
+		std::vector<unsigned> single;
+		tree.Query_Frustum(frustums[3], single);
+		TEST_CHECK(batched.size() == frustums.size() && batched[3] == single);
+		std::vector<BVH::RayHit> hits(rays.size());
+		tree.Ray_Cast_Bounds_Batch(rays.data(), rays.size(), hits.data(), Default_Thread_Pool(), boxes.data());
+		bool same = true;
+		for (size_t ray = 0; ray < rays.size(); ++ray) {
+			BVH::RayHit hit = tree.Ray_Cast_Bounds(rays[ray], boxes.data());
+			same = same && hit.primitive == hits[ray].primitive && hit.distance == hits[ray].distance;
+		}
+		TEST_CHECK(same);
+
+		// Moved boxes are found again after a refit, the shape is kept
+		std::vector<AABB> moved = boxes;
+		std::uniform_real_distribution<float> drift(-5.0f, 5.0f);
+		for (AABB& box : moved) {
+			glm::vec3 offset(drift(random), drift(random), drift(random));
+			box = AABB(box.minimum + offset, box.maximum + offset);
+		}
+		size_t nodeCount = tree.nodes.size();
+		tree.Refit(moved.data());
+		TEST_CHECK(tree.nodes.size() == nodeCount && Tree_Consistent(tree, moved));
+		TEST_CHECK(Queries_Match(tree, moved, frustums, regions, rays));
+	}
+
+	// Nothing to build is an empty tree that finds nothing
+	BVH empty;
+	empty.Build(std::vector<AABB>());
+	std::vector<unsigned> results;
+	TEST_CHECK(empty.Empty() && empty.Query_Frustum(frustums[0], results) == 0 && empty.Ray_Cast_Bounds(rays[0], nullptr).primitive == unsigned(-1));
+});
+
+Tests::Register bvhBenchmark("BVH_Benchmark", [] {
+	std::mt19937 random(33);
+	float const spread = 2000.0f;
+	std::vector<AABB> boxes = Scattered_Boxes(random, 200000, spread);
+	std::vector<Frustum> frustums = Random_Frustums(random, 20, spread);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BVH tree;
+	tree.Build(boxes, &Default_Thread_Pool());
+	double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<unsigned> results;
+	start = std::chrono::steady_clock::now();
+	for (Frustum const& frustum : frustums) {
+		results.clear();
+		tree.Query_Frustum(frustum, results);
+	}
+	double queryMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(frustums.size());
+
+	size_t visible = 0;
+	start = std::chrono::steady_clock::now();
+	for (Frustum const& frustum : frustums) {
+		for (AABB const& box : boxes) {
+			unsigned mask = FRUSTUM_ALL_PLANES;
+			visible += frustum.Test(box, mask) ? 1 : 0;
+		}
+	}
+	double bruteMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(frustums.size());
+
+	start = std::chrono::steady_clock::now();
+	tree.Refit(boxes.data());
+	double refitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	TEST_CHECK(visible > 0);
+	// Timings are reported, not checked, they depend on the machine and the build
+	std::printf("  %zu boxes: build %.1f ms, frustum query %.3f ms against %.3f ms testing every box, refit %.2f ms, SAH cost %.1f\n",
+		boxes.size(), buildMilliseconds, queryMilliseconds, bruteMilliseconds, refitMilliseconds, tree.Cost());
+});
@@ -0,0 +1,104 @@
+#include "Tests.hpp"
+#include "BlockCompression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Every BC format must decode back to its source above a PSNR floor, the floors sit a little under what the encoders reach today
+
+// Smooth gradients with noise and a few hard edges, alpha follows its own gradient
+std::vector<unsigned char> Test_Rgba_Image(int width, int height) {
+	std::mt19937 random(40);
+	std::normal_distribution<float> noise(0.0f, 3.0f);
+	std::vector<unsigned char> pixels(size_t(width) * size_t(height) * 4);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			float u = float(x) / float(width);
+			float v = float(y) / float(height);
+			float values[4] = {
+				255.0f * u,
+				255.0f * (0.5f + 0.5f * std::sin(6.0f * u + 4.0f * v)),
+				((x / 16 + y / 16) % 2) ? 200.0f : 60.0f,
+				255.0f * v
+			};
+			for (int channel = 0; channel < 4; ++channel) {
+				float value = values[channel] + noise(random);
+				pixels[(size_t(y) * size_t(width) + size_t(x)) * 4 + size_t(channel)] = (unsigned char)std::min(255.0f, std::max(0.0f, std::round(value)));
+			}
+		}
+	}
+	return pixels;
+}
+
+// Channels [first, first + count) of an RGBA image
+std::vector<unsigned char> Extract_Channels(std::vector<unsigned char> const& rgba, int first, int count) {
+	std::vector<unsigned char> channels;
+	for (size_t pixel = 0; pixel < rgba.size() / 4; ++pixel) {
+		channels.insert(channels.end(), rgba.begin() + pixel * 4 + first, rgba.begin() + pixel * 4 + first + count);
+	}
+	return channels;
+}
+
+Tests::Register blockCompressionRoundTrip("Block_Compression_Round_Trip", [] {
+	// Not a multiple of the block size so the edge blocks repeat pixels
+	int const width = 70;
+	int const height = 37;
+	std::vector<unsigned char> rgba = Test_Rgba_Image(width, height);
+	struct Case {
+		BlockCompression::Format format;
+		int first;
+		int count;
+		// Decoded channels compared, BC1 alpha is not encoded
+		int compared;
+		double floor;
+		char const* name;
+	};
+	Case const cases[] = {
+		{ BlockCompression::Format::BC1, 0, 3, 3, 33.0, "BC1" },
+		{ BlockCompression::Format::BC3, 0, 4, 4, 34.0, "BC3" },
+		{ BlockCompression::Format::BC4, 1, 1, 1, 40.0, "BC4" },
+		{ BlockCompression::Format::BC5, 1, 2, 2, 42.0, "BC5" },
+		{ BlockCompression::Format::BC7, 0, 4, 4, 35.0, "BC7" }
+	};
+	for (Case const& test : cases) {
+		std::vector<unsigned char> source = Extract_Channels(rgba, test.first, test.count);
+		for (BlockCompression::Quality quality : { BlockCompression::Quality::Fast, BlockCompression::Quality::Normal, BlockCompression::Quality::High }) {
+			BlockCompression::CompressSettings settings;
+			settings.format = test.format;
+			settings.quality = quality;
+			settings.channel = test.first;
+			std::vector<unsigned char> compressed = BlockCompression::Compress(rgba.data(), width, height, 4, settings, quality == BlockCompression::Quality::Normal ? &Default_Thread_Pool() : nullptr);
+			TEST_CHECK(compressed.size() == BlockCompression::Level_Bytes(test.format, width, height));
+			std::vector<unsigned char> decoded = BlockCompression::Decompress(compressed.data(), width, height, test.format);
+			int decodedChannels = BlockCompression::Format_Channels(test.format);
+			std::vector<unsigned char> compared;
+			for (size_t pixel = 0; pixel < size_t(width) * size_t(height); ++pixel) {
+				compared.insert(compared.end(), decoded.begin() + pixel * decodedChannels, decoded.begin() + pixel * decodedChannels + test.compared);
+			}
+			double psnr = BlockCompression::Psnr(source.data(), compared.data(), source.size());
+			std::printf("  %s quality %d: %.2f dB\n", test.name, int(quality), psnr);
+			// Fast takes endpoints from the bounding box, it may fall up to 3 dB under the floor
+			TEST_CHECK(psnr >= test.floor - (quality == BlockCompression::Quality::Fast ? 3.0 : 0.0));
+		}
+	}
+});
+
+Tests::Register blockCompressionBc7Mode("Block_Compression_Bc7_Mode", [] {
+	// The mode is the lowest set bit of the first 7 bits, every block must be mode 6
+	// Flat blocks come back exactly when their channels share the parity one p-bit gives them
+	unsigned char const colours[2][4] = { { 200, 100, 50, 254 }, { 201, 101, 51, 255 } };
+	for (unsigned char const* colour : colours) {
+		std::vector<unsigned char> flat;
+		for (size_t pixel = 0; pixel < 8 * 8; ++pixel) {
+			flat.insert(flat.end(), colour, colour + 4);
+		}
+		std::vector<unsigned char> compressed = BlockCompression::Compress(flat.data(), 8, 8, 4, BlockCompression::CompressSettings());
+		for (size_t block = 0; block < compressed.size(); block += 16) {
+			TEST_CHECK((compressed[block] & 0x7f) == (1 << BlockCompression::BC7_MODE));
+		}
+		std::vector<unsigned char> decoded = BlockCompression::Decompress(compressed.data(), 8, 8, BlockCompression::Format::BC7);
+		TEST_CHECK(std::isinf(BlockCompression::Psnr(flat.data(), decoded.data(), flat.size())));
+	}
+});
@@ -0,0 +1,140 @@
+#include "Tests.hpp"
+#include "Culling.hpp"
+#include "GpuCulling.hpp"
+#include <GLAD\gl.h>
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// The compute pass of GpuCulling must keep exactly the draws Culling::Test_One keeps and transparent draws in their sorted order,
+// cull_compute.glsl is loaded from the working directory
+
+struct CullVertex {
+	float position[3];
+};
+
+GLuint Compile_Program(char const* vertexSource, char const* fragmentSource) {
+	GLuint program = glCreateProgram();
+	for (std::pair<GLenum, char const*> stage : { std::make_pair(GLenum(GL_VERTEX_SHADER), vertexSource), std::make_pair(GLenum(GL_FRAGMENT_SHADER), fragmentSource) }) {
+		GLuint shader = glCreateShader(stage.first);
+		glShaderSource(shader, 1, &stage.second, nullptr);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	glLinkProgram(program);
+	return program;
+}
+
+Tests::Register gpuCullingMatchesCpu("Gpu_Culling_Matches_Cpu", [] {
+	if (!GpuCulling::Supported()) {
+		std::printf("  skipped, draw counts from a buffer are not supported\n");
+		return;
+	}
+	// Draws land nowhere, only the commands the compute pass writes are checked
+	char const* vertexSource = "#version 450 core\nlayout (location = 0) in vec3 position;\nvoid main() { gl_Position = vec4(position, 1.0); }\n";
+	char const* fragmentSource = "#version 450 core\nout vec4 color;\nvoid main() { color = vec4(1.0); }\n";
+	GLuint programs[2] = { Compile_Program(vertexSource, fragmentSource), Compile_Program(vertexSource, fragmentSource) };
+
+	std::shared_ptr<BufferFormat> format = std::make_shared<BufferFormat>(alignof(CullVertex));
+	format->AddFloat(3);
+	size_t const drawCount = 5000;
+	std::vector<CullVertex> vertices(drawCount + 2, CullVertex{ { 0.0f, 0.0f, 0.0f } });
+	BufferArena arena(format, uint32_t(vertices.size()), 3);
+	size_t mesh = arena.Add(vertices, std::vector<unsigned int>{ 0, 1, 2 });
+	VertexArray vertexArray(format);
+	TEST_CHECK(arena.Bind(vertexArray, 0));
+	BufferArena::Range base = arena.MeshRange(mesh);
+
+	// Boxes around the frustum, some inside, some outside and some crossing its planes
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> spread(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> depth(-60.0f, 40.0f);
+	std::vector<AABB> boxes;
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	IndirectDraw::IndirectRenderer renderer;
+	renderer.Set_View(view, 0.1f, 100.0f);
+	for (size_t draw = 0; draw < drawCount; ++draw) {
+		glm::vec3 center(spread(random), spread(random), depth(random));
+		boxes.emplace_back(center - glm::vec3(0.5f), center + glm::vec3(0.5f));
+		// A quarter blend, their groups hold draws of the same state at neighbouring depths
+		RenderQueue::Pass pass = random() % 4 == 0 ? RenderQueue::Pass::Transparent : RenderQueue::Pass::Opaque;
+		IndirectDraw::GroupKey key{ programs[random() % 2], vertexArray.VertexArrayId(), uint32_t(random() % 2), pass };
+		// The base vertex tells the draws apart in the culled commands
+		BufferArena::Range range = base;
+		range.baseVertex = base.baseVertex + GLint(draw);
+		renderer.Add(key, range, glm::translate(glm::mat4(1.0f), center), uint32_t(draw), boxes.back());
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	Frustum frustum(projection * view);
+
+	// Its own target, the test window's default framebuffer may not be drawable
+	GLuint framebuffer;
+	GLuint renderbuffer;
+	glCreateFramebuffers(1, &framebuffer);
+	glCreateRenderbuffers(1, &renderbuffer);
+	glNamedRenderbufferStorage(renderbuffer, GL_RGBA8, 64, 64);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	RingBuffer frameData(1 << 20);
+	GpuCulling::GpuCuller culler;
+	frameData.BeginFrame();
+	TEST_CHECK(culler.Submit(renderer, frameData, frustum, [](uint32_t) {}));
+	frameData.EndFrame();
+	TEST_CHECK(glGetError() == GL_NO_ERROR);
+
+	Culling::BoundsSoA bounds;
+	bounds.Assign(boxes);
+	Culling::FrustumPlanes planes(frustum);
+	std::vector<bool> cpuVisible(drawCount);
+	size_t cpuCount = 0;
+	for (size_t draw = 0; draw < drawCount; ++draw) {
+		cpuVisible[draw] = Culling::Test_One(planes, bounds, draw);
+		cpuCount += cpuVisible[draw];
+	}
+	TEST_CHECK(cpuCount > 0 && cpuCount < drawCount);
+
+	std::vector<IndirectDraw::Group> const& groups = renderer.Groups();
+	std::vector<GLuint> counts = culler.Read_Counts(groups.size());
+	std::vector<IndirectDraw::DrawElementsIndirectCommand> commands = culler.Read_Commands(drawCount);
+	size_t gpuCount = 0;
+	size_t orderedDraws = 0;
+	for (size_t group = 0; group < groups.size(); ++group) {
+		if (RenderQueue::Depth_Leads(groups[group].key.pass)) {
+			// Every draw keeps its sorted slot, culled ones draw no instances
+			TEST_CHECK(counts[group] == groups[group].count);
+			for (size_t slot = groups[group].first; slot < groups[group].first + groups[group].count; ++slot) {
+				GLint draw = renderer.Sorted_Commands()[slot].baseVertex - base.baseVertex;
+				TEST_CHECK(commands[slot].baseVertex - base.baseVertex == draw && commands[slot].baseInstance == slot);
+				TEST_CHECK((commands[slot].instanceCount == 1) == cpuVisible[size_t(draw)] && commands[slot].instanceCount <= 1);
+				gpuCount += commands[slot].instanceCount;
+			}
+			orderedDraws += groups[group].count;
+			continue;
+		}
+		// Visible draws are packed from the group's first slot in any order, each names its slot as base instance
+		std::set<GLint> visible;
+		for (size_t slot = groups[group].first; slot < groups[group].first + counts[group]; ++slot) {
+			TEST_CHECK(commands[slot].baseInstance == slot && commands[slot].instanceCount == 1);
+			visible.insert(commands[slot].baseVertex - base.baseVertex);
+		}
+		TEST_CHECK(visible.size() == counts[group] && counts[group] <= groups[group].count);
+		for (size_t index = groups[group].first; index < groups[group].first + groups[group].count; ++index) {
+			GLint draw = renderer.Sorted_Commands()[index].baseVertex - base.baseVertex;
+			TEST_CHECK((visible.count(draw) != 0) == cpuVisible[size_t(draw)]);
+		}
+		gpuCount += counts[group];
+	}
+	TEST_CHECK(gpuCount == cpuCount);
+	TEST_CHECK(orderedDraws > 0 && orderedDraws < drawCount);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &renderbuffer);
+	glDeleteProgram(programs[0]);
+	glDeleteProgram(programs[1]);
+}, true);
@@ -0,0 +1,184 @@
+#include "Tests.hpp"
+#include "IndirectDraw.hpp"
+#include "RingBuffer.hpp"
+#include "Shader.hpp"
+#include <GLAD\gl.h>
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// IndirectRenderer::Sort orders draws by pass, state and depth, none of which touches GL.
+// Draws of packed images must sample their layer and region of the texture array, indirect_vertex.glsl and fragment.glsl are loaded from the working directory
+
+glm::mat4 At_Depth(float distance) {
+	return glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -distance));
+}
+
+Tests::Register indirectDrawOrder("Indirect_Draw_Order", [] {
+	IndirectDraw::IndirectRenderer renderer;
+	renderer.Set_View(glm::mat4(1.0f), 0.1f, 100.0f);
+	BufferArena::Range range;
+	// Names 65536 apart would have shared a group when keys kept only their low 16 bits
+	GLuint const programs[2] = { 7, 7 + 65536 };
+	IndirectDraw::GroupKey opaque{ programs[0], 1, 3 };
+	IndirectDraw::GroupKey opaqueOther{ programs[1], 1, 3 };
+	IndirectDraw::GroupKey blended{ programs[0], 1, 3, RenderQueue::Pass::Transparent };
+	IndirectDraw::GroupKey blendedOther{ programs[0], 1, 4, RenderQueue::Pass::Transparent };
+	// Material is the index the draw was added at
+	renderer.Add(blended, range, At_Depth(10.0f), 0);
+	renderer.Add(opaque, range, At_Depth(50.0f), 1);
+	renderer.Add(blendedOther, range, At_Depth(30.0f), 2);
+	renderer.Add(opaqueOther, range, At_Depth(5.0f), 3);
+	renderer.Add(opaque, range, At_Depth(20.0f), 4);
+	renderer.Add(blended, range, At_Depth(60.0f), 5);
+	renderer.Sort();
+
+	std::vector<uint32_t> order;
+	for (IndirectDraw::DrawData const& data : renderer.Sorted_Data()) {
+		order.push_back(data.material);
+	}
+	// Opaque draws by program and then front to back, blended ones back to front across their batches
+	TEST_CHECK((order == std::vector<uint32_t>{ 4, 1, 3, 5, 2, 0 }));
+	std::vector<IndirectDraw::Group> const& groups = renderer.Groups();
+	TEST_CHECK(groups.size() == 5);
+	TEST_CHECK(groups[0].key == opaque && groups[0].count == 2);
+	TEST_CHECK(groups[1].key == opaqueOther && groups[1].count == 1);
+	TEST_CHECK(groups[2].key == blended && groups[3].key == blendedOther && groups[4].key == blended);
+});
+
+// std140 layout of the Frame block, as FrameUniforms in Application.cpp
+struct AtlasFrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 cameraPosition;
+	glm::vec4 cameraOrientation;
+	glm::vec4 modelPosition;
+	glm::vec4 modelOrientation;
+	float ratio;
+	float padding[3];
+};
+
+// Position, colour and texture coordinates, the vertex layout of the arena meshes
+struct AtlasVertex {
+	float position[3];
+	float colour[3];
+	float texCoord[2];
+};
+
+Tests::Register indirectDrawAtlasLayer("Indirect_Draw_Atlas_Layer", [] {
+	if (!GLAD_GL_VERSION_4_6) {
+		std::printf("  skipped, the shaders are GLSL 4.60\n");
+		return;
+	}
+	GLsizei const size = 8;
+	GLuint target = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &target);
+	glTextureStorage2D(target, 1, GL_RGBA8, size, size);
+	GLuint framebuffer = 0;
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, target, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, size, size);
+
+	// Layer 0 red, layer 1 green on its left half and blue on its right, as an atlas page of two images
+	GLsizei const page = 16;
+	std::vector<unsigned char> texels(size_t(page) * size_t(page) * 4 * 2);
+	for (GLsizei layer = 0; layer < 2; ++layer) {
+		for (GLsizei y = 0; y < page; ++y) {
+			for (GLsizei x = 0; x < page; ++x) {
+				unsigned char* texel = texels.data() + ((size_t(layer) * page + y) * page + x) * 4;
+				texel[0] = layer == 0 ? 255 : 0;
+				texel[1] = layer == 1 && x < page / 2 ? 255 : 0;
+				texel[2] = layer == 1 && x >= page / 2 ? 255 : 0;
+				texel[3] = 255;
+			}
+		}
+	}
+	GLuint array = 0;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+	glTextureParameteri(array, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(array, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(array, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(array, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureStorage3D(array, 1, GL_RGBA8, page, page, 2);
+	glTextureSubImage3D(array, 0, 0, 0, 0, page, page, 2, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	// Yellow 2D texture for the draw that is not packed
+	unsigned char const yellow[4] = { 255, 255, 0, 255 };
+	GLuint plain = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &plain);
+	glTextureParameteri(plain, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureStorage2D(plain, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(plain, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, yellow);
+
+	// A quad over the left half of the screen and one over the right, texture coordinates 0 to 1 across each
+	std::shared_ptr<BufferFormat> format = std::make_shared<BufferFormat>(alignof(AtlasVertex));
+	format->AddFloat(3);
+	format->AddFloat(3);
+	format->AddFloat(2);
+	BufferArena arena(format, 8, 12);
+	std::vector<unsigned int> quad = { 0, 1, 2, 0, 2, 3 };
+	size_t halves[2];
+	for (int half = 0; half < 2; ++half) {
+		float left = half == 0 ? -1.0f : 0.0f;
+		std::vector<AtlasVertex> vertices = {
+			{ { left, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+			{ { left + 1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+			{ { left + 1.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+			{ { left, 1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } }
+		};
+		halves[half] = arena.Add(vertices, quad);
+	}
+	VertexArray vertexArray(format);
+	TEST_CHECK(arena.Bind(vertexArray, 0));
+
+	Shader shader("./indirect_vertex.glsl", "./fragment.glsl");
+	IndirectDraw::IndirectRenderer renderer;
+	// The left quad samples the right half of layer 1, coordinates outside 0 to 1 would clamp to it
+	IndirectDraw::BatchLayer packed;
+	packed.layer = 1;
+	packed.uvTransform = glm::vec4(0.5f, 1.0f, 0.5f, 0.0f);
+	renderer.Add({ shader.programId, vertexArray.VertexArrayId(), array }, arena.MeshRange(halves[0]), glm::mat4(1.0f), 0, packed);
+	renderer.Add({ shader.programId, vertexArray.VertexArrayId(), plain }, arena.MeshRange(halves[1]), glm::mat4(1.0f), 1);
+
+	RingBuffer frameData(1 << 16);
+	frameData.BeginFrame();
+	AtlasFrameUniforms uniforms{};
+	uniforms.view = glm::mat4(1.0f);
+	uniforms.projection = glm::mat4(1.0f);
+	frameData.BindUniform(0, frameData.Push(uniforms, frameData.UniformAlignment()));
+	// Arrays on unit 2, 2D textures on unit 0, as Application binds batches
+	bool submitted = renderer.Submit(frameData, [&](uint32_t batch) {
+		GLint batchTarget = GL_TEXTURE_2D;
+		glGetTextureParameteriv(batch, GL_TEXTURE_TARGET, &batchTarget);
+		glBindTextureUnit(batchTarget == GL_TEXTURE_2D_ARRAY ? 2 : 0, batch);
+	});
+	frameData.EndFrame();
+	TEST_CHECK(submitted);
+
+	std::vector<unsigned char> pixels(size_t(size) * size_t(size) * 4);
+	glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	bool left = true;
+	bool right = true;
+	for (GLsizei y = 0; y < size; ++y) {
+		for (GLsizei x = 0; x < size; ++x) {
+			unsigned char const* pixel = pixels.data() + (size_t(y) * size + x) * 4;
+			if (x < size / 2) {
+				left = left && pixel[0] == 0 && pixel[1] == 0 && pixel[2] == 255;
+			}
+			else {
+				right = right && pixel[0] == 255 && pixel[1] == 255 && pixel[2] == 0;
+			}
+		}
+	}
+	TEST_CHECK(left && right);
+	TEST_CHECK(glGetError() == GL_NO_ERROR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTextureUnit(0, 0);
+	glBindTextureUnit(2, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	GLuint const textures[3] = { target, array, plain };
+	glDeleteTextures(3, textures);
+}, true);
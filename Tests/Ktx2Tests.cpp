@@ -0,0 +1,51 @@
+#include "Tests.hpp"
+#include "Ktx2.hpp"
+#include <stdexcept>
+#include <vector>
+
+// Ktx2::File reads headers from disk caches and glTF files, malformed ones must throw instead of reading past the data
+
+// A 4x4 RGBA8 texture with its full chain of 3 levels
+Ktx2::Image Small_Image() {
+	Ktx2::Image image;
+	image.format = Ktx2::Raw_Vk_Format(4, false);
+	image.width = 4;
+	image.height = 4;
+	for (int level = 0; level < 3; ++level) {
+		image.levels.emplace_back(Ktx2::Level_Bytes(image.format, Mipmap::Level_Size(4, level), Mipmap::Level_Size(4, level)), (unsigned char)(level + 1));
+	}
+	return image;
+}
+
+bool Throws(std::vector<unsigned char> data) {
+	try {
+		Ktx2::File file(std::move(data));
+	}
+	catch (std::runtime_error const&) {
+		return true;
+	}
+	return false;
+}
+
+Tests::Register ktx2RoundTrip("Ktx2_Round_Trip", [] {
+	Ktx2::Image image = Small_Image();
+	for (Ktx2::Supercompression scheme : { Ktx2::Supercompression::None, Ktx2::Supercompression::Zlib }) {
+		Ktx2::File file(Ktx2::Serialize(image, scheme));
+		TEST_CHECK(file.Width() == 4 && file.Height() == 4 && file.Level_Count() == 3);
+		TEST_CHECK(file.To_Image().levels == image.levels);
+	}
+});
+
+Tests::Register ktx2LevelCount("Ktx2_Level_Count", [] {
+	std::vector<unsigned char> data = Ktx2::Serialize(Small_Image());
+	// levelCount follows the identifier and seven other header fields
+	size_t levelCountOffset = sizeof(Ktx2::IDENTIFIER) + 28;
+	// Room for the level index, so only the count itself is wrong
+	data.resize(data.size() + Ktx2::LEVEL_INDEX_BYTES * 64, 0);
+	for (uint32_t levels : { 4u, 33u, 40u, 1000u }) {
+		std::vector<unsigned char> broken = data;
+		Ktx2::Set_32(broken, levelCountOffset, levels);
+		TEST_CHECK(Throws(broken));
+	}
+	TEST_CHECK(!Throws(data));
+});
@@ -0,0 +1,68 @@
+#include "Tests.hpp"
+#include <GLAD\gl.h>
+#include <GLFW\glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+// Runs every registered test, or only those named on the command line, and exits with failure when any check fails
+
+// Tests that need OpenGL share one hidden 4.5 core window, a software driver such as Mesa llvmpipe is enough for them
+bool Create_Context() {
+	if (!glfwInit()) {
+		std::cerr << "GLFW Init Failed." << std::endl;
+		return false;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "Tests", NULL, NULL);
+	if (!window) {
+		std::cerr << "Failed to create GLFW window." << std::endl;
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGL()) {
+		std::cerr << "Failed to initialized GLAD." << std::endl;
+		return false;
+	}
+	std::cout << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER) << std::endl;
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<Tests::Test const*> selected;
+	for (Tests::Test const& test : Tests::Registry()) {
+		if (argc < 2 || std::find_if(argv + 1, argv + argc, [&](char const* name) { return test.name == name; }) != argv + argc) {
+			selected.push_back(&test);
+		}
+	}
+	bool context = false;
+	size_t failed = 0;
+	for (Tests::Test const* test : selected) {
+		if (test->needsContext && !context) {
+			context = Create_Context();
+			if (!context) {
+				return EXIT_FAILURE;
+			}
+		}
+		std::cout << test->name << std::endl;
+		Tests::Failures() = 0;
+		try {
+			test->run();
+		}
+		catch (std::exception const& exception) {
+			std::cout << "  threw " << exception.what() << std::endl;
+			++Tests::Failures();
+		}
+		if (Tests::Failures() != 0) {
+			++failed;
+		}
+	}
+	if (context) {
+		glfwTerminate();
+	}
+	std::cout << selected.size() - failed << " of " << selected.size() << " tests passed." << std::endl;
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,182 @@
+#include "Tests.hpp"
+#include "MeshoptEncoder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Round trips of MeshoptEncoder.hpp through MeshoptDecoder.hpp, the encoder exists to produce these fixtures
+
+// The triangle codec may rotate each triangle's corners, winding is kept
+template <class _Ty>
+bool Same_Triangles(std::vector<_Ty> const& decoded, std::vector<unsigned int> const& source) {
+	if (decoded.size() != source.size()) {
+		return false;
+	}
+	for (size_t index = 0; index < source.size(); index += 3) {
+		bool match = false;
+		for (size_t rotation = 0; rotation < 3; ++rotation) {
+			match |= decoded[index] == source[index + rotation] && decoded[index + 1] == source[index + (rotation + 1) % 3] && decoded[index + 2] == source[index + (rotation + 2) % 3];
+		}
+		if (!match) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Two triangles per cell of a size by size grid, the order a mesh exporter writes
+std::vector<unsigned int> Grid_Triangles(unsigned int size) {
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y < size; ++y) {
+		for (unsigned int x = 0; x < size; ++x) {
+			unsigned int corner = y * (size + 1) + x;
+			indices.insert(indices.end(), { corner, corner + size + 1, corner + 1, corner + 1, corner + size + 1, corner + size + 2 });
+		}
+	}
+	return indices;
+}
+
+Tests::Register vertexRoundTrip("Meshopt_Vertex_Round_Trip", [] {
+	std::mt19937 random(1);
+	for (size_t vertexSize : { 4, 8, 12, 16, 32, 36, 64, 256 }) {
+		for (size_t vertexCount : { 0, 1, 3, 15, 16, 17, 100, 257, 1000, 5000 }) {
+			// Half of each vertex changes slowly, like positions, the rest is noise
+			std::vector<unsigned char> vertices(vertexSize * vertexCount);
+			for (size_t index = 0; index < vertices.size(); ++index) {
+				vertices[index] = index % vertexSize < vertexSize / 2 ? (unsigned char)(index / vertexSize * 3 + random() % 3) : (unsigned char)random();
+			}
+			std::vector<unsigned char> encoded = Meshopt::Encode_Vertex_Buffer(vertices.data(), vertexCount, vertexSize);
+			TEST_CHECK(!encoded.empty() && encoded.size() <= Meshopt::Encode_Vertex_Buffer_Bound(vertexCount, vertexSize));
+			// The byte past the end catches writes outside the destination
+			std::vector<unsigned char> decoded(vertices.size() + 1, 0xCD);
+			TEST_CHECK(Meshopt::Decode_Vertex_Buffer(decoded.data(), vertexCount, vertexSize, encoded.data(), encoded.size()));
+			// data() of an empty vector may be null, which memcmp must not be given
+			TEST_CHECK(vertices.empty() || std::memcmp(decoded.data(), vertices.data(), vertices.size()) == 0);
+			TEST_CHECK(decoded.back() == 0xCD);
+			if (vertexCount > 0) {
+				TEST_CHECK(!Meshopt::Decode_Vertex_Buffer(decoded.data(), vertexCount, vertexSize, encoded.data(), encoded.size() - 1));
+			}
+		}
+	}
+});
+
+Tests::Register indexRoundTrip("Meshopt_Index_Round_Trip", [] {
+	for (unsigned int size : { 2, 10, 50, 300 }) {
+		std::vector<unsigned int> indices = Grid_Triangles(size);
+		size_t vertexCount = (size + 1) * (size + 1);
+		std::vector<unsigned char> triangles = Meshopt::Encode_Index_Buffer(indices.data(), indices.size(), vertexCount);
+		TEST_CHECK(!triangles.empty() && triangles.size() <= Meshopt::Encode_Index_Buffer_Bound(indices.size(), vertexCount));
+		std::vector<unsigned int> decoded(indices.size());
+		TEST_CHECK(Meshopt::Decode_Index_Buffer(decoded.data(), decoded.size(), sizeof(unsigned int), triangles.data(), triangles.size()));
+		TEST_CHECK(Same_Triangles(decoded, indices));
+		if (vertexCount <= 65536) {
+			std::vector<unsigned short> decodedShort(indices.size());
+			TEST_CHECK(Meshopt::Decode_Index_Buffer(decodedShort.data(), decodedShort.size(), sizeof(unsigned short), triangles.data(), triangles.size()));
+			TEST_CHECK(Same_Triangles(decodedShort, indices));
+		}
+		TEST_CHECK(!Meshopt::Decode_Index_Buffer(decoded.data(), decoded.size(), sizeof(unsigned int), triangles.data(), triangles.size() - 1));
+
+		std::vector<unsigned char> sequence = Meshopt::Encode_Index_Sequence(indices.data(), indices.size(), vertexCount);
+		TEST_CHECK(!sequence.empty() && sequence.size() <= Meshopt::Encode_Index_Sequence_Bound(indices.size(), vertexCount));
+		std::vector<unsigned int> decodedSequence(indices.size());
+		TEST_CHECK(Meshopt::Decode_Index_Sequence(decodedSequence.data(), decodedSequence.size(), sizeof(unsigned int), sequence.data(), sequence.size()));
+		TEST_CHECK(decodedSequence == indices);
+	}
+
+	// Scattered triangles miss the edge and vertex fifos, repeats of the first one hit them
+	std::mt19937 random(2);
+	for (int round = 0; round < 50; ++round) {
+		size_t vertexCount = 1 + random() % 100000;
+		std::vector<unsigned int> indices;
+		for (size_t triangle = random() % 500; triangle > 0; --triangle) {
+			if (random() % 20 == 0) {
+				indices.insert(indices.end(), { 0, 1, 2 });
+			}
+			else {
+				for (int corner = 0; corner < 3; ++corner) {
+					indices.push_back(static_cast<unsigned int>(random() % vertexCount));
+				}
+			}
+		}
+		vertexCount = std::max<size_t>(vertexCount, 3);
+		std::vector<unsigned char> triangles = Meshopt::Encode_Index_Buffer(indices.data(), indices.size(), vertexCount);
+		std::vector<unsigned int> decoded(indices.size());
+		TEST_CHECK(Meshopt::Decode_Index_Buffer(decoded.data(), decoded.size(), sizeof(unsigned int), triangles.data(), triangles.size()));
+		TEST_CHECK(Same_Triangles(decoded, indices));
+
+		std::vector<unsigned char> sequence = Meshopt::Encode_Index_Sequence(indices.data(), indices.size(), vertexCount);
+		std::vector<unsigned int> decodedSequence(indices.size());
+		TEST_CHECK(Meshopt::Decode_Index_Sequence(decodedSequence.data(), decodedSequence.size(), sizeof(unsigned int), sequence.data(), sequence.size()));
+		TEST_CHECK(decodedSequence == indices);
+	}
+});
+
+Tests::Register filterRoundTrip("Meshopt_Filter_Round_Trip", [] {
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+	for (size_t count : { 1, 3, 4, 7, 64 }) {
+		std::vector<float> normals(count * 4);
+		std::vector<float> rotations(count * 4);
+		std::vector<float> values(count * 3);
+		for (size_t element = 0; element < count; ++element) {
+			float normal[3] = { signedUnit(random), signedUnit(random), signedUnit(random) };
+			float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float rotation[4] = { signedUnit(random), signedUnit(random), signedUnit(random), signedUnit(random) };
+			float rotationLength = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+			for (size_t component = 0; component < 3; ++component) {
+				normals[element * 4 + component] = normal[component] / normalLength;
+				values[element * 3 + component] = signedUnit(random) * 1000.0f;
+			}
+			normals[element * 4 + 3] = 1.0f;
+			for (size_t component = 0; component < 4; ++component) {
+				rotations[element * 4 + component] = rotation[component] / rotationLength;
+			}
+		}
+
+		// 16 bit octahedral normals also go through the vertex codec, as a filtered attribute stream does
+		std::vector<short> octahedral(count * 4);
+		Meshopt::Encode_Octahedral_Filter(octahedral.data(), count, 8, 12, normals.data());
+		std::vector<unsigned char> encoded = Meshopt::Encode_Vertex_Buffer(octahedral.data(), count, 8);
+		std::vector<short> decoded(count * 4);
+		TEST_CHECK(Meshopt::Decode_Vertex_Buffer(decoded.data(), count, 8, encoded.data(), encoded.size()));
+		TEST_CHECK(Meshopt::Apply_Filter(Meshopt::Filter::Octahedral, decoded.data(), count, 8));
+		for (size_t index = 0; index < count * 4; index += 4) {
+			for (size_t component = 0; component < 3; ++component) {
+				TEST_CHECK(std::fabs(decoded[index + component] / 32767.0f - normals[index + component]) < 0.01f);
+			}
+		}
+
+		std::vector<signed char> octahedralByte(count * 4);
+		Meshopt::Encode_Octahedral_Filter(octahedralByte.data(), count, 4, 8, normals.data());
+		TEST_CHECK(Meshopt::Apply_Filter(Meshopt::Filter::Octahedral, octahedralByte.data(), count, 4));
+		for (size_t index = 0; index < count * 4; index += 4) {
+			for (size_t component = 0; component < 3; ++component) {
+				TEST_CHECK(std::fabs(octahedralByte[index + component] / 127.0f - normals[index + component]) < 0.05f);
+			}
+		}
+
+		// q and -q are the same rotation so only the size of the dot product is compared
+		std::vector<short> quaternions(count * 4);
+		Meshopt::Encode_Quaternion_Filter(quaternions.data(), count, 12, rotations.data());
+		TEST_CHECK(Meshopt::Apply_Filter(Meshopt::Filter::Quaternion, quaternions.data(), count, 8));
+		for (size_t index = 0; index < count * 4; index += 4) {
+			float dot = 0.0f;
+			for (size_t component = 0; component < 4; ++component) {
+				dot += quaternions[index + component] / 32767.0f * rotations[index + component];
+			}
+			TEST_CHECK(std::fabs(std::fabs(dot) - 1.0f) < 0.01f);
+		}
+
+		std::vector<unsigned int> exponential(count * 3);
+		Meshopt::Encode_Exponential_Filter(exponential.data(), count, 12, 15, values.data());
+		TEST_CHECK(Meshopt::Apply_Filter(Meshopt::Filter::Exponential, exponential.data(), count, 12));
+		for (size_t index = 0; index < count * 3; ++index) {
+			float value;
+			std::memcpy(&value, &exponential[index], sizeof(float));
+			TEST_CHECK(std::fabs(value - values[index]) <= std::fabs(values[index]) * 1e-3f);
+		}
+	}
+	TEST_CHECK(!Meshopt::Apply_Filter(Meshopt::Filter::Quaternion, nullptr, 0, 4));
+});
@@ -0,0 +1,238 @@
+#include "Tests.hpp"
+#include "Mipmap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Mipmap levels must be the filtered level above in linear space, the same whichever SIMD path or thread count built them
+
+std::vector<unsigned char> Random_Mip_Image(std::mt19937& random, int width, int height, int channels) {
+	std::vector<unsigned char> pixels(size_t(width) * size_t(height) * size_t(channels));
+	for (unsigned char& value : pixels) {
+		value = (unsigned char)(random() % 256);
+	}
+	return pixels;
+}
+
+// Fraction of stored pixels that pass an alpha test at 'cutoff'
+float Stored_Coverage(std::vector<unsigned char> const& pixels, float cutoff) {
+	size_t covered = 0;
+	for (size_t alpha = 3; alpha < pixels.size(); alpha += 4) {
+		covered += float(pixels[alpha]) / 255.0f > cutoff;
+	}
+	return float(covered) / float(pixels.size() / 4);
+}
+
+Tests::Register mipmapBoxAverage("Mipmap_Box_Average", [] {
+	TEST_CHECK(Mipmap::Level_Count(8, 6) == 4 && Mipmap::Level_Count(1, 1) == 1 && Mipmap::Level_Count(5, 3) == 3 && Mipmap::Level_Count(1, 1024) == 11);
+	TEST_CHECK(Mipmap::Level_Size(5, 1) == 2 && Mipmap::Level_Size(5, 2) == 1 && Mipmap::Level_Size(5, 7) == 1);
+
+	// Halving an even size averages each 2x2 block, rounded to the nearest byte, ties may go either way
+	std::mt19937 random(39);
+	int const width = 16;
+	int const height = 12;
+	for (int channels = 1; channels <= 4; ++channels) {
+		std::vector<unsigned char> pixels = Random_Mip_Image(random, width, height, channels);
+		std::vector<std::vector<unsigned char>> levels = Mipmap::Generate(pixels.data(), width, height, channels, Mipmap::MipSettings());
+		TEST_CHECK(int(levels.size()) == Mipmap::Level_Count(width, height) - 1);
+		bool sized = true;
+		for (size_t level = 0; level < levels.size(); ++level) {
+			sized = sized && levels[level].size() == size_t(Mipmap::Level_Size(width, int(level) + 1) * Mipmap::Level_Size(height, int(level) + 1) * channels);
+		}
+		TEST_CHECK(sized);
+
+		bool averaged = true;
+		for (int y = 0; y < height / 2; ++y) {
+			for (int x = 0; x < width / 2; ++x) {
+				for (int channel = 0; channel < channels; ++channel) {
+					int sum = 0;
+					for (int corner = 0; corner < 4; ++corner) {
+						sum += pixels[(size_t(y * 2 + corner / 2) * width + size_t(x * 2 + corner % 2)) * channels + channel];
+					}
+					int value = levels[0][(size_t(y) * (width / 2) + size_t(x)) * channels + channel];
+					averaged = averaged && (sum % 4 == 2 ? value == sum / 4 || value == sum / 4 + 1 : value == (sum + 2) / 4);
+				}
+			}
+		}
+		TEST_CHECK(averaged);
+	}
+
+	bool threw = false;
+	try {
+		Mipmap::Generate(nullptr, 4, 4, 5, Mipmap::MipSettings());
+	}
+	catch (std::runtime_error const&) {
+		threw = true;
+	}
+	TEST_CHECK(threw);
+});
+
+Tests::Register mipmapSrgbFiltering("Mipmap_Srgb_Filtering", [] {
+	// Half black and half white is half the light, which sRGB stores as 188 rather than 128
+	int const size = 32;
+	std::vector<unsigned char> checker(size_t(size) * size * 4);
+	for (int pixel = 0; pixel < size * size; ++pixel) {
+		unsigned char value = (pixel % size + pixel / size) % 2 ? 255 : 0;
+		std::fill(checker.begin() + pixel * 4, checker.begin() + pixel * 4 + 3, value);
+		checker[size_t(pixel) * 4 + 3] = 255;
+	}
+	for (bool srgb : { true, false }) {
+		Mipmap::MipSettings settings;
+		settings.srgb = srgb;
+		std::vector<std::vector<unsigned char>> levels = Mipmap::Generate(checker.data(), size, size, 4, settings);
+		bool grey = true;
+		for (std::vector<unsigned char> const& level : levels) {
+			for (size_t index = 0; index < level.size(); ++index) {
+				grey = grey && level[index] == (index % 4 == 3 ? 255 : srgb ? 188 : 128);
+			}
+		}
+		TEST_CHECK(grey);
+	}
+
+	// Every byte survives the sRGB decode and encode tables, so flat images stay flat through every filter
+	bool roundTrip = true;
+	for (int value = 0; value < 256; ++value) {
+		unsigned char byte = (unsigned char)value;
+		roundTrip = roundTrip && Mipmap::From_Linear(Mipmap::To_Linear(&byte, 1, 1, true), 1, true)[0] == byte;
+	}
+	TEST_CHECK(roundTrip);
+	for (Mipmap::Filter filter : { Mipmap::Filter::Box, Mipmap::Filter::Kaiser, Mipmap::Filter::Lanczos }) {
+		for (bool srgb : { true, false }) {
+			// Odd sizes fold filter taps into the edges
+			int const width = 37;
+			int const height = 11;
+			std::vector<unsigned char> flat(size_t(width) * height * 3, 77);
+			Mipmap::MipSettings settings;
+			settings.filter = filter;
+			settings.srgb = srgb;
+			bool constant = true;
+			for (std::vector<unsigned char> const& level : Mipmap::Generate(flat.data(), width, height, 3, settings)) {
+				constant = constant && std::all_of(level.begin(), level.end(), [](unsigned char value) { return value == 77; });
+			}
+			TEST_CHECK(constant);
+		}
+	}
+});
+
+Tests::Register mipmapSimdMatchesScalar("Mipmap_Simd_Matches_Scalar", [] {
+	// The kernels against plain loops, lengths around both vector widths so the tails are covered
+	std::mt19937 random(40);
+	std::uniform_real_distribution<float> value(0.0f, 1.0f);
+	float const tolerance = 1e-6f;
+	bool rowsMatch = true;
+	for (size_t length = 0; length < 40; ++length) {
+		for (int taps : { 1, 2, 7 }) {
+			std::vector<std::vector<float>> source(size_t(taps), std::vector<float>(length, 0.0f));
+			std::vector<float const*> rows;
+			std::vector<float> weights;
+			for (std::vector<float>& row : source) {
+				std::generate(row.begin(), row.end(), [&] { return value(random); });
+				rows.emplace_back(row.data());
+				weights.emplace_back(value(random) - 0.25f);
+			}
+			std::vector<float> destination(length);
+			Mipmap::Weighted_Row_Sum(rows.data(), weights.data(), taps, destination.data(), length);
+			for (size_t index = 0; index < length; ++index) {
+				float expected = 0.0f;
+				for (int tap = 0; tap < taps; ++tap) {
+					expected += weights[size_t(tap)] * source[size_t(tap)][index];
+				}
+				rowsMatch = rowsMatch && std::abs(destination[index] - expected) <= tolerance;
+			}
+		}
+	}
+	TEST_CHECK(rowsMatch);
+
+	bool filtered = true;
+	for (int channels = 1; channels <= 4; ++channels) {
+		for (Mipmap::Filter filter : { Mipmap::Filter::Box, Mipmap::Filter::Kaiser, Mipmap::Filter::Lanczos }) {
+			int const width = 45;
+			int const destinationWidth = 22;
+			Mipmap::Taps taps = Mipmap::Filter_Taps(width, destinationWidth, filter);
+			std::vector<float> source(size_t(width) * channels);
+			std::generate(source.begin(), source.end(), [&] { return value(random); });
+			std::vector<float> destination(size_t(destinationWidth) * channels);
+			Mipmap::Filter_Row(source.data(), taps, destinationWidth, channels, destination.data());
+			for (int pixel = 0; pixel < destinationWidth; ++pixel) {
+				// Every window reads inside the row and its weights sum to one
+				float total = 0.0f;
+				filtered = filtered && taps.first[pixel] >= 0 && taps.first[pixel] + taps.count <= width;
+				for (int channel = 0; channel < channels; ++channel) {
+					float expected = 0.0f;
+					for (int tap = 0; tap < taps.count; ++tap) {
+						float weight = taps.weights[size_t(pixel) * taps.count + tap];
+						expected += weight * source[size_t(taps.first[pixel] + tap) * channels + channel];
+						total += channel == 0 ? weight : 0.0f;
+					}
+					filtered = filtered && std::abs(destination[size_t(pixel) * channels + channel] - expected) <= tolerance;
+				}
+				filtered = filtered && std::abs(total - 1.0f) <= 1e-5f;
+			}
+		}
+	}
+	TEST_CHECK(filtered);
+
+	// Rows split across the pool give the serial chain byte for byte
+	std::vector<unsigned char> pixels = Random_Mip_Image(random, 300, 200, 4);
+	Mipmap::MipSettings settings;
+	settings.filter = Mipmap::Filter::Kaiser;
+	settings.srgb = true;
+	TEST_CHECK(Mipmap::Generate(pixels.data(), 300, 200, 4, settings) == Mipmap::Generate(pixels.data(), 300, 200, 4, settings, &Default_Thread_Pool()));
+});
+
+Tests::Register mipmapAlphaCoverage("Mipmap_Alpha_Coverage", [] {
+	// Fine alpha detail, as on foliage, blurs towards its mean so the levels thin out at a high cutoff unless alpha is rescaled
+	int const size = 256;
+	float const cutoff = 0.75f;
+	std::vector<unsigned char> pixels(size_t(size) * size * 4, 200);
+	for (int pixel = 0; pixel < size * size; ++pixel) {
+		float detail = std::sin(float(pixel % size) * 0.9f) * std::sin(float(pixel / size) * 1.3f);
+		pixels[size_t(pixel) * 4 + 3] = (unsigned char)std::lround(255.0f * (0.5f + 0.5f * detail));
+	}
+	float coverage = Stored_Coverage(pixels, cutoff);
+
+	Mipmap::MipSettings settings;
+	std::vector<std::vector<unsigned char>> plain = Mipmap::Generate(pixels.data(), size, size, 4, settings);
+	settings.alphaCutoff = cutoff;
+	std::vector<std::vector<unsigned char>> preserved = Mipmap::Generate(pixels.data(), size, size, 4, settings);
+	// Down to 16x16, below that a level has too few pixels to match the top closely
+	bool kept = true;
+	bool thinned = false;
+	for (size_t level = 0; level < 4; ++level) {
+		kept = kept && std::abs(Stored_Coverage(preserved[level], cutoff) - coverage) < 0.02f;
+		thinned = thinned || std::abs(Stored_Coverage(plain[level], cutoff) - coverage) > 0.1f;
+	}
+	TEST_CHECK(kept && thinned);
+	// Colour is not touched by the alpha scale
+	bool colour = true;
+	for (size_t level = 0; level < plain.size(); ++level) {
+		for (size_t index = 0; index < plain[level].size(); ++index) {
+			colour = colour && (index % 4 == 3 || plain[level][index] == preserved[level][index]);
+		}
+	}
+	TEST_CHECK(colour);
+});
+
+Tests::Register mipmapBenchmark("Mipmap_Benchmark", [] {
+	std::mt19937 random(42);
+	int const size = 2048;
+	std::vector<unsigned char> pixels = Random_Mip_Image(random, size, size, 4);
+	Mipmap::MipSettings settings;
+	settings.srgb = true;
+	for (Mipmap::Filter filter : { Mipmap::Filter::Box, Mipmap::Filter::Kaiser }) {
+		settings.filter = filter;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<std::vector<unsigned char>> serial = Mipmap::Generate(pixels.data(), size, size, 4, settings);
+		double serialMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		start = std::chrono::steady_clock::now();
+		std::vector<std::vector<unsigned char>> pooled = Mipmap::Generate(pixels.data(), size, size, 4, settings, &Default_Thread_Pool());
+		double pooledMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		TEST_CHECK(serial == pooled);
+		// Timings are reported, not checked, they depend on the machine and the build
+		std::printf("  %dx%d sRGB chain, %s filter: %.1f ms serial, %.1f ms on the pool\n", size, size, filter == Mipmap::Filter::Box ? "box" : "Kaiser", serialMilliseconds, pooledMilliseconds);
+	}
+});
@@ -0,0 +1,203 @@
+#include "Tests.hpp"
+#include "Morph.hpp"
+#include <GLAD\gl.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Sparse morph blending must match base + sum(weight * dense delta), and only the affected vertex ranges may change or be uploaded
+
+struct DenseMorph {
+	Morph::MorphMesh mesh;
+	// Per target, the dense deltas the sparse target was built from
+	std::vector<std::vector<float>> deltas[Morph::StreamCount];
+};
+
+DenseMorph Random_Morph_Mesh(std::mt19937& random, size_t vertexCount, size_t targetCount) {
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	DenseMorph morph;
+	morph.mesh.vertexCount = vertexCount;
+	for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+		for (size_t index = 0; index < vertexCount * Morph::STREAM_WIDTH[stream]; ++index) {
+			morph.mesh.base[stream].emplace_back(coordinate(random));
+		}
+	}
+	for (size_t target = 0; target < targetCount; ++target) {
+		std::vector<float> dense[Morph::StreamCount];
+		for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+			// Odd targets leave the tangents alone
+			if (stream == Morph::Tangent && target % 2) {
+				continue;
+			}
+			dense[stream].assign(vertexCount * Morph::STREAM_WIDTH[stream], 0.0f);
+		}
+		// A few clusters of moving vertices with still vertices inside them
+		for (size_t cluster = 0; cluster < 3; ++cluster) {
+			size_t first = random() % vertexCount;
+			size_t last = std::min(vertexCount, first + 1 + random() % 40);
+			for (size_t vertex = first; vertex < last; ++vertex) {
+				if (random() % 4 == 0) {
+					continue;
+				}
+				for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+					unsigned width = Morph::STREAM_WIDTH[stream];
+					for (size_t component = 0; component < width && !dense[stream].empty(); ++component) {
+						dense[stream][vertex * width + component] = coordinate(random);
+					}
+				}
+			}
+		}
+		morph.mesh.Add_Target(dense);
+		for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+			morph.deltas[stream].emplace_back(dense[stream]);
+		}
+	}
+	return morph;
+}
+
+float Morph_Difference(DenseMorph const& morph, std::vector<float> const& weights, Morph::MorphOutput const& output) {
+	float difference = 0.0f;
+	for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+		std::vector<float> expected = morph.mesh.base[stream];
+		for (size_t target = 0; target < weights.size(); ++target) {
+			if (morph.deltas[stream][target].empty() || std::fabs(weights[target]) < Morph::Settings().weightEpsilon) {
+				continue;
+			}
+			for (size_t index = 0; index < expected.size(); ++index) {
+				expected[index] += weights[target] * morph.deltas[stream][target][index];
+			}
+		}
+		for (size_t index = 0; index < expected.size(); ++index) {
+			difference = std::max(difference, std::abs(output.streams[stream][index] - expected[index]));
+		}
+	}
+	return difference;
+}
+
+bool Dirty_Ranges_Are_Affected(Morph::MorphMesh const& mesh, Morph::MorphOutput const& output) {
+	if (output.dirtyRanges.size() != mesh.affected.size()) {
+		return false;
+	}
+	for (size_t run = 0; run < mesh.affected.size(); ++run) {
+		if (output.dirtyRanges[run].first != mesh.affected[run].firstVertex || output.dirtyRanges[run].second != mesh.affected[run].vertexCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+Tests::Register morphBuildRuns("Morph_Build_Runs", [] {
+	// Gaps of 2 and 3 still vertices with a merge gap of 2, then a flagged last vertex
+	std::vector<bool> flagged = { false, true, true, false, false, true, false, false, false, true, true, false, true };
+	std::vector<Morph::Run> runs = Morph::MorphMesh::Build_Runs(flagged, 2);
+	TEST_CHECK(runs.size() == 2);
+	TEST_CHECK(runs[0].firstVertex == 1 && runs[0].vertexCount == 5 && runs[0].deltaOffset == 0);
+	TEST_CHECK(runs[1].firstVertex == 9 && runs[1].vertexCount == 4 && runs[1].deltaOffset == 5);
+	TEST_CHECK(Morph::MorphMesh::Build_Runs(std::vector<bool>(7, false), 2).empty());
+
+	// Deltas of a target are its runs packed back to back
+	std::mt19937 random(30);
+	DenseMorph morph = Random_Morph_Mesh(random, 300, 4);
+	for (size_t target = 0; target < morph.mesh.targets.size(); ++target) {
+		Morph::SparseTarget const& sparse = morph.mesh.targets[target];
+		unsigned offset = 0;
+		for (Morph::Run const& run : sparse.runs) {
+			TEST_CHECK(run.deltaOffset == offset);
+			offset += run.vertexCount;
+			for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+				unsigned width = Morph::STREAM_WIDTH[stream];
+				if (sparse.deltas[stream].empty()) {
+					continue;
+				}
+				TEST_CHECK(std::equal(sparse.deltas[stream].begin() + size_t(run.deltaOffset) * width, sparse.deltas[stream].begin() + size_t(run.deltaOffset + run.vertexCount) * width,
+					morph.deltas[stream][target].begin() + size_t(run.firstVertex) * width));
+			}
+		}
+		for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+			TEST_CHECK(sparse.deltas[stream].size() == (morph.deltas[stream][target].empty() ? 0 : offset * Morph::STREAM_WIDTH[stream]));
+		}
+	}
+});
+
+Tests::Register morphBlendMatchesDense("Morph_Blend_Matches_Dense", [] {
+	std::mt19937 random(31);
+	size_t const targetCount = 6;
+	DenseMorph morph = Random_Morph_Mesh(random, 2000, targetCount);
+	TEST_CHECK(!morph.mesh.affected.empty());
+	std::uniform_real_distribution<float> weight(-1.0f, 1.0f);
+
+	Morph::MorphOutput output;
+	std::vector<float> weights(targetCount, 0.0f);
+	Morph::Statistics statistics = Morph::Blend(morph.mesh, weights.data(), weights.size(), output);
+	// The first blend writes everything
+	TEST_CHECK(output.dirtyRanges.size() == 1 && output.dirtyRanges[0].first == 0 && output.dirtyRanges[0].second == morph.mesh.vertexCount);
+	TEST_CHECK(statistics.targetsBlended == 0 && statistics.targetsSkipped == targetCount);
+	TEST_CHECK(Morph_Difference(morph, weights, output) == 0.0f);
+
+	for (size_t frame = 0; frame < 20; ++frame) {
+		for (float& value : weights) {
+			value = weight(random);
+		}
+		// Targets go back to zero, or below the epsilon, and must leave no trace
+		weights[frame % targetCount] = 0.0f;
+		weights[(frame + 3) % targetCount] = frame % 2 ? 0.0f : 1e-6f;
+		if (frame % 5 == 4) {
+			std::fill(weights.begin(), weights.end(), 0.0f);
+		}
+		statistics = Morph::Blend(morph.mesh, weights.data(), weights.size(), output);
+		TEST_CHECK(Morph_Difference(morph, weights, output) < 1e-5f);
+		TEST_CHECK(Dirty_Ranges_Are_Affected(morph.mesh, output));
+		TEST_CHECK(statistics.targetsBlended + statistics.targetsSkipped == targetCount);
+
+		// Unchanged weights are not blended again
+		std::vector<float> before = output.streams[Morph::Position];
+		statistics = Morph::Blend(morph.mesh, weights.data(), weights.size(), output);
+		TEST_CHECK(statistics.targetsBlended == 0 && statistics.targetsSkipped == 0 && statistics.verticesWritten == 0);
+		TEST_CHECK(output.dirtyRanges.empty() && output.streams[Morph::Position] == before);
+	}
+});
+
+Tests::Register morphUploadDirtyRanges("Morph_Upload_Dirty_Ranges", [] {
+	std::mt19937 random(32);
+	size_t const targetCount = 3;
+	DenseMorph morph = Random_Morph_Mesh(random, 1500, targetCount);
+	float const sentinel = -7.0f;
+
+	GLuint buffers[Morph::StreamCount];
+	glCreateBuffers(Morph::StreamCount, buffers);
+	for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+		std::vector<float> filled(morph.mesh.vertexCount * Morph::STREAM_WIDTH[stream], sentinel);
+		glNamedBufferData(buffers[stream], GLsizeiptr(filled.size() * sizeof(float)), filled.data(), GL_DYNAMIC_DRAW);
+	}
+
+	Morph::MorphOutput output;
+	std::vector<float> weights = { 0.5f, -0.25f, 1.0f };
+	for (size_t pass = 0; pass < 2; ++pass) {
+		Morph::Blend(morph.mesh, weights.data(), weights.size(), output);
+		Morph::Upload_Dirty_Ranges(output, buffers);
+
+		// Marks the vertices the upload had to write
+		std::vector<bool> dirty(morph.mesh.vertexCount, false);
+		for (std::pair<size_t, size_t> const& range : output.dirtyRanges) {
+			std::fill(dirty.begin() + range.first, dirty.begin() + range.first + range.second, true);
+		}
+		for (unsigned stream = 0; stream < Morph::StreamCount; ++stream) {
+			unsigned width = Morph::STREAM_WIDTH[stream];
+			std::vector<float> uploaded(morph.mesh.vertexCount * width);
+			glGetNamedBufferSubData(buffers[stream], 0, GLsizeiptr(uploaded.size() * sizeof(float)), uploaded.data());
+			bool matches = true;
+			for (size_t index = 0; index < uploaded.size(); ++index) {
+				matches = matches && uploaded[index] == (dirty[index / width] ? output.streams[stream][index] : sentinel);
+			}
+			TEST_CHECK(matches);
+			// The next pass must only rewrite the affected vertices
+			std::vector<float> filled(uploaded.size(), sentinel);
+			glNamedBufferSubData(buffers[stream], 0, GLsizeiptr(filled.size() * sizeof(float)), filled.data());
+		}
+		weights = { 0.0f, 0.75f, -1.0f };
+	}
+	TEST_CHECK(Dirty_Ranges_Are_Affected(morph.mesh, output));
+	TEST_CHECK(glGetError() == GL_NO_ERROR);
+	glDeleteBuffers(Morph::StreamCount, buffers);
+}, true);
@@ -0,0 +1,87 @@
+#include "Tests.hpp"
+#include "Occlusion.hpp"
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <vector>
+
+// OcclusionCuller must reject boxes hidden behind an occluder and keep every box it cannot prove hidden, all on the CPU
+
+// Unit cube around the origin, solid from every side
+Occlusion::OccluderMesh Occluder_Cube() {
+	std::vector<float> positions;
+	for (unsigned corner = 0; corner < 8; ++corner) {
+		positions.insert(positions.end(), { corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f });
+	}
+	std::vector<unsigned> indices = {
+		0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5,
+		0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6,
+		0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3
+	};
+	return Occlusion::OccluderMesh(std::move(positions), std::move(indices));
+}
+
+AABB Box_At(glm::vec3 const& center, glm::vec3 const& halfSize) {
+	return AABB(center - halfSize, center + halfSize);
+}
+
+Tests::Register occlusionWall("Occlusion_Wall", [] {
+	// Camera at z = 10 looking down -z, a 20 x 20 x 1 wall at the origin
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	glm::mat4 wall = glm::scale(glm::mat4(1.0f), glm::vec3(20.0f, 20.0f, 1.0f));
+	Occlusion::OccluderMesh cube = Occluder_Cube();
+
+	std::vector<AABB> boxes = {
+		// Behind the wall
+		Box_At(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.5f)),
+		Box_At(glm::vec3(3.0f, -2.0f, -30.0f), glm::vec3(2.0f)),
+		// In front of the wall
+		Box_At(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.5f)),
+		// Behind the wall but reaching past its edge on screen
+		Box_At(glm::vec3(14.0f, 0.0f, -5.0f), glm::vec3(2.0f, 0.5f, 0.5f)),
+		// Crossing the near plane, its corners behind the camera cannot be projected
+		Box_At(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.5f, 0.5f, 1.0f)),
+		// Touching the wall's front face
+		Box_At(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.5f))
+	};
+	std::vector<bool> expected = { false, false, true, true, true, true };
+
+	for (bool parallel : { false, true }) {
+		ThreadPool* pool = parallel ? &Default_Thread_Pool() : nullptr;
+		Occlusion::OcclusionCuller culler;
+		culler.Begin(projection * view);
+		culler.Add_Occluder(cube, wall);
+		culler.Render(pool);
+		TEST_CHECK(culler.statistics.occluderTriangles == 12 && culler.statistics.rasterizedTriangles > 0);
+		for (size_t box = 0; box < boxes.size(); ++box) {
+			TEST_CHECK(culler.Visible(boxes[box]) == expected[box]);
+		}
+
+		std::vector<unsigned> visible = { 0, 1, 2, 3, 4, 5 };
+		culler.Cull(boxes.data(), visible, pool);
+		TEST_CHECK((visible == std::vector<unsigned>{ 2, 3, 4, 5 }));
+		TEST_CHECK(culler.statistics.tested == 6 && culler.statistics.occluded == 2);
+
+		// Without occluders nothing is hidden
+		culler.Begin(projection * view);
+		culler.Render(pool);
+		for (AABB const& box : boxes) {
+			TEST_CHECK(culler.Visible(box));
+		}
+	}
+});
+
+Tests::Register occlusionNearOccluder("Occlusion_Near_Occluder", [] {
+	// Occluders crossing the near plane are dropped rather than clipped, nothing behind them may be rejected
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	// A slope from below and behind the camera up past the box, it lies between the two
+	Occlusion::OccluderMesh slope({ -50.0f, -50.0f, 20.0f, 50.0f, -50.0f, 20.0f, -50.0f, 50.0f, -20.0f, 50.0f, 50.0f, -20.0f }, { 0, 1, 3, 0, 3, 2 });
+
+	Occlusion::OcclusionCuller culler;
+	culler.Begin(projection * view);
+	culler.Add_Occluder(slope, glm::mat4(1.0f));
+	culler.Render();
+	TEST_CHECK(culler.statistics.occluderTriangles == 2 && culler.statistics.rasterizedTriangles == 0);
+	TEST_CHECK(culler.Visible(Box_At(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.5f))));
+});
@@ -0,0 +1,214 @@
+#include "Tests.hpp"
+#include "OffsetAllocator.hpp"
+#include "BufferArena.hpp"
+#include <GLAD\gl.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// OffsetAllocator ranges must never overlap, must merge back into one range when freed and must keep their contents through Defragment
+
+struct LiveRange {
+	uint32_t allocation;
+	uint32_t offset;
+	uint32_t size;
+};
+
+// Ranges inside the space and apart from each other, free units are the rest
+bool Ranges_Consistent(OffsetAllocator const& allocator, std::vector<LiveRange> ranges) {
+	std::sort(ranges.begin(), ranges.end(), [](LiveRange const& left, LiveRange const& right) { return left.offset < right.offset; });
+	uint32_t used = 0;
+	for (size_t index = 0; index < ranges.size(); ++index) {
+		if (allocator.Offset(ranges[index].allocation) != ranges[index].offset || allocator.Size(ranges[index].allocation) != ranges[index].size) {
+			return false;
+		}
+		if (ranges[index].offset + ranges[index].size > allocator.Capacity()) {
+			return false;
+		}
+		if (index > 0 && ranges[index - 1].offset + ranges[index - 1].size > ranges[index].offset) {
+			return false;
+		}
+		used += ranges[index].size;
+	}
+	return allocator.Free_Units() == allocator.Capacity() - used;
+}
+
+Tests::Register offsetAllocatorCoalesce("Offset_Allocator_Coalesce", [] {
+	OffsetAllocator allocator(1000);
+	uint32_t a = allocator.Allocate(300);
+	uint32_t b = allocator.Allocate(200);
+	uint32_t c = allocator.Allocate(100);
+	TEST_CHECK(allocator.Offset(a) == 0 && allocator.Offset(b) == 300 && allocator.Offset(c) == 500);
+	TEST_CHECK(allocator.Free_Units() == 400 && allocator.Largest_Free() == 400);
+	// Empty requests still take a unit so handles stay distinct
+	uint32_t empty = allocator.Allocate(0);
+	TEST_CHECK(allocator.Size(empty) == 1);
+	allocator.Free(empty);
+
+	// Neither neighbour of b is free yet
+	allocator.Free(b);
+	TEST_CHECK(allocator.Largest_Free() == 400 && allocator.Free_Units() == 600);
+	// a merges with b on its right into a range larger than the tail
+	allocator.Free(a);
+	TEST_CHECK(allocator.Largest_Free() == 500);
+	uint32_t fill = allocator.Allocate(500);
+	TEST_CHECK(fill != OffsetAllocator::NO_SPACE && allocator.Offset(fill) == 0);
+	allocator.Free(fill);
+	// c merges with a + b on its left and the tail on its right
+	allocator.Free(c);
+	TEST_CHECK(allocator.Largest_Free() == 1000 && allocator.Free_Units() == 1000);
+
+	// Freed handles are not allocations any more
+	bool threw = false;
+	try {
+		allocator.Free(c);
+	}
+	catch (std::runtime_error const&) {
+		threw = true;
+	}
+	TEST_CHECK(threw);
+});
+
+Tests::Register offsetAllocatorExhaustion("Offset_Allocator_Exhaustion", [] {
+	OffsetAllocator allocator(1000);
+	uint32_t big = allocator.Allocate(999);
+	TEST_CHECK(big != OffsetAllocator::NO_SPACE);
+	TEST_CHECK(allocator.Allocate(2) == OffsetAllocator::NO_SPACE);
+	uint32_t last = allocator.Allocate(1);
+	TEST_CHECK(last != OffsetAllocator::NO_SPACE && allocator.Offset(last) == 999);
+	TEST_CHECK(allocator.Allocate(1) == OffsetAllocator::NO_SPACE && allocator.Free_Units() == 0);
+
+	// Any request up to the largest free range succeeds, anything larger fails, whatever bin the range is filed under
+	std::mt19937 random(45);
+	OffsetAllocator fragmented(100000);
+	std::vector<LiveRange> ranges;
+	for (size_t step = 0; step < 4000; ++step) {
+		if (!ranges.empty() && random() % 2) {
+			size_t index = random() % ranges.size();
+			fragmented.Free(ranges[index].allocation);
+			ranges[index] = ranges.back();
+			ranges.pop_back();
+			continue;
+		}
+		uint32_t size = 1 + uint32_t(random() % 700);
+		uint32_t largest = fragmented.Largest_Free();
+		uint32_t allocation = fragmented.Allocate(size);
+		TEST_CHECK((allocation != OffsetAllocator::NO_SPACE) == (size <= largest));
+		if (allocation != OffsetAllocator::NO_SPACE) {
+			ranges.push_back({ allocation, fragmented.Offset(allocation), size });
+		}
+	}
+	TEST_CHECK(Ranges_Consistent(fragmented, ranges));
+	for (LiveRange const& range : ranges) {
+		fragmented.Free(range.allocation);
+	}
+	TEST_CHECK(fragmented.Largest_Free() == fragmented.Capacity());
+});
+
+Tests::Register offsetAllocatorGrow("Offset_Allocator_Grow", [] {
+	OffsetAllocator allocator(100);
+	uint32_t first = allocator.Allocate(100);
+	TEST_CHECK(allocator.Allocate(10) == OffsetAllocator::NO_SPACE);
+	// New units follow the used last range
+	allocator.Grow(150);
+	uint32_t second = allocator.Allocate(20);
+	TEST_CHECK(allocator.Offset(first) == 0 && allocator.Offset(second) == 100);
+	// A free last range is extended rather than followed by another
+	allocator.Grow(400);
+	TEST_CHECK(allocator.Capacity() == 400 && allocator.Largest_Free() == 280);
+	// Shrinking is ignored
+	allocator.Grow(50);
+	TEST_CHECK(allocator.Capacity() == 400);
+});
+
+Tests::Register offsetAllocatorDefragment("Offset_Allocator_Defragment", [] {
+	std::mt19937 random(46);
+	OffsetAllocator allocator(20000);
+	// Each unit holds the allocation that owns it, moves are applied to this copy the way BufferArena copies its buffers
+	std::vector<uint32_t> memory(allocator.Capacity(), OffsetAllocator::NO_SPACE);
+	std::vector<LiveRange> ranges;
+	for (size_t step = 0; step < 600; ++step) {
+		if (!ranges.empty() && random() % 3 == 0) {
+			size_t index = random() % ranges.size();
+			allocator.Free(ranges[index].allocation);
+			ranges[index] = ranges.back();
+			ranges.pop_back();
+			continue;
+		}
+		uint32_t size = 1 + uint32_t(random() % 90);
+		uint32_t allocation = allocator.Allocate(size);
+		if (allocation == OffsetAllocator::NO_SPACE) {
+			continue;
+		}
+		ranges.push_back({ allocation, allocator.Offset(allocation), size });
+		std::fill(memory.begin() + ranges.back().offset, memory.begin() + ranges.back().offset + size, allocation);
+	}
+	std::vector<LiveRange> before = ranges;
+	std::sort(before.begin(), before.end(), [](LiveRange const& left, LiveRange const& right) { return left.offset < right.offset; });
+
+	std::vector<OffsetAllocator::Move> moves = allocator.Defragment();
+	TEST_CHECK(!moves.empty());
+	for (size_t index = 0; index < moves.size(); ++index) {
+		OffsetAllocator::Move const& move = moves[index];
+		TEST_CHECK(move.to < move.from && (index == 0 || moves[index - 1].to + moves[index - 1].size <= move.to));
+		std::memmove(memory.data() + move.to, memory.data() + move.from, move.size * sizeof(uint32_t));
+	}
+
+	// Packed from 0 in the order they were in, every range still holds its own units
+	uint32_t cursor = 0;
+	bool packed = true;
+	bool kept = true;
+	for (LiveRange& range : before) {
+		packed = packed && allocator.Offset(range.allocation) == cursor;
+		range.offset = cursor;
+		kept = kept && std::all_of(memory.begin() + cursor, memory.begin() + cursor + range.size, [&](uint32_t owner) { return owner == range.allocation; });
+		cursor += range.size;
+	}
+	TEST_CHECK(packed && kept);
+	TEST_CHECK(Ranges_Consistent(allocator, before));
+	TEST_CHECK(allocator.Largest_Free() == allocator.Capacity() - cursor);
+	// A packed space has nothing left to move
+	TEST_CHECK(allocator.Defragment().empty());
+});
+
+Tests::Register bufferArenaDefragment("Buffer_Arena_Defragment", [] {
+	// Overlapping moves go through a scratch buffer, each mesh's vertices and indices must survive them
+	std::shared_ptr<BufferFormat> format = std::make_shared<BufferFormat>(alignof(float));
+	format->AddFloat(1);
+	BufferArena arena(format, 64, 64);
+	std::vector<size_t> meshes;
+	std::vector<std::vector<float>> contents;
+	for (size_t mesh = 0; mesh < 12; ++mesh) {
+		std::vector<float> vertices(5 + mesh * 3);
+		for (size_t vertex = 0; vertex < vertices.size(); ++vertex) {
+			vertices[vertex] = float(mesh * 1000 + vertex);
+		}
+		meshes.emplace_back(arena.Add(vertices, std::vector<unsigned int>(vertices.size(), unsigned(mesh))));
+		contents.emplace_back(std::move(vertices));
+	}
+	for (size_t mesh = 0; mesh < meshes.size(); mesh += 3) {
+		arena.Remove(meshes[mesh]);
+	}
+	arena.Defragment();
+
+	bool matches = true;
+	GLuint previousEnd = 0;
+	for (size_t mesh = 0; mesh < meshes.size(); ++mesh) {
+		if (mesh % 3 == 0) {
+			continue;
+		}
+		BufferArena::Range range = arena.MeshRange(meshes[mesh]);
+		matches = matches && GLuint(range.baseVertex) == previousEnd;
+		previousEnd += range.vertexCount;
+		std::vector<float> vertices(range.vertexCount);
+		std::vector<unsigned int> indices(range.indexCount);
+		glGetNamedBufferSubData(arena.VertexBuffer()->BufferId(), GLintptr(range.baseVertex) * GLintptr(sizeof(float)), GLsizeiptr(vertices.size() * sizeof(float)), vertices.data());
+		glGetNamedBufferSubData(arena.IndexBuffer()->BufferId(), GLintptr(range.firstIndex) * GLintptr(sizeof(unsigned int)), GLsizeiptr(indices.size() * sizeof(unsigned int)), indices.data());
+		matches = matches && vertices == contents[mesh] && std::all_of(indices.begin(), indices.end(), [&](unsigned int index) { return index == unsigned(mesh); });
+	}
+	TEST_CHECK(matches);
+	TEST_CHECK(glGetError() == GL_NO_ERROR);
+}, true);
@@ -0,0 +1,251 @@
+#include "Tests.hpp"
+#include "RayCast.hpp"
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+// RayCast hits must be the closest of testing every triangle, alone, in packets and through placed instances
+
+// Heightfield of cells x cells quads, two triangles each, one unit per cell
+void Terrain_Mesh(size_t cells, std::vector<float>& positions, std::vector<unsigned>& indices) {
+	std::mt19937 random(35);
+	std::uniform_real_distribution<float> noise(-0.2f, 0.2f);
+	positions.clear();
+	indices.clear();
+	for (size_t z = 0; z <= cells; ++z) {
+		for (size_t x = 0; x <= cells; ++x) {
+			float height = 4.0f * std::sin(float(x) * 0.05f) * std::cos(float(z) * 0.07f) + noise(random);
+			positions.insert(positions.end(), { float(x), height, float(z) });
+		}
+	}
+	unsigned const row = unsigned(cells + 1);
+	for (unsigned z = 0; z < unsigned(cells); ++z) {
+		for (unsigned x = 0; x < unsigned(cells); ++x) {
+			unsigned corner = z * row + x;
+			indices.insert(indices.end(), { corner, corner + row, corner + 1, corner + 1, corner + row, corner + row + 1 });
+		}
+	}
+}
+
+// Moller-Trumbore over every triangle, both faces count
+RayCast::Hit Brute_Force_Hit(std::vector<float> const& positions, std::vector<unsigned> const& indices, RayCast::Ray const& ray) {
+	RayCast::Hit hit;
+	for (size_t triangle = 0; triangle < indices.size() / 3; ++triangle) {
+		glm::vec3 corners[3];
+		for (size_t corner = 0; corner < 3; ++corner) {
+			float const* position = positions.data() + size_t(indices[triangle * 3 + corner]) * 3;
+			corners[corner] = glm::vec3(position[0], position[1], position[2]);
+		}
+		glm::vec3 edge1 = corners[1] - corners[0];
+		glm::vec3 edge2 = corners[2] - corners[0];
+		glm::vec3 p = glm::cross(ray.direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (std::fabs(determinant) <= RayCast::PARALLEL_EPSILON) {
+			continue;
+		}
+		glm::vec3 t = ray.origin - corners[0];
+		float u = glm::dot(t, p) / determinant;
+		glm::vec3 q = glm::cross(t, edge1);
+		float v = glm::dot(ray.direction, q) / determinant;
+		float distance = glm::dot(edge2, q) / determinant;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f && distance < std::min(hit.distance, ray.maxDistance)) {
+			hit.triangle = unsigned(triangle);
+			hit.distance = distance;
+			hit.u = u;
+			hit.v = v;
+		}
+	}
+	return hit;
+}
+
+// Rays from above the terrain towards random points on it, some aimed past its edges so they miss
+std::vector<RayCast::Ray> Terrain_Rays(std::mt19937& random, size_t count, float size) {
+	std::uniform_real_distribution<float> across(-0.1f * size, 1.1f * size);
+	std::uniform_real_distribution<float> height(5.0f, 30.0f);
+	std::vector<RayCast::Ray> rays;
+	for (size_t ray = 0; ray < count; ++ray) {
+		RayCast::Ray cast;
+		cast.origin = glm::vec3(across(random), height(random), across(random));
+		cast.direction = glm::normalize(glm::vec3(across(random), 0.0f, across(random)) - cast.origin);
+		rays.emplace_back(cast);
+	}
+	return rays;
+}
+
+// Hits agree when both miss, or both hit at the same distance, the triangle may differ where two meet
+bool Same_Hit(RayCast::Hit const& hit, RayCast::Hit const& expected, float tolerance) {
+	return hit.Valid() == expected.Valid() && (!hit.Valid() || std::fabs(hit.distance - expected.distance) <= tolerance * std::max(1.0f, expected.distance));
+}
+
+Tests::Register rayCastMatchesBruteForce("Ray_Cast_Matches_Brute_Force", [] {
+	std::vector<float> positions;
+	std::vector<unsigned> indices;
+	Terrain_Mesh(48, positions, indices);
+	std::mt19937 random(36);
+	std::vector<RayCast::Ray> rays = Terrain_Rays(random, 500, 48.0f);
+	// A short ray stops above the ground
+	rays[0].origin = glm::vec3(10.5f, 20.0f, 10.5f);
+	rays[0].direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	rays[0].maxDistance = 5.0f;
+
+	for (bool parallel : { false, true }) {
+		RayCast::TriangleBVH mesh(positions, indices, parallel ? &Default_Thread_Pool() : nullptr);
+		TEST_CHECK(mesh.TriangleCount() == indices.size() / 3);
+		size_t hitCount = 0;
+		bool matches = true;
+		for (RayCast::Ray const& ray : rays) {
+			RayCast::Hit hit;
+			mesh.Intersect(ray, hit);
+			RayCast::Hit expected = Brute_Force_Hit(positions, indices, ray);
+			matches = matches && Same_Hit(hit, expected, 1e-4f);
+			hitCount += hit.Valid() ? 1 : 0;
+		}
+		TEST_CHECK(matches);
+		TEST_CHECK(!Brute_Force_Hit(positions, indices, rays[0]).Valid());
+		// Both hits and misses were tried
+		TEST_CHECK(hitCount > rays.size() / 2 && hitCount < rays.size());
+
+		// Packets give the hits of their rays traced one at a time, also when fewer than PACKET_SIZE are given
+		bool packed = true;
+		for (size_t first = 0; first < rays.size(); first += RayCast::PACKET_SIZE - (first % 3 == 0 ? 1 : 0)) {
+			size_t count = std::min(RayCast::PACKET_SIZE - (first % 3 == 0 ? 1 : 0), rays.size() - first);
+			RayCast::Hit hits[RayCast::PACKET_SIZE];
+			mesh.Intersect_Packet(rays.data() + first, count, hits);
+			for (size_t ray = 0; ray < count; ++ray) {
+				RayCast::Hit single;
+				mesh.Intersect(rays[first + ray], single);
+				packed = packed && hits[ray].triangle == single.triangle && hits[ray].distance == single.distance;
+			}
+		}
+		TEST_CHECK(packed);
+	}
+
+	// Indices past the last vertex are refused
+	std::vector<unsigned> broken = { 0, 1, unsigned(positions.size() / 3) };
+	bool threw = false;
+	try {
+		RayCast::TriangleBVH invalid(positions, broken);
+	}
+	catch (std::out_of_range const&) {
+		threw = true;
+	}
+	TEST_CHECK(threw);
+});
+
+Tests::Register rayCastScene("Ray_Cast_Scene", [] {
+	std::vector<float> positions;
+	std::vector<unsigned> indices;
+	Terrain_Mesh(16, positions, indices);
+	std::shared_ptr<RayCast::TriangleBVH const> mesh = std::make_shared<RayCast::TriangleBVH const>(positions, indices);
+
+	// Instances of one mesh moved, turned and scaled, each checked against its triangles moved into world space
+	std::vector<glm::mat4> worlds = {
+		glm::mat4(1.0f),
+		glm::translate(glm::mat4(1.0f), glm::vec3(20.0f, 2.0f, 0.0f)) * glm::rotate(glm::mat4(1.0f), 0.7f, glm::vec3(0.0f, 1.0f, 0.0f)),
+		glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -3.0f, 25.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(1.5f, 0.5f, 1.5f))
+	};
+	RayCast::Scene scene;
+	std::vector<float> worldPositions;
+	std::vector<unsigned> worldIndices;
+	for (size_t instance = 0; instance < worlds.size(); ++instance) {
+		TEST_CHECK(scene.Add_Instance(mesh, worlds[instance]) == instance);
+		unsigned first = unsigned(worldPositions.size() / 3);
+		for (size_t vertex = 0; vertex < positions.size() / 3; ++vertex) {
+			glm::vec3 moved(worlds[instance] * glm::vec4(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2], 1.0f));
+			worldPositions.insert(worldPositions.end(), { moved.x, moved.y, moved.z });
+		}
+		for (unsigned index : indices) {
+			worldIndices.emplace_back(first + index);
+		}
+	}
+	scene.Build();
+
+	std::mt19937 random(37);
+	std::vector<RayCast::Ray> rays = Terrain_Rays(random, 400, 45.0f);
+	size_t const triangles = indices.size() / 3;
+	bool matches = true;
+	for (RayCast::Ray const& ray : rays) {
+		RayCast::SceneHit hit = scene.Intersect(ray);
+		RayCast::Hit expected = Brute_Force_Hit(worldPositions, worldIndices, ray);
+		matches = matches && Same_Hit(hit.hit, expected, 1e-3f) && (!hit.Valid() || hit.instance == expected.triangle / triangles);
+	}
+	TEST_CHECK(matches);
+
+	// Moving an instance and refitting finds it in its new place
+	worlds[0] = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 40.0f, 0.0f));
+	scene.Set_Transform(0, worlds[0]);
+	scene.Refit();
+	RayCast::Ray down;
+	down.origin = glm::vec3(8.0f, 100.0f, 8.0f);
+	down.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	RayCast::SceneHit moved = scene.Intersect(down);
+	TEST_CHECK(moved.Valid() && moved.instance == 0 && moved.hit.distance < 70.0f);
+
+	// Batches give the single ray hits
+	std::vector<RayCast::SceneHit> hits(rays.size());
+	scene.Intersect_Batch(rays.data(), rays.size(), hits.data(), Default_Thread_Pool());
+	bool same = true;
+	for (size_t ray = 0; ray < rays.size(); ++ray) {
+		RayCast::SceneHit single = scene.Intersect(rays[ray]);
+		same = same && hits[ray].instance == single.instance && hits[ray].hit.triangle == single.hit.triangle && hits[ray].hit.distance == single.hit.distance;
+	}
+	TEST_CHECK(same);
+});
+
+Tests::Register rayCastBenchmark("Ray_Cast_Benchmark", [] {
+	std::vector<float> positions;
+	std::vector<unsigned> indices;
+	// About a million triangles
+	size_t const cells = 708;
+	Terrain_Mesh(cells, positions, indices);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	RayCast::TriangleBVH mesh(positions, indices, &Default_Thread_Pool());
+	double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// Incoherent rays from anywhere above the terrain
+	std::mt19937 random(38);
+	std::vector<RayCast::Ray> rays = Terrain_Rays(random, 100000, float(cells));
+	size_t hitCount = 0;
+	start = std::chrono::steady_clock::now();
+	for (RayCast::Ray const& ray : rays) {
+		RayCast::Hit hit;
+		mesh.Intersect(ray, hit);
+		hitCount += hit.Valid() ? 1 : 0;
+	}
+	double incoherentMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(rays.size());
+
+	// Coherent packets, neighbouring pixels of a camera looking down at the terrain
+	glm::vec3 eye(float(cells) * 0.5f, 60.0f, float(cells) * 0.5f);
+	std::vector<RayCast::Ray> pixels;
+	for (size_t y = 0; y < 200; ++y) {
+		for (size_t x = 0; x < 500; ++x) {
+			RayCast::Ray ray;
+			ray.origin = eye;
+			ray.direction = glm::normalize(glm::vec3(float(x) / 250.0f - 1.0f, -1.0f, float(y) / 100.0f - 1.0f));
+			pixels.emplace_back(ray);
+		}
+	}
+	start = std::chrono::steady_clock::now();
+	for (size_t first = 0; first < pixels.size(); first += RayCast::PACKET_SIZE) {
+		RayCast::Hit hits[RayCast::PACKET_SIZE];
+		mesh.Intersect_Packet(pixels.data() + first, RayCast::PACKET_SIZE, hits);
+		hitCount += hits[0].Valid() ? 1 : 0;
+	}
+	double packetMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(pixels.size());
+	start = std::chrono::steady_clock::now();
+	for (RayCast::Ray const& ray : pixels) {
+		RayCast::Hit hit;
+		mesh.Intersect(ray, hit);
+		hitCount += hit.Valid() ? 1 : 0;
+	}
+	double coherentMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(pixels.size());
+	TEST_CHECK(hitCount > 0);
+	// Timings are reported, not checked, they depend on the machine and the build
+	std::printf("  %zu triangles: build %.0f ms, %.2f us per incoherent ray, %.2f us per coherent ray, %.2f us per ray in packets of %zu\n",
+		mesh.TriangleCount(), buildMilliseconds, incoherentMicroseconds, coherentMicroseconds, packetMicroseconds, RayCast::PACKET_SIZE);
+});
@@ -0,0 +1,186 @@
+#include "Tests.hpp"
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// RenderQueue keys must decode to the fields they were made from, and Radix_Sort must order packets as std::stable_sort does
+
+RenderQueue::Fields Random_Fields(std::mt19937& random) {
+	RenderQueue::Fields fields;
+	fields.pass = RenderQueue::Pass(random() % 4);
+	fields.program = uint32_t(random() % (1u << RenderQueue::PROGRAM_BITS));
+	fields.format = uint32_t(random() % (1u << RenderQueue::FORMAT_BITS));
+	fields.material = uint32_t(random() % (1u << RenderQueue::MATERIAL_BITS));
+	fields.textures = uint32_t(random() % (1u << RenderQueue::TEXTURES_BITS));
+	fields.depth = uint32_t(random() % (RenderQueue::MAX_DEPTH + 1));
+	return fields;
+}
+
+// Packets of a frame: a few programs and formats, many materials, a fifth of them transparent when asked
+std::vector<RenderQueue::Packet> Random_Packets(std::mt19937& random, size_t count, bool transparent) {
+	std::vector<RenderQueue::Packet> packets;
+	for (uint32_t index = 0; index < uint32_t(count); ++index) {
+		RenderQueue::Fields fields = Random_Fields(random);
+		fields.pass = transparent && random() % 5 == 0 ? RenderQueue::Pass::Transparent : RenderQueue::Pass::Opaque;
+		fields.program %= 4;
+		fields.format %= 2;
+		fields.material %= 300;
+		// Repeated keys show whether equal keys keep their order
+		fields.depth %= 64;
+		packets.push_back({ RenderQueue::Make_Key(fields), index, 0 });
+	}
+	return packets;
+}
+
+bool Same_Packets(std::vector<RenderQueue::Packet> const& left, std::vector<RenderQueue::Packet> const& right) {
+	return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(), [](RenderQueue::Packet const& a, RenderQueue::Packet const& b) {
+		return a.key == b.key && a.index == b.index;
+	});
+}
+
+void Stable_Sort_Packets(std::vector<RenderQueue::Packet>& packets) {
+	std::stable_sort(packets.begin(), packets.end(), [](RenderQueue::Packet const& left, RenderQueue::Packet const& right) { return left.key < right.key; });
+}
+
+Tests::Register renderQueueKeyRoundTrip("Render_Queue_Key_Round_Trip", [] {
+	std::mt19937 random(50);
+	bool decoded = true;
+	for (size_t test = 0; test < 10000; ++test) {
+		RenderQueue::Fields fields = Random_Fields(random);
+		RenderQueue::Fields back = RenderQueue::Decode_Key(RenderQueue::Make_Key(fields));
+		decoded = decoded && back.pass == fields.pass && back.program == fields.program && back.format == fields.format &&
+			back.material == fields.material && back.textures == fields.textures && back.depth == fields.depth;
+	}
+	TEST_CHECK(decoded);
+
+	// Opaque draws of one state go front to back, transparent ones back to front whatever their state
+	RenderQueue::Fields near;
+	near.depth = 10;
+	RenderQueue::Fields far = near;
+	far.depth = 1000;
+	TEST_CHECK(RenderQueue::Make_Key(near) < RenderQueue::Make_Key(far));
+	near.pass = far.pass = RenderQueue::Pass::Transparent;
+	far.program = 0;
+	near.program = 5;
+	TEST_CHECK(RenderQueue::Make_Key(far) < RenderQueue::Make_Key(near));
+	// Passes lead every key
+	RenderQueue::Fields overlay;
+	overlay.pass = RenderQueue::Pass::Overlay;
+	TEST_CHECK(RenderQueue::Make_Key(far) < RenderQueue::Make_Key(overlay));
+
+	// Fields too wide for the key are refused rather than spilling into their neighbours
+	RenderQueue::Fields wide;
+	wide.material = 1u << RenderQueue::MATERIAL_BITS;
+	bool threw = false;
+	try {
+		RenderQueue::Make_Key(wide);
+	}
+	catch (std::runtime_error const&) {
+		threw = true;
+	}
+	TEST_CHECK(threw);
+});
+
+Tests::Register renderQueueRadixSort("Render_Queue_Radix_Sort", [] {
+	std::mt19937 random(51);
+	// Around the insertion sort limit, and large enough for every radix pass
+	for (size_t count : { size_t(0), size_t(1), size_t(RenderQueue::INSERTION_SORT_LIMIT - 1), size_t(RenderQueue::INSERTION_SORT_LIMIT), size_t(1000), size_t(50000) }) {
+		for (bool transparent : { false, true }) {
+			std::vector<RenderQueue::Packet> packets = Random_Packets(random, count, transparent);
+			std::vector<RenderQueue::Packet> expected = packets;
+			Stable_Sort_Packets(expected);
+			std::vector<RenderQueue::Packet> scratch;
+			size_t passes = RenderQueue::Radix_Sort(packets, scratch);
+			TEST_CHECK(Same_Packets(packets, expected));
+			// Opaque keys of the first four programs share their top byte, it is never sorted on
+			TEST_CHECK(count < RenderQueue::INSERTION_SORT_LIMIT ? passes == 0 : passes <= (transparent ? 8 : 7));
+		}
+	}
+
+	// Fully random keys need every pass
+	std::vector<RenderQueue::Packet> packets;
+	for (uint32_t index = 0; index < 5000; ++index) {
+		packets.push_back({ (uint64_t(random()) << 32) | random(), index, 0 });
+	}
+	std::vector<RenderQueue::Packet> expected = packets;
+	Stable_Sort_Packets(expected);
+	std::vector<RenderQueue::Packet> scratch;
+	TEST_CHECK(RenderQueue::Radix_Sort(packets, scratch) == 8 && Same_Packets(packets, expected));
+});
+
+Tests::Register renderQueueSubmit("Render_Queue_Submit", [] {
+	RenderQueue::RenderQueue queue;
+	RenderQueue::Fields fields;
+	fields.program = 2;
+	fields.material = 7;
+	fields.depth = 30;
+	queue.Push(fields, 0);
+	fields.depth = 10;
+	queue.Push(fields, 1);
+	fields.material = 3;
+	queue.Push(fields, 2);
+	fields.pass = RenderQueue::Pass::Transparent;
+	queue.Push(fields, 3);
+
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> changes;
+	queue.Submit([&](RenderQueue::Packet const& packet, RenderQueue::Fields const& decoded, uint32_t changed) {
+		order.push_back(packet.index);
+		changes.push_back(changed);
+		TEST_CHECK(RenderQueue::Make_Key(decoded) == packet.key);
+	});
+	TEST_CHECK((order == std::vector<uint32_t>{ 2, 1, 0, 3 }));
+	uint32_t const all = RenderQueue::CHANGED_PASS | RenderQueue::CHANGED_PROGRAM | RenderQueue::CHANGED_FORMAT | RenderQueue::CHANGED_MATERIAL | RenderQueue::CHANGED_TEXTURES;
+	TEST_CHECK((changes == std::vector<uint32_t>{ all, RenderQueue::CHANGED_MATERIAL, 0, RenderQueue::CHANGED_PASS | RenderQueue::CHANGED_MATERIAL }));
+	TEST_CHECK(queue.statistics.packets == 4 && queue.statistics.stateChanges == 8);
+	// Too few packets for the radix passes
+	TEST_CHECK(queue.statistics.radixPasses == 0 && queue.statistics.skippedPasses == 0);
+
+	// A frame of opaque packets skips at least the shared top byte
+	std::mt19937 random(53);
+	queue.Clear();
+	for (RenderQueue::Packet const& packet : Random_Packets(random, 1000, false)) {
+		queue.Push(packet.key, packet.index);
+	}
+	queue.Sort();
+	TEST_CHECK(queue.statistics.skippedPasses >= 1 && queue.statistics.radixPasses + queue.statistics.skippedPasses == 8);
+	uint64_t previousKey = 0;
+	bool ordered = true;
+	queue.Submit([&](RenderQueue::Packet const& packet, RenderQueue::Fields const&, uint32_t) {
+		ordered = ordered && packet.key >= previousKey;
+		previousKey = packet.key;
+	});
+	TEST_CHECK(ordered && queue.statistics.packets == 1004);
+
+	queue.Clear();
+	TEST_CHECK(queue.Size() == 0);
+});
+
+Tests::Register renderQueueBenchmark("Render_Queue_Benchmark", [] {
+	std::mt19937 random(52);
+	size_t const count = 200000;
+	size_t const repeats = 5;
+	std::vector<RenderQueue::Packet> source = Random_Packets(random, count, true);
+	std::vector<RenderQueue::Packet> packets;
+	std::vector<RenderQueue::Packet> scratch;
+	double radixMilliseconds = 0.0;
+	double stableMilliseconds = 0.0;
+	for (size_t repeat = 0; repeat < repeats; ++repeat) {
+		packets = source;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RenderQueue::Radix_Sort(packets, scratch);
+		radixMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<RenderQueue::Packet> expected = source;
+		start = std::chrono::steady_clock::now();
+		Stable_Sort_Packets(expected);
+		stableMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		TEST_CHECK(Same_Packets(packets, expected));
+	}
+	// Timings are reported, not checked, they depend on the machine and the build
+	std::printf("  %zu packets: Radix_Sort %.2f ms, std::stable_sort %.2f ms\n", count, radixMilliseconds / repeats, stableMilliseconds / repeats);
+});
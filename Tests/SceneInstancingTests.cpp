@@ -0,0 +1,187 @@
+#include "Tests.hpp"
+#include "SceneInstancing.hpp"
+#include "BVH.hpp"
+#include "Culling.hpp"
+#include "JsonParse.hpp"
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Instance bounds patched as streamed meshes are published must match a full Instance_Bounds rebuild, the document is written to the temp directory
+
+// Nodes spread over a few meshes, every fourth node a child of the one before it, meshes have no data as only their bounds are used
+GLTF::GLTFDoc Instancing_Document(size_t nodeCount, size_t meshCount, std::string const& name) {
+	std::mt19937 random(37);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::ostringstream json;
+	json << R"({ "asset": { "version": "2.0" }, "accessors": [ { "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 1, 1 ] } ], "meshes": [ )";
+	for (size_t mesh = 0; mesh < meshCount; ++mesh) {
+		json << (mesh ? ", " : "") << R"({ "primitives": [ { "attributes": { "POSITION": 0 } } ] })";
+	}
+	json << " ], \"nodes\": [ ";
+	std::vector<size_t> roots;
+	for (size_t node = 0; node < nodeCount; ++node) {
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+		matrix = glm::rotate(matrix, 3.14159265f * unit(random), glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 2.0f)));
+		matrix = glm::scale(matrix, glm::vec3(1.5f + unit(random), 1.0f, 1.0f));
+		json << (node ? ", " : "") << "{ \"mesh\": " << node % meshCount << ", \"matrix\": [ ";
+		for (glm::length_t element = 0; element < 16; ++element) {
+			json << (element ? ", " : "") << matrix[element / 4][element % 4];
+		}
+		json << " ]";
+		if (node % 4 != 3 && node + 1 < nodeCount && (node + 1) % 4 == 3) {
+			json << ", \"children\": [ " << node + 1 << " ]";
+		}
+		json << " }";
+		if (node % 4 != 3) {
+			roots.emplace_back(node);
+		}
+	}
+	json << " ], \"scenes\": [ { \"nodes\": [ ";
+	for (size_t root = 0; root < roots.size(); ++root) {
+		json << (root ? ", " : "") << roots[root];
+	}
+	json << " ] } ], \"scene\": 0 }";
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+	std::ofstream(path) << json.str();
+	std::shared_ptr<JsonParse::JsonObject> object = std::static_pointer_cast<JsonParse::JsonObject>(JsonParse::JsonReader::Parse_Json(path).first);
+	GLTF::Validator validate(object);
+	TEST_CHECK(validate.errors.empty());
+	return GLTF::GLTFDoc(object);
+}
+
+// What a loaded streamed document keeps of its instances
+struct StreamedInstances {
+	SceneGraph scene;
+	std::vector<unsigned> nodeSlots;
+	std::vector<std::vector<glm::mat4>> slotInstances;
+	std::vector<AABB> meshBounds;
+	std::vector<AABB> bounds;
+	std::vector<unsigned> slots;
+	std::vector<glm::mat4> worlds;
+	std::vector<SceneInstancing::Batch> batches;
+	BVH instances;
+	Culling::BoundsSoA cullBounds;
+
+	// Every mesh starts with a unit placeholder box, as declared bounds would give
+	StreamedInstances(GLTF::GLTFDoc const& doc) : meshBounds(doc.meshes.size(), AABB(glm::vec3(-0.5f), glm::vec3(0.5f))) {
+		nodeSlots = scene.Add_Document(doc);
+		scene.Update();
+		Rebuild(doc);
+	}
+
+	void Rebuild(GLTF::GLTFDoc const& doc) {
+		SceneInstancing::Instance_Bounds(scene, slotInstances, meshBounds, bounds, slots, worlds);
+		instances.Build(bounds);
+		cullBounds.Assign(bounds);
+		batches = SceneInstancing::Compile(doc, scene, nodeSlots, slots);
+	}
+
+	// The in place path of Publish_Streamed_Meshes
+	std::vector<unsigned> Publish(std::vector<GLTF::index_type> const& meshes, std::mt19937& random) {
+		std::uniform_real_distribution<float> corner(-3.0f, 3.0f);
+		std::vector<unsigned char> published(meshBounds.size(), 0);
+		for (GLTF::index_type mesh : meshes) {
+			glm::vec3 a(corner(random), corner(random), corner(random));
+			glm::vec3 b(corner(random), corner(random), corner(random));
+			meshBounds[mesh] = AABB(glm::min(a, b), glm::max(a, b));
+			published[mesh] = 1;
+		}
+		std::vector<unsigned> patched = SceneInstancing::Patch_Instance_Bounds(batches, published, slotInstances, meshBounds, slots, worlds, bounds);
+		for (unsigned instance : patched) {
+			cullBounds.Set(instance, bounds[instance]);
+		}
+		instances.Refit(bounds.data());
+		return patched;
+	}
+};
+
+bool Same_Cull_Bounds(Culling::BoundsSoA const& left, Culling::BoundsSoA const& right) {
+	return left.Size() == right.Size() && left.centerX == right.centerX && left.centerY == right.centerY && left.centerZ == right.centerZ &&
+		left.extentX == right.extentX && left.extentY == right.extentY && left.extentZ == right.extentZ && left.radius == right.radius;
+}
+
+Tests::Register sceneInstancingPatchMatchesRebuild("Scene_Instancing_Patch_Matches_Rebuild", [] {
+	GLTF::GLTFDoc doc = Instancing_Document(200, 12, "SceneInstancingTests.gltf");
+	StreamedInstances streamed(doc);
+	TEST_CHECK(streamed.bounds.size() == 200);
+	std::mt19937 random(38);
+
+	// Meshes finish in three groups, after each the patched state must be what a rebuild gives
+	std::vector<std::vector<GLTF::index_type>> groups = { { 0, 3, 7 }, { 1, 2 }, { 4, 5, 6, 8, 9, 10, 11 } };
+	for (std::vector<GLTF::index_type> const& group : groups) {
+		std::vector<unsigned> patched = streamed.Publish(group, random);
+		size_t expected = 0;
+		for (unsigned slot : streamed.slots) {
+			expected += std::find(group.begin(), group.end(), streamed.scene.mesh[slot]) != group.end() ? 1 : 0;
+		}
+		TEST_CHECK(patched.size() == expected);
+
+		std::vector<AABB> bounds;
+		std::vector<unsigned> slots;
+		std::vector<glm::mat4> worlds;
+		SceneInstancing::Instance_Bounds(streamed.scene, streamed.slotInstances, streamed.meshBounds, bounds, slots, worlds);
+		bool same = bounds.size() == streamed.bounds.size();
+		for (size_t instance = 0; same && instance < bounds.size(); ++instance) {
+			same = bounds[instance].minimum == streamed.bounds[instance].minimum && bounds[instance].maximum == streamed.bounds[instance].maximum;
+		}
+		TEST_CHECK(same && slots == streamed.slots && worlds == streamed.worlds);
+		Culling::BoundsSoA cullBounds;
+		cullBounds.Assign(bounds);
+		TEST_CHECK(Same_Cull_Bounds(cullBounds, streamed.cullBounds));
+		// The refit tree still holds every box
+		AABB all;
+		for (AABB const& box : bounds) {
+			all.Grow(box);
+		}
+		TEST_CHECK(streamed.instances.nodes[0].Bounds().minimum == all.minimum && streamed.instances.nodes[0].Bounds().maximum == all.maximum);
+	}
+
+	// GPU instances replace a stand in, which keeps its placeholder until the rebuild
+	StreamedInstances instanced(doc);
+	unsigned slot = instanced.nodeSlots[5];
+	instanced.slotInstances.resize(instanced.scene.Size());
+	instanced.slotInstances[slot] = { glm::mat4(1.0f), glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, 0.0f)) };
+	unsigned standIn = unsigned(std::find(instanced.slots.begin(), instanced.slots.end(), slot) - instanced.slots.begin());
+	AABB placeholder = instanced.bounds[standIn];
+	std::vector<unsigned> patched = instanced.Publish({ doc.nodes[5].mesh }, random);
+	TEST_CHECK(std::find(patched.begin(), patched.end(), standIn) == patched.end());
+	TEST_CHECK(instanced.bounds[standIn].minimum == placeholder.minimum && instanced.bounds[standIn].maximum == placeholder.maximum);
+	instanced.Rebuild(doc);
+	TEST_CHECK(instanced.bounds.size() == 201 && std::count(instanced.slots.begin(), instanced.slots.end(), slot) == 2);
+});
+
+Tests::Register sceneInstancingPatchBenchmark("Scene_Instancing_Patch_Benchmark", [] {
+	GLTF::GLTFDoc doc = Instancing_Document(50000, 500, "SceneInstancingBenchmark.gltf");
+	StreamedInstances streamed(doc);
+	std::mt19937 random(39);
+
+	// One mesh finishing at a time, as a stream publishes them
+	size_t const published = 50;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (GLTF::index_type mesh = 0; mesh < published; ++mesh) {
+		streamed.Publish({ mesh }, random);
+	}
+	double patchMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(published);
+
+	size_t const rebuilds = 5;
+	start = std::chrono::steady_clock::now();
+	for (size_t rebuild = 0; rebuild < rebuilds; ++rebuild) {
+		streamed.Rebuild(doc);
+	}
+	double rebuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(rebuilds);
+	TEST_CHECK(streamed.bounds.size() == doc.nodes.size());
+	// Timings are reported, not checked, they depend on the machine and the build
+	std::printf("  %zu instances: %.3f ms to patch a published mesh and refit, %.2f ms to rebuild the instances, hierarchy and batches\n",
+		streamed.bounds.size(), patchMilliseconds, rebuildMilliseconds);
+});
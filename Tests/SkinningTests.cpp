@@ -0,0 +1,137 @@
+#include "Tests.hpp"
+#include "Skinning.hpp"
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// The SSE and AVX2 skinning kernels must match the scalar ones, and dual quaternion skinning of a rigid pose must be that pose
+
+Skinning::SkinnedMesh Random_Skinned_Mesh(std::mt19937& random, size_t vertexCount, unsigned jointCount) {
+	std::uniform_real_distribution<float> coordinate(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Skinning::SkinnedMesh mesh;
+	mesh.vertexCount = vertexCount;
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+		glm::vec3 normal = glm::normalize(glm::vec3(coordinate(random), coordinate(random), coordinate(random)) + glm::vec3(0.01f));
+		glm::vec3 tangent = glm::normalize(glm::cross(normal, glm::vec3(0.3f, 0.5f, 0.8f)));
+		mesh.positions.insert(mesh.positions.end(), { coordinate(random), coordinate(random), coordinate(random) });
+		mesh.normals.insert(mesh.normals.end(), { normal.x, normal.y, normal.z });
+		mesh.tangents.insert(mesh.tangents.end(), { tangent.x, tangent.y, tangent.z, vertex % 2 ? 1.0f : -1.0f });
+		float weights[4] = { unit(random), unit(random), unit(random), unit(random) };
+		// Some vertices follow one joint only
+		if (vertex % 5 == 0) {
+			weights[1] = weights[2] = weights[3] = 0.0f;
+		}
+		float sum = weights[0] + weights[1] + weights[2] + weights[3];
+		for (float weight : weights) {
+			mesh.weights.emplace_back(weight / sum);
+			mesh.joints.emplace_back((unsigned short)(random() % jointCount));
+			mesh.maxJoint = std::max(mesh.maxJoint, unsigned(mesh.joints.back()));
+		}
+	}
+	// Padded so the last vertex can be loaded 4 wide
+	mesh.positions.emplace_back(0.0f);
+	mesh.normals.emplace_back(0.0f);
+	return mesh;
+}
+
+std::vector<glm::mat4> Random_Palette(std::mt19937& random, unsigned jointCount) {
+	std::uniform_real_distribution<float> coordinate(-5.0f, 5.0f);
+	std::uniform_real_distribution<float> angle(-3.1f, 3.1f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+	std::vector<glm::mat4> palette;
+	for (unsigned joint = 0; joint < jointCount; ++joint) {
+		glm::vec3 axis = glm::normalize(glm::vec3(coordinate(random), coordinate(random), coordinate(random)) + glm::vec3(0.01f));
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(coordinate(random), coordinate(random), coordinate(random)));
+		matrix = glm::rotate(matrix, angle(random), axis);
+		palette.emplace_back(glm::scale(matrix, glm::vec3(scale(random))));
+	}
+	return palette;
+}
+
+float Skinned_Difference(std::vector<Skinning::SkinnedVertex> const& a, std::vector<Skinning::SkinnedVertex> const& b) {
+	float difference = 0.0f;
+	for (size_t vertex = 0; vertex < a.size(); ++vertex) {
+		float const* left = a[vertex].position;
+		float const* right = b[vertex].position;
+		for (size_t component = 0; component < sizeof(Skinning::SkinnedVertex) / sizeof(float); ++component) {
+			difference = std::max(difference, std::abs(left[component] - right[component]));
+		}
+	}
+	return difference;
+}
+
+Tests::Register skinningSimdMatchesScalar("Skinning_Simd_Matches_Scalar", [] {
+	std::mt19937 random(29);
+	unsigned const jointCount = 24;
+	// Not a multiple of any vector width, and skinned from an offset like the ranges of Skin_Meshes
+	size_t const vertexCount = 1037;
+	size_t const begin = 3;
+	Skinning::SkinnedMesh mesh = Random_Skinned_Mesh(random, vertexCount, jointCount);
+	std::vector<glm::mat4> palette = Random_Palette(random, jointCount);
+	std::vector<Skinning::DualQuaternion> dualQuaternions;
+	Skinning::Build_Dual_Quaternions(palette, dualQuaternions);
+
+	std::vector<Skinning::SkinnedVertex> linear(vertexCount, Skinning::SkinnedVertex{});
+	std::vector<Skinning::SkinnedVertex> dual(vertexCount, Skinning::SkinnedVertex{});
+	Skinning::Skin_Linear_Blend_Scalar(mesh, palette.data(), begin, vertexCount, linear.data());
+	Skinning::Skin_Dual_Quaternion_Scalar(mesh, dualQuaternions.data(), begin, vertexCount, dual.data());
+	// Positions are at most about 20 from the origin
+	float const tolerance = 1e-4f;
+#ifdef SIMD_SSE
+	for (bool avx2 : { false, true }) {
+		if (avx2 && !Simd::Has_Avx2()) {
+			std::printf("  AVX2 kernels skipped, the CPU does not support them\n");
+			continue;
+		}
+		std::vector<Skinning::SkinnedVertex> simd(vertexCount, Skinning::SkinnedVertex{});
+		Skinning::Skin_Linear_Blend_Simd(mesh, palette.data(), begin, vertexCount, simd.data(), avx2);
+		TEST_CHECK(Skinned_Difference(simd, linear) < tolerance);
+		Skinning::Skin_Dual_Quaternion_Simd(mesh, dualQuaternions.data(), begin, vertexCount, simd.data(), avx2);
+		TEST_CHECK(Skinned_Difference(simd, dual) < tolerance);
+	}
+#else
+	std::printf("  SIMD kernels are not compiled in\n");
+#endif
+	// Vertices before 'begin' are not written
+	TEST_CHECK(linear[0].position[0] == 0.0f && dual[begin - 1].normal[2] == 0.0f);
+});
+
+Tests::Register skinningDualQuaternionRigid("Skinning_Dual_Quaternion_Rigid", [] {
+	std::mt19937 random(30);
+	unsigned const jointCount = 4;
+	size_t const vertexCount = 101;
+	Skinning::SkinnedMesh mesh = Random_Skinned_Mesh(random, vertexCount, jointCount);
+	glm::mat4 pose = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, -2.0f, 3.0f)), glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	std::vector<glm::mat4> palette(jointCount, pose);
+	std::vector<Skinning::DualQuaternion> dualQuaternions;
+	Skinning::Build_Dual_Quaternions(palette, dualQuaternions);
+	// q and -q are the same rotation, blending them must not cancel
+	for (size_t joint = 1; joint < jointCount; joint += 2) {
+		for (size_t index = 0; index < 4; ++index) {
+			dualQuaternions[joint].real[index] = -dualQuaternions[joint].real[index];
+			dualQuaternions[joint].dual[index] = -dualQuaternions[joint].dual[index];
+		}
+	}
+
+	std::vector<Skinning::SkinnedVertex> scalar(vertexCount, Skinning::SkinnedVertex{});
+	std::vector<Skinning::SkinnedVertex> dispatched(vertexCount, Skinning::SkinnedVertex{});
+	Skinning::Skin_Dual_Quaternion_Scalar(mesh, dualQuaternions.data(), 0, vertexCount, scalar.data());
+	Skinning::Skin_Dual_Quaternion(mesh, dualQuaternions.data(), 0, vertexCount, dispatched.data());
+	for (std::vector<Skinning::SkinnedVertex> const* skinned : { &scalar, &dispatched }) {
+		float difference = 0.0f;
+		for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+			glm::vec3 position = glm::vec3(pose * glm::vec4(mesh.positions[vertex * 3], mesh.positions[vertex * 3 + 1], mesh.positions[vertex * 3 + 2], 1.0f));
+			glm::vec3 normal = glm::vec3(pose * glm::vec4(mesh.normals[vertex * 3], mesh.normals[vertex * 3 + 1], mesh.normals[vertex * 3 + 2], 0.0f));
+			Skinning::SkinnedVertex const& output = (*skinned)[vertex];
+			for (glm::length_t component = 0; component < 3; ++component) {
+				difference = std::max(difference, std::abs(output.position[component] - position[component]));
+				difference = std::max(difference, std::abs(output.normal[component] - normal[component]));
+			}
+		}
+		TEST_CHECK(difference < 1e-5f);
+	}
+});
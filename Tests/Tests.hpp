@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal test registry, each test file registers its tests with a static Tests::Register and Main.cpp runs them
+namespace Tests {
+	struct Test {
+		std::string name;
+		std::function<void()> run;
+		// Tests that need a current OpenGL context, Main only creates one when such a test is selected
+		bool needsContext;
+	};
+
+	inline std::vector<Test>& Registry() {
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	// Failed checks of the test being run, Main resets it before each test
+	inline size_t& Failures() {
+		static size_t failures = 0;
+		return failures;
+	}
+
+	inline void Check(bool passed, char const* expression, char const* file, int line) {
+		if (!passed) {
+			std::printf("  %s:%d: %s\n", file, line, expression);
+			++Failures();
+		}
+	}
+
+	struct Register {
+		Register(std::string name, std::function<void()> run, bool needsContext = false) {
+			Registry().push_back({ std::move(name), std::move(run), needsContext });
+		}
+	};
+}
+
+#define TEST_CHECK(expression) Tests::Check(bool(expression), #expression, __FILE__, __LINE__)
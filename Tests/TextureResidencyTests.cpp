@@ -0,0 +1,141 @@
+#include "Tests.hpp"
+#include "TextureResidency.hpp"
+#include <random>
+#include <vector>
+
+// TextureResidency::Residency must stay under its budget, evict the least recently used textures first and never drop a tail
+
+// Square RGBA8 texture with its full chain of levels
+TextureResidency::TextureDesc Square_Texture(int size) {
+	TextureResidency::TextureDesc desc;
+	desc.width = size;
+	desc.height = size;
+	for (int level = size; level > 0; level >>= 1) {
+		desc.levelBytes.emplace_back(size_t(level) * size_t(level) * 4);
+	}
+	return desc;
+}
+
+size_t Level_Range_Bytes(TextureResidency::TextureDesc const& desc, int first) {
+	size_t bytes = 0;
+	for (size_t level = size_t(first); level < desc.levelBytes.size(); ++level) {
+		bytes += desc.levelBytes[level];
+	}
+	return bytes;
+}
+
+// Carries out every load at once, as if each read finished before the next frame
+TextureResidency::Decisions Residency_Frame(TextureResidency::Residency& residency) {
+	TextureResidency::Decisions decisions = residency.Update();
+	for (TextureResidency::Load const& load : decisions.loads) {
+		residency.Loaded(load.texture, load.first);
+	}
+	return decisions;
+}
+
+Tests::Register textureResidencyBudget("Texture_Residency_Budget", [] {
+	std::mt19937 random(43);
+	std::vector<TextureResidency::TextureDesc> descs;
+	TextureResidency::Residency residency(0);
+	size_t tails = 0;
+	for (int size : { 1024, 512, 2048, 256, 64, 1024 }) {
+		descs.emplace_back(Square_Texture(size));
+		size_t texture = residency.Add(descs.back());
+		TEST_CHECK(texture == descs.size() - 1);
+		// The tail is the finest level of at most TAIL_SIZE texels across
+		int tail = 0;
+		while (std::max(size >> tail, 1) > TextureResidency::TAIL_SIZE) {
+			++tail;
+		}
+		tails += Level_Range_Bytes(descs.back(), tail);
+	}
+	size_t const budget = tails + 6 * descs[0].levelBytes[0];
+	residency.Set_Budget(budget);
+
+	// Tails are loaded first whatever was requested
+	TextureResidency::Decisions decisions = Residency_Frame(residency);
+	TEST_CHECK(decisions.loads.size() == descs.size() && decisions.evictions.empty());
+	TEST_CHECK(residency.Used_Bytes() == tails);
+
+	std::uniform_real_distribution<float> level(0.0f, 6.0f);
+	for (size_t frame = 0; frame < 300; ++frame) {
+		for (size_t texture = 0; texture < descs.size(); ++texture) {
+			if (random() % 3 != 0) {
+				residency.Request(texture, frame < 100 ? 0.0f : level(random));
+			}
+		}
+		decisions = Residency_Frame(residency);
+		TEST_CHECK(decisions.loads.size() <= size_t(TextureResidency::LOADS_PER_UPDATE));
+		TEST_CHECK(residency.Used_Bytes() <= budget);
+		// Bytes in use are exactly the resident levels
+		size_t resident = 0;
+		for (size_t texture = 0; texture < descs.size(); ++texture) {
+			resident += Level_Range_Bytes(descs[texture], residency.Resident_Level(texture));
+		}
+		TEST_CHECK(residency.Used_Bytes() == resident);
+	}
+});
+
+Tests::Register textureResidencyEviction("Texture_Residency_Eviction", [] {
+	// 256 texels across: level 0, level 1 and a tail from level 2
+	TextureResidency::TextureDesc desc = Square_Texture(256);
+	size_t const full = Level_Range_Bytes(desc, 0);
+	size_t const tail = Level_Range_Bytes(desc, 2);
+	TextureResidency::Residency residency(2 * full + tail);
+	size_t a = residency.Add(desc);
+	size_t b = residency.Add(desc);
+	size_t c = residency.Add(desc);
+
+	// A and B fill the budget, C keeps its tail
+	for (size_t frame = 0; frame < 4; ++frame) {
+		residency.Request(a, 0.0f);
+		residency.Request(b, 0.0f);
+		Residency_Frame(residency);
+	}
+	TEST_CHECK(residency.Resident_Level(a) == 0 && residency.Resident_Level(b) == 0 && residency.Resident_Level(c) == 2);
+	TEST_CHECK(residency.Used_Bytes() == residency.Budget());
+	// B is used again, A is now the least recently used
+	residency.Request(b, 0.0f);
+	Residency_Frame(residency);
+
+	// C takes one level per frame, each from A
+	residency.Request(c, 0.0f);
+	TextureResidency::Decisions decisions = Residency_Frame(residency);
+	TEST_CHECK(decisions.evictions.size() == 1 && decisions.evictions[0].texture == a && decisions.evictions[0].level == 1);
+	TEST_CHECK(decisions.loads.size() == 1 && decisions.loads[0].texture == c && decisions.loads[0].first == 1);
+	residency.Request(c, 0.0f);
+	decisions = Residency_Frame(residency);
+	TEST_CHECK(decisions.evictions.size() == 1 && decisions.evictions[0].texture == a && decisions.evictions[0].level == 2);
+	TEST_CHECK(residency.Resident_Level(a) == 2 && residency.Resident_Level(b) == 0 && residency.Resident_Level(c) == 0);
+
+	// A shrinking budget is met at the next Update, B was used before C so it goes first, its two levels in one eviction
+	residency.Set_Budget(3 * tail);
+	decisions = Residency_Frame(residency);
+	TEST_CHECK(decisions.loads.empty() && decisions.evictions.size() == 2);
+	TEST_CHECK(decisions.evictions[0].texture == b && decisions.evictions[0].level == 2);
+	TEST_CHECK(decisions.evictions[1].texture == c && decisions.evictions[1].level == 2);
+	TEST_CHECK(residency.Used_Bytes() == 3 * tail);
+
+	// Tails stay when even they do not fit, and nothing finer loads
+	residency.Set_Budget(tail);
+	residency.Request(a, 0.0f);
+	decisions = Residency_Frame(residency);
+	TEST_CHECK(decisions.loads.empty() && decisions.evictions.empty());
+	TEST_CHECK(residency.Used_Bytes() == 3 * tail);
+	for (size_t texture : { a, b, c }) {
+		TEST_CHECK(residency.Resident_Level(texture) == 2);
+	}
+});
+
+Tests::Register textureResidencyFailed("Texture_Residency_Failed", [] {
+	TextureResidency::TextureDesc desc = Square_Texture(128);
+	TextureResidency::Residency residency(Level_Range_Bytes(desc, 0));
+	size_t texture = residency.Add(desc);
+	TextureResidency::Decisions decisions = residency.Update();
+	TEST_CHECK(decisions.loads.size() == 1 && residency.Loading(texture));
+	// A tail that cannot be read releases its bytes and is not asked for again
+	residency.Failed(texture, decisions.loads[0].first, decisions.loads[0].last);
+	TEST_CHECK(residency.Used_Bytes() == 0 && !residency.Loading(texture));
+	residency.Request(texture, 0.0f);
+	TEST_CHECK(residency.Update().loads.empty());
+});